@@ -239,6 +239,7 @@ void BatteryNotifier::sendNotification(BatteryNotifier::NotificationID id)
     QVariantHash hints;
     hints.insert(NotificationManager::HINT_CATEGORY, info.category);
     hints.insert(NotificationManager::HINT_PREVIEW_BODY, info.message);
+    hints.insert(NotificationManager::HINT_VOLATILE, true);
     QueuedNotification queued;
     queued.number = manager->Notify(qApp->applicationName(), 0, info.icon,
                                     QString(), QString(), QStringList(), hints, -1);
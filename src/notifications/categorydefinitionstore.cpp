@@ -17,6 +17,7 @@
 #include "categorydefinitionstore.h"
 #include <QFileInfo>
 #include <QDir>
+#include <QSettings>
 
 //! The file extension for the category definition files
 static const char *FILE_EXTENSION = ".conf";
@@ -24,24 +25,83 @@ static const char *FILE_EXTENSION = ".conf";
 //! The maximum size of the category definition file
 static const uint FILE_MAX_SIZE = 32768;
 
+//! Time in milliseconds without further changes after which changes to the category definition files are processed
+static const int CHANGE_DELAY = 500;
+
 CategoryDefinitionStore::CategoryDefinitionStore(const QString &categoryDefinitionsPath, uint maxStoredCategoryDefinitions, QObject *parent) :
     QObject(parent),
     categoryDefinitionsPath(categoryDefinitionsPath),
-    maxStoredCategoryDefinitions(maxStoredCategoryDefinitions)
+    maxStoredCategoryDefinitions(maxStoredCategoryDefinitions),
+    usageCount(0),
+    categoryDefinitionFileListChanged(false)
 {
     if (!this->categoryDefinitionsPath.endsWith('/')) {
         this->categoryDefinitionsPath.append('/');
     }
 
+    // Collect changes into a batch until no further changes have been made for a while
+    categoryDefinitionChangeTimer.setInterval(CHANGE_DELAY);
+    categoryDefinitionChangeTimer.setSingleShot(true);
+    connect(&categoryDefinitionChangeTimer, SIGNAL(timeout()), this, SLOT(processCategoryDefinitionChanges()));
+
     // Watch for changes in category definition files
     categoryDefinitionPathWatcher.addPath(this->categoryDefinitionsPath);
-    connect(&categoryDefinitionPathWatcher, SIGNAL(directoryChanged(QString)), this, SLOT(updateCategoryDefinitionFileList()));
-    connect(&categoryDefinitionPathWatcher, SIGNAL(fileChanged(QString)), this, SLOT(updateCategoryDefinitionFile(QString)));
+    connect(&categoryDefinitionPathWatcher, SIGNAL(directoryChanged(QString)), this, SLOT(scheduleCategoryDefinitionFileListUpdate()));
+    connect(&categoryDefinitionPathWatcher, SIGNAL(fileChanged(QString)), this, SLOT(scheduleCategoryDefinitionFileUpdate(QString)));
     updateCategoryDefinitionFileList();
 }
 
-void CategoryDefinitionStore::updateCategoryDefinitionFileList()
+void CategoryDefinitionStore::scheduleCategoryDefinitionFileListUpdate()
+{
+    categoryDefinitionFileListChanged = true;
+    categoryDefinitionChangeTimer.start();
+}
+
+void CategoryDefinitionStore::scheduleCategoryDefinitionFileUpdate(const QString &path)
+{
+    changedCategoryDefinitionFiles.insert(path);
+    categoryDefinitionChangeTimer.start();
+}
+
+void CategoryDefinitionStore::processCategoryDefinitionChanges()
+{
+    categoryDefinitionChangeTimer.stop();
+
+    QStringList uninstalledCategories;
+    if (categoryDefinitionFileListChanged) {
+        categoryDefinitionFileListChanged = false;
+        uninstalledCategories = updateCategoryDefinitionFileList();
+    }
+
+    // Removing a category definition file is handled by updateCategoryDefinitionFileList()
+    QStringList modifiedCategories;
+    foreach (const QString &path, changedCategoryDefinitionFiles) {
+        QFileInfo fileInfo(path);
+        if (fileInfo.exists()) {
+            QString category = fileInfo.completeBaseName();
+
+            // Categories which have not been used yet are loaded when they are first needed
+            if (categoryDefinitions.contains(category) && !loadSettings(category)) {
+                // A definition which can no longer be read is no longer available
+                uninstalledCategories.append(category);
+            } else {
+                modifiedCategories.append(category);
+            }
+        }
+    }
+    changedCategoryDefinitionFiles.clear();
+
+    if (!uninstalledCategories.isEmpty()) {
+        emit categoryDefinitionsUninstalled(uninstalledCategories);
+    }
+    if (!modifiedCategories.isEmpty()) {
+        emit categoryDefinitionsModified(modifiedCategories);
+    }
+}
+
+QStringList CategoryDefinitionStore::updateCategoryDefinitionFileList()
 {
+    QStringList uninstalledCategories;
     QDir categoryDefinitionsDir(categoryDefinitionsPath);
 
     if(categoryDefinitionsDir.exists()) {
@@ -55,108 +115,104 @@ void CategoryDefinitionStore::updateCategoryDefinitionFileList()
             QString categoryDefinitionPath = categoryDefinitionsPath + removedCategory;
             categoryDefinitionPathWatcher.removePath(categoryDefinitionPath);
             categoryDefinitions.remove(category);
-            emit categoryDefinitionUninstalled(category);
+            uninstalledCategories.append(category);
         }
 
         categoryDefinitionFiles = files;
 
-        // Add category definition files to watcher
-        foreach(QString file, categoryDefinitionFiles){
+        // Add category definition files to watcher. Files replaced on upgrade are no longer watched so check all of them.
+        const QSet<QString> watchedFiles(categoryDefinitionPathWatcher.files().toSet());
+        foreach(const QString &file, categoryDefinitionFiles){
             QString categoryDefinitionFilePath = categoryDefinitionsPath + file;
-            if (!categoryDefinitionPathWatcher.files().contains(categoryDefinitionFilePath)) {
+            if (!watchedFiles.contains(categoryDefinitionFilePath)) {
                 categoryDefinitionPathWatcher.addPath(categoryDefinitionFilePath);
             }
         }
     }
-}
 
-void CategoryDefinitionStore::updateCategoryDefinitionFile(const QString &path)
-{
-    QFileInfo fileInfo(path);
-    if (fileInfo.exists()) {
-       QString category = fileInfo.completeBaseName();
-       loadSettings(category);
-       emit categoryDefinitionModified(category);
-    }
+    return uninstalledCategories;
 }
 
 bool CategoryDefinitionStore::categoryDefinitionExists(const QString &category) const
 {
-    bool categoryFound = false;
-
-    if (!categoryDefinitions.contains(category)) {
-        // If the category definition has not been loaded yet load it
-        loadSettings(category);
-    }
-
-    if (categoryDefinitions.contains(category)) {
-        categoryDefinitionAccessed(category);
-        categoryFound = true;
-    }
-
-    return categoryFound;
+    return categoryDefinition(category) != 0;
 }
 
 QList<QString> CategoryDefinitionStore::allKeys(const QString &category) const
 {
-    if (categoryDefinitionExists(category)) {
-        return categoryDefinitions.value(category)->allKeys();
-    }
-
-    return QList<QString>();
+    const CategoryDefinition *definition = categoryDefinition(category);
+    return definition != 0 ? definition->parameters.keys() : QList<QString>();
 }
 
 bool CategoryDefinitionStore::contains(const QString &category, const QString &key) const
 {
-    if (categoryDefinitionExists(category)) {
-        return categoryDefinitions.value(category)->contains(key);
-    }
-
-    return false;
+    const CategoryDefinition *definition = categoryDefinition(category);
+    return definition != 0 && definition->parameters.contains(key);
 }
 
 QString CategoryDefinitionStore::value(const QString &category, const QString &key) const
 {
-    if (contains(category, key)) {
-        return categoryDefinitions.value(category)->value(key).toString();
-    }
-
-    return QString();
+    const CategoryDefinition *definition = categoryDefinition(category);
+    return definition != 0 ? definition->parameters.value(key) : QString();
 }
 
 QHash<QString, QString> CategoryDefinitionStore::categoryParameters(const QString &category) const
 {
-    QHash<QString, QString> rv;
-
-    if (categoryDefinitionExists(category)) {
-        const QSettings &categoryDefinitionSettings(*(categoryDefinitions.value(category)));
-        foreach (const QString &key, categoryDefinitionSettings.allKeys()) {
-            rv.insert(key, categoryDefinitionSettings.value(key).toString());
-        }
-    }
-
-    return rv;
+    // The parameters are implicitly shared so returning them doesn't copy anything
+    const CategoryDefinition *definition = categoryDefinition(category);
+    return definition != 0 ? definition->parameters : QHash<QString, QString>();
 }
 
-void CategoryDefinitionStore::loadSettings(const QString &category) const
+bool CategoryDefinitionStore::loadSettings(const QString &category) const
 {
     QFileInfo file(QString(categoryDefinitionsPath).append(category).append(FILE_EXTENSION));
     if (file.exists() && file.size() != 0 && file.size() <= FILE_MAX_SIZE) {
-        QSharedPointer<QSettings> categoryDefinitionSettings(new QSettings(file.filePath(), QSettings::IniFormat));
-        if (categoryDefinitionSettings->status() == QSettings::NoError) {
-            categoryDefinitions.insert(category, categoryDefinitionSettings);
+        // QSettings is only used for parsing the file; the parameters are kept in a plain hash
+        QSettings categoryDefinitionSettings(file.filePath(), QSettings::IniFormat);
+        if (categoryDefinitionSettings.status() == QSettings::NoError) {
+            CategoryDefinition &definition = categoryDefinitions[category];
+            definition.parameters.clear();
+            foreach (const QString &key, categoryDefinitionSettings.allKeys()) {
+                definition.parameters.insert(key, categoryDefinitionSettings.value(key).toString());
+            }
+            return true;
         }
     }
+
+    // Forget any earlier definition so that an empty, oversized or broken file is not used in its stead
+    categoryDefinitions.remove(category);
+    return false;
 }
 
-void CategoryDefinitionStore::categoryDefinitionAccessed(const QString &category) const
+const CategoryDefinitionStore::CategoryDefinition *CategoryDefinitionStore::categoryDefinition(const QString &category) const
 {
-    // Mark the category definition as recently used by moving it to the beginning of the usage list
-    categoryDefinitionUsage.removeAll(category);
-    categoryDefinitionUsage.insert(0, category);
+    QHash<QString, CategoryDefinition>::iterator it = categoryDefinitions.find(category);
+    if (it == categoryDefinitions.end()) {
+        // Only categories with a definition file can be loaded; this avoids touching the file system for unknown
+        // categories unless the list of files has changed and the change has not been processed yet
+        if (!categoryDefinitionFiles.contains(category + FILE_EXTENSION) && !categoryDefinitionFileListChanged) {
+            return 0;
+        }
 
-    // If there are too many category definitions in memory get rid of the extra ones
-    while (categoryDefinitionUsage.count() > (int)maxStoredCategoryDefinitions) {
-        categoryDefinitions.remove(categoryDefinitionUsage.takeLast());
+        if (!loadSettings(category)) {
+            return 0;
+        }
+        it = categoryDefinitions.find(category);
+
+        // If there are too many category definitions in memory get rid of the least recently used one
+        if (categoryDefinitions.count() > (int)maxStoredCategoryDefinitions) {
+            QHash<QString, CategoryDefinition>::iterator leastRecentlyUsed = categoryDefinitions.end();
+            for (QHash<QString, CategoryDefinition>::iterator candidate = categoryDefinitions.begin(); candidate != categoryDefinitions.end(); ++candidate) {
+                if (candidate != it && (leastRecentlyUsed == categoryDefinitions.end() || candidate->lastUsed < leastRecentlyUsed->lastUsed)) {
+                    leastRecentlyUsed = candidate;
+                }
+            }
+            categoryDefinitions.erase(leastRecentlyUsed);
+            it = categoryDefinitions.find(category);
+        }
     }
+
+    // Mark the category definition as recently used
+    it->lastUsed = ++usageCount;
+    return &it.value();
 }
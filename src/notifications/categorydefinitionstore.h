@@ -18,17 +18,25 @@
 #define CATEGORYDEFINITIONSTORE_H_
 
 #include <QString>
-#include <QMap>
+#include <QHash>
 #include <QSet>
-#include <QSettings>
-#include <QSharedPointer>
 #include <QStringList>
 #include <QFileSystemWatcher>
+#include <QTimer>
 
 /*!
  * A class that represents a notification category store. The category
  * store will store all the category definitions stored in the given path.
  *
+ * Each category definition file is parsed once when the category is first
+ * used or when the file changes. The parameters are then kept in memory so
+ * that looking them up does not touch the file system.
+ *
+ * Changes to the category definition files are collected until no further
+ * changes have been made for a short while and then reported in a single
+ * batch, so that installing or upgrading a package with many category
+ * definitions does not cause a flood of updates.
+ *
  * The category store will limit the number of configuration
  * files it will read. The rationale is to constrain memory usage and startup
  * time in case a huge number of category definitions are defined by a misbehaving
@@ -100,56 +108,102 @@ public:
     QHash<QString, QString> categoryParameters(const QString &category) const;
 
 private slots:
-    //! Updates the list of available category definition files
-    void updateCategoryDefinitionFileList();
+    //! Schedules an update of the list of available category definition files
+    void scheduleCategoryDefinitionFileListUpdate();
 
     /*!
-     * Updates the category definition represented in the given file
+     * Schedules an update of the category definition represented in the given file
      *
-     * Only updates the category definition if the file is modified. Removing an category definition file is handled
-     * by updateCategoryDefinitionFileList() slot
+     * \param path the path of the modified category definition file
+     */
+    void scheduleCategoryDefinitionFileUpdate(const QString &path);
+
+    /*!
+     * Applies the scheduled updates and emits categoryDefinitionsUninstalled()
+     * and categoryDefinitionsModified() for the affected categories.
      */
-    void updateCategoryDefinitionFile(const QString &path);
+    void processCategoryDefinitionChanges();
 
 signals:
     /*!
-     * A signal sent whenever an category definition has been modified
+     * A signal sent whenever category definitions have been modified
      *
-     * \param category the category definition that was modified
+     * \param categories the category definitions that were modified
      */
-    void categoryDefinitionModified(const QString &category);
+    void categoryDefinitionsModified(const QStringList &categories);
 
     /*!
-     * A signal sent whenever an category definition has been uninstalled
+     * A signal sent whenever category definitions have been uninstalled
      *
-     * \param category the category definition that was removed
+     * \param categories the category definitions that were removed
      */
-    void categoryDefinitionUninstalled(const QString &category);
+    void categoryDefinitionsUninstalled(const QStringList &categories);
 
 private:
+    //! A parsed category definition
+    struct CategoryDefinition
+    {
+        CategoryDefinition() : lastUsed(0) {}
+
+        //! The parameters of the category keyed by name
+        QHash<QString, QString> parameters;
+        //! Value of usageCount when the category definition was last used
+        quint64 lastUsed;
+    };
+
     //! The path where the category definition files are stored
     QString categoryDefinitionsPath;
 
     //! The maximum number of category definitions to keep in memory
     uint maxStoredCategoryDefinitions;
 
-    //! Map for storing category definitions and corresponding QSettings object
-    mutable QMap<QString, QSharedPointer<QSettings> > categoryDefinitions;
+    //! Parsed category definitions keyed by category
+    mutable QHash<QString, CategoryDefinition> categoryDefinitions;
+
+    //! Number of category definition accesses so far, for finding the least recently used category definition
+    mutable quint64 usageCount;
 
-    //! List for keeping track of which category definitions have been most recently used
-    mutable QStringList categoryDefinitionUsage;
+    /*!
+     * Updates the list of available category definition files and the files
+     * being watched.
+     *
+     * \return the categories whose definition files were removed
+     */
+    QStringList updateCategoryDefinitionFileList();
 
-    //! Load the data into our internal map
-    void loadSettings(const QString &category) const;
+    /*!
+     * Parses the definition of the given category from its file into
+     * categoryDefinitions. If the file does not exist or cannot be parsed
+     * any earlier definition of the category is removed.
+     *
+     * \param category the category
+     * \return \c true if the definition was loaded, \c false otherwise
+     */
+    bool loadSettings(const QString &category) const;
 
-    //! Marks the category to be used recently
-    void categoryDefinitionAccessed(const QString &category) const;
+    /*!
+     * Returns the definition of the given category, loading it if necessary,
+     * and marks it as recently used.
+     *
+     * \param category the category
+     * \return the category definition or 0 if the category does not exist
+     */
+    const CategoryDefinition *categoryDefinition(const QString &category) const;
 
     //! File system watcher to notice changes in installed category definitions
     QFileSystemWatcher categoryDefinitionPathWatcher;
 
     //! List of available category definition files
     QSet<QString> categoryDefinitionFiles;
+
+    //! Timer for collecting changes to the category definition files into a batch
+    QTimer categoryDefinitionChangeTimer;
+
+    //! Whether the list of category definition files needs to be updated
+    bool categoryDefinitionFileListChanged;
+
+    //! Paths of the modified category definition files
+    QSet<QString> changedCategoryDefinitionFiles;
 };
 
 #endif /* CATEGORYDEFINITIONSTORE_H_ */
@@ -59,6 +59,7 @@ void DiskSpaceNotifier::handleDiskSpaceChange(const QString &path, int percentag
         QVariantHash hints;
         hints.insert(NotificationManager::HINT_CATEGORY, "x-nemo.system.diskspace");
         hints.insert(NotificationManager::HINT_PREVIEW_BODY, diskLowText);
+        hints.insert(NotificationManager::HINT_VOLATILE, true);
 
         // TODO go to some relevant place when clicking the notification
         NotificationManager *manager = NotificationManager::instance();
@@ -69,10 +70,7 @@ void DiskSpaceNotifier::handleDiskSpaceChange(const QString &path, int percentag
 void DiskSpaceNotifier::removeDiskSpaceNotifications()
 {
     NotificationManager *manager = NotificationManager::instance();
-    foreach (uint id, manager->notificationIds()) {
-        LipstickNotification *notification = NotificationManager::instance()->notification(id);
-        if (notification->category() == "x-nemo.system.diskspace") {
-            manager->CloseNotification(id);
-        }
+    foreach (uint id, manager->notificationIdsWithCategory("x-nemo.system.diskspace")) {
+        manager->CloseNotification(id);
     }
 }
@@ -17,8 +17,90 @@
 #include "lipsticknotification.h"
 
 #include <QDBusArgument>
+#include <QSet>
 #include <QtDebug>
 
+namespace {
+
+//! Creates the shared copies of the keys of the well-known hints
+QSet<QString> createWellKnownHintKeys()
+{
+    static const char * const wellKnownHints[] = {
+        NotificationManager::HINT_URGENCY,
+        NotificationManager::HINT_CATEGORY,
+        NotificationManager::HINT_TRANSIENT,
+        NotificationManager::HINT_DESKTOP_ENTRY,
+        NotificationManager::HINT_IMAGE_PATH,
+        NotificationManager::HINT_SOUND_FILE,
+        NotificationManager::HINT_SUPPRESS_SOUND,
+        NotificationManager::HINT_X,
+        NotificationManager::HINT_Y,
+        NotificationManager::HINT_ICON,
+        NotificationManager::HINT_ITEM_COUNT,
+        NotificationManager::HINT_PRIORITY,
+        NotificationManager::HINT_TIMESTAMP,
+        NotificationManager::HINT_PREVIEW_ICON,
+        NotificationManager::HINT_PREVIEW_BODY,
+        NotificationManager::HINT_PREVIEW_SUMMARY,
+        NotificationManager::HINT_USER_REMOVABLE,
+        NotificationManager::HINT_USER_CLOSEABLE,
+        NotificationManager::HINT_FEEDBACK,
+        NotificationManager::HINT_HIDDEN,
+        NotificationManager::HINT_DISPLAY_ON,
+        NotificationManager::HINT_LED_DISABLED_WITHOUT_BODY_AND_SUMMARY,
+        NotificationManager::HINT_ORIGIN,
+        NotificationManager::HINT_OWNER,
+        NotificationManager::HINT_VOLATILE
+    };
+
+    QSet<QString> keys;
+    for (unsigned i = 0; i < sizeof(wellKnownHints) / sizeof(wellKnownHints[0]); ++i) {
+        keys.insert(QString::fromLatin1(wellKnownHints[i]));
+    }
+    return keys;
+}
+
+/*!
+ * Returns the shared copies of the keys of the well-known hints. Only these
+ * are shared between notifications so that the keys chosen by the senders
+ * can't grow the set.
+ */
+const QSet<QString> &wellKnownHintKeys()
+{
+    static const QSet<QString> keys(createWellKnownHintKeys());
+    return keys;
+}
+
+//! Returns whether the hint is represented by a property of its own and should therefore be left out of hintValues()
+bool isPropertyHint(const QString &hint)
+{
+    static const char * const propertyHints[] = {
+        NotificationManager::HINT_ICON,
+        NotificationManager::HINT_TIMESTAMP,
+        NotificationManager::HINT_PREVIEW_ICON,
+        NotificationManager::HINT_PREVIEW_SUMMARY,
+        NotificationManager::HINT_PREVIEW_BODY,
+        NotificationManager::HINT_URGENCY,
+        NotificationManager::HINT_ITEM_COUNT,
+        NotificationManager::HINT_PRIORITY,
+        NotificationManager::HINT_CATEGORY,
+        NotificationManager::HINT_USER_REMOVABLE,
+        NotificationManager::HINT_HIDDEN,
+        NotificationManager::HINT_ORIGIN,
+        NotificationManager::HINT_OWNER
+    };
+
+    for (unsigned i = 0; i < sizeof(propertyHints) / sizeof(propertyHints[0]); ++i) {
+        if (hint.compare(propertyHints[i], Qt::CaseInsensitive) == 0) {
+            return true;
+        }
+    }
+    return hint.startsWith(NotificationManager::HINT_REMOTE_ACTION_PREFIX, Qt::CaseInsensitive) ||
+           hint.startsWith(NotificationManager::HINT_REMOTE_ACTION_ICON_PREFIX, Qt::CaseInsensitive);
+}
+
+}
+
 LipstickNotification::LipstickNotification(const QString &appName, uint replacesId, const QString &appIcon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout, QObject *parent) :
     QObject(parent),
     appName_(appName),
@@ -28,16 +110,19 @@ LipstickNotification::LipstickNotification(const QString &appName, uint replaces
     body_(body),
     actions_(actions),
     hints_(hints),
+    hintValuesValid_(false),
     expireTimeout_(expireTimeout)
 {
-    updateHintValues();
+    updateHintFields();
 }
 
 LipstickNotification::LipstickNotification(QObject *parent) :
     QObject(parent),
     replacesId_(0),
+    hintValuesValid_(false),
     expireTimeout_(-1)
 {
+    updateHintFields();
 }
 
 LipstickNotification::LipstickNotification(const LipstickNotification &notification) :
@@ -49,9 +134,10 @@ LipstickNotification::LipstickNotification(const LipstickNotification &notificat
     body_(notification.body_),
     actions_(notification.actions_),
     hints_(notification.hints_),
+    hintValuesValid_(false),
     expireTimeout_(notification.expireTimeout_)
 {
-    updateHintValues();
+    updateHintFields();
 }
 
 QString LipstickNotification::appName() const
@@ -113,6 +199,7 @@ QStringList LipstickNotification::actions() const
 void LipstickNotification::setActions(const QStringList &actions)
 {
     actions_ = actions;
+    updateRemoteActions();
 }
 
 QVariantHash LipstickNotification::hints() const
@@ -122,6 +209,17 @@ QVariantHash LipstickNotification::hints() const
 
 QVariantMap LipstickNotification::hintValues() const
 {
+    if (!hintValuesValid_) {
+        hintValues_.clear();
+        QVariantHash::const_iterator it = hints_.constBegin(), end = hints_.constEnd();
+        for ( ; it != end; ++it) {
+            // Filter out the hints that are represented by other properties
+            if (!isPropertyHint(it.key())) {
+                hintValues_.insert(it.key(), it.value());
+            }
+        }
+        hintValuesValid_ = true;
+    }
     return hintValues_;
 }
 
@@ -138,7 +236,7 @@ void LipstickNotification::setHints(const QVariantHash &hints)
     QString oldCategory = category();
 
     hints_ = hints;
-    updateHintValues();
+    updateHintFields();
 
     if (oldIcon != icon()) {
         emit iconChanged();
@@ -191,62 +289,111 @@ void LipstickNotification::setExpireTimeout(int expireTimeout)
 
 QString LipstickNotification::icon() const
 {
-    return hints_.value(NotificationManager::HINT_ICON).toString();
+    return icon_;
 }
 
 QDateTime LipstickNotification::timestamp() const
 {
-    return hints_.value(NotificationManager::HINT_TIMESTAMP).toDateTime();
+    return timestamp_;
 }
 
 QString LipstickNotification::previewIcon() const
 {
-    return hints_.value(NotificationManager::HINT_PREVIEW_ICON).toString();
+    return previewIcon_;
 }
 
 QString LipstickNotification::previewSummary() const
 {
-    return hints_.value(NotificationManager::HINT_PREVIEW_SUMMARY).toString();
+    return previewSummary_;
 }
 
 QString LipstickNotification::previewBody() const
 {
-    return hints_.value(NotificationManager::HINT_PREVIEW_BODY).toString();
+    return previewBody_;
 }
 
 int LipstickNotification::urgency() const
 {
-    return hints_.value(NotificationManager::HINT_URGENCY).toInt();
+    return urgency_;
 }
 
 int LipstickNotification::itemCount() const
 {
-    return hints_.value(NotificationManager::HINT_ITEM_COUNT).toInt();
+    return itemCount_;
 }
 
 int LipstickNotification::priority() const
 {
-    return hints_.value(NotificationManager::HINT_PRIORITY).toInt();
+    return priority_;
 }
 
 QString LipstickNotification::category() const
 {
-    return hints_.value(NotificationManager::HINT_CATEGORY).toString();
+    return category_;
 }
 
 bool LipstickNotification::isUserRemovable() const
 {
-    return hints_.value(NotificationManager::HINT_USER_REMOVABLE, QVariant(true)).toBool();
+    return userRemovable_;
 }
 
 bool LipstickNotification::hidden() const
 {
-    return hints_.value(NotificationManager::HINT_HIDDEN, QVariant(false)).toBool();
+    return hidden_;
 }
 
 QVariantList LipstickNotification::remoteActions() const
 {
-    QVariantList rv;
+    return remoteActions_;
+}
+
+QString LipstickNotification::origin() const
+{
+    return origin_;
+}
+
+QString LipstickNotification::owner() const
+{
+    return owner_;
+}
+
+void LipstickNotification::updateHintFields()
+{
+    // Share the keys of the well-known hints between notifications. Only keys which are not shared yet are
+    // replaced, so hints taken from another notification are used as they are without copying them.
+    const QSet<QString> &keys(wellKnownHintKeys());
+    for (QSet<QString>::const_iterator key = keys.constBegin(); key != keys.constEnd(); ++key) {
+        QVariantHash::const_iterator it = hints_.constFind(*key);
+        if (it != hints_.constEnd() && it.key().constData() != key->constData()) {
+            const QVariant value(it.value());
+            hints_.remove(*key);
+            hints_.insert(*key, value);
+        }
+    }
+
+    icon_ = hints_.value(NotificationManager::HINT_ICON).toString();
+    timestamp_ = hints_.value(NotificationManager::HINT_TIMESTAMP).toDateTime();
+    previewIcon_ = hints_.value(NotificationManager::HINT_PREVIEW_ICON).toString();
+    previewSummary_ = hints_.value(NotificationManager::HINT_PREVIEW_SUMMARY).toString();
+    previewBody_ = hints_.value(NotificationManager::HINT_PREVIEW_BODY).toString();
+    category_ = hints_.value(NotificationManager::HINT_CATEGORY).toString();
+    origin_ = hints_.value(NotificationManager::HINT_ORIGIN).toString();
+    owner_ = hints_.value(NotificationManager::HINT_OWNER).toString();
+    urgency_ = hints_.value(NotificationManager::HINT_URGENCY).toInt();
+    itemCount_ = hints_.value(NotificationManager::HINT_ITEM_COUNT).toInt();
+    priority_ = hints_.value(NotificationManager::HINT_PRIORITY).toInt();
+    userRemovable_ = hints_.value(NotificationManager::HINT_USER_REMOVABLE, QVariant(true)).toBool();
+    hidden_ = hints_.value(NotificationManager::HINT_HIDDEN, QVariant(false)).toBool();
+
+    hintValuesValid_ = false;
+    hintValues_.clear();
+
+    updateRemoteActions();
+}
+
+void LipstickNotification::updateRemoteActions()
+{
+    remoteActions_.clear();
 
     QStringList::const_iterator it = actions_.constBegin(), end = actions_.constEnd();
     while (it != end) {
@@ -294,47 +441,7 @@ QVariantList LipstickNotification::remoteActions() const
                 vm.insert(QStringLiteral("arguments"), args);
             }
 
-            rv.append(vm);
-        }
-    }
-
-    return rv;
-}
-
-QString LipstickNotification::origin() const
-{
-    return hints_.value(NotificationManager::HINT_ORIGIN).toString();
-}
-
-QString LipstickNotification::owner() const
-{
-    return hints_.value(NotificationManager::HINT_OWNER).toString();
-}
-
-void LipstickNotification::updateHintValues()
-{
-    hintValues_.clear();
-
-    QVariantHash::const_iterator it = hints_.constBegin(), end = hints_.constEnd();
-    for ( ; it != end; ++it) {
-        // Filter out the hints that are represented by other properties
-        const QString &hint(it.key());
-        if (hint.compare(NotificationManager::HINT_ICON, Qt::CaseInsensitive) != 0 &&
-            hint.compare(NotificationManager::HINT_TIMESTAMP, Qt::CaseInsensitive) != 0 &&
-            hint.compare(NotificationManager::HINT_PREVIEW_ICON, Qt::CaseInsensitive) != 0 &&
-            hint.compare(NotificationManager::HINT_PREVIEW_SUMMARY, Qt::CaseInsensitive) != 0 &&
-            hint.compare(NotificationManager::HINT_PREVIEW_BODY, Qt::CaseInsensitive) != 0 &&
-            hint.compare(NotificationManager::HINT_URGENCY, Qt::CaseInsensitive) != 0 &&
-            hint.compare(NotificationManager::HINT_ITEM_COUNT, Qt::CaseInsensitive) != 0 &&
-            hint.compare(NotificationManager::HINT_PRIORITY, Qt::CaseInsensitive) != 0 &&
-            hint.compare(NotificationManager::HINT_CATEGORY, Qt::CaseInsensitive) != 0 &&
-            hint.compare(NotificationManager::HINT_USER_REMOVABLE, Qt::CaseInsensitive) != 0 &&
-            hint.compare(NotificationManager::HINT_HIDDEN, Qt::CaseInsensitive) != 0 &&
-            hint.compare(NotificationManager::HINT_ORIGIN, Qt::CaseInsensitive) != 0 &&
-            hint.compare(NotificationManager::HINT_OWNER, Qt::CaseInsensitive) != 0 &&
-            !hint.startsWith(NotificationManager::HINT_REMOTE_ACTION_PREFIX, Qt::CaseInsensitive) &&
-            !hint.startsWith(NotificationManager::HINT_REMOTE_ACTION_ICON_PREFIX, Qt::CaseInsensitive)) {
-            hintValues_.insert(hint, it.value());
+            remoteActions_.append(vm);
         }
     }
 }
@@ -366,6 +473,7 @@ const QDBusArgument &operator>>(const QDBusArgument &argument, LipstickNotificat
     argument >> notification.hints_;
     argument >> notification.expireTimeout_;
     argument.endStructure();
+    notification.updateHintFields();
     return argument;
 }
 
@@ -109,6 +109,8 @@ public:
 
     //! Returns the hints for the notification
     QVariantHash hints() const;
+
+    //! Returns the hints which are not represented by other properties. The map is built when first needed.
     QVariantMap hintValues() const;
 
     //! Sets the hints for the notification
@@ -227,7 +229,11 @@ signals:
     void userRemovableChanged();
 
 private:
-    void updateHintValues();
+    //! Parses the well-known hints into their typed members
+    void updateHintFields();
+
+    //! Decodes the remote actions from the actions and hints
+    void updateRemoteActions();
 
     //! Name of the application sending the notification
     QString appName_;
@@ -247,12 +253,40 @@ private:
     //! Actions for the notification as a list of identifier/string pairs
     QStringList actions_;
 
-    //! Hints for the notification
+    /*!
+     * Hints for the notification as sent, including the well-known ones.
+     * They are kept so that hints() returns the original values and types
+     * for the database and D-Bus. The string members parsed from them
+     * share their data with these values.
+     */
     QVariantHash hints_;
-    QVariantMap hintValues_;
+
+    //! Hints not represented by other properties; valid only if hintValuesValid_ is set
+    mutable QVariantMap hintValues_;
+
+    //! Whether hintValues_ is up to date with the hints
+    mutable bool hintValuesValid_;
 
     //! Expiration timeout for the notification
     int expireTimeout_;
+
+    //! Well-known hints parsed by updateHintFields()
+    QString icon_;
+    QDateTime timestamp_;
+    QString previewIcon_;
+    QString previewSummary_;
+    QString previewBody_;
+    QString category_;
+    QString origin_;
+    QString owner_;
+    int urgency_;
+    int itemCount_;
+    int priority_;
+    bool userRemovable_;
+    bool hidden_;
+
+    //! Remote actions decoded by updateRemoteActions()
+    QVariantList remoteActions_;
 };
 
 Q_DECLARE_METATYPE(LipstickNotification)
@@ -0,0 +1,686 @@
+/***************************************************************************
+**
+** Copyright (C) 2012 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlTableModel>
+#include <QTimer>
+#include <sys/statfs.h>
+#include "notificationmanager.h"
+#include "notificationdatabase.h"
+
+// Define this if you'd like to see debug messages from the notification database
+#ifdef DEBUG_NOTIFICATIONS
+#define NOTIFICATIONS_DEBUG(things) qDebug() << Q_FUNC_INFO << things
+#else
+#define NOTIFICATIONS_DEBUG(things)
+#endif
+
+//! Path of the privileged storage directory relative to the home directory
+static const char *PRIVILEGED_DATA_PATH= "/.local/share/system/privileged";
+
+//! Minimum amount of disk space needed for the notification database in kilobytes
+static const uint MINIMUM_FREE_SPACE_NEEDED_IN_KB = 1024;
+
+//! Version of the database schema written by this implementation
+static const int CURRENT_SCHEMA_VERSION = 2;
+
+//! QDataStream version used for the action and hint blobs
+static const QDataStream::Version BLOB_STREAM_VERSION = QDataStream::Qt_5_0;
+
+//! Maximum number of prepared statements kept in the statement cache
+static const int MAX_PREPARED_STATEMENTS = 64;
+
+//! Value of the auto_vacuum pragma for incremental vacuuming
+static const int INCREMENTAL_AUTO_VACUUM = 2;
+
+NotificationDatabase::NotificationDatabase(StoragePolicy storagePolicy, int commitDelay, int maximumTransactionAge) :
+    QObject(),
+    policy(storagePolicy),
+    maxTransactionAge(maximumTransactionAge),
+    database(0),
+    committed(true),
+    databaseCommitTimer(new QTimer(this)),
+    batchDepth(0),
+    modificationsSinceMaintenance(0),
+    queueHead(new Modification),
+    queueTail(queueHead.load()),
+    processingRequested(0),
+    opened(false)
+{
+    // Commit the modifications to the database some time after the last modification so that writing to disk doesn't affect user experience
+    databaseCommitTimer->setInterval(commitDelay);
+    databaseCommitTimer->setSingleShot(true);
+    connect(databaseCommitTimer, SIGNAL(timeout()), this, SLOT(commit()));
+
+    if (policy != MemoryOnly) {
+        // All database access happens in the worker thread
+        moveToThread(&workerThread);
+        workerThread.start();
+    }
+}
+
+NotificationDatabase::~NotificationDatabase()
+{
+    if (workerThread.isRunning()) {
+        // Write everything queued so far and stop the worker thread
+        flush();
+        QMetaObject::invokeMethod(this, "close", Qt::BlockingQueuedConnection);
+        workerThread.quit();
+        workerThread.wait();
+    }
+
+    delete queueTail;
+}
+
+QList<NotificationDatabase::Record> NotificationDatabase::restore()
+{
+    if (policy == MemoryOnly) {
+        return QList<Record>();
+    }
+
+    QMetaObject::invokeMethod(this, "open", Qt::BlockingQueuedConnection);
+
+    QList<Record> records;
+    records.swap(restoredRecords);
+    return records;
+}
+
+bool NotificationDatabase::isOpen() const
+{
+    return opened;
+}
+
+void NotificationDatabase::execSQL(const QString &command, const QVariantList &args)
+{
+    if (!opened) {
+        return;
+    }
+
+    Modification *modification = new Modification;
+    modification->command = command;
+    modification->args = args;
+    enqueue(modification);
+}
+
+void NotificationDatabase::beginBatch()
+{
+    if (opened) {
+        enqueue(new Modification(Modification::BeginBatch));
+    }
+}
+
+void NotificationDatabase::endBatch()
+{
+    if (opened) {
+        enqueue(new Modification(Modification::EndBatch));
+    }
+}
+
+void NotificationDatabase::flush()
+{
+    if (opened) {
+        QMetaObject::invokeMethod(this, "processModificationsAndCommit", Qt::BlockingQueuedConnection);
+    }
+}
+
+void NotificationDatabase::performMaintenance()
+{
+    if (opened) {
+        QMetaObject::invokeMethod(this, "maintain", Qt::QueuedConnection);
+    }
+}
+
+NotificationDatabase::StoragePolicy NotificationDatabase::storagePolicy() const
+{
+    return policy;
+}
+
+NotificationDatabase::StoragePolicy NotificationDatabase::storagePolicyFromString(const QString &name)
+{
+    if (name == "memory") {
+        return MemoryOnly;
+    } else if (name == "durable") {
+        return Durable;
+    }
+    return Batched;
+}
+
+void NotificationDatabase::enqueue(Modification *modification)
+{
+    // Link the modification after the previous head; the worker thread only follows complete links
+    Modification *previous = queueHead.fetchAndStoreOrdered(modification);
+    previous->next.storeRelease(modification);
+
+    // Request processing unless a request is already pending
+    if (processingRequested.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "processModifications", Qt::QueuedConnection);
+    }
+}
+
+void NotificationDatabase::open()
+{
+    database = new QSqlDatabase;
+    if (connectToDatabase()) {
+        if (checkTableValidity()) {
+            fetchData();
+            opened = true;
+        } else {
+            database->close();
+        }
+    }
+}
+
+void NotificationDatabase::close()
+{
+    databaseCommitTimer->stop();
+    batchDepth = 0;
+    clearPreparedStatements();
+    if (database != 0) {
+        database->close();
+        delete database;
+        database = 0;
+    }
+    opened = false;
+}
+
+void NotificationDatabase::processModifications()
+{
+    // Clear the request first so that modifications queued from now on request processing again
+    processingRequested.storeRelease(0);
+
+    Modification *next;
+    while ((next = queueTail->next.loadAcquire()) != 0) {
+        switch (next->type) {
+        case Modification::Statement:
+            apply(next->command, next->args);
+            break;
+        case Modification::BeginBatch:
+            if (batchDepth++ == 0) {
+                startTransaction();
+            }
+            break;
+        case Modification::EndBatch:
+            if (batchDepth > 0 && --batchDepth == 0) {
+                finishTransaction();
+            }
+            break;
+        }
+
+        // The processed modification becomes the new tail
+        next->command.clear();
+        next->args.clear();
+        delete queueTail;
+        queueTail = next;
+    }
+}
+
+void NotificationDatabase::processModificationsAndCommit()
+{
+    processModifications();
+    commit();
+}
+
+void NotificationDatabase::commit()
+{
+    // Any aditional rules about when database commits are allowed can be added here
+    databaseCommitTimer->stop();
+    if (!committed) {
+        database->commit();
+        committed = true;
+    }
+}
+
+void NotificationDatabase::maintain()
+{
+    processModifications();
+    if (database == 0 || !database->isOpen() || batchDepth > 0 || modificationsSinceMaintenance == 0) {
+        return;
+    }
+
+    // Maintenance statements can't run inside a transaction
+    commit();
+    modificationsSinceMaintenance = 0;
+
+    QSqlQuery query(*database);
+
+    // Expiration times are deleted along with their notifications but an interrupted write may leave some behind
+    query.exec("DELETE FROM expiration WHERE id NOT IN (SELECT id FROM notifications)");
+
+    if (query.exec("PRAGMA auto_vacuum") && query.next() && query.value(0).toInt() != INCREMENTAL_AUTO_VACUUM) {
+        // Incremental vacuuming can only be enabled by vacuuming the whole database once
+        clearPreparedStatements();
+        query.exec("PRAGMA auto_vacuum=INCREMENTAL");
+        query.exec("VACUUM");
+    } else {
+        query.exec("PRAGMA incremental_vacuum");
+    }
+
+    // Move the write-ahead log into the database and truncate it so that it does not keep growing
+    query.exec("PRAGMA wal_checkpoint(TRUNCATE)");
+}
+
+QString NotificationDatabase::directory()
+{
+    const QString path = QString::fromLocal8Bit(qgetenv("LIPSTICK_NOTIFICATION_DATABASE_DIR"));
+    return path.isEmpty() ? "/home/nemo" + QString(PRIVILEGED_DATA_PATH) + QDir::separator() + "Notifications" : path;
+}
+
+bool NotificationDatabase::connectToDatabase()
+{
+    const QString databasePath = directory();
+    if (!QDir::root().exists(databasePath)) {
+        QDir::root().mkpath(databasePath);
+    }
+    QString databaseName = databasePath + "/notifications.db";
+
+    *database = QSqlDatabase::addDatabase("QSQLITE", metaObject()->className());
+    database->setDatabaseName(databaseName);
+    bool success = checkForDiskSpace(databasePath, MINIMUM_FREE_SPACE_NEEDED_IN_KB);
+    if (success) {
+        success = database->open();
+        if (!success) {
+            NOTIFICATIONS_DEBUG(database->lastError().driverText() << databaseName << database->lastError().databaseText());
+
+            // If opening the database fails, try to recreate the database
+            removeDatabaseFile(databaseName);
+            success = database->open();
+            NOTIFICATIONS_DEBUG("Unable to open database file. Recreating. Success: " << success);
+        }
+    } else {
+        NOTIFICATIONS_DEBUG("Not enough free disk space available. Unable to open database.");
+    }
+
+    if (success) {
+        // Set up the database mode to write-ahead locking to improve performance
+        QSqlQuery(*database).exec("PRAGMA journal_mode=WAL");
+    }
+
+    return success;
+}
+
+bool NotificationDatabase::checkForDiskSpace(const QString &path, unsigned long freeSpaceNeeded)
+{
+    struct statfs st;
+    bool spaceAvailable = false;
+    if (statfs(path.toUtf8().data(), &st) != -1) {
+        unsigned long freeSpaceInKb = (st.f_bsize * st.f_bavail) / 1024;
+        if (freeSpaceInKb > freeSpaceNeeded) {
+            spaceAvailable = true;
+        }
+    }
+    return spaceAvailable;
+}
+
+void NotificationDatabase::removeDatabaseFile(const QString &path)
+{
+    // Remove also -shm and -wal files created when journal-mode=WAL is being used
+    QDir::root().remove(path + "-shm");
+    QDir::root().remove(path + "-wal");
+    QDir::root().remove(path);
+}
+
+bool NotificationDatabase::checkTableValidity()
+{
+    bool result = true;
+    bool recreateNotificationsTable = false;
+    bool recreateExpirationTable = false;
+
+    const int databaseVersion(schemaVersion());
+
+    if (databaseVersion == 0) {
+        // Unmodified database - remove any existing notifications, which might cause problems
+        qWarning() << "Removing obsolete notifications";
+        recreateNotificationsTable = true;
+        recreateExpirationTable = true;
+    } else {
+        if (databaseVersion == 1 && !migrateSchemaFromVersion1()) {
+            qWarning() << "Unable to migrate notifications from schema version 1";
+        }
+
+        // Check that the notifications table schema is as expected
+        QSqlTableModel notificationsTableModel(0, *database);
+        notificationsTableModel.setTable("notifications");
+        recreateNotificationsTable = (notificationsTableModel.fieldIndex("id") == -1 ||
+                                      notificationsTableModel.fieldIndex("app_name") == -1 ||
+                                      notificationsTableModel.fieldIndex("app_icon") == -1 ||
+                                      notificationsTableModel.fieldIndex("summary") == -1 ||
+                                      notificationsTableModel.fieldIndex("body") == -1 ||
+                                      notificationsTableModel.fieldIndex("expire_timeout") == -1 ||
+                                      notificationsTableModel.fieldIndex("actions") == -1 ||
+                                      notificationsTableModel.fieldIndex("hints") == -1);
+
+        // Check that the expiration table schema is as expected
+        QSqlTableModel expirationTableModel(0, *database);
+        expirationTableModel.setTable("expiration");
+        recreateExpirationTable = (expirationTableModel.fieldIndex("id") == -1 ||
+                                   expirationTableModel.fieldIndex("expire_at") == -1);
+    }
+
+    if (recreateNotificationsTable) {
+        result &= recreateTable("notifications", "id INTEGER PRIMARY KEY, app_name TEXT, app_icon TEXT, summary TEXT, body TEXT, expire_timeout INTEGER, actions BLOB, hints BLOB");
+    }
+
+    if (recreateExpirationTable) {
+        result &= recreateTable("expiration", "id INTEGER PRIMARY KEY, expire_at INTEGER");
+    }
+
+    if ((recreateNotificationsTable || recreateExpirationTable) && !setSchemaVersion(CURRENT_SCHEMA_VERSION)) {
+        qWarning() << "Unable to set database schema version!";
+    }
+
+    return result;
+}
+
+bool NotificationDatabase::migrateSchemaFromVersion1()
+{
+    // Gather actions for each notification
+    QHash<uint, QStringList> actions;
+    QSqlQuery actionsQuery("SELECT * FROM actions", *database);
+    QSqlRecord actionsRecord = actionsQuery.record();
+    int actionsTableIdFieldIndex = actionsRecord.indexOf("id");
+    int actionsTableActionFieldIndex = actionsRecord.indexOf("action");
+    while (actionsQuery.next()) {
+        uint id = actionsQuery.value(actionsTableIdFieldIndex).toUInt();
+        actions[id].append(actionsQuery.value(actionsTableActionFieldIndex).toString());
+    }
+
+    // Gather hints for each notification
+    QHash<uint, QVariantHash> hints;
+    QSqlQuery hintsQuery("SELECT * FROM hints", *database);
+    QSqlRecord hintsRecord = hintsQuery.record();
+    int hintsTableIdFieldIndex = hintsRecord.indexOf("id");
+    int hintsTableHintFieldIndex = hintsRecord.indexOf("hint");
+    int hintsTableValueFieldIndex = hintsRecord.indexOf("value");
+    while (hintsQuery.next()) {
+        uint id = hintsQuery.value(hintsTableIdFieldIndex).toUInt();
+        const QString hintName(hintsQuery.value(hintsTableHintFieldIndex).toString());
+        const QVariant hintValue(hintsQuery.value(hintsTableValueFieldIndex));
+
+        if (hintName == NotificationManager::HINT_TIMESTAMP) {
+            // Timestamps in the version 1 tables are UTC but not marked as such; store them as typed UTC values
+            QDateTime timestamp(QDateTime::fromString(hintValue.toString(), Qt::ISODate));
+            timestamp.setTimeSpec(Qt::UTC);
+            hints[id].insert(hintName, timestamp);
+        } else {
+            hints[id].insert(hintName, hintValue);
+        }
+    }
+
+    bool result = database->transaction();
+    if (result) {
+        QSqlQuery query(*database);
+        result &= query.exec("ALTER TABLE notifications ADD COLUMN actions BLOB");
+        result &= query.exec("ALTER TABLE notifications ADD COLUMN hints BLOB");
+
+        QSqlQuery updateQuery(*database);
+        result &= updateQuery.prepare("UPDATE notifications SET actions=?, hints=? WHERE id=?");
+
+        QSqlQuery idQuery("SELECT id FROM notifications", *database);
+        while (result && idQuery.next()) {
+            const uint id = idQuery.value(0).toUInt();
+            updateQuery.addBindValue(serializeActions(actions.value(id)));
+            updateQuery.addBindValue(serializeHints(hints.value(id)));
+            updateQuery.addBindValue(id);
+            result &= updateQuery.exec();
+        }
+
+        result &= query.exec("DROP TABLE actions");
+        result &= query.exec("DROP TABLE hints");
+
+        if (result && setSchemaVersion(CURRENT_SCHEMA_VERSION)) {
+            result = database->commit();
+        } else {
+            database->rollback();
+            result = false;
+        }
+    }
+
+    if (result) {
+        // Reclaim the space used by the dropped tables
+        QSqlQuery(*database).exec("VACUUM");
+        qWarning() << "Notifications migrated to schema version" << CURRENT_SCHEMA_VERSION;
+    }
+
+    return result;
+}
+
+int NotificationDatabase::schemaVersion()
+{
+    int result = -1;
+
+    if (database->isOpen()) {
+        QSqlQuery query(*database);
+        if (query.exec("PRAGMA user_version") && query.next()) {
+            result = query.value(0).toInt();
+        }
+    }
+
+    return result;
+}
+
+bool NotificationDatabase::setSchemaVersion(int version)
+{
+    bool result = false;
+
+    if (database->isOpen()) {
+        QSqlQuery query(*database);
+        if (query.exec(QString::fromLatin1("PRAGMA user_version=%1").arg(version))) {
+            result = true;
+        }
+    }
+
+    return result;
+}
+
+bool NotificationDatabase::recreateTable(const QString &tableName, const QString &definition)
+{
+    bool result = false;
+
+    if (database->isOpen()) {
+        QSqlQuery(*database).exec("DROP TABLE " + tableName);
+        result = QSqlQuery(*database).exec("CREATE TABLE " + tableName + " (" + definition + ")");
+    }
+
+    return result;
+}
+
+QByteArray NotificationDatabase::serializeActions(const QStringList &actions)
+{
+    QByteArray data;
+    if (!actions.isEmpty()) {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream.setVersion(BLOB_STREAM_VERSION);
+        stream << actions;
+    }
+    return data;
+}
+
+QStringList NotificationDatabase::deserializeActions(const QByteArray &data)
+{
+    QStringList actions;
+    if (!data.isEmpty()) {
+        QDataStream stream(data);
+        stream.setVersion(BLOB_STREAM_VERSION);
+        stream >> actions;
+    }
+    return actions;
+}
+
+QByteArray NotificationDatabase::serializeHints(const QVariantHash &hints)
+{
+    QByteArray data;
+    if (!hints.isEmpty()) {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream.setVersion(BLOB_STREAM_VERSION);
+        stream << quint32(hints.count());
+
+        QVariantHash::const_iterator it = hints.constBegin(), end = hints.constEnd();
+        for ( ; it != end; ++it) {
+            // Values of types without stream operators (such as D-Bus structures) are stored as strings
+            stream << it.key();
+            if (it.value().userType() < QMetaType::User) {
+                stream << it.value();
+            } else {
+                stream << QVariant(it.value().toString());
+            }
+        }
+    }
+    return data;
+}
+
+QVariantHash NotificationDatabase::deserializeHints(const QByteArray &data)
+{
+    QVariantHash hints;
+    if (!data.isEmpty()) {
+        QDataStream stream(data);
+        stream.setVersion(BLOB_STREAM_VERSION);
+
+        quint32 count = 0;
+        stream >> count;
+
+        // The count comes from the database, so only trust it as far as the data could hold that many
+        // entries: each one has at least a string length, a variant type and a null flag
+        const quint32 minimumEntrySize = sizeof(quint32) + sizeof(quint32) + sizeof(qint8);
+        hints.reserve(qMin<quint32>(count, data.size() / minimumEntrySize));
+        for (quint32 i = 0; i < count; ++i) {
+            QString key;
+            QVariant value;
+            stream >> key >> value;
+            if (stream.status() != QDataStream::Ok) {
+                break;
+            }
+            hints.insert(key, value);
+        }
+    }
+    return hints;
+}
+
+void NotificationDatabase::fetchData()
+{
+    // Gather expiration times for displayed notifications
+    QSqlQuery expirationQuery("SELECT * FROM expiration", *database);
+    QSqlRecord expirationRecord = expirationQuery.record();
+    int expirationTableIdFieldIndex = expirationRecord.indexOf("id");
+    int expirationTableExpireAtFieldIndex = expirationRecord.indexOf("expire_at");
+    QHash<uint, qint64> expireAt;
+    while (expirationQuery.next()) {
+        uint id = expirationQuery.value(expirationTableIdFieldIndex).toUInt();
+        expireAt.insert(id, expirationQuery.value(expirationTableExpireAtFieldIndex).value<qint64>());
+    }
+
+    // Read the notifications
+    QSqlQuery notificationsQuery("SELECT * FROM notifications", *database);
+    QSqlRecord notificationsRecord = notificationsQuery.record();
+    int notificationsTableIdFieldIndex = notificationsRecord.indexOf("id");
+    int notificationsTableAppNameFieldIndex = notificationsRecord.indexOf("app_name");
+    int notificationsTableAppIconFieldIndex = notificationsRecord.indexOf("app_icon");
+    int notificationsTableSummaryFieldIndex = notificationsRecord.indexOf("summary");
+    int notificationsTableBodyFieldIndex = notificationsRecord.indexOf("body");
+    int notificationsTableExpireTimeoutFieldIndex = notificationsRecord.indexOf("expire_timeout");
+    int notificationsTableActionsFieldIndex = notificationsRecord.indexOf("actions");
+    int notificationsTableHintsFieldIndex = notificationsRecord.indexOf("hints");
+    while (notificationsQuery.next()) {
+        Record record;
+        record.id = notificationsQuery.value(notificationsTableIdFieldIndex).toUInt();
+        record.appName = notificationsQuery.value(notificationsTableAppNameFieldIndex).toString();
+        record.appIcon = notificationsQuery.value(notificationsTableAppIconFieldIndex).toString();
+        record.summary = notificationsQuery.value(notificationsTableSummaryFieldIndex).toString();
+        record.body = notificationsQuery.value(notificationsTableBodyFieldIndex).toString();
+        record.expireTimeout = notificationsQuery.value(notificationsTableExpireTimeoutFieldIndex).toInt();
+        record.actions = deserializeActions(notificationsQuery.value(notificationsTableActionsFieldIndex).toByteArray());
+        record.hints = deserializeHints(notificationsQuery.value(notificationsTableHintsFieldIndex).toByteArray());
+        record.expireAt = expireAt.value(record.id, 0);
+        restoredRecords.append(record);
+    }
+}
+
+void NotificationDatabase::apply(const QString &command, const QVariantList &args)
+{
+    if (database == 0 || !database->isOpen()) {
+        return;
+    }
+
+    // In the durable mode every statement outside a batch is committed on its own
+    if (policy != Durable) {
+        startTransaction();
+    }
+
+    QSqlQuery *query = preparedStatements.value(command);
+    QScopedPointer<QSqlQuery> uncachedQuery;
+    if (query == 0) {
+        query = new QSqlQuery(*database);
+        if (!query->prepare(command)) {
+            NOTIFICATIONS_DEBUG(command << query->lastError());
+            delete query;
+            return;
+        }
+
+        // Reuse the prepared statement for subsequent executions of the same command
+        if (preparedStatements.count() < MAX_PREPARED_STATEMENTS) {
+            preparedStatements.insert(command, query);
+        } else {
+            uncachedQuery.reset(query);
+        }
+    }
+
+    foreach(const QVariant &arg, args) {
+        query->addBindValue(arg);
+    }
+
+    query->exec();
+    modificationsSinceMaintenance++;
+
+    if (query->lastError().isValid()) {
+        NOTIFICATIONS_DEBUG(command << args << query->lastError());
+    }
+
+    finishTransaction();
+}
+
+void NotificationDatabase::startTransaction()
+{
+    if (committed && database != 0 && database->isOpen()) {
+        committed = false;
+        database->transaction();
+        transactionAge.start();
+    }
+}
+
+void NotificationDatabase::finishTransaction()
+{
+    if (committed || batchDepth > 0) {
+        return;
+    }
+
+    if (policy == Durable || transactionAge.elapsed() >= maxTransactionAge) {
+        // Don't let a constant stream of modifications keep the transaction open indefinitely
+        commit();
+    } else {
+        databaseCommitTimer->start();
+    }
+}
+
+void NotificationDatabase::clearPreparedStatements()
+{
+    qDeleteAll(preparedStatements);
+    preparedStatements.clear();
+}
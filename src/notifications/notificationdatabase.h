@@ -0,0 +1,368 @@
+/***************************************************************************
+**
+** Copyright (C) 2012 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef NOTIFICATIONDATABASE_H
+#define NOTIFICATIONDATABASE_H
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <QVariantHash>
+
+class QSqlDatabase;
+class QSqlQuery;
+class QTimer;
+
+//! A notification as stored in the notification database
+struct NotificationRecord
+{
+    NotificationRecord() : id(0), expireTimeout(0), expireAt(0) {}
+
+    uint id;
+    QString appName;
+    QString appIcon;
+    QString summary;
+    QString body;
+    QStringList actions;
+    QVariantHash hints;
+    int expireTimeout;
+    //! Expiration time in milliseconds since epoch or 0 if the notification has not been scheduled to expire
+    qint64 expireAt;
+};
+
+/*!
+ * \class NotificationDatabase
+ *
+ * \brief Stores notifications in an SQLite database in a worker thread.
+ *
+ * The notification database owns a worker thread which performs all access
+ * to the database. The rest of the interface is meant to be used from the
+ * thread which created the notification database.
+ *
+ * Modifications are not applied immediately: execSQL() appends them to a
+ * lock-free queue from which the worker thread applies them in order. How
+ * the modifications are committed depends on the storage policy. Destroying
+ * the notification database applies and commits all queued modifications
+ * before returning.
+ */
+class NotificationDatabase : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Policies for storing the notifications
+    enum StoragePolicy {
+        //! Notifications are not stored at all
+        MemoryOnly,
+        //! Modifications are collected into a transaction which is committed when no modifications have been made for a while or when the transaction gets too old
+        Batched,
+        //! Each modification is committed immediately
+        Durable
+    };
+
+    //! A notification as stored in the database
+    typedef NotificationRecord Record;
+
+    /*!
+     * Creates a notification database. Unless the storage policy is
+     * MemoryOnly, starts the worker thread.
+     *
+     * \param storagePolicy the policy for storing the notifications
+     * \param commitDelay time in milliseconds after the last modification after which a batched transaction is committed
+     * \param maximumTransactionAge time in milliseconds after which a batched transaction is committed even if modifications keep coming
+     */
+    NotificationDatabase(StoragePolicy storagePolicy = Batched, int commitDelay = 10000, int maximumTransactionAge = 60000);
+
+    /*!
+     * Applies and commits all queued modifications, closes the
+     * database and stops the worker thread.
+     */
+    virtual ~NotificationDatabase();
+
+    /*!
+     * Opens the database, creating or migrating the tables if necessary,
+     * and returns the notifications stored in it. Blocks until done.
+     *
+     * \return the stored notifications
+     */
+    QList<Record> restore();
+
+    /*!
+     * Returns whether the database was successfully opened by restore().
+     *
+     * \return \c true if the database is open, \c false otherwise
+     */
+    bool isOpen() const;
+
+    /*!
+     * Queues a SQL command to be executed in the database. Does nothing if
+     * the database is not open. The commands are executed in the order in
+     * which they were queued.
+     *
+     * \param command the SQL command
+     * \param args list of values to be bound to the positional placeholders ('?' -character) in the command.
+     */
+    void execSQL(const QString &command, const QVariantList &args = QVariantList());
+
+    /*!
+     * Starts a batch of modifications. All modifications queued until the
+     * matching endBatch() call are committed in the same transaction
+     * regardless of the storage policy. Batches may be nested. Does nothing
+     * if the database is not open.
+     */
+    void beginBatch();
+
+    //! Ends a batch of modifications started with beginBatch()
+    void endBatch();
+
+    //! Applies and commits all queued modifications. Blocks until done.
+    void flush();
+
+    /*!
+     * Queues maintenance of the database file: removes orphaned expiration
+     * rows, returns free pages to the file system and checkpoints the
+     * write-ahead log. The maintenance is done after the modifications
+     * queued so far have been applied and committed, and is skipped if
+     * nothing has been modified since the previous maintenance. Does not
+     * block. Does nothing if the database is not open.
+     */
+    void performMaintenance();
+
+    //! Returns the policy for storing the notifications
+    StoragePolicy storagePolicy() const;
+
+    /*!
+     * Returns the storage policy with the given name.
+     *
+     * \param name "memory", "batched" or "durable"
+     * \return the storage policy or Batched if the name is not recognized
+     */
+    static StoragePolicy storagePolicyFromString(const QString &name);
+
+    /*!
+     * Returns the directory of the database and the other notification
+     * data. The LIPSTICK_NOTIFICATION_DATABASE_DIR environment variable
+     * overrides the default location, so that benchmarks can run against
+     * a scratch directory.
+     *
+     * \return the path of the directory
+     */
+    static QString directory();
+
+    //! Serializes notification actions into a binary blob for the database
+    static QByteArray serializeActions(const QStringList &actions);
+
+    //! Deserializes notification actions from a binary blob in the database
+    static QStringList deserializeActions(const QByteArray &data);
+
+    //! Serializes notification hints, including the types of their values, into a binary blob for the database
+    static QByteArray serializeHints(const QVariantHash &hints);
+
+    //! Deserializes notification hints from a binary blob in the database
+    static QVariantHash deserializeHints(const QByteArray &data);
+
+private slots:
+    //! Opens the database and reads the stored notifications into restoredRecords. Called in the worker thread.
+    void open();
+
+    //! Closes the database. Called in the worker thread.
+    void close();
+
+    //! Applies all queued modifications to the database. Called in the worker thread.
+    void processModifications();
+
+    //! Applies all queued modifications and commits the current transaction. Called in the worker thread.
+    void processModificationsAndCommit();
+
+    //! Commits the current database transaction, if any. Called in the worker thread.
+    void commit();
+
+    //! Applies and commits all queued modifications and maintains the database file. Called in the worker thread.
+    void maintain();
+
+private:
+    //! A queued modification
+    struct Modification
+    {
+        //! Types of the queued modifications
+        enum Type {
+            //! A SQL command to be executed
+            Statement,
+            //! Start of a batch of modifications to be committed together
+            BeginBatch,
+            //! End of a batch of modifications to be committed together
+            EndBatch
+        };
+
+        Modification(Type type = Statement) : type(type), next(0) {}
+
+        Type type;
+        QString command;
+        QVariantList args;
+        QAtomicPointer<Modification> next;
+    };
+
+    /*!
+     * Appends a modification to the queue and makes sure the worker thread
+     * will process it. May be called from any thread.
+     *
+     * \param modification the modification to append
+     */
+    void enqueue(Modification *modification);
+
+    /*!
+     * Creates a connection to the Sqlite database.
+     *
+     * \return \c true if the connection was successfully established, \c false otherwise
+     */
+    bool connectToDatabase();
+
+    /*!
+     * Checks whether there is enough free disk space available.
+     *
+     * \param path any path to the file system from which the space should be checked
+     * \param freeSpaceNeeded free space needed in kilobytes
+     * \return \c true if there is enough free space in given file system, \c false otherwise
+     */
+    static bool checkForDiskSpace(const QString &path, unsigned long freeSpaceNeeded);
+
+    /*!
+     * Removes a database file from the filesystem. Removes related -wal and -shm files as well.
+     *
+     * \param path the path of the database file to be removed
+     */
+    static void removeDatabaseFile(const QString &path);
+
+    /*!
+     * Ensures that all database tables have the requires fields.
+     * Recreates the tables if needed.
+     *
+     * \return \c true if the database can be used, \c false otherwise
+     */
+    bool checkTableValidity();
+
+    /*!
+     * Migrates a version 1 database, which stores each action and hint in a row of its own,
+     * to the current schema, which stores the actions and hints of a notification as blobs
+     * in the notification's row.
+     *
+     * \return \c true if the database was migrated, \c false otherwise
+     */
+    bool migrateSchemaFromVersion1();
+
+    /*!
+     * Returns the schema version of the database.
+     *
+     * \return the version number the database schema is currently set to.
+     */
+    int schemaVersion();
+
+    /*!
+     * Sets the schema version of the database.
+     *
+     * \param version the version number to set the database schema to.
+     * \return \c true if the database is updated.
+     */
+    bool setSchemaVersion(int version);
+
+    /*!
+     * Recreates a table in the database.
+     *
+     * \param tableName the name of the table to be created
+     * \param definition SQL definition for the table
+     * \return \c true if the table was created, \c false otherwise
+     */
+    bool recreateTable(const QString &tableName, const QString &definition);
+
+    //! Reads the stored notifications into restoredRecords
+    void fetchData();
+
+    /*!
+     * Executes a SQL command in the database. In the batched mode starts a new transaction if none is active currently,
+     * otherwise the command goes to the active transaction. The transaction is then finished with finishTransaction().
+     * The command is prepared only once and the prepared statement is reused for subsequent calls.
+     * \param command the SQL command
+     * \param args list of values to be bound to the positional placeholders ('?' -character) in the command.
+     */
+    void apply(const QString &command, const QVariantList &args);
+
+    //! Starts a new database transaction unless one is active already
+    void startTransaction();
+
+    /*!
+     * Commits the current database transaction or restarts the commit timer
+     * depending on the storage policy and the age of the transaction. Does
+     * nothing while a batch of modifications is being applied.
+     */
+    void finishTransaction();
+
+    //! Destroys all cached prepared statements
+    void clearPreparedStatements();
+
+    //! The policy for storing the notifications
+    StoragePolicy policy;
+
+    //! Time in milliseconds after which a batched transaction is committed even if modifications keep coming
+    int maxTransactionAge;
+
+    //! The worker thread which performs all database access
+    QThread workerThread;
+
+    //! Database for the notifications. Only accessed in the worker thread.
+    QSqlDatabase *database;
+
+    //! Prepared statements keyed by their SQL command. Only accessed in the worker thread.
+    QHash<QString, QSqlQuery *> preparedStatements;
+
+    //! Whether the current database transaction has been committed to the database. Only accessed in the worker thread.
+    bool committed;
+
+    //! Timer for triggering the commit of the current database transaction. Lives in the worker thread.
+    QTimer *databaseCommitTimer;
+
+    //! Time since the current database transaction was started. Only accessed in the worker thread.
+    QElapsedTimer transactionAge;
+
+    //! Number of batches of modifications currently open. Only accessed in the worker thread.
+    int batchDepth;
+
+    //! Number of statements applied since the previous maintenance. Only accessed in the worker thread.
+    int modificationsSinceMaintenance;
+
+    //! The most recently queued modification. Modifications are appended here.
+    QAtomicPointer<Modification> queueHead;
+
+    //! The most recently processed modification; its successors are still to be processed. Only accessed in the worker thread.
+    Modification *queueTail;
+
+    //! Whether processing of the queue has been requested but not started yet
+    QAtomicInt processingRequested;
+
+    //! Whether the database is open
+    bool opened;
+
+    //! The notifications read by open()
+    QList<Record> restoredRecords;
+
+#ifdef UNIT_TEST
+    friend class Ut_NotificationDatabase;
+#endif
+};
+
+#endif // NOTIFICATIONDATABASE_H
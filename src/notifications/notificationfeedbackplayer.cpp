@@ -30,12 +30,28 @@ enum PreviewMode {
     AllNotificationsDisabled
 };
 
+static const int DEFAULT_FEEDBACK_MERGE_WINDOW = 1000;
+static const int DEFAULT_MAXIMUM_ACTIVE_EVENTS = 4;
+
 NotificationFeedbackPlayer::NotificationFeedbackPlayer(QObject *parent) :
     QObject(parent),
     ngfClient(new Ngf::Client(this)),
-    minimumPriority_(0)
+    minimumPriority_(0),
+    feedbackMergeWindow_(DEFAULT_FEEDBACK_MERGE_WINDOW),
+    maximumActiveEvents_(DEFAULT_MAXIMUM_ACTIVE_EVENTS),
+    displayOnRequestTime(-1),
+    playedCount(0),
+    mergedCount(0),
+    cappedCount(0),
+    displayOnRequestCount(0),
+    displayOnRequestSuppressedCount(0)
 {
+    clock.start();
+
     connect(NotificationManager::instance(), SIGNAL(notificationRemoved(uint)), this, SLOT(removeNotification(uint)));
+    connect(NotificationManager::instance(), SIGNAL(notificationsRestored(const QList<uint> &)), this, SLOT(addRestoredNotifications(const QList<uint> &)));
+    connect(ngfClient, SIGNAL(eventCompleted(quint32)), this, SLOT(removeActiveEvent(quint32)));
+    connect(ngfClient, SIGNAL(eventFailed(quint32)), this, SLOT(removeActiveEvent(quint32)));
 
     QTimer::singleShot(0, this, SLOT(init()));
 }
@@ -44,8 +60,16 @@ void NotificationFeedbackPlayer::init()
 {
     ngfClient->connect();
 
-    foreach(uint id, NotificationManager::instance()->notificationIds()) {
-        idToEventId.insert(NotificationManager::instance()->notification(id), 0);
+    addRestoredNotifications(NotificationManager::instance()->notificationIds());
+}
+
+void NotificationFeedbackPlayer::addRestoredNotifications(const QList<uint> &ids)
+{
+    foreach(uint id, ids) {
+        LipstickNotification *notification = NotificationManager::instance()->notification(id);
+        if (notification != 0 && !idToEventId.contains(notification)) {
+            idToEventId.insert(notification, 0);
+        }
     }
 }
 
@@ -56,8 +80,7 @@ void NotificationFeedbackPlayer::addNotification(uint id)
     if (notification != 0 && !idToEventId.contains(notification) && isEnabled(notification)) {
         // Ask mce to turn the screen on if requested
         if (notification->hints().value(NotificationManager::HINT_DISPLAY_ON).toBool()) {
-            QDBusMessage msg = QDBusMessage::createMethodCall(MCE_SERVICE, MCE_REQUEST_PATH, MCE_REQUEST_IF, MCE_DISPLAY_ON_REQ);
-            QDBusConnection::systemBus().asyncCall(msg);
+            requestDisplayOn();
         }
 
         // Play the feedback related to the notification if any
@@ -70,7 +93,11 @@ void NotificationFeedbackPlayer::addNotification(uint id)
                 properties.insert("media.vibra", true);
                 properties.insert("media.backlight", true);
             }
-            idToEventId.insert(notification, ngfClient->play(feedback, properties));
+            uint eventId = playFeedback(feedback, properties, notification->urgency() >= 2);
+            if (eventId != 0) {
+                eventReferenceCounts[eventId]++;
+            }
+            idToEventId.insert(notification, eventId);
         }
     }
 }
@@ -80,14 +107,87 @@ void NotificationFeedbackPlayer::removeNotification(uint id)
     LipstickNotification *notification = NotificationManager::instance()->notification(id);
 
     if (notification != 0) {
-        // Stop the feedback related to the notification, if any
+        // Stop the feedback related to the notification, if any, unless merged notifications still share it
         uint eventId = idToEventId.take(notification);
-        if (eventId != 0) {
+        if (eventId != 0 && --eventReferenceCounts[eventId] <= 0) {
             ngfClient->stop(eventId);
+            forgetEvent(eventId);
+        }
+    }
+}
+
+void NotificationFeedbackPlayer::removeActiveEvent(quint32 eventId)
+{
+    forgetEvent(eventId);
+}
+
+void NotificationFeedbackPlayer::forgetEvent(uint eventId)
+{
+    activeEventIds.removeOne(eventId);
+    if (eventReferenceCounts.remove(eventId) == 0) {
+        return;
+    }
+
+    for (QHash<LipstickNotification *, uint>::iterator it = idToEventId.begin(); it != idToEventId.end(); ++it) {
+        if (it.value() == eventId) {
+            it.value() = 0;
         }
     }
 }
 
+void NotificationFeedbackPlayer::requestDisplayOn()
+{
+    if (displayOnRequestTime >= 0 && isWithinMergeWindow(displayOnRequestTime)) {
+        displayOnRequestSuppressedCount++;
+        return;
+    }
+
+    QDBusMessage msg = QDBusMessage::createMethodCall(MCE_SERVICE, MCE_REQUEST_PATH, MCE_REQUEST_IF, MCE_DISPLAY_ON_REQ);
+    QDBusConnection::systemBus().asyncCall(msg);
+    displayOnRequestTime = clock.elapsed();
+    displayOnRequestCount++;
+}
+
+uint NotificationFeedbackPlayer::playFeedback(const QString &feedback, const QMap<QString, QVariant> &properties, bool critical)
+{
+    if (!critical) {
+        QHash<QString, qint64>::const_iterator playTime = feedbackPlayTimes.constFind(feedback);
+        if (playTime != feedbackPlayTimes.constEnd() && isWithinMergeWindow(playTime.value())) {
+            mergedCount++;
+            const uint eventId = feedbackEventIds.value(feedback);
+            return activeEventIds.contains(eventId) ? eventId : 0;
+        }
+    }
+
+    if (activeEventIds.count() >= maximumActiveEvents_) {
+        if (!critical || activeEventIds.isEmpty()) {
+            cappedCount++;
+            return 0;
+        }
+
+        // Make room for the critical feedback by stopping the oldest event
+        uint oldestEventId = activeEventIds.first();
+        ngfClient->stop(oldestEventId);
+        forgetEvent(oldestEventId);
+        cappedCount++;
+    }
+
+    // A feedback which failed to play is not merged into
+    uint eventId = ngfClient->play(feedback, properties);
+    if (eventId != 0) {
+        feedbackPlayTimes.insert(feedback, clock.elapsed());
+        feedbackEventIds.insert(feedback, eventId);
+        activeEventIds.append(eventId);
+        playedCount++;
+    }
+    return eventId;
+}
+
+bool NotificationFeedbackPlayer::isWithinMergeWindow(qint64 time) const
+{
+    return clock.elapsed() - time < feedbackMergeWindow_;
+}
+
 bool NotificationFeedbackPlayer::isEnabled(LipstickNotification *notification)
 {
     uint mode = AllNotificationsEnabled;
@@ -112,3 +212,42 @@ void NotificationFeedbackPlayer::setMinimumPriority(int minimumPriority)
 
     emit minimumPriorityChanged();
 }
+
+int NotificationFeedbackPlayer::feedbackMergeWindow() const
+{
+    return feedbackMergeWindow_;
+}
+
+void NotificationFeedbackPlayer::setFeedbackMergeWindow(int feedbackMergeWindow)
+{
+    if (feedbackMergeWindow_ != feedbackMergeWindow) {
+        feedbackMergeWindow_ = feedbackMergeWindow;
+
+        emit feedbackMergeWindowChanged();
+    }
+}
+
+int NotificationFeedbackPlayer::maximumActiveEvents() const
+{
+    return maximumActiveEvents_;
+}
+
+void NotificationFeedbackPlayer::setMaximumActiveEvents(int maximumActiveEvents)
+{
+    if (maximumActiveEvents_ != maximumActiveEvents) {
+        maximumActiveEvents_ = maximumActiveEvents;
+
+        emit maximumActiveEventsChanged();
+    }
+}
+
+QVariantHash NotificationFeedbackPlayer::statistics() const
+{
+    QVariantHash statistics;
+    statistics.insert("played", playedCount);
+    statistics.insert("merged", mergedCount);
+    statistics.insert("capped", cappedCount);
+    statistics.insert("displayOnRequests", displayOnRequestCount);
+    statistics.insert("displayOnRequestsSuppressed", displayOnRequestSuppressedCount);
+    return statistics;
+}
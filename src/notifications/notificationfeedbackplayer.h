@@ -19,6 +19,8 @@
 #include "lipstickglobal.h"
 #include <QObject>
 #include <QHash>
+#include <QElapsedTimer>
+#include <QVariantHash>
 
 class LipstickNotification;
 namespace Ngf {
@@ -29,11 +31,23 @@ namespace Ngf {
  * \class NotificationFeedbackPlayer
  *
  * \brief Plays non-graphical feedback for notifications.
+ *
+ * To keep a burst of notifications from turning into a burst of feedback
+ * events, a feedback is played at most once per merge window: notifications
+ * requesting a feedback that was started less than feedbackMergeWindow
+ * milliseconds ago are merged into that event, which keeps playing until
+ * all the notifications sharing it have been removed. Likewise only
+ * one display on request is sent to MCE per merge window. No more than
+ * maximumActiveEvents feedback events are kept playing at a time; further
+ * events are suppressed, except for critical notifications which stop the
+ * oldest active event instead. Critical notifications are never merged.
  */
 class LIPSTICK_EXPORT NotificationFeedbackPlayer : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(int minimumPriority READ minimumPriority WRITE setMinimumPriority NOTIFY minimumPriorityChanged)
+    Q_PROPERTY(int feedbackMergeWindow READ feedbackMergeWindow WRITE setFeedbackMergeWindow NOTIFY feedbackMergeWindowChanged)
+    Q_PROPERTY(int maximumActiveEvents READ maximumActiveEvents WRITE setMaximumActiveEvents NOTIFY maximumActiveEventsChanged)
 
 public:
     explicit NotificationFeedbackPlayer(QObject *parent = 0);
@@ -52,10 +66,58 @@ public:
      */
     void setMinimumPriority(int minimumPriority);
 
+    /*!
+     * Returns the time in milliseconds during which repeated requests for the same feedback are merged
+     *
+     * \return the merge window in milliseconds
+     */
+    int feedbackMergeWindow() const;
+
+    /*!
+     * Sets the time in milliseconds during which repeated requests for the same feedback are merged.
+     * Setting the window to 0 plays a feedback for every notification.
+     *
+     * \param feedbackMergeWindow the merge window in milliseconds
+     */
+    void setFeedbackMergeWindow(int feedbackMergeWindow);
+
+    /*!
+     * Returns the maximum number of feedback events played at the same time
+     *
+     * \return the maximum number of feedback events played at the same time
+     */
+    int maximumActiveEvents() const;
+
+    /*!
+     * Sets the maximum number of feedback events played at the same time
+     *
+     * \param maximumActiveEvents the maximum number of feedback events played at the same time
+     */
+    void setMaximumActiveEvents(int maximumActiveEvents);
+
+    /*!
+     * Returns statistics about the played feedback: "played" is the number
+     * of feedback events played, "merged" the number of feedback requests
+     * merged into a recently played event, "capped" the number of feedback
+     * events suppressed or stopped because too many events were active,
+     * "displayOnRequests" the number of display on requests sent and
+     * "displayOnRequestsSuppressed" the number of duplicate display on
+     * requests not sent.
+     *
+     * \return the statistics keyed by their names
+     */
+    Q_INVOKABLE QVariantHash statistics() const;
+
 signals:
     //! Emitted when the minimum priority of notifications for which a feedback should be played has changed
     void minimumPriorityChanged();
 
+    //! Emitted when the feedback merge window has changed
+    void feedbackMergeWindowChanged();
+
+    //! Emitted when the maximum number of active feedback events has changed
+    void maximumActiveEventsChanged();
+
 private slots:
     //! Initializes the feedback player
     void init();
@@ -74,10 +136,45 @@ private slots:
      */
     void removeNotification(uint id);
 
+    /*!
+     * Marks the notifications with the given IDs as already presented so
+     * that no feedback is played for them.
+     *
+     * \param ids the IDs of the restored notifications
+     */
+    void addRestoredNotifications(const QList<uint> &ids);
+
+    /*!
+     * Forgets a feedback event which has finished playing.
+     *
+     * \param eventId the NGF play ID of the event
+     */
+    void removeActiveEvent(quint32 eventId);
+
 private:
     //! Check whether feedbacks should be enabled for the given notification
     bool isEnabled(LipstickNotification *notification);
 
+    //! Asks MCE to turn the display on unless it was already asked to within the merge window
+    void requestDisplayOn();
+
+    /*!
+     * Plays a feedback unless it should be merged into an event already
+     * playing or too many events are active.
+     *
+     * \param feedback the name of the feedback
+     * \param properties the properties of the feedback
+     * \param critical whether the feedback is for a critical notification
+     * \return the NGF play ID of the played or merged into event or 0 if there is no such event
+     */
+    uint playFeedback(const QString &feedback, const QMap<QString, QVariant> &properties, bool critical);
+
+    //! Returns whether the given time stamp from the clock is within the merge window
+    bool isWithinMergeWindow(qint64 time) const;
+
+    //! Forgets an event which is no longer playing so that none of its notifications stops it
+    void forgetEvent(uint eventId);
+
     //! Non-graphical feedback player
     Ngf::Client *ngfClient;
 
@@ -87,6 +184,45 @@ private:
     //! The minimum priority of notifications for which a feedback should be played
     int minimumPriority_;
 
+    //! The time in milliseconds during which repeated requests for the same feedback are merged
+    int feedbackMergeWindow_;
+
+    //! The maximum number of feedback events played at the same time
+    int maximumActiveEvents_;
+
+    //! Clock for the merge window
+    QElapsedTimer clock;
+
+    //! The time each feedback was last played
+    QHash<QString, qint64> feedbackPlayTimes;
+
+    //! The NGF play ID of the event each feedback was last played as
+    QHash<QString, uint> feedbackEventIds;
+
+    //! The number of notifications sharing each active feedback event
+    QHash<uint, int> eventReferenceCounts;
+
+    //! The time the display was last requested to be turned on or -1 if it has not been requested
+    qint64 displayOnRequestTime;
+
+    //! The NGF play IDs of the active feedback events, oldest first
+    QList<uint> activeEventIds;
+
+    //! Number of feedback events played
+    int playedCount;
+
+    //! Number of feedback requests merged into a recently played event
+    int mergedCount;
+
+    //! Number of feedback events suppressed or stopped because too many events were active
+    int cappedCount;
+
+    //! Number of display on requests sent
+    int displayOnRequestCount;
+
+    //! Number of duplicate display on requests not sent
+    int displayOnRequestSuppressedCount;
+
 #ifdef UNIT_TEST
     friend class Ut_NotificationFeedbackPlayer;
 #endif
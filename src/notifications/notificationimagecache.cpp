@@ -0,0 +1,336 @@
+/***************************************************************************
+**
+** Copyright (C) 2012 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include <QCryptographicHash>
+#include <QDBusArgument>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QDebug>
+#include "notificationimagecache.h"
+
+namespace {
+
+//! The largest width and height of an image accepted in an image data hint; larger images can't be shown in a notification anyway
+const int MAX_IMAGE_SIZE = 1024;
+
+//! Name of the subdirectory of the cache in which the image contents are stored
+const char *CONTENT_DIRECTORY = "content";
+
+/*!
+ * Image data read from an image data hint. Reading the hint only checks
+ * the data; converting it to an image is left to the worker thread.
+ */
+struct ImageData
+{
+    ImageData() : width(0), height(0), rowstride(0), hasAlpha(false), channels(0) {}
+
+    //! The image if the hint contained one, otherwise the raw samples below are used
+    QImage image;
+    int width;
+    int height;
+    int rowstride;
+    bool hasAlpha;
+    int channels;
+    QByteArray data;
+
+    //! Returns whether the image data was valid
+    bool isValid() const
+    {
+        return !image.isNull() || !data.isEmpty();
+    }
+
+    //! Converts the image data to an image
+    QImage toImage() const
+    {
+        if (!image.isNull()) {
+            return image;
+        }
+
+        QImage converted(width, height, hasAlpha ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+        if (converted.isNull()) {
+            return QImage();
+        }
+        for (int y = 0; y < height; ++y) {
+            const uchar *source = reinterpret_cast<const uchar *>(data.constData()) + y * rowstride;
+            QRgb *target = reinterpret_cast<QRgb *>(converted.scanLine(y));
+            for (int x = 0; x < width; ++x, source += channels) {
+                target[x] = hasAlpha ? qRgba(source[0], source[1], source[2], source[3]) : qRgb(source[0], source[1], source[2]);
+            }
+        }
+        return converted;
+    }
+};
+
+/*!
+ * Reads the value of an image data hint.
+ *
+ * \param imageData the value of an image data hint
+ * \return the image data, which is not valid if the hint was not valid or the image is too large
+ */
+ImageData readImageData(const QVariant &imageData)
+{
+    ImageData result;
+    if (imageData.userType() == QMetaType::QImage) {
+        const QImage image(imageData.value<QImage>());
+        if (image.width() <= MAX_IMAGE_SIZE && image.height() <= MAX_IMAGE_SIZE) {
+            result.image = image;
+        }
+        return result;
+    }
+
+    if (imageData.userType() != qMetaTypeId<QDBusArgument>()) {
+        return result;
+    }
+
+    const QDBusArgument argument(imageData.value<QDBusArgument>());
+    if (argument.currentSignature() != QLatin1String("(iiibiiay)")) {
+        return result;
+    }
+
+    int width, height, rowstride, bitsPerSample, channels;
+    bool hasAlpha;
+    QByteArray data;
+    argument.beginStructure();
+    argument >> width >> height >> rowstride >> hasAlpha >> bitsPerSample >> channels >> data;
+    argument.endStructure();
+
+    // The specification only allows 8 bits per sample and RGB or RGBA samples. The sizes come from
+    // the sender, so calculate with 64 bits to keep them from overflowing.
+    if (width <= 0 || height <= 0 || width > MAX_IMAGE_SIZE || height > MAX_IMAGE_SIZE ||
+            bitsPerSample != 8 || channels != (hasAlpha ? 4 : 3) || qint64(rowstride) < qint64(width) * channels ||
+            qint64(data.size()) < qint64(height - 1) * rowstride + qint64(width) * channels) {
+        return result;
+    }
+
+    result.width = width;
+    result.height = height;
+    result.rowstride = rowstride;
+    result.hasAlpha = hasAlpha;
+    result.channels = channels;
+    result.data = data;
+    return result;
+}
+
+//! Returns the paths of the image contents the links in the cache directory refer to
+QSet<QString> linkedContentPaths(const QDir &directory)
+{
+    QSet<QString> paths;
+    foreach (const QFileInfo &info, directory.entryInfoList(QDir::Files | QDir::System | QDir::Hidden)) {
+        if (info.isSymLink()) {
+            paths.insert(QDir::cleanPath(info.symLinkTarget()));
+        }
+    }
+    return paths;
+}
+
+//! Converts, hashes and writes an image in the worker thread
+class ImageWriter : public QRunnable
+{
+public:
+    ImageWriter(const QDir &directory, const QString &path, const ImageData &imageData) :
+        directory(directory),
+        path(path),
+        imageData(imageData)
+    {
+    }
+
+    void run()
+    {
+        const QImage image(imageData.toImage());
+        if (image.isNull()) {
+            qWarning() << "Unable to convert notification image" << path;
+            return;
+        }
+
+        // Name the contents by the hash of the image so that identical images share the file
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(QByteArray::number(image.width()) + 'x' + QByteArray::number(image.height()) + ':' + QByteArray::number(image.format()));
+        hash.addData(reinterpret_cast<const char *>(image.constBits()), image.byteCount());
+        const QDir contentDirectory(directory.absoluteFilePath(CONTENT_DIRECTORY));
+        const QString contentPath(contentDirectory.absoluteFilePath(QString::fromLatin1(hash.result().toHex()) + ".png"));
+
+        if (!QFile::exists(contentPath)) {
+            if (!contentDirectory.exists() && !QDir::root().mkpath(contentDirectory.absolutePath())) {
+                qWarning() << "Unable to create the notification image directory" << contentDirectory.absolutePath();
+                return;
+            }
+
+            // Write the whole file or nothing so that a referenced file is never partial
+            QSaveFile file(contentPath);
+            if (!file.open(QIODevice::WriteOnly) || !image.save(&file, "PNG") || !file.commit()) {
+                qWarning() << "Unable to store notification image" << contentPath << file.errorString();
+                return;
+            }
+        }
+
+        // The path handed out is a link to the contents
+        if (!QFile::link(contentPath, path)) {
+            qWarning() << "Unable to link notification image" << path << "to" << contentPath;
+        }
+    }
+
+private:
+    QDir directory;
+    QString path;
+    ImageData imageData;
+};
+
+//! Removes image links, and the contents no longer linked to, in the worker thread
+class ImageRemover : public QRunnable
+{
+public:
+    ImageRemover(const QDir &directory, const QStringList &paths) :
+        directory(directory),
+        paths(paths)
+    {
+    }
+
+    void run()
+    {
+        QSet<QString> contentPaths;
+        foreach (const QString &path, paths) {
+            const QFileInfo info(path);
+            if (info.isSymLink()) {
+                contentPaths.insert(QDir::cleanPath(info.symLinkTarget()));
+            }
+            QFile::remove(path);
+        }
+
+        // Identical images of other notifications may still refer to the same contents
+        contentPaths.subtract(linkedContentPaths(directory));
+        foreach (const QString &contentPath, contentPaths) {
+            QFile::remove(contentPath);
+        }
+    }
+
+private:
+    QDir directory;
+    QStringList paths;
+};
+
+//! Removes the image links not referenced anymore and the contents no longer linked to in the worker thread
+class UnreferencedImageRemover : public QRunnable
+{
+public:
+    UnreferencedImageRemover(const QDir &directory, const QSet<QString> &referencedPaths) :
+        directory(directory),
+        referencedPaths(referencedPaths)
+    {
+    }
+
+    void run()
+    {
+        foreach (const QString &fileName, directory.entryList(QDir::Files | QDir::System | QDir::Hidden)) {
+            const QString path(directory.filePath(fileName));
+            if (!referencedPaths.contains(path)) {
+                QFile::remove(path);
+            }
+        }
+
+        const QSet<QString> contentPaths(linkedContentPaths(directory));
+        const QDir contentDirectory(directory.absoluteFilePath(CONTENT_DIRECTORY));
+        foreach (const QString &fileName, contentDirectory.entryList(QDir::Files | QDir::Hidden)) {
+            const QString contentPath(QDir::cleanPath(contentDirectory.absoluteFilePath(fileName)));
+            if (!contentPaths.contains(contentPath)) {
+                QFile::remove(contentPath);
+            }
+        }
+    }
+
+private:
+    QDir directory;
+    QSet<QString> referencedPaths;
+};
+
+}
+
+NotificationImageCache::NotificationImageCache(const QString &path) :
+    directory(path),
+    namePrefix(QString::number(QDateTime::currentMSecsSinceEpoch(), 36)),
+    nameCount(0)
+{
+    fileOperations.setMaxThreadCount(1);
+
+    // The images stored by earlier instances are listed once so that contains() never has to touch the file system
+    foreach (const QString &fileName, directory.entryList(QDir::Files | QDir::System | QDir::Hidden)) {
+        storedPaths.insert(directory.filePath(fileName));
+    }
+}
+
+NotificationImageCache::~NotificationImageCache()
+{
+    fileOperations.waitForDone();
+}
+
+QString NotificationImageCache::store(const QVariant &imageData)
+{
+    const ImageData data(readImageData(imageData));
+    if (!data.isValid()) {
+        return QString();
+    }
+
+    // The contents are not known until the image has been converted and hashed in the worker thread, so hand
+    // out a new path which the worker links to the contents
+    QString path;
+    do {
+        path = directory.filePath(QString("%1-%2.png").arg(namePrefix).arg(++nameCount, 0, 36));
+    } while (storedPaths.contains(path));
+
+    storedPaths.insert(path);
+    fileOperations.start(new ImageWriter(directory, path, data));
+    return path;
+}
+
+bool NotificationImageCache::contains(const QString &path) const
+{
+    // Only paths in the cache directory are ever stored
+    return storedPaths.contains(path);
+}
+
+void NotificationImageCache::addReference(const QString &path)
+{
+    QHash<QString, int>::iterator it = references.find(path);
+    if (it != references.end()) {
+        ++it.value();
+    } else if (contains(path)) {
+        references.insert(path, 1);
+    }
+}
+
+void NotificationImageCache::releaseReference(const QString &path)
+{
+    QHash<QString, int>::iterator it = references.find(path);
+    if (it != references.end() && --it.value() == 0) {
+        references.erase(it);
+        storedPaths.remove(path);
+        fileOperations.start(new ImageRemover(directory, QStringList() << path));
+    }
+}
+
+void NotificationImageCache::removeUnreferencedImages()
+{
+    const QSet<QString> referencedPaths(references.keys().toSet());
+    storedPaths.intersect(referencedPaths);
+    fileOperations.start(new UnreferencedImageRemover(directory, referencedPaths));
+}
+
+void NotificationImageCache::waitForFileOperations()
+{
+    fileOperations.waitForDone();
+}
@@ -0,0 +1,127 @@
+/***************************************************************************
+**
+** Copyright (C) 2012 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef NOTIFICATIONIMAGECACHE_H
+#define NOTIFICATIONIMAGECACHE_H
+
+#include <QDir>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <QVariant>
+
+/*!
+ * \class NotificationImageCache
+ *
+ * \brief Stores the images sent as notification hints in files.
+ *
+ * Raw image data sent in the image data hints is stored as a PNG file
+ * named by the hash of its contents in the "content" subdirectory, so
+ * notifications with identical images share a single file. Each stored
+ * image gets a path of its own in the cache directory, which is a link to
+ * the contents. The notifications refer to these paths instead of carrying
+ * the image data themselves.
+ *
+ * Each notification referring to an image holds a reference to it. When
+ * the last reference is released the link is removed, and the contents
+ * once no other link refers to them.
+ *
+ * The images are converted, hashed, encoded, written and removed in a
+ * worker thread in the order in which they were requested. The cache
+ * directory is listed once when the cache is created; after that the file
+ * system is not accessed in the calling thread.
+ */
+class NotificationImageCache
+{
+public:
+    /*!
+     * Creates a notification image cache.
+     *
+     * \param path the directory in which the image files are stored
+     */
+    explicit NotificationImageCache(const QString &path);
+
+    //! Destroys the notification image cache after finishing the queued file operations
+    ~NotificationImageCache();
+
+    /*!
+     * Stores image data in the cache. The image data is only checked here;
+     * it is converted and the file is written in the worker thread, where
+     * identical image data stored already is shared. Does not add a
+     * reference to the image.
+     *
+     * \param imageData the value of an image data hint: either a D-Bus structure of the form (iiibiiay) or a QImage
+     * \return the path of the image file or an empty string if the image data was not valid
+     */
+    QString store(const QVariant &imageData);
+
+    /*!
+     * Returns whether the given path refers to an image file in the cache.
+     *
+     * \param path the path to check
+     * \return \c true if the path refers to an image file in the cache when it was created or stored or queued since, \c false otherwise
+     */
+    bool contains(const QString &path) const;
+
+    /*!
+     * Adds a reference to an image file in the cache. Does nothing if the
+     * path does not refer to an image file in the cache.
+     *
+     * \param path the path of the image file
+     */
+    void addReference(const QString &path);
+
+    /*!
+     * Releases a reference to an image file in the cache. Removes the file
+     * when the last reference to it is released.
+     *
+     * \param path the path of the image file
+     */
+    void releaseReference(const QString &path);
+
+    //! Removes all files in the cache to which there are no references
+    void removeUnreferencedImages();
+
+    //! Blocks until the queued file operations are done
+    void waitForFileOperations();
+
+private:
+    //! The directory in which the image files are stored
+    QDir directory;
+
+    //! Prefix of the names of the image files stored by this instance
+    QString namePrefix;
+
+    //! Number of image files named by this instance
+    quint64 nameCount;
+
+    //! Number of references to each image file keyed by the path of the file
+    QHash<QString, int> references;
+
+    //! Paths of the image files found when the cache was created and stored or queued to be stored since
+    QSet<QString> storedPaths;
+
+    //! Single worker thread for the file operations, which keeps them in order
+    QThreadPool fileOperations;
+
+    Q_DISABLE_COPY(NotificationImageCache)
+
+#ifdef UNIT_TEST
+    friend class Ut_NotificationImageCache;
+#endif
+};
+
+#endif // NOTIFICATIONIMAGECACHE_H
@@ -15,14 +15,25 @@
 
 #include "notificationmanager.h"
 #include "notificationlistmodel.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// Orders notifications paired with their sort keys latest first like indexFor() does
+bool isLaterThan(const QPair<QPair<qint64, uint>, LipstickNotification *> &lhs, const QPair<QPair<qint64, uint>, LipstickNotification *> &rhs)
+{
+    return lhs.first > rhs.first;
+}
+
+}
 
 NotificationListModel::NotificationListModel(QObject *parent) :
     QObjectListModel(parent),
     m_populated(false)
 {
-    connect(NotificationManager::instance(), SIGNAL(notificationModified(uint)), this, SLOT(updateNotification(uint)));
-    connect(NotificationManager::instance(), SIGNAL(notificationRemoved(uint)), this, SLOT(removeNotification(uint)));
-    connect(NotificationManager::instance(), SIGNAL(notificationsRemoved(const QList<uint> &)), this, SLOT(removeNotifications(const QList<uint> &)));
+    connect(NotificationManager::instance(), SIGNAL(notificationsChanged(const QList<uint> &, const QList<uint> &, const QList<uint> &)), this, SLOT(applyChanges(const QList<uint> &, const QList<uint> &, const QList<uint> &)));
+    connect(NotificationManager::instance(), SIGNAL(notificationsRestored(const QList<uint> &)), this, SLOT(addNotifications(const QList<uint> &)));
     connect(this, SIGNAL(clearRequested()), NotificationManager::instance(), SLOT(removeUserRemovableNotifications()));
 
     QTimer::singleShot(0, this, SLOT(init()));
@@ -44,7 +55,7 @@ void NotificationListModel::init()
             updateNotification(id);
         }
     } else {
-        QList<QObject *> initialNotifications;
+        QList<LipstickNotification *> initialNotifications;
 
         foreach(uint id, NotificationManager::instance()->notificationIds()) {
             LipstickNotification *notification = NotificationManager::instance()->notification(id);
@@ -53,7 +64,7 @@ void NotificationListModel::init()
             }
         }
 
-        addItems(initialNotifications);
+        insertNotifications(initialNotifications);
     }
 
     m_populated = true;
@@ -65,10 +76,14 @@ void NotificationListModel::updateNotification(uint id)
     LipstickNotification *notification = NotificationManager::instance()->notification(id);
 
     if (notification != 0) {
-        int currentIndex = indexOf(notification);
+        // Notifications in the model are found by their sort keys rather than by scanning the model
+        QHash<uint, SortKey>::const_iterator currentKey = m_sortKeys.constFind(id);
+        int currentIndex = currentKey != m_sortKeys.constEnd() ? indexFor(currentKey.value()) : -1;
         if (notificationShouldBeShown(notification)) {
             // Place the notifications in the model latest first, moving existing notifications if necessary
-            int newIndex = indexFor(notification);
+            const SortKey key(sortKey(notification));
+            int newIndex = indexFor(key);
+            m_sortKeys.insert(id, key);
             if (currentIndex < 0) {
                 insertItem(newIndex, notification);
             } else if (newIndex == currentIndex || newIndex == (currentIndex + 1)) {
@@ -82,28 +97,70 @@ void NotificationListModel::updateNotification(uint id)
                 move(currentIndex, newIndex);
             }
         } else if (currentIndex >= 0) {
-            removeItem(notification);
+            removeItem(currentIndex);
+            m_sortKeys.remove(id);
         }
     }
 }
 
 int NotificationListModel::indexFor(LipstickNotification *notification)
 {
-    for (int index = 0; index < itemCount(); index++) {
-        LipstickNotification *notificationAtIndex = static_cast<LipstickNotification *>(get(index));
-        if (notification->replacesId() == notificationAtIndex->replacesId()) {
-            continue;
-        }
+    return indexFor(sortKey(notification));
+}
 
-        if (notification->timestamp() > notificationAtIndex->timestamp()) {
-            return index;
-        } else if (notification->timestamp() == notificationAtIndex->timestamp()) {
-            if (notification->replacesId() > notificationAtIndex->replacesId()) {
-                return index;
-            }
+NotificationListModel::SortKey NotificationListModel::sortKey(const LipstickNotification *notification)
+{
+    const QDateTime timestamp(notification->timestamp());
+    return SortKey(timestamp.isValid() ? timestamp.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min(), notification->replacesId());
+}
+
+int NotificationListModel::indexFor(const SortKey &key)
+{
+    // The model is ordered latest first: find the first notification which is earlier than the key.
+    // A notification being updated still has its old key, which matches its current position.
+    int low = 0;
+    int high = itemCount();
+    while (low < high) {
+        const int middle = (low + high) / 2;
+        if (sortKeyAt(middle) > key) {
+            low = middle + 1;
+        } else {
+            high = middle;
         }
     }
-    return itemCount();
+    return low;
+}
+
+NotificationListModel::SortKey NotificationListModel::sortKeyAt(int index)
+{
+    return m_sortKeys.value(static_cast<LipstickNotification *>(get(index))->replacesId());
+}
+
+void NotificationListModel::insertNotifications(const QList<LipstickNotification *> &notifications)
+{
+    // Sort the notifications latest first, getting the sort key of each notification only once
+    QList<QPair<SortKey, LipstickNotification *> > sortedNotifications;
+    foreach (LipstickNotification *notification, notifications) {
+        sortedNotifications.append(qMakePair(sortKey(notification), notification));
+    }
+    std::sort(sortedNotifications.begin(), sortedNotifications.end(), isLaterThan);
+
+    // Insert each run of notifications which falls between the same two existing notifications in one go
+    int i = 0;
+    while (i < sortedNotifications.count()) {
+        const int index = indexFor(sortedNotifications.at(i).first);
+        const bool hasNext = index < itemCount();
+        const SortKey nextKey(hasNext ? sortKeyAt(index) : SortKey());
+
+        QList<QObject *> items;
+        do {
+            items.append(sortedNotifications.at(i).second);
+            m_sortKeys.insert(sortedNotifications.at(i).second->replacesId(), sortedNotifications.at(i).first);
+            ++i;
+        } while (i < sortedNotifications.count() && (!hasNext || sortedNotifications.at(i).first > nextKey));
+
+        insertItems(index, items);
+    }
 }
 
 void NotificationListModel::refreshModel()
@@ -116,23 +173,96 @@ void NotificationListModel::markAsDisplayed(uint id)
     NotificationManager::instance()->MarkNotificationDisplayed(id);
 }
 
-void NotificationListModel::removeNotification(uint id)
+void NotificationListModel::addNotifications(const QList<uint> &ids)
 {
-    if (LipstickNotification *notification = NotificationManager::instance()->notification(id)) {
-        removeItem(notification);
+    if (!m_populated) {
+        // The notifications will be added when the model gets populated
+        return;
+    }
+
+    // Restored notifications are normally older than the ones already in the model, so they usually end up at the end in one go
+    QList<LipstickNotification *> restoredNotifications;
+    foreach (uint id, ids) {
+        LipstickNotification *notification = NotificationManager::instance()->notification(id);
+        if (notification != 0 && notificationShouldBeShown(notification) && !m_sortKeys.contains(id)) {
+            restoredNotifications.append(notification);
+        }
     }
+    insertNotifications(restoredNotifications);
 }
 
-void NotificationListModel::removeNotifications(const QList<uint> &ids)
+void NotificationListModel::applyChanges(const QList<uint> &added, const QList<uint> &modified, const QList<uint> &removed)
 {
-    if (!ids.isEmpty()) {
-        QList<QObject *> items;
-        foreach (uint id, ids) {
-            if (LipstickNotification *notification = NotificationManager::instance()->notification(id)) {
-                items.append(notification);
+    if (!m_populated) {
+        // The notifications will be added when the model gets populated
+        return;
+    }
+
+    // The removed notifications are no longer known by the manager, so find them in the model by their sort keys
+    QList<QObject *> removedItems;
+    foreach (uint id, removed) {
+        QHash<uint, SortKey>::const_iterator key = m_sortKeys.constFind(id);
+        if (key != m_sortKeys.constEnd()) {
+            const int index = indexFor(key.value());
+            if (index < itemCount() && sortKeyAt(index) == key.value()) {
+                removedItems.append(get(index));
+            }
+        }
+    }
+
+    QList<LipstickNotification *> newNotifications;
+    QList<uint> updatedIds;
+    QList<uint> movedIds;
+    foreach (uint id, added + modified) {
+        LipstickNotification *notification = NotificationManager::instance()->notification(id);
+        if (notification == 0) {
+            continue;
+        }
+
+        // Only the notifications in the model have sort keys
+        QHash<uint, SortKey>::const_iterator key = m_sortKeys.constFind(id);
+        const bool inModel = key != m_sortKeys.constEnd();
+        if (!notificationShouldBeShown(notification)) {
+            if (inModel) {
+                removedItems.append(notification);
             }
+        } else if (!inModel) {
+            newNotifications.append(notification);
+        } else if (key.value() == sortKey(notification)) {
+            updatedIds.append(id);
+        } else {
+            movedIds.append(id);
+        }
+    }
+
+    if (!removedItems.isEmpty()) {
+        foreach (QObject *item, removedItems) {
+            m_sortKeys.remove(static_cast<LipstickNotification *>(item)->replacesId());
+        }
+        removeItems(removedItems);
+    }
+
+    // Notifications rarely move, so move them one by one
+    foreach (uint id, movedIds) {
+        updateNotification(id);
+    }
+
+    insertNotifications(newNotifications);
+
+    // Report the notifications updated in place once the rows no longer change, one run of adjacent rows at a time
+    QList<int> updatedRows;
+    foreach (uint id, updatedIds) {
+        updatedRows.append(indexFor(m_sortKeys.value(id)));
+    }
+    std::sort(updatedRows.begin(), updatedRows.end());
+    int i = 0;
+    while (i < updatedRows.count()) {
+        const int first = updatedRows.at(i);
+        int last = first;
+        while (++i < updatedRows.count() && updatedRows.at(i) <= last + 1) {
+            last = updatedRows.at(i);
         }
-        removeItems(items);
+        emit dataChanged(index(first, 0), index(last, 0));
     }
 }
 
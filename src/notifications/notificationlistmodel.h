@@ -18,6 +18,8 @@
 
 #include "qobjectlistmodel.h"
 #include "lipstickglobal.h"
+#include <QHash>
+#include <QPair>
 
 class LipstickNotification;
 
@@ -39,8 +41,17 @@ signals:
 private slots:
     void init();
     void updateNotification(uint id);
-    void removeNotification(uint id);
-    void removeNotifications(const QList<uint> &ids);
+    void addNotifications(const QList<uint> &ids);
+
+    /*!
+     * Applies the changes reported by the notification manager during an
+     * event loop iteration, removing and inserting contiguous rows together.
+     *
+     * \param added the IDs of the added notifications
+     * \param modified the IDs of the modified notifications
+     * \param removed the IDs of the removed notifications
+     */
+    void applyChanges(const QList<uint> &added, const QList<uint> &modified, const QList<uint> &removed);
 
 protected:
     /*!
@@ -55,7 +66,8 @@ protected:
 
     /*!
      * Checks where the notification should be placed so that the
-     * notifications in the model are ordered by timestamp.
+     * notifications in the model are ordered by timestamp. The position is
+     * found with a binary search.
      *
      * \param notification the notification for which to get the position
      * \return index in which the notification shoud be placed
@@ -69,8 +81,30 @@ protected:
 private:
     Q_DISABLE_COPY(NotificationListModel)
 
+    //! The position of a notification in the model: timestamp in milliseconds since epoch and notification ID, latest first
+    typedef QPair<qint64, uint> SortKey;
+
+    //! Returns the sort key for the current state of the notification
+    static SortKey sortKey(const LipstickNotification *notification);
+
+    //! Returns the index in which a notification with the given sort key should be placed
+    int indexFor(const SortKey &key);
+
+    //! Returns the sort key of the notification at the given index of the model
+    SortKey sortKeyAt(int index);
+
+    /*!
+     * Inserts notifications into the model in the right positions.
+     *
+     * \param notifications the notifications to insert, none of which may be in the model already
+     */
+    void insertNotifications(const QList<LipstickNotification *> &notifications);
+
     bool m_populated;
 
+    //! Sort keys of the notifications in the model as of their placement keyed by notification ID, so that the model stays ordered by them
+    QHash<uint, SortKey> m_sortKeys;
+
 #ifdef UNIT_TEST
     friend class Ut_NotificationListModel;
 #endif
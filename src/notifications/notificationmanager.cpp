@@ -14,17 +14,22 @@
 ****************************************************************************/
 
 #include <QCoreApplication>
+#include <QDBusConnectionInterface>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
 #include <QDebug>
-#include <QSqlDatabase>
-#include <QSqlError>
-#include <QSqlQuery>
-#include <QSqlRecord>
-#include <QSqlTableModel>
+#include <QSettings>
 #include <mremoteaction.h>
 #include <mdesktopentry.h>
-#include <sys/statfs.h>
+#include <algorithm>
+#include <functional>
 #include <limits>
+#include <qmactivity.h>
+#include <qmdisplaystate.h>
 #include "categorydefinitionstore.h"
+#include "notificationdatabase.h"
+#include "notificationimagecache.h"
 #include "notificationmanageradaptor.h"
 #include "notificationmanager.h"
 
@@ -41,20 +46,63 @@ static const char *CATEGORY_DEFINITION_FILE_DIRECTORY = "/usr/share/lipstick/not
 //! The number configuration files to load into the event type store.
 static const uint MAX_CATEGORY_DEFINITION_FILES = 100;
 
-//! Path of the privileged storage directory relative to the home directory
-static const char *PRIVILEGED_DATA_PATH= "/.local/share/system/privileged";
+//! The subdirectory of the notification data directory in which the images sent as image data hints are stored
+static const char *NOTIFICATION_IMAGE_DIRECTORY = "images";
 
 //! Path to probe for desktop entries
 static const char *DESKTOP_ENTRY_PATH= "/usr/share/applications/";
 
-//! Minimum amount of disk space needed for the notification database in kilobytes
-static const uint MINIMUM_FREE_SPACE_NEEDED_IN_KB = 1024;
+//! Number of stale entries always tolerated in the expiration queue before it is rebuilt
+static const int MIN_EXPIRATION_QUEUE_COMPACTION_SIZE = 32;
+
+//! Maximum number of parameters bound to a single statement (SQLITE_MAX_VARIABLE_NUMBER)
+static const int MAX_BOUND_PARAMETERS = 999;
+
+//! Number of restored notifications created at a time
+static const int RESTORE_BATCH_SIZE = 50;
+
+//! The global lipstick configuration file containing the notification storage settings
+static const char *LIPSTICK_SETTINGS_FILE = "/usr/share/lipstick/lipstick.conf";
+
+//! Default time in milliseconds after the last modification after which the modifications are committed to the database
+static const int DEFAULT_COMMIT_DELAY = 10000;
+
+//! Default time in milliseconds after which the modifications are committed to the database even if more keep coming
+static const int DEFAULT_MAX_TRANSACTION_AGE = 60000;
+
+//! Default number of notifications per second a sender may send over time
+static const double DEFAULT_RATE_LIMIT = 10;
+
+//! Default number of notifications a sender may send in a burst
+static const int DEFAULT_RATE_LIMIT_BURST = 20;
+
+//! Default time in milliseconds during which further updates to a notification are coalesced
+static const int DEFAULT_COALESCE_INTERVAL = 16;
+
+//! Default maximum number of notifications of a single application
+static const int DEFAULT_MAX_NOTIFICATIONS_PER_APPLICATION = 200;
+
+//! Default maximum number of notifications in total
+static const int DEFAULT_MAX_NOTIFICATIONS = 1000;
+
+//! Default time in milliseconds the device has to be idle before the database is maintained
+static const int DEFAULT_MAINTENANCE_DELAY = 5000;
+
+//! Maximum number of deferred notifications per sender; further new notifications are dropped
+static const int MAX_DEFERRED_NOTIFICATIONS_PER_SENDER = 100;
+
+//! Number of token buckets kept before the full ones are discarded
+static const int MAX_RATE_LIMIT_BUCKETS = 64;
+
+//! Number of notification closures remembered for GetNotificationsSince()
+static const int MAX_REMOVAL_LOG_SIZE = 1000;
 
 const char *NotificationManager::HINT_URGENCY = "urgency";
 const char *NotificationManager::HINT_CATEGORY = "category";
 const char *NotificationManager::HINT_TRANSIENT = "transient";
 const char *NotificationManager::HINT_DESKTOP_ENTRY = "desktop-entry";
 const char *NotificationManager::HINT_IMAGE_DATA = "image_data";
+const char *NotificationManager::HINT_IMAGE_PATH = "image-path";
 const char *NotificationManager::HINT_SOUND_FILE = "sound-file";
 const char *NotificationManager::HINT_SUPPRESS_SOUND = "suppress-sound";
 const char *NotificationManager::HINT_X = "x";
@@ -76,6 +124,7 @@ const char *NotificationManager::HINT_DISPLAY_ON = "x-nemo-display-on";
 const char *NotificationManager::HINT_LED_DISABLED_WITHOUT_BODY_AND_SUMMARY = "x-nemo-led-disabled-without-body-and-summary";
 const char *NotificationManager::HINT_ORIGIN = "x-nemo-origin";
 const char *NotificationManager::HINT_OWNER = "x-nemo-owner";
+const char *NotificationManager::HINT_VOLATILE = "x-nemo-volatile";
 
 namespace {
 
@@ -141,9 +190,25 @@ NotificationManager::NotificationManager(QObject *parent) :
     QDBusContext(),
     previousNotificationID(0),
     categoryDefinitionStore(new CategoryDefinitionStore(CATEGORY_DEFINITION_FILE_DIRECTORY, MAX_CATEGORY_DEFINITION_FILES, this)),
-    database(new QSqlDatabase),
-    committed(true),
-    nextExpirationTime(0)
+    database(0),
+    imageCache(new NotificationImageCache(NotificationDatabase::directory() + QDir::separator() + NOTIFICATION_IMAGE_DIRECTORY)),
+    // Start from the startup time so that the serials handed out by earlier instances are older than those of this one
+    firstChangeSerial(quint64(QDateTime::currentMSecsSinceEpoch()) * 1000),
+    changeSerial(firstChangeSerial),
+    removalLogStart(firstChangeSerial),
+    rateLimit(DEFAULT_RATE_LIMIT),
+    rateLimitBurst(DEFAULT_RATE_LIMIT_BURST),
+    coalescedNotificationCount(0),
+    droppedNotificationCount(0),
+    avoidedDatabaseWriteCount(0),
+    maxNotificationsPerApplication(DEFAULT_MAX_NOTIFICATIONS_PER_APPLICATION),
+    maxNotifications(DEFAULT_MAX_NOTIFICATIONS),
+    evictedNotificationCount(0),
+    senderWatcher(new QDBusServiceWatcher(QString(), QDBusConnection::sessionBus(), QDBusServiceWatcher::WatchForUnregistration, this)),
+    senderIdentityHits(0),
+    senderIdentityMisses(0),
+    displayState(new MeeGo::QmDisplayState(this)),
+    activity(new MeeGo::QmActivity(this))
 {
     qDBusRegisterMetaType<QVariantHash>();
     qDBusRegisterMetaType<LipstickNotification>();
@@ -153,24 +218,62 @@ NotificationManager::NotificationManager(QObject *parent) :
     QDBusConnection::sessionBus().registerService("org.freedesktop.Notifications");
     QDBusConnection::sessionBus().registerObject("/org/freedesktop/Notifications", this);
 
-    connect(categoryDefinitionStore, SIGNAL(categoryDefinitionUninstalled(QString)), this, SLOT(removeNotificationsWithCategory(QString)));
-    connect(categoryDefinitionStore, SIGNAL(categoryDefinitionModified(QString)), this, SLOT(updateNotificationsWithCategory(QString)));
+    connect(categoryDefinitionStore, SIGNAL(categoryDefinitionsUninstalled(QStringList)), this, SLOT(removeNotificationsWithCategories(QStringList)));
+    connect(categoryDefinitionStore, SIGNAL(categoryDefinitionsModified(QStringList)), this, SLOT(updateNotificationsWithCategories(QStringList)));
 
-    // Commit the modifications to the database 10 seconds after the last modification so that writing to disk doesn't affect user experience
-    databaseCommitTimer.setInterval(10000);
-    databaseCommitTimer.setSingleShot(true);
-    connect(&databaseCommitTimer, SIGNAL(timeout()), this, SLOT(commit()));
+    // Destroy removed notifications 10 seconds after the last removal so that any users of the notifications have time to let go of them
+    removedNotificationsTimer.setInterval(10000);
+    removedNotificationsTimer.setSingleShot(true);
+    connect(&removedNotificationsTimer, SIGNAL(timeout()), this, SLOT(destroyRemovedNotificationsIfIdle()));
 
     expirationTimer.setSingleShot(true);
     connect(&expirationTimer, SIGNAL(timeout()), this, SLOT(expire()));
 
+    // Create the restored notifications in batches whenever there is nothing else to do
+    restoreTimer.setInterval(0);
+    connect(&restoreTimer, SIGNAL(timeout()), this, SLOT(restoreNextNotifications()));
+
+    // Store the notifications as configured: "memory", "batched" (default) or "durable"
+    QSettings settings(LIPSTICK_SETTINGS_FILE, QSettings::IniFormat);
+    database = new NotificationDatabase(NotificationDatabase::storagePolicyFromString(settings.value("Notifications/storagePolicy").toString()),
+                                        settings.value("Notifications/commitDelay", DEFAULT_COMMIT_DELAY).toInt(),
+                                        settings.value("Notifications/maxTransactionAge", DEFAULT_MAX_TRANSACTION_AGE).toInt());
+
+    // Limit the rate of notifications from each D-Bus sender and coalesce rapid updates
+    rateLimit = settings.value("Notifications/rateLimit", DEFAULT_RATE_LIMIT).toDouble();
+    rateLimitBurst = qMax(1, settings.value("Notifications/rateLimitBurst", DEFAULT_RATE_LIMIT_BURST).toInt());
+    rateLimitClock.start();
+    deferredNotificationTimer.setInterval(settings.value("Notifications/coalesceInterval", DEFAULT_COALESCE_INTERVAL).toInt());
+    deferredNotificationTimer.setSingleShot(true);
+    connect(&deferredNotificationTimer, SIGNAL(timeout()), this, SLOT(processDeferredNotifications()));
+
+    // Limit the number of notifications an application, or all of them, may keep: 0 disables a limit
+    maxNotificationsPerApplication = qMax(0, settings.value("Notifications/maxNotificationsPerApplication", DEFAULT_MAX_NOTIFICATIONS_PER_APPLICATION).toInt());
+    maxNotifications = qMax(0, settings.value("Notifications/maxNotifications", DEFAULT_MAX_NOTIFICATIONS).toInt());
+
+    // Unique bus names are never reused, so a cached sender identity is valid until the sender disconnects
+    connect(senderWatcher, SIGNAL(serviceUnregistered(QString)), this, SLOT(removeSenderIdentity(QString)));
+
+    // Maintain the database while nobody is using the device so that the maintenance does not compete with the UI
+    maintenanceTimer.setInterval(settings.value("Notifications/maintenanceDelay", DEFAULT_MAINTENANCE_DELAY).toInt());
+    maintenanceTimer.setSingleShot(true);
+    connect(&maintenanceTimer, SIGNAL(timeout()), this, SLOT(performMaintenance()));
+    connect(displayState, SIGNAL(displayStateChanged(MeeGo::QmDisplayState::DisplayState)), this, SLOT(scheduleMaintenance()));
+    connect(activity, SIGNAL(activityChanged(MeeGo::QmActivity::Activity)), this, SLOT(scheduleMaintenance()));
+
+    // Report the changes made during an event loop iteration together
+    changeJournalTimer.setInterval(0);
+    changeJournalTimer.setSingleShot(true);
+    connect(&changeJournalTimer, SIGNAL(timeout()), this, SLOT(flushChangeJournal()));
+
     restoreNotifications();
 }
 
 NotificationManager::~NotificationManager()
 {
-    database->commit();
+    // Destroying the database writes all pending modifications to the disk
     delete database;
+    delete imageCache;
 }
 
 LipstickNotification *NotificationManager::notification(uint id) const
@@ -196,14 +299,249 @@ QStringList NotificationManager::GetCapabilities()
                          << "x-nemo-remote-actions"
                          << HINT_USER_REMOVABLE
                          << HINT_ORIGIN
-                         << "x-nemo-get-notifications";
+                         << HINT_VOLATILE
+                         << "x-nemo-get-notifications"
+                         << "x-nemo-batch";
 }
 
 uint NotificationManager::Notify(const QString &appName, uint replacesId, const QString &appIcon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout)
 {
-    uint id = replacesId != 0 ? replacesId : nextAvailableNotificationID();
+    return throttledNotify(calledFromDBus() ? message().service() : QString(), appName, replacesId, appIcon, summary, body, actions, hints, expireTimeout);
+}
+
+QList<uint> NotificationManager::NotifyMany(const NotificationList &notifications)
+{
+    const QList<LipstickNotification *> notificationList(notifications.notifications());
+    const QList<uint> ids(throttledNotifyMany(calledFromDBus() ? message().service() : QString(), notificationList));
+
+    if (calledFromDBus()) {
+        // The notifications were created when demarshalling the call and nobody else owns them
+        qDeleteAll(notificationList);
+    }
+
+    return ids;
+}
+
+QList<uint> NotificationManager::throttledNotifyMany(const QString &sender, const QList<LipstickNotification *> &batch)
+{
+    QList<uint> ids;
+    QList<uint> modifiedIds;
+    QSet<uint> modifiedIdSet;
+
+    // The whole batch takes a single token, so sending in batches is cheaper than sending one by one
+    const bool beyondRateLimit = !sender.isEmpty() && !takeRateLimitToken(sender);
+
+    database->beginBatch();
+    foreach (LipstickNotification *notification, batch) {
+        const uint replacesId = notification->replacesId();
+        uint id;
+        if (beyondRateLimit || awaitsSenderIdentity(sender, notification->appName(), notification->appIcon())) {
+            // Beyond the rate limit of the sender or until it has been identified the notifications are deferred as if they were sent with Notify()
+            id = throttledNotify(sender, notification->appName(), replacesId, notification->appIcon(), notification->summary(), notification->body(), notification->actions(), notification->hints(), notification->expireTimeout(), true);
+        } else {
+            // The batch supersedes any update of the notification still waiting to be handled
+            const bool create = cancelDeferredNotification(replacesId);
+            id = addOrReplaceNotification(sender, notification->appName(), create ? 0 : replacesId, notification->appIcon(), notification->summary(), notification->body(), notification->actions(), notification->hints(), notification->expireTimeout(), create ? replacesId : 0);
+            if (id != 0 && !modifiedIdSet.contains(id)) {
+                modifiedIdSet.insert(id);
+                modifiedIds.append(id);
+            }
+        }
+        ids.append(id);
+    }
+    database->endBatch();
+
+    // A notification of the batch may have been evicted to make room for a later one
+    for (int i = 0; i < ids.count(); ++i) {
+        if (modifiedIdSet.contains(ids.at(i)) && !notifications.contains(ids.at(i))) {
+            modifiedIds.removeOne(ids.at(i));
+            ids[i] = 0;
+        }
+    }
+
+    if (!modifiedIds.isEmpty()) {
+        emit notificationsModified(modifiedIds);
+    }
+
+    return ids;
+}
+
+uint NotificationManager::throttledNotify(const QString &sender, const QString &appName, uint replacesId, const QString &appIcon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout, bool beyondRateLimit)
+{
+    if (sender.isEmpty()) {
+        // Notifications from lipstick itself are handled right away
+        const uint id = addOrReplaceNotification(sender, appName, replacesId, appIcon, summary, body, actions, hints, expireTimeout);
+        if (id != 0) {
+            emit notificationModified(id);
+        }
+        return id;
+    }
+
+    // Identifying a new sender takes a D-Bus round trip, so its notification waits for the reply
+    const bool awaitingIdentity = awaitsSenderIdentity(sender, appName, appIcon);
+
+    uint id = replacesId;
+    DeferredNotification *deferred = 0;
+    if (replacesId != 0) {
+        QHash<uint, DeferredNotification>::iterator it = deferredNotifications.find(replacesId);
+        if (it != deferredNotifications.end()) {
+            // Collapse the deferred notification into this one
+            coalescedNotificationCount++;
+            deferred = &it.value();
+        } else if (restoredNotification(replacesId) == 0) {
+            // Return the ID 0 when trying to update a notification which doesn't exist
+            return 0;
+        } else if (coalescingIds.contains(replacesId) || beyondRateLimit || awaitingIdentity || !takeRateLimitToken(sender)) {
+            // Updated during the coalescing interval, too often or by an unidentified sender: handle the update later
+            deferred = &deferNotification(replacesId, sender, false);
+        }
+    } else if (beyondRateLimit || awaitingIdentity || !takeRateLimitToken(sender)) {
+        if (deferredNotificationCounts.value(sender) >= MAX_DEFERRED_NOTIFICATIONS_PER_SENDER) {
+            droppedNotificationCount++;
+            return 0;
+        }
+
+        // Sending too often or not identified yet: reserve an ID but create the notification later
+        id = nextAvailableNotificationID();
+        deferred = &deferNotification(id, sender, true);
+    }
+
+    if (deferred != 0) {
+        deferred->appName = appName;
+        deferred->appIcon = appIcon;
+        deferred->summary = summary;
+        deferred->body = body;
+        deferred->actions = actions;
+        deferred->hints = hints;
+        deferred->expireTimeout = expireTimeout;
+
+        // Identify the sender while the notification waits; an awaited identity holds the notification back until the reply
+        if (appName.isEmpty() || appIcon.isEmpty()) {
+            lookUpSenderIdentity(sender);
+        }
+        return id;
+    }
+
+    id = addOrReplaceNotification(sender, appName, replacesId, appIcon, summary, body, actions, hints, expireTimeout);
+    if (id != 0) {
+        // Coalesce further updates arriving during the coalescing interval
+        coalescingIds.insert(id);
+        if (!deferredNotificationTimer.isActive()) {
+            deferredNotificationTimer.start();
+        }
+        emit notificationModified(id);
+    }
+    return id;
+}
+
+NotificationManager::DeferredNotification &NotificationManager::deferNotification(uint id, const QString &sender, bool create)
+{
+    DeferredNotification &deferred = deferredNotifications[id];
+    deferred.sender = sender;
+    deferred.create = create;
+    deferredNotificationIds.append(id);
+    deferredNotificationCounts[sender]++;
+    if (!deferredNotificationTimer.isActive()) {
+        deferredNotificationTimer.start();
+    }
+    return deferred;
+}
+
+bool NotificationManager::takeRateLimitToken(const QString &sender)
+{
+    if (rateLimit <= 0) {
+        return true;
+    }
+
+    const qint64 currentTime(rateLimitClock.elapsed());
+    QHash<QString, RateLimitBucket>::iterator it = rateLimitBuckets.find(sender);
+    if (it == rateLimitBuckets.end()) {
+        if (rateLimitBuckets.count() >= MAX_RATE_LIMIT_BUCKETS) {
+            // Forget the senders which have not sent anything for long enough to have a full bucket
+            QHash<QString, RateLimitBucket>::iterator bucket = rateLimitBuckets.begin();
+            while (bucket != rateLimitBuckets.end()) {
+                if (bucket->tokens + (currentTime - bucket->updated) * rateLimit / 1000 >= rateLimitBurst) {
+                    bucket = rateLimitBuckets.erase(bucket);
+                } else {
+                    ++bucket;
+                }
+            }
+        }
+
+        // A new sender starts with a full bucket
+        it = rateLimitBuckets.insert(sender, RateLimitBucket());
+        it->tokens = rateLimitBurst;
+        it->updated = currentTime;
+    } else {
+        it->tokens = qMin<double>(rateLimitBurst, it->tokens + (currentTime - it->updated) * rateLimit / 1000);
+        it->updated = currentTime;
+    }
 
-    if (replacesId == 0 || notifications.contains(id)) {
+    if (it->tokens >= 1) {
+        it->tokens -= 1;
+        return true;
+    }
+    return false;
+}
+
+bool NotificationManager::cancelDeferredNotification(uint id)
+{
+    QHash<uint, DeferredNotification>::iterator it = deferredNotifications.find(id);
+    if (it == deferredNotifications.end()) {
+        return false;
+    }
+
+    const bool create = it->create;
+    if (--deferredNotificationCounts[it->sender] <= 0) {
+        deferredNotificationCounts.remove(it->sender);
+    }
+    deferredNotifications.erase(it);
+    deferredNotificationIds.removeOne(id);
+    return create;
+}
+
+void NotificationManager::processDeferredNotifications()
+{
+    // A new coalescing interval starts for the notifications handled now
+    coalescingIds.clear();
+
+    QList<uint> modifiedIds;
+    QList<uint> remainingIds;
+    database->beginBatch();
+    foreach (uint id, deferredNotificationIds) {
+        const DeferredNotification deferred(deferredNotifications.value(id));
+        if (!senderIdentityLookups.contains(deferred.sender) && takeRateLimitToken(deferred.sender)) {
+            deferredNotifications.remove(id);
+            if (--deferredNotificationCounts[deferred.sender] <= 0) {
+                deferredNotificationCounts.remove(deferred.sender);
+            }
+
+            const uint modifiedId = addOrReplaceNotification(deferred.sender, deferred.appName, deferred.create ? 0 : id, deferred.appIcon, deferred.summary, deferred.body, deferred.actions, deferred.hints, deferred.expireTimeout, deferred.create ? id : 0);
+            if (modifiedId != 0) {
+                modifiedIds.append(modifiedId);
+                coalescingIds.insert(modifiedId);
+            }
+        } else {
+            remainingIds.append(id);
+        }
+    }
+    database->endBatch();
+    deferredNotificationIds = remainingIds;
+
+    if (!coalescingIds.isEmpty() || !deferredNotificationIds.isEmpty()) {
+        deferredNotificationTimer.start();
+    }
+
+    if (!modifiedIds.isEmpty()) {
+        emit notificationsModified(modifiedIds);
+    }
+}
+
+uint NotificationManager::addOrReplaceNotification(const QString &sender, const QString &appName, uint replacesId, const QString &appIcon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout, uint newId)
+{
+    uint id = replacesId != 0 ? replacesId : (newId != 0 ? newId : nextAvailableNotificationID());
+
+    if (replacesId == 0 || restoredNotification(id) != 0) {
         QString appName_(appName);
         QString appIcon_(appIcon);
         QString summary_(summary);
@@ -246,18 +584,14 @@ uint NotificationManager::Notify(const QString &appName, uint replacesId, const
             }
         }
 
-        if ((appName_.isEmpty() || appIcon_.isEmpty()) && calledFromDBus()) {
-            // Use the pid to try to provide these properties
-            const QString callerService(message().service());
-            const QDBusReply<uint> pidReply(connection().interface()->servicePid(callerService));
-            if (pidReply.isValid()) {
-                const QPair<QString, QString> properties(processProperties(pidReply.value()));
-                if (appName_.isEmpty() && !properties.first.isEmpty()) {
-                    appName_ = properties.first;
-                }
-                if (appIcon_.isEmpty() && !properties.second.isEmpty()) {
-                    appIcon_ = properties.second;
-                }
+        if ((appName_.isEmpty() || appIcon_.isEmpty()) && !sender.isEmpty()) {
+            // Use the process of the sender to try to provide these properties
+            const SenderIdentity identity(senderIdentity(sender));
+            if (appName_.isEmpty() && !identity.appName.isEmpty()) {
+                appName_ = identity.appName;
+            }
+            if (appIcon_.isEmpty() && !identity.appIcon.isEmpty()) {
+                appIcon_ = identity.appIcon;
             }
         } else if (appName_ == QStringLiteral("AndroidNotification")) {
             // This forwarded Android notification contains the real app name in the summary
@@ -270,15 +604,71 @@ uint NotificationManager::Notify(const QString &appName, uint replacesId, const
             }
         }
 
+        // Keep only a reference to the image data so that it is neither kept in memory nor stored in the database
+        storeImageData(hints_);
+
         if (replacesId == 0) {
             // Create a new notification
             LipstickNotification *notification = new LipstickNotification(appName_, id, appIcon_, summary_, body_, actions, hints_, expireTimeout_, this);
             connect(notification, SIGNAL(actionInvoked(QString)), this, SLOT(invokeAction(QString)), Qt::QueuedConnection);
             connect(notification, SIGNAL(removeRequested()), this, SLOT(removeNotificationIfUserRemovable()), Qt::QueuedConnection);
             notifications.insert(id, notification);
+            addToIndexes(notification);
+            updateImageReference(id, hints_);
+            stampChange(id);
+            journalChange(id, JournalAdded);
+
+            // Add the notification, its actions and its hints to the database unless it is kept in memory only
+            if (isVolatile(hints_)) {
+                volatileNotificationIds.insert(id);
+                avoidedDatabaseWriteCount++;
+            } else {
+                insertNotification(id, appName_, appIcon_, summary_, body_, actions, hints_, expireTimeout_);
+            }
+
+            // Make room for the notification if there are too many
+            evictNotifications(id);
         } else {
             // Only replace an existing notification if it really exists
             LipstickNotification *notification = notifications.value(id);
+
+            if (hints.value(HINT_TIMESTAMP).toString().isEmpty()) {
+                // The timestamp was generated for this call: keep the existing one if nothing else changed
+                QVariantHash unchangedHints(hints_);
+                unchangedHints.insert(HINT_TIMESTAMP, notification->hints().value(HINT_TIMESTAMP));
+                if (unchangedHints == notification->hints()) {
+                    hints_ = unchangedHints;
+                }
+            }
+
+            const bool wasVolatile = volatileNotificationIds.contains(id);
+            if (!isVolatile(hints_)) {
+                if (wasVolatile) {
+                    // The notification is no longer kept in memory only so store all of it
+                    volatileNotificationIds.remove(id);
+                    insertNotification(id, appName_, appIcon_, summary_, body_, actions, hints_, expireTimeout_);
+                } else {
+                    // Update only the changed columns in the database
+                    updateNotification(notification, appName_, appIcon_, summary_, body_, actions, hints_, expireTimeout_);
+                }
+            } else if (!wasVolatile) {
+                // The notification is kept in memory only from now on
+                volatileNotificationIds.insert(id);
+                deleteRows("notifications", QVariantList() << id);
+            } else {
+                avoidedDatabaseWriteCount++;
+            }
+
+            if (unscheduleExpiration(id)) {
+                // Delete the existing expiration time from the database
+                if (wasVolatile) {
+                    avoidedDatabaseWriteCount++;
+                } else {
+                    deleteRows("expiration", QVariantList() << id);
+                }
+            }
+
+            removeFromIndexes(notification);
             notification->setAppName(appName_);
             notification->setAppIcon(appIcon_);
             notification->setSummary(summary_);
@@ -286,26 +676,13 @@ uint NotificationManager::Notify(const QString &appName, uint replacesId, const
             notification->setActions(actions);
             notification->setHints(hints_);
             notification->setExpireTimeout(expireTimeout_);
-
-            // Delete the existing notification from the database
-            execSQL(QString("DELETE FROM notifications WHERE id=?"), QVariantList() << id);
-            execSQL(QString("DELETE FROM actions WHERE id=?"), QVariantList() << id);
-            execSQL(QString("DELETE FROM hints WHERE id=?"), QVariantList() << id);
-            execSQL(QString("DELETE FROM expiration WHERE id=?"), QVariantList() << id);
-        }
-
-        // Add the notification, its actions and its hints to the database
-        execSQL("INSERT INTO notifications VALUES (?, ?, ?, ?, ?, ?)", QVariantList() << id << appName_ << appIcon_ << summary_ << body_ << expireTimeout_);
-        foreach (const QString &action, actions) {
-            execSQL("INSERT INTO actions VALUES (?, ?)", QVariantList() << id << action);
-        }
-        QVariantHash::const_iterator hit = hints_.constBegin(), hend = hints_.constEnd();
-        for ( ; hit != hend; ++hit) {
-            execSQL("INSERT INTO hints VALUES (?, ?, ?)", QVariantList() << id << hit.key() << hit.value());
+            addToIndexes(notification);
+            updateImageReference(id, hints_);
+            stampChange(id);
+            journalChange(id, JournalModified);
         }
 
         NOTIFICATIONS_DEBUG("NOTIFY:" << appName_ << appIcon_ << summary_ << body_ << actions << hints_ << expireTimeout_ << "->" << id);
-        emit notificationModified(id);
     } else {
         // Return the ID 0 when trying to update a notification which doesn't exist
         id = 0;
@@ -316,73 +693,108 @@ uint NotificationManager::Notify(const QString &appName, uint replacesId, const
 
 void NotificationManager::CloseNotification(uint id, NotificationClosedReason closeReason)
 {
-    if (notifications.contains(id)) {
+    if (cancelDeferredNotification(id)) {
+        // The notification was never created so there is nothing else to remove
+        emit NotificationClosed(id, closeReason);
+    } else if (restoredNotification(id) != 0) {
         emit NotificationClosed(id, closeReason);
 
-        // Remove the notification, its actions and its hints from database
+        // Remove the notification and its expiration time from database
         const QVariantList params(QVariantList() << id);
-        execSQL(QString("DELETE FROM notifications WHERE id=?"), params);
-        execSQL(QString("DELETE FROM actions WHERE id=?"), params);
-        execSQL(QString("DELETE FROM hints WHERE id=?"), params);
-        execSQL(QString("DELETE FROM expiration WHERE id=?"), params);
+        const bool volatileNotification = volatileNotificationIds.contains(id);
+        if (volatileNotification) {
+            avoidedDatabaseWriteCount++;
+        } else {
+            deleteRows("notifications", params);
+        }
+        if (unscheduleExpiration(id)) {
+            if (volatileNotification) {
+                avoidedDatabaseWriteCount++;
+            } else {
+                deleteRows("expiration", params);
+            }
+        }
 
         NOTIFICATIONS_DEBUG("REMOVE:" << id);
         emit notificationRemoved(id);
 
         // Mark the notification to be destroyed
-        removedNotifications.insert(notifications.take(id));
+        removedNotifications.insert(takeNotification(id));
+        removedNotificationsTimer.start();
     }
 }
 
 void NotificationManager::CloseNotifications(const QList<uint> &ids, NotificationClosedReason closeReason)
 {
-    if (!ids.isEmpty()) {
-        foreach (uint id, ids) {
-            if (notifications.contains(id)) {
-                emit NotificationClosed(id, closeReason);
-
-                // Remove the notification, its actions and its hints from database
-                const QVariantList params(QVariantList() << id);
-                execSQL(QString("DELETE FROM notifications WHERE id=?"), params);
-                execSQL(QString("DELETE FROM actions WHERE id=?"), params);
-                execSQL(QString("DELETE FROM hints WHERE id=?"), params);
-                execSQL(QString("DELETE FROM expiration WHERE id=?"), params);
+    QList<uint> closedIds;
+    QSet<uint> closedIdSet;
+    QVariantList params;
+    QVariantList expirationParams;
+    foreach (uint id, ids) {
+        if (cancelDeferredNotification(id)) {
+            // The notification was never created so there is nothing else to remove
+            emit NotificationClosed(id, closeReason);
+        } else if (!closedIdSet.contains(id) && restoredNotification(id) != 0) {
+            emit NotificationClosed(id, closeReason);
+            closedIds << id;
+            closedIdSet.insert(id);
+            const bool volatileNotification = volatileNotificationIds.contains(id);
+            if (volatileNotification) {
+                avoidedDatabaseWriteCount++;
+            } else {
+                params << id;
+            }
+            if (unscheduleExpiration(id)) {
+                if (volatileNotification) {
+                    avoidedDatabaseWriteCount++;
+                } else {
+                    expirationParams << id;
+                }
             }
         }
+    }
 
-        NOTIFICATIONS_DEBUG("REMOVE:" << ids);
-        emit notificationsRemoved(ids);
+    if (!closedIds.isEmpty()) {
+        // Remove the notifications and their expiration times from database
+        database->beginBatch();
+        deleteRows("notifications", params);
+        deleteRows("expiration", expirationParams);
+        database->endBatch();
 
-        foreach (uint id, ids) {
+        NOTIFICATIONS_DEBUG("REMOVE:" << closedIds);
+        emit notificationsRemoved(closedIds);
+
+        foreach (uint id, closedIds) {
             emit notificationRemoved(id);
 
             // Mark the notification to be destroyed
-            removedNotifications.insert(notifications.take(id));
+            removedNotifications.insert(takeNotification(id));
         }
+        removedNotificationsTimer.start();
     }
 }
 
 void NotificationManager::MarkNotificationDisplayed(uint id)
 {
-    if (notifications.contains(id)) {
-        const LipstickNotification *notification = notifications.value(id);
+    const LipstickNotification *notification = restoredNotification(id);
+    if (notification != 0) {
         if (notification->hints().value(HINT_TRANSIENT).toBool()) {
             // Remove this notification immediately
             CloseNotification(id, NotificationExpired);
             NOTIFICATIONS_DEBUG("REMOVED transient:" << id);
         } else {
             const int timeout(notification->expireTimeout());
-            if (timeout > 0) {
-                // Insert the timeout into the expiration table, or leave the existing value if already present
+            if (timeout > 0 && !expirationTimes.contains(id)) {
+                // Schedule the expiration and store it in the expiration table; an existing expiration time is left as is
                 const qint64 currentTime(QDateTime::currentDateTimeUtc().toMSecsSinceEpoch());
                 const qint64 expireAt(currentTime + timeout);
-                execSQL(QString("INSERT OR IGNORE INTO expiration(id, expire_at) VALUES(?, ?)"), QVariantList() << id << expireAt);
-
-                if (nextExpirationTime == 0 || (expireAt < nextExpirationTime)) {
-                    // This will be the next notification to expire - update the timer
-                    nextExpirationTime = expireAt;
-                    expirationTimer.start(timeout);
+                scheduleExpiration(id, expireAt);
+                if (volatileNotificationIds.contains(id)) {
+                    avoidedDatabaseWriteCount++;
+                } else {
+                    database->execSQL(QString("INSERT OR REPLACE INTO expiration(id, expire_at) VALUES(?, ?)"), QVariantList() << id << expireAt);
                 }
+                updateExpirationTimer(currentTime);
 
                 NOTIFICATIONS_DEBUG("DISPLAYED:" << id << "expiring in:" << timeout);
             }
@@ -400,24 +812,77 @@ QString NotificationManager::GetServerInformation(QString &name, QString &vendor
 
 NotificationList NotificationManager::GetNotifications(const QString &owner)
 {
+    restorePendingNotifications();
+
     QList<LipstickNotification *> notificationList;
-    QHash<uint, LipstickNotification *>::const_iterator it = notifications.constBegin(), end = notifications.constEnd();
-    for ( ; it != end; ++it) {
-        LipstickNotification *notification = it.value();
-        if (notification->owner() == owner) {
-            notificationList.append(notification);
+    foreach (uint id, notificationIdsByOwner.value(owner)) {
+        notificationList.append(notifications.value(id));
+    }
+
+    return NotificationList(notificationList);
+}
+
+static bool removalSerialLessThan(quint64 serial, const QPair<quint64, uint> &removal)
+{
+    return serial < removal.first;
+}
+
+NotificationList NotificationManager::GetNotificationsSince(quint64 serial, QList<uint> &removedIds, quint64 &currentSerial, bool &complete)
+{
+    restorePendingNotifications();
+
+    currentSerial = changeSerial;
+    complete = serial < firstChangeSerial || serial > changeSerial || serial < removalLogStart;
+
+    QList<LipstickNotification *> notificationList;
+    if (complete) {
+        notificationList = notifications.values();
+    } else {
+        QMap<quint64, uint>::const_iterator end = notificationIdsBySerial.constEnd();
+        for (QMap<quint64, uint>::const_iterator it = notificationIdsBySerial.upperBound(serial); it != end; ++it) {
+            notificationList.append(notifications.value(it.value()));
+        }
+
+        QList<QPair<quint64, uint> >::const_iterator it = std::upper_bound(removalLog.constBegin(), removalLog.constEnd(), serial, removalSerialLessThan);
+        for ( ; it != removalLog.constEnd(); ++it) {
+            removedIds.append(it->second);
         }
     }
 
+    NOTIFICATIONS_DEBUG("CHANGES SINCE:" << serial << "->" << currentSerial << "complete:" << complete << "changed:" << notificationList.count() << "removed:" << removedIds.count());
     return NotificationList(notificationList);
 }
 
+QVariantHash NotificationManager::GetNotificationStatistics() const
+{
+    QVariantHash statistics;
+    statistics.insert("coalesced", coalescedNotificationCount);
+    statistics.insert("dropped", droppedNotificationCount);
+    statistics.insert("deferred", deferredNotifications.count());
+    statistics.insert("volatile", volatileNotificationIds.count());
+    statistics.insert("databaseWritesAvoided", avoidedDatabaseWriteCount);
+    statistics.insert("evicted", evictedNotificationCount);
+    return statistics;
+}
+
+QVariantHash NotificationManager::GetApplicationNotificationCounts()
+{
+    restorePendingNotifications();
+
+    QVariantHash counts;
+    QHash<QString, QSet<uint> >::const_iterator it = notificationIdsByAppName.constBegin(), end = notificationIdsByAppName.constEnd();
+    for ( ; it != end; ++it) {
+        counts.insert(it.key(), uint(it.value().count()));
+    }
+    return counts;
+}
+
 uint NotificationManager::nextAvailableNotificationID()
 {
     bool idIncreased = false;
 
     // Try to find an unused ID. Increase the ID at least once but only up to 2^32-1 times.
-    for (uint i = 0; i < UINT32_MAX && (!idIncreased || notifications.contains(previousNotificationID)); i++, idIncreased = true) {
+    for (uint i = 0; i < UINT32_MAX && (!idIncreased || notifications.contains(previousNotificationID) || pendingRecords.contains(previousNotificationID) || deferredNotifications.contains(previousNotificationID)); i++, idIncreased = true) {
         previousNotificationID++;
 
         if (previousNotificationID == 0) {
@@ -429,38 +894,48 @@ uint NotificationManager::nextAvailableNotificationID()
     return previousNotificationID;
 }
 
-void NotificationManager::removeNotificationsWithCategory(const QString &category)
+QList<uint> NotificationManager::notificationIdsWithCategory(const QString &category)
+{
+    restorePendingNotifications();
+
+    return notificationIdsByCategory.value(category).toList();
+}
+
+void NotificationManager::removeNotificationsWithCategories(const QStringList &categories)
 {
     QList<uint> ids;
-    QHash<uint, LipstickNotification *>::const_iterator it = notifications.constBegin(), end = notifications.constEnd();
-    for ( ; it != end; ++it) {
-        LipstickNotification *notification(it.value());
-        if (notification->category() == category) {
-            ids.append(it.key());
-        }
+    foreach (const QString &category, categories) {
+        ids.append(notificationIdsWithCategory(category));
     }
     CloseNotifications(ids);
 }
 
-void NotificationManager::updateNotificationsWithCategory(const QString &category)
+void NotificationManager::updateNotificationsWithCategories(const QStringList &categories)
 {
     QList<LipstickNotification *> categoryNotifications;
-
-    QHash<uint, LipstickNotification *>::const_iterator it = notifications.constBegin(), end = notifications.constEnd();
-    for ( ; it != end; ++it) {
-        LipstickNotification *notification(it.value());
-        if (notification->category() == category) {
-            categoryNotifications.append(notification);
+    foreach (const QString &category, categories) {
+        foreach (uint id, notificationIdsWithCategory(category)) {
+            categoryNotifications.append(notifications.value(id));
         }
     }
 
+    QList<uint> modifiedIds;
+    database->beginBatch();
     foreach (LipstickNotification *notification, categoryNotifications) {
         // Remove the preview summary and body hints to avoid showing the preview banner again
         QVariantHash hints = notification->hints();
         hints.remove(HINT_PREVIEW_SUMMARY);
         hints.remove(HINT_PREVIEW_BODY);
 
-        Notify(notification->appName(), notification->replacesId(), notification->appIcon(), notification->summary(), notification->body(), notification->actions(), hints, notification->expireTimeout());
+        const uint id = addOrReplaceNotification(QString(), notification->appName(), notification->replacesId(), notification->appIcon(), notification->summary(), notification->body(), notification->actions(), hints, notification->expireTimeout());
+        if (id != 0) {
+            modifiedIds.append(id);
+        }
+    }
+    database->endBatch();
+
+    if (!modifiedIds.isEmpty()) {
+        emit notificationsModified(modifiedIds);
     }
 }
 
@@ -478,337 +953,570 @@ void NotificationManager::addTimestamp(QVariantHash &hints)
 
 void NotificationManager::restoreNotifications()
 {
-    if (connectToDatabase()) {
-        if (checkTableValidity()) {
-            fetchData();
-        } else {
-            database->close();
+    const QList<NotificationDatabase::Record> records(database->restore());
+
+    const qint64 currentTime(QDateTime::currentDateTimeUtc().toMSecsSinceEpoch());
+    QVariantList expiredIds;
+
+    // Only reserve the IDs and schedule the expirations here; the notifications are created later in batches
+    foreach (const NotificationDatabase::Record &record, records) {
+        const uint id = record.id;
+
+        if (id > previousNotificationID) {
+            // Use the highest notification ID found as the previous notification ID
+            previousNotificationID = id;
         }
+
+        if (record.expireAt != 0) {
+            if (record.expireAt <= currentTime) {
+                NOTIFICATIONS_DEBUG("EXPIRED AT RESTORE:" << record.appName << record.appIcon << record.summary << record.body << record.actions << record.hints << record.expireTimeout << "->" << id);
+                expiredIds.append(id);
+                continue;
+            }
+
+            expirationTimes.insert(id, record.expireAt);
+            expirationQueue.append(qMakePair(record.expireAt, id));
+        }
+
+        pendingRecords.insert(id, record);
+        updateImageReference(id, record.hints);
+    }
+
+    // Images are only referred to by notifications, so any image not referred to by the restored ones is stale
+    imageCache->removeUnreferencedImages();
+
+    // Remove the expired notifications from the database without ever creating them
+    deleteRows("notifications", expiredIds);
+    deleteRows("expiration", expiredIds);
+    foreach (const QVariant &id, expiredIds) {
+        emit NotificationClosed(id.toUInt(), NotificationExpired);
+    }
+
+    std::make_heap(expirationQueue.begin(), expirationQueue.end(), std::greater<ExpirationEntry>());
+    updateExpirationTimer(currentTime);
+
+    // Order the restored notifications by their timestamps, the ID breaking ties between equal or missing ones
+    QList<QPair<qint64, uint> > receptionOrder;
+    for (QHash<uint, NotificationDatabase::Record>::const_iterator it = pendingRecords.constBegin(); it != pendingRecords.constEnd(); ++it) {
+        const QDateTime timestamp(it->hints.value(HINT_TIMESTAMP).toDateTime());
+        receptionOrder.append(qMakePair(timestamp.isValid() ? timestamp.toMSecsSinceEpoch() : qint64(0), it.key()));
+    }
+    std::sort(receptionOrder.begin(), receptionOrder.end());
+
+    // Change serials from before this instance keep the restored notifications out of the changes since
+    // and make them the first ones to be evicted, oldest first
+    quint64 serial = firstChangeSerial - receptionOrder.count();
+    for (int i = 0; i < receptionOrder.count(); ++i, ++serial) {
+        const uint id = receptionOrder.at(i).second;
+        const NotificationDatabase::Record &record(pendingRecords[id]);
+        notificationSerials.insert(id, serial);
+        notificationIdsBySerial.insert(serial, id);
+        addToEvictionIndexes(id, record.appName, record.hints);
+        pendingCountsByAppName[record.appName]++;
+
+        // Create the latest notifications first
+        pendingRecordIds.prepend(id);
     }
+    if (!pendingRecordIds.isEmpty()) {
+        restoreTimer.start();
+    }
+
+    qWarning() << "Notifications restored:" << pendingRecords.count();
 }
 
-bool NotificationManager::connectToDatabase()
+LipstickNotification *NotificationManager::restoredNotification(uint id)
 {
-    QString databasePath = "/home/nemo" + QString(PRIVILEGED_DATA_PATH) + QDir::separator() + "Notifications";
-    if (!QDir::root().exists(databasePath)) {
-        QDir::root().mkpath(databasePath);
+    QHash<uint, NotificationDatabase::Record>::iterator it = pendingRecords.find(id);
+    if (it == pendingRecords.end()) {
+        return notifications.value(id);
     }
-    QString databaseName = databasePath + "/notifications.db";
 
-    *database = QSqlDatabase::addDatabase("QSQLITE", metaObject()->className());
-    database->setDatabaseName(databaseName);
-    bool success = checkForDiskSpace(databasePath, MINIMUM_FREE_SPACE_NEEDED_IN_KB);
-    if (success) {
-        success = database->open();
-        if (!success) {
-            NOTIFICATIONS_DEBUG(database->lastError().driverText() << databaseName << database->lastError().databaseText());
+    const NotificationDatabase::Record &record(it.value());
+    LipstickNotification *notification = new LipstickNotification(record.appName, id, record.appIcon, record.summary, record.body, record.actions, record.hints, record.expireTimeout, this);
+    connect(notification, SIGNAL(actionInvoked(QString)), this, SLOT(invokeAction(QString)), Qt::QueuedConnection);
+    connect(notification, SIGNAL(removeRequested()), this, SLOT(removeNotificationIfUserRemovable()), Qt::QueuedConnection);
+    notifications.insert(id, notification);
 
-            // If opening the database fails, try to recreate the database
-            removeDatabaseFile(databaseName);
-            success = database->open();
-            NOTIFICATIONS_DEBUG("Unable to open database file. Recreating. Success: " << success);
-        }
-    } else {
-        NOTIFICATIONS_DEBUG("Not enough free disk space available. Unable to open database.");
-    }
+    // The serial given at restore is kept since creating the notification does not change it
+    addToIndexes(notification);
 
-    if (success) {
-        // Set up the database mode to write-ahead locking to improve performance
-        QSqlQuery(*database).exec("PRAGMA journal_mode=WAL");
+    QHash<QString, int>::iterator count = pendingCountsByAppName.find(record.appName);
+    if (count != pendingCountsByAppName.end() && --count.value() <= 0) {
+        pendingCountsByAppName.erase(count);
     }
+    pendingRecords.erase(it);
 
-    return success;
+    NOTIFICATIONS_DEBUG("RESTORED:" << notification->appName() << notification->appIcon() << notification->summary() << notification->body() << notification->actions() << notification->hints() << notification->expireTimeout() << "->" << id);
+    return notification;
 }
 
-bool NotificationManager::checkForDiskSpace(const QString &path, unsigned long freeSpaceNeeded)
+void NotificationManager::restorePendingNotifications(int maximumCount)
 {
-    struct statfs st;
-    bool spaceAvailable = false;
-    if (statfs(path.toUtf8().data(), &st) != -1) {
-        unsigned long freeSpaceInKb = (st.f_bsize * st.f_bavail) / 1024;
-        if (freeSpaceInKb > freeSpaceNeeded) {
-            spaceAvailable = true;
+    QList<uint> ids;
+    while (!pendingRecordIds.isEmpty() && ids.count() < maximumCount) {
+        const uint id = pendingRecordIds.takeFirst();
+
+        // Notifications which have been needed in the meantime have been created already
+        if (pendingRecords.contains(id)) {
+            restoredNotification(id);
+            ids.append(id);
         }
     }
-    return spaceAvailable;
+
+    if (pendingRecordIds.isEmpty()) {
+        restoreTimer.stop();
+    }
+
+    if (!ids.isEmpty()) {
+        emit notificationsRestored(ids);
+    }
 }
 
-void NotificationManager::removeDatabaseFile(const QString &path)
+void NotificationManager::restoreNextNotifications()
 {
-    // Remove also -shm and -wal files created when journal-mode=WAL is being used
-    QDir::root().remove(path + "-shm");
-    QDir::root().remove(path + "-wal");
-    QDir::root().remove(path);
+    restorePendingNotifications(RESTORE_BATCH_SIZE);
 }
 
-bool NotificationManager::checkTableValidity()
+void NotificationManager::destroyRemovedNotifications()
 {
-    bool result = true;
-    bool recreateNotificationsTable = false;
-    bool recreateActionsTable = false;
-    bool recreateHintsTable = false;
-    bool recreateExpirationTable = false;
+    qDeleteAll(removedNotifications);
+    removedNotifications.clear();
+}
 
-    const int databaseVersion(schemaVersion());
+void NotificationManager::flushChangeJournal()
+{
+    QList<uint> added;
+    QList<uint> modified;
+    QList<uint> removed;
+    foreach (uint id, changeJournalOrder) {
+        // Entries cancelled out or already reported are no longer in the journal
+        const int changes = changeJournal.take(id);
+        if (changes & JournalRemoved) {
+            removed.append(id);
+        }
+        if (changes & JournalAdded) {
+            added.append(id);
+        } else if (changes == JournalModified) {
+            modified.append(id);
+        }
+    }
+    changeJournal.clear();
+    changeJournalOrder.clear();
+
+    if (!added.isEmpty() || !modified.isEmpty() || !removed.isEmpty()) {
+        emit notificationsChanged(added, modified, removed);
+    }
+}
 
-    if (databaseVersion == 0) {
-        // Unmodified database - remove any existing notifications, which might cause problems
-        qWarning() << "Removing obsolete notifications";
-        recreateNotificationsTable = true;
-        recreateActionsTable = true;
-        recreateHintsTable = true;
-        recreateExpirationTable = true;
+void NotificationManager::destroyRemovedNotificationsIfIdle()
+{
+    if (isIdle()) {
+        destroyRemovedNotifications();
+    }
+}
 
-        if (!setSchemaVersion(1)) {
-            qWarning() << "Unable to set database schema version!";
+void NotificationManager::scheduleMaintenance()
+{
+    if (isIdle()) {
+        if (!maintenanceTimer.isActive()) {
+            maintenanceTimer.start();
         }
     } else {
-        // Check that the notifications table schema is as expected
-        QSqlTableModel notificationsTableModel(0, *database);
-        notificationsTableModel.setTable("notifications");
-        recreateNotificationsTable = (notificationsTableModel.fieldIndex("id") == -1 ||
-                                      notificationsTableModel.fieldIndex("app_name") == -1 ||
-                                      notificationsTableModel.fieldIndex("app_icon") == -1 ||
-                                      notificationsTableModel.fieldIndex("summary") == -1 ||
-                                      notificationsTableModel.fieldIndex("body") == -1 ||
-                                      notificationsTableModel.fieldIndex("expire_timeout") == -1);
+        maintenanceTimer.stop();
+    }
+}
 
-        // Check that the actions table schema is as expected
-        QSqlTableModel actionsTableModel(0, *database);
-        actionsTableModel.setTable("actions");
-        recreateActionsTable = (actionsTableModel.fieldIndex("id") == -1 ||
-                                actionsTableModel.fieldIndex("action") == -1);
+void NotificationManager::performMaintenance()
+{
+    if (!isIdle()) {
+        return;
+    }
+
+    // Notifications removed recently may still be in use; they are destroyed once the removal timer fires
+    if (!removedNotificationsTimer.isActive()) {
+        destroyRemovedNotifications();
+    }
+    database->performMaintenance();
+}
 
-        // Check that the hints table schema is as expected
-        QSqlTableModel hintsTableModel(0, *database);
-        hintsTableModel.setTable("hints");
-        recreateHintsTable = (hintsTableModel.fieldIndex("id") == -1 ||
-                              hintsTableModel.fieldIndex("hint") == -1 ||
-                              hintsTableModel.fieldIndex("value") == -1);
+bool NotificationManager::isIdle() const
+{
+    return displayState->get() == MeeGo::QmDisplayState::Off || activity->get() == MeeGo::QmActivity::Inactive;
+}
+
+bool NotificationManager::isVolatile(const QVariantHash &hints)
+{
+    return hints.value(HINT_VOLATILE).toBool() || hints.value(HINT_TRANSIENT).toBool();
+}
+
+void NotificationManager::insertNotification(uint id, const QString &appName, const QString &appIcon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout)
+{
+    if (database->isOpen()) {
+        database->execSQL("INSERT INTO notifications VALUES (?, ?, ?, ?, ?, ?, ?, ?)", QVariantList() << id << appName << appIcon << summary << body << expireTimeout << NotificationDatabase::serializeActions(actions) << NotificationDatabase::serializeHints(hints));
+    }
+}
 
-        // Check that the expiration table schema is as expected
-        QSqlTableModel expirationTableModel(0, *database);
-        expirationTableModel.setTable("expiration");
-        recreateExpirationTable = (expirationTableModel.fieldIndex("id") == -1 ||
-                                   expirationTableModel.fieldIndex("expire_at") == -1);
+void NotificationManager::updateNotification(const LipstickNotification *notification, const QString &appName, const QString &appIcon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout)
+{
+    if (!database->isOpen()) {
+        // The notifications are not being stored
+        return;
     }
 
-    if (recreateNotificationsTable) {
-        result &= recreateTable("notifications", "id INTEGER PRIMARY KEY, app_name TEXT, app_icon TEXT, summary TEXT, body TEXT, expire_timeout INTEGER");
+    QStringList assignments;
+    QVariantList values;
+
+    if (notification->appName() != appName) {
+        assignments << "app_name=?";
+        values << appName;
+    }
+    if (notification->appIcon() != appIcon) {
+        assignments << "app_icon=?";
+        values << appIcon;
+    }
+    if (notification->summary() != summary) {
+        assignments << "summary=?";
+        values << summary;
+    }
+    if (notification->body() != body) {
+        assignments << "body=?";
+        values << body;
+    }
+    if (notification->expireTimeout() != expireTimeout) {
+        assignments << "expire_timeout=?";
+        values << expireTimeout;
+    }
+    if (notification->actions() != actions) {
+        assignments << "actions=?";
+        values << NotificationDatabase::serializeActions(actions);
+    }
+    if (notification->hints() != hints) {
+        assignments << "hints=?";
+        values << NotificationDatabase::serializeHints(hints);
     }
 
-    if (recreateActionsTable) {
-        result &= recreateTable("actions", "id INTEGER, action TEXT, PRIMARY KEY(id, action)");
+    if (!assignments.isEmpty()) {
+        database->execSQL(QString("UPDATE notifications SET %1 WHERE id=?").arg(assignments.join(", ")), values << notification->replacesId());
     }
+}
 
-    if (recreateHintsTable) {
-        result &= recreateTable("hints", "id INTEGER, hint TEXT, value TEXT, PRIMARY KEY(id, hint)");
+void NotificationManager::deleteRows(const QString &table, const QVariantList &ids)
+{
+    if (ids.count() == 1) {
+        database->execSQL(QString("DELETE FROM %1 WHERE id=?").arg(table), ids);
+        return;
     }
 
-    if (recreateExpirationTable) {
-        result &= recreateTable("expiration", "id INTEGER PRIMARY KEY, expire_at INTEGER");
+    for (int index = 0; index < ids.count(); index += MAX_BOUND_PARAMETERS) {
+        const QVariantList params(ids.mid(index, MAX_BOUND_PARAMETERS));
+        const QString placeholders = QString("?%1").arg(QString(", ?").repeated(params.count() - 1));
+        database->execSQL(QString("DELETE FROM %1 WHERE id IN (%2)").arg(table).arg(placeholders), params);
     }
+}
 
-    return result;
+uint NotificationManager::notificationId(const LipstickNotification *notification) const
+{
+    // The ID of a notification is its replacesId; removed notifications waiting to be destroyed no longer have one
+    const uint id = notification->replacesId();
+    return notifications.value(id) == notification ? id : 0;
 }
 
-int NotificationManager::schemaVersion()
+LipstickNotification *NotificationManager::takeNotification(uint id)
 {
-    int result = -1;
+    LipstickNotification *notification = notifications.take(id);
+    if (notification != 0) {
+        removeFromIndexes(notification);
+        updateImageReference(id, QVariantHash());
+        stampRemoval(id);
+        journalChange(id, JournalRemoved);
+        volatileNotificationIds.remove(id);
+    }
+    return notification;
+}
 
-    if (database->isOpen()) {
-        QSqlQuery query(*database);
-        if (query.exec("PRAGMA user_version") && query.next()) {
-            result = query.value(0).toInt();
+static void addToIndex(QHash<QString, QSet<uint> > &index, const QString &key, uint id)
+{
+    index[key].insert(id);
+}
+
+static void removeFromIndex(QHash<QString, QSet<uint> > &index, const QString &key, uint id)
+{
+    QHash<QString, QSet<uint> >::iterator it = index.find(key);
+    if (it != index.end()) {
+        it->remove(id);
+        if (it->isEmpty()) {
+            index.erase(it);
         }
     }
+}
 
-    return result;
+void NotificationManager::addToIndexes(const LipstickNotification *notification)
+{
+    const uint id = notification->replacesId();
+    addToIndex(notificationIdsByOwner, notification->owner(), id);
+    addToIndex(notificationIdsByCategory, notification->category(), id);
+    addToIndex(notificationIdsByAppName, notification->appName(), id);
+    addToEvictionIndexes(id, notification->appName(), notification->hints());
 }
 
-bool NotificationManager::setSchemaVersion(int version)
+void NotificationManager::removeFromIndexes(const LipstickNotification *notification)
 {
-    bool result = false;
+    const uint id = notification->replacesId();
+    removeFromIndex(notificationIdsByOwner, notification->owner(), id);
+    removeFromIndex(notificationIdsByCategory, notification->category(), id);
+    removeFromIndex(notificationIdsByAppName, notification->appName(), id);
+    removeFromEvictionIndexes(id, notification->appName());
+}
 
-    if (database->isOpen()) {
-        QSqlQuery query(*database);
-        if (query.exec(QString::fromLatin1("PRAGMA user_version=%1").arg(version))) {
-            result = true;
-        }
+void NotificationManager::addToEvictionIndexes(uint id, const QString &appName, const QVariantHash &hints)
+{
+    QHash<uint, quint64>::const_iterator serial = notificationSerials.constFind(id);
+    if (serial != notificationSerials.constEnd() && isEvictable(hints)) {
+        evictableIdsBySerial.insert(serial.value(), id);
+        evictableIdsByAppName[appName].insert(serial.value(), id);
     }
-
-    return result;
 }
 
-bool NotificationManager::recreateTable(const QString &tableName, const QString &definition)
+void NotificationManager::removeFromEvictionIndexes(uint id, const QString &appName)
 {
-    bool result = false;
+    QHash<uint, quint64>::const_iterator serial = notificationSerials.constFind(id);
+    if (serial == notificationSerials.constEnd()) {
+        return;
+    }
 
-    if (database->isOpen()) {
-        QSqlQuery(*database).exec("DROP TABLE " + tableName);
-        result = QSqlQuery(*database).exec("CREATE TABLE " + tableName + " (" + definition + ")");
-    }
-
-    return result;
-}
-
-void NotificationManager::fetchData()
-{
-    // Gather actions for each notification
-    QSqlQuery actionsQuery("SELECT * FROM actions", *database);
-    QSqlRecord actionsRecord = actionsQuery.record();
-    int actionsTableIdFieldIndex = actionsRecord.indexOf("id");
-    int actionsTableActionFieldIndex = actionsRecord.indexOf("action");
-    QHash<uint, QStringList> actions;
-    while (actionsQuery.next()) {
-        uint id = actionsQuery.value(actionsTableIdFieldIndex).toUInt();
-        actions[id].append(actionsQuery.value(actionsTableActionFieldIndex).toString());
-    }
-
-    // Gather hints for each notification
-    QSqlQuery hintsQuery("SELECT * FROM hints", *database);
-    QSqlRecord hintsRecord = hintsQuery.record();
-    int hintsTableIdFieldIndex = hintsRecord.indexOf("id");
-    int hintsTableHintFieldIndex = hintsRecord.indexOf("hint");
-    int hintsTableValueFieldIndex = hintsRecord.indexOf("value");
-    QHash<uint, QVariantHash> hints;
-    while (hintsQuery.next()) {
-        uint id = hintsQuery.value(hintsTableIdFieldIndex).toUInt();
-        const QString hintName(hintsQuery.value(hintsTableHintFieldIndex).toString());
-        const QVariant hintValue(hintsQuery.value(hintsTableValueFieldIndex));
-
-        QVariant value;
-        if (hintName == HINT_TIMESTAMP) {
-            // Timestamps in the DB are already UTC but not marked as such, so they will
-            // be converted again unless specified to be UTC
-            QDateTime timestamp(QDateTime::fromString(hintValue.toString(), Qt::ISODate));
-            timestamp.setTimeSpec(Qt::UTC);
-            value = timestamp.toString(Qt::ISODate);
-        } else {
-            value = hintValue;
+    evictableIdsBySerial.remove(serial.value());
+    QHash<QString, QMap<quint64, uint> >::iterator it = evictableIdsByAppName.find(appName);
+    if (it != evictableIdsByAppName.end()) {
+        it->remove(serial.value());
+        if (it->isEmpty()) {
+            evictableIdsByAppName.erase(it);
         }
-        hints[id].insert(hintName, value);
     }
+}
 
-    // Gather expiration times for displayed notifications
-    QSqlQuery expirationQuery("SELECT * FROM expiration", *database);
-    QSqlRecord expirationRecord = expirationQuery.record();
-    int expirationTableIdFieldIndex = expirationRecord.indexOf("id");
-    int expirationTableExpireAtFieldIndex = expirationRecord.indexOf("expire_at");
-    QHash<uint, qint64> expireAt;
-    while (expirationQuery.next()) {
-        uint id = expirationQuery.value(expirationTableIdFieldIndex).toUInt();
-        expireAt.insert(id, expirationQuery.value(expirationTableExpireAtFieldIndex).value<qint64>());
+void NotificationManager::evictNotifications(uint id)
+{
+    const LipstickNotification *notification = notifications.value(id);
+    if (notification == 0) {
+        return;
     }
 
-    const qint64 currentTime(QDateTime::currentDateTimeUtc().toMSecsSinceEpoch());
-    QList<uint> expiredIds;
-    qint64 nextTimeout = std::numeric_limits<qint64>::max();
-    bool unexpiredRemaining = false;
-
-    // Create the notifications
-    QSqlQuery notificationsQuery("SELECT * FROM notifications", *database);
-    QSqlRecord notificationsRecord = notificationsQuery.record();
-    int notificationsTableIdFieldIndex = notificationsRecord.indexOf("id");
-    int notificationsTableAppNameFieldIndex = notificationsRecord.indexOf("app_name");
-    int notificationsTableAppIconFieldIndex = notificationsRecord.indexOf("app_icon");
-    int notificationsTableSummaryFieldIndex = notificationsRecord.indexOf("summary");
-    int notificationsTableBodyFieldIndex = notificationsRecord.indexOf("body");
-    int notificationsTableExpireTimeoutFieldIndex = notificationsRecord.indexOf("expire_timeout");
-    while (notificationsQuery.next()) {
-        uint id = notificationsQuery.value(notificationsTableIdFieldIndex).toUInt();
-        QString appName = notificationsQuery.value(notificationsTableAppNameFieldIndex).toString();
-        QString appIcon = notificationsQuery.value(notificationsTableAppIconFieldIndex).toString();
-        QString summary = notificationsQuery.value(notificationsTableSummaryFieldIndex).toString();
-        QString body = notificationsQuery.value(notificationsTableBodyFieldIndex).toString();
-        int expireTimeout = notificationsQuery.value(notificationsTableExpireTimeoutFieldIndex).toInt();
-
-        bool expired = false;
-        if (expireAt.contains(id)) {
-            const qint64 expiry(expireAt.value(id));
-            if (expiry <= currentTime) {
-                expired = true;
-            } else {
-                nextTimeout = qMin(expiry, nextTimeout);
-                unexpiredRemaining = true;
+    QList<uint> evictedIds;
+    QSet<uint> evictedIdSet;
+
+    // Restored notifications not created yet count against the limits as well
+    const QString appName(notification->appName());
+    int excess = 0;
+    if (maxNotificationsPerApplication > 0) {
+        excess = notificationIdsByAppName.value(appName).count() + pendingCountsByAppName.value(appName) - maxNotificationsPerApplication;
+    }
+    QHash<QString, QMap<quint64, uint> >::const_iterator appIds = evictableIdsByAppName.constFind(appName);
+    if (excess > 0 && appIds != evictableIdsByAppName.constEnd()) {
+        for (QMap<quint64, uint>::const_iterator it = appIds->constBegin(); excess > 0 && it != appIds->constEnd(); ++it) {
+            if (it.value() != id) {
+                evictedIds.append(it.value());
+                evictedIdSet.insert(it.value());
+                --excess;
             }
         }
+    }
 
-        LipstickNotification *notification = new LipstickNotification(appName, id, appIcon, summary, body, actions[id], hints[id], expireTimeout, this);
-        notifications.insert(id, notification);
-
-        if (id > previousNotificationID) {
-            // Use the highest notification ID found as the previous notification ID
-            previousNotificationID = id;
+    excess = maxNotifications > 0 ? notifications.count() + pendingRecords.count() - evictedIds.count() - maxNotifications : 0;
+    for (QMap<quint64, uint>::const_iterator it = evictableIdsBySerial.constBegin(); excess > 0 && it != evictableIdsBySerial.constEnd(); ++it) {
+        const uint evictedId = it.value();
+        if (evictedId != id && !evictedIdSet.contains(evictedId)) {
+            evictedIds.append(evictedId);
+            evictedIdSet.insert(evictedId);
+            --excess;
         }
+    }
 
-        if (!expired) {
-            connect(notification, SIGNAL(actionInvoked(QString)), this, SLOT(invokeAction(QString)), Qt::QueuedConnection);
-            connect(notification, SIGNAL(removeRequested()), this, SLOT(removeNotificationIfUserRemovable()), Qt::QueuedConnection);
+    if (!evictedIds.isEmpty()) {
+        NOTIFICATIONS_DEBUG("EVICT:" << evictedIds);
+        evictedNotificationCount += evictedIds.count();
+        CloseNotifications(evictedIds, NotificationExpired);
+    }
+}
 
-            NOTIFICATIONS_DEBUG("RESTORED:" << appName << appIcon << summary << body << actions[id] << hints[id] << expireTimeout << "->" << id);
-            emit notificationModified(id);
-        } else {
-            NOTIFICATIONS_DEBUG("EXPIRED AT RESTORE:" << appName << appIcon << summary << body << actions[id] << hints[id] << expireTimeout << "->" << id);
-            expiredIds.append(id);
+bool NotificationManager::isEvictable(const QVariantHash &hints)
+{
+    return hints.value(HINT_URGENCY).toInt() < 2 && hints.value(HINT_USER_REMOVABLE, true).toBool();
+}
+
+void NotificationManager::storeImageData(QVariantHash &hints)
+{
+    // Earlier versions of the specification used different names for the image data hint
+    static const char *imageDataHints[] = { "image-data", HINT_IMAGE_DATA, "icon_data" };
+
+    QString path;
+    for (uint i = 0; i < sizeof(imageDataHints) / sizeof(imageDataHints[0]) && path.isEmpty(); ++i) {
+        QVariantHash::const_iterator it = hints.constFind(imageDataHints[i]);
+        if (it != hints.constEnd()) {
+            path = imageCache->store(it.value());
         }
     }
 
-    CloseNotifications(expiredIds, NotificationExpired);
+    if (!path.isEmpty()) {
+        // The image data takes precedence over any image path given; image data which could not be stored is kept as it is
+        for (uint i = 0; i < sizeof(imageDataHints) / sizeof(imageDataHints[0]); ++i) {
+            hints.remove(imageDataHints[i]);
+        }
+        hints.insert(HINT_IMAGE_PATH, path);
+    }
+}
 
-    nextExpirationTime = unexpiredRemaining ? nextTimeout : 0;
-    if (nextExpirationTime) {
-        const qint64 nextTriggerInterval(nextExpirationTime - currentTime);
-        expirationTimer.start(static_cast<int>(std::min<qint64>(nextTriggerInterval, std::numeric_limits<int>::max())));
+void NotificationManager::updateImageReference(uint id, const QVariantHash &hints)
+{
+    const QString path(hints.value(HINT_IMAGE_PATH).toString());
+    const QString previousPath(notificationImages.value(id));
+    if (path == previousPath) {
+        return;
+    }
+
+    if (imageCache->contains(path)) {
+        imageCache->addReference(path);
+        notificationImages.insert(id, path);
+    } else {
+        notificationImages.remove(id);
     }
 
-    qWarning() << "Notifications restored:" << notifications.count();
+    if (!previousPath.isEmpty()) {
+        // Removes the image file if this was the last notification referring to it
+        imageCache->releaseReference(previousPath);
+    }
 }
 
-void NotificationManager::commit()
+void NotificationManager::stampChange(uint id)
 {
-    // Any aditional rules about when database commits are allowed can be added here
-    if (!committed) {
-        database->commit();
-        committed = true;
+    // The eviction indexes are ordered by the change serials
+    const LipstickNotification *notification = notifications.value(id);
+    if (notification != 0) {
+        removeFromEvictionIndexes(id, notification->appName());
     }
 
-    qDeleteAll(removedNotifications);
-    removedNotifications.clear();
+    QHash<uint, quint64>::iterator it = notificationSerials.find(id);
+    if (it != notificationSerials.end()) {
+        notificationIdsBySerial.remove(it.value());
+        it.value() = ++changeSerial;
+    } else {
+        notificationSerials.insert(id, ++changeSerial);
+    }
+    notificationIdsBySerial.insert(changeSerial, id);
+
+    if (notification != 0) {
+        addToEvictionIndexes(id, notification->appName(), notification->hints());
+    }
 }
 
-void NotificationManager::execSQL(const QString &command, const QVariantList &args)
+void NotificationManager::stampRemoval(uint id)
 {
-    if (!database->isOpen()) {
-        return;
+    QHash<uint, quint64>::iterator it = notificationSerials.find(id);
+    if (it != notificationSerials.end()) {
+        notificationIdsBySerial.remove(it.value());
+        notificationSerials.erase(it);
     }
 
-    if (committed) {
-        committed = false;
-        database->transaction();
+    removalLog.append(qMakePair(++changeSerial, id));
+    if (removalLog.count() > MAX_REMOVAL_LOG_SIZE) {
+        // Callers with a serial older than the forgotten closure have to fetch all notifications
+        removalLogStart = removalLog.takeFirst().first;
     }
+}
 
-    QSqlQuery query(*database);
-    query.prepare(command);
+void NotificationManager::journalChange(uint id, JournalChange change)
+{
+    if (changeJournal.isEmpty()) {
+        changeJournalTimer.start();
+    }
 
-    foreach(const QVariant &arg, args) {
-        query.addBindValue(arg);
+    QHash<uint, int>::iterator it = changeJournal.find(id);
+    if (it == changeJournal.end()) {
+        changeJournal.insert(id, change);
+        changeJournalOrder.append(id);
+    } else if (change != JournalRemoved) {
+        it.value() |= change;
+    } else if (it.value() & JournalAdded) {
+        // Nobody has seen the notification added during this iteration, so only an earlier removal remains
+        it.value() &= JournalRemoved;
+        if (it.value() == 0) {
+            changeJournal.erase(it);
+        }
+    } else {
+        it.value() = JournalRemoved;
     }
+}
 
-    query.exec();
+NotificationManager::SenderIdentity NotificationManager::senderIdentity(const QString &sender)
+{
+    QHash<QString, SenderIdentity>::const_iterator it = senderIdentities.constFind(sender);
+    if (it != senderIdentities.constEnd()) {
+        senderIdentityHits++;
+        NOTIFICATIONS_DEBUG("SENDER IDENTITY HIT:" << sender << "hits:" << senderIdentityHits << "misses:" << senderIdentityMisses);
+        return it.value();
+    }
+
+    // The lookup of the sender failed, most likely because the sender is gone already
+    senderIdentityMisses++;
+    NOTIFICATIONS_DEBUG("SENDER IDENTITY MISS:" << sender << "hits:" << senderIdentityHits << "misses:" << senderIdentityMisses);
+    return SenderIdentity();
+}
 
-    if (query.lastError().isValid()) {
-        NOTIFICATIONS_DEBUG(command << args << query.lastError());
+bool NotificationManager::awaitsSenderIdentity(const QString &sender, const QString &appName, const QString &appIcon) const
+{
+    return !sender.isEmpty() && (appName.isEmpty() || appIcon.isEmpty()) && !senderIdentities.contains(sender);
+}
+
+void NotificationManager::lookUpSenderIdentity(const QString &sender)
+{
+    if (senderIdentities.contains(sender) || senderIdentityLookups.contains(sender)) {
+        return;
     }
 
-    databaseCommitTimer.start();
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().interface()->asyncCall("GetConnectionUnixProcessID", sender), this);
+    watcher->setProperty("sender", sender);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(handleSenderPidReply(QDBusPendingCallWatcher*)));
+    senderIdentityLookups.insert(sender);
+}
+
+NotificationManager::SenderIdentity NotificationManager::cacheSenderIdentity(const QString &sender, uint pid)
+{
+    const QPair<QString, QString> properties(processProperties(pid));
+    SenderIdentity &identity = senderIdentities[sender];
+    identity.appName = properties.first;
+    identity.appIcon = properties.second;
+    senderWatcher->addWatchedService(sender);
+    return identity;
+}
+
+void NotificationManager::handleSenderPidReply(QDBusPendingCallWatcher *watcher)
+{
+    const QString sender(watcher->property("sender").toString());
+    const QDBusPendingReply<uint> pidReply(*watcher);
+    watcher->deleteLater();
+
+    // The lookup is no longer wanted if the sender disconnected in the meantime
+    if (senderIdentityLookups.remove(sender) && !senderIdentities.contains(sender) && pidReply.isValid()) {
+        cacheSenderIdentity(sender, pidReply.value());
+    }
+
+    // The notifications of the sender no longer wait, whether it was identified or not
+    if (deferredNotificationCounts.contains(sender) && !deferredNotificationTimer.isActive()) {
+        deferredNotificationTimer.start();
+    }
+}
+
+void NotificationManager::removeSenderIdentity(const QString &sender)
+{
+    senderIdentities.remove(sender);
+    senderIdentityLookups.remove(sender);
+    senderWatcher->removeWatchedService(sender);
 }
 
 void NotificationManager::invokeAction(const QString &action)
 {
     LipstickNotification *notification = qobject_cast<LipstickNotification *>(sender());
     if (notification != 0) {
-        uint id = notifications.key(notification, 0);
+        uint id = notificationId(notification);
         if (id > 0) {
             QString remoteAction = notification->hints().value(QString(HINT_REMOTE_ACTION_PREFIX) + action).toString();
             if (!remoteAction.isEmpty()) {
@@ -837,11 +1545,15 @@ void NotificationManager::removeNotificationIfUserRemovable(uint id)
     if (id == 0) {
         LipstickNotification *notification = qobject_cast<LipstickNotification *>(sender());
         if (notification != 0) {
-            id = notifications.key(notification, 0);
+            id = notificationId(notification);
         }
     }
 
-    LipstickNotification *notification = notifications[id];
+    LipstickNotification *notification = notifications.value(id);
+    if (notification == 0) {
+        return;
+    }
+
     QVariant userRemovable = notification->hints().value(HINT_USER_REMOVABLE);
     if (!userRemovable.isValid() || userRemovable.toBool()) {
         // The notification should be removed if user removability is not defined (defaults to true) or is set to true
@@ -854,7 +1566,16 @@ void NotificationManager::removeNotificationIfUserRemovable(uint id)
             emit notificationRemoved(id);
 
             // Mark the notification as hidden
-            execSQL("INSERT INTO hints VALUES (?, ?, ?)", QVariantList() << id << HINT_HIDDEN << true);
+            QVariantHash hints(notification->hints());
+            hints.insert(HINT_HIDDEN, true);
+            notification->setHints(hints);
+            stampChange(id);
+            journalChange(id, JournalModified);
+            if (volatileNotificationIds.contains(id)) {
+                avoidedDatabaseWriteCount++;
+            } else {
+                database->execSQL("UPDATE notifications SET hints=? WHERE id=?", QVariantList() << NotificationDatabase::serializeHints(hints) << id);
+            }
         }
     }
 }
@@ -863,36 +1584,70 @@ void NotificationManager::expire()
 {
     const qint64 currentTime(QDateTime::currentDateTimeUtc().toMSecsSinceEpoch());
     QList<uint> expiredIds;
-    qint64 nextTimeout = std::numeric_limits<qint64>::max();
-    bool unexpiredRemaining = false;
-
-    QSqlQuery expirationQuery("SELECT * FROM expiration", *database);
-    QSqlRecord expirationRecord = expirationQuery.record();
-    int expirationTableIdFieldIndex = expirationRecord.indexOf("id");
-    int expirationTableExpireAtFieldIndex = expirationRecord.indexOf("expire_at");
-    while (expirationQuery.next()) {
-        const uint id = expirationQuery.value(expirationTableIdFieldIndex).toUInt();
-        const qint64 expiry = expirationQuery.value(expirationTableExpireAtFieldIndex).value<qint64>();
-
-        if (expiry <= currentTime) {
-            expiredIds.append(id);
-        } else {
-            nextTimeout = qMin(expiry, nextTimeout);
-            unexpiredRemaining = true;
+
+    // Take all the due entries from the top of the queue; stale entries are discarded on the way
+    while (!expirationQueue.isEmpty() && expirationQueue.first().first <= currentTime) {
+        const ExpirationEntry entry(expirationQueue.first());
+        std::pop_heap(expirationQueue.begin(), expirationQueue.end(), std::greater<ExpirationEntry>());
+        expirationQueue.removeLast();
+
+        if (expirationTimes.value(entry.second, -1) == entry.first) {
+            expiredIds.append(entry.second);
         }
     }
 
     CloseNotifications(expiredIds, NotificationExpired);
 
-    nextExpirationTime = unexpiredRemaining ? nextTimeout : 0;
-    if (nextExpirationTime) {
-        const qint64 nextTriggerInterval(nextExpirationTime - currentTime);
+    updateExpirationTimer(currentTime);
+}
+
+void NotificationManager::scheduleExpiration(uint id, qint64 expireAt)
+{
+    expirationTimes.insert(id, expireAt);
+    expirationQueue.append(qMakePair(expireAt, id));
+    std::push_heap(expirationQueue.begin(), expirationQueue.end(), std::greater<ExpirationEntry>());
+}
+
+bool NotificationManager::unscheduleExpiration(uint id)
+{
+    if (expirationTimes.remove(id) == 0) {
+        return false;
+    }
+
+    // The queue entry is left in place and skipped once it reaches the top of the queue.
+    // Rebuild the queue if most of it consists of such stale entries.
+    if (expirationQueue.count() > 2 * expirationTimes.count() + MIN_EXPIRATION_QUEUE_COMPACTION_SIZE) {
+        expirationQueue.clear();
+        QHash<uint, qint64>::const_iterator it = expirationTimes.constBegin(), end = expirationTimes.constEnd();
+        for ( ; it != end; ++it) {
+            expirationQueue.append(qMakePair(it.value(), it.key()));
+        }
+        std::make_heap(expirationQueue.begin(), expirationQueue.end(), std::greater<ExpirationEntry>());
+    }
+
+    return true;
+}
+
+void NotificationManager::updateExpirationTimer(qint64 currentTime)
+{
+    // Discard stale entries so that the top of the queue is the next notification to expire
+    while (!expirationQueue.isEmpty() && expirationTimes.value(expirationQueue.first().second, -1) != expirationQueue.first().first) {
+        std::pop_heap(expirationQueue.begin(), expirationQueue.end(), std::greater<ExpirationEntry>());
+        expirationQueue.removeLast();
+    }
+
+    if (expirationQueue.isEmpty()) {
+        expirationTimer.stop();
+    } else {
+        const qint64 nextTriggerInterval(qMax<qint64>(expirationQueue.first().first - currentTime, 0));
         expirationTimer.start(static_cast<int>(std::min<qint64>(nextTriggerInterval, std::numeric_limits<int>::max())));
     }
 }
 
 void NotificationManager::removeUserRemovableNotifications()
 {
+    restorePendingNotifications();
+
     QList<uint> closableNotifications;
 
     // Find any closable notifications we can close as a batch
@@ -910,8 +1665,13 @@ void NotificationManager::removeUserRemovableNotifications()
 
     CloseNotifications(closableNotifications, NotificationDismissedByUser);
 
-    // Remove any remaining notifications
+    // Hide any remaining notifications in a single transaction; the ones already hidden need not be written again
+    database->beginBatch();
     foreach(uint id, notifications.keys()) {
-        removeNotificationIfUserRemovable(id);
+        const LipstickNotification *notification = notifications.value(id);
+        if (notification != 0 && !notification->hidden()) {
+            removeNotificationIfUserRemovable(id);
+        }
     }
+    database->endBatch();
 }
@@ -18,13 +18,25 @@
 
 #include "lipstickglobal.h"
 #include "lipsticknotification.h"
+#include <QMap>
 #include <QObject>
 #include <QTimer>
 #include <QSet>
+#include <QVector>
 #include <QDBusContext>
+#include <QElapsedTimer>
+#include <climits>
 
 class CategoryDefinitionStore;
-class QSqlDatabase;
+class NotificationDatabase;
+class NotificationImageCache;
+class QDBusPendingCallWatcher;
+class QDBusServiceWatcher;
+struct NotificationRecord;
+namespace MeeGo {
+class QmActivity;
+class QmDisplayState;
+}
 
 /*!
  * \class NotificationManager
@@ -53,9 +65,12 @@ public:
     //! Standard hint: This specifies the name of the desktop filename representing the calling program. This should be the same as the prefix used for the application's .desktop file. An example would be "rhythmbox" from "rhythmbox.desktop". This can be used by the daemon to retrieve the correct icon for the application, for logging purposes, etc. Not supported by this implementation.
     static const char *HINT_DESKTOP_ENTRY;
 
-    //! Standard hint: This is a raw data image format which describes the width, height, rowstride, has alpha, bits per sample, channels and image data respectively. We use this value if the icon field is left blank. Not supported by this implementation.
+    //! Standard hint: This is a raw data image format which describes the width, height, rowstride, has alpha, bits per sample, channels and image data respectively. We use this value if the icon field is left blank. The image is stored in a file and replaced by the HINT_IMAGE_PATH hint.
     static const char *HINT_IMAGE_DATA;
 
+    //! Standard hint: Path to an image file. Set to the stored image when the HINT_IMAGE_DATA hint is given.
+    static const char *HINT_IMAGE_PATH;
+
     //! Standard hint: The path to a sound file to play when the notification pops up. Not supported by this implementation.
     static const char *HINT_SOUND_FILE;
 
@@ -119,6 +134,9 @@ public:
     //! Nemo hint: Indicates the identifer of the owner for notification
     static const char *HINT_OWNER;
 
+    //! Nemo hint: If true, the notification is kept in memory only and not stored in the database. Transient notifications are always volatile.
+    static const char *HINT_VOLATILE;
+
     //! Notification closing reasons used in the NotificationClosed signal
     enum NotificationClosedReason {
         //! The notification expired.
@@ -145,7 +163,9 @@ public:
     LipstickNotification *notification(uint id) const;
 
     /*!
-     * Returns a list of notification IDs.
+     * Returns a list of notification IDs. Notifications restored from the
+     * database are only included once they have been announced with the
+     * notificationsRestored() signal.
      *
      * \return a list of notification IDs.
      */
@@ -163,6 +183,14 @@ public:
     /*!
      * Sends a notification to the notification server.
      *
+     * Notifications sent over D-Bus are rate limited per sender: a sender
+     * exceeding the configured rate gets its notifications deferred until
+     * the rate allows them to be handled. Updates to the same notification
+     * arriving within the coalescing interval are collapsed into the latest
+     * one. The ID of a deferred notification is returned right away; a
+     * deferred new notification is dropped and 0 returned if the sender
+     * already has too many deferred notifications.
+     *
      * \param appName The optional name of the application sending the notification. Can be blank.
      * \param replacesId The optional notification ID that this notification replaces. The server must atomically (ie with no flicker or other visual cues) replace the given notification with this one. This allows clients to effectively modify the notification while it's active. A value of value of 0 means that this notification won't replace any existing notifications.
      * \param appIcon The optional program icon of the calling application. Can be an empty string, indicating no icon.
@@ -174,6 +202,21 @@ public:
      */
     uint Notify(const QString &appName, uint replacesId, const QString &appIcon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout);
 
+    /*!
+     * Sends a batch of notifications to the notification server. Each notification
+     * is handled like in Notify(), the replacesId of the notification being used as
+     * the ID of the notification to replace. All modifications are stored to the
+     * database in a single transaction and notificationsModified() is emitted once
+     * for the whole batch instead of notificationModified() for each notification.
+     * Notifications received over D-Bus are destroyed once the batch has been handled.
+     * Each notification in a batch counts against the rate limit of the sender;
+     * the ones beyond it are deferred or dropped like in Notify().
+     *
+     * \param notifications the notifications to send
+     * \return the IDs of the notifications in the same order; 0 for each notification which replaced a nonexistent notification
+     */
+    QList<uint> NotifyMany(const NotificationList &notifications);
+
     /*!
      * Causes a notification to be forcefully closed and removed from the user's view.
      * It can be used, for example, in the event that what the notification pertains
@@ -188,6 +231,7 @@ public:
     /*!
      * Causes all listed notifications to be forcefully closed and removed from the user's view.
      * The NotificationClosed signal is emitted by this method for each closed notification.
+     * The notifications are removed from the database in a single transaction.
      *
      * \param ids the IDs of the notifications to be closed
      * \param closeReason the reason for the closure of these notifications
@@ -221,6 +265,65 @@ public:
      */
     NotificationList GetNotifications(const QString &owner);
 
+    /*!
+     * Returns the notifications which have been added or modified after the
+     * given change serial and the IDs of the notifications which have been
+     * closed after it. The closed notification IDs should be applied before
+     * the returned notifications, since an ID may be reused.
+     *
+     * If the changes since the serial are not known, because the serial is 0,
+     * was handed out by an earlier instance of the notification manager or
+     * is older than the oldest closure remembered, all notifications are
+     * returned and \a complete is set to \c true; the caller should then
+     * replace all of its notifications with the returned ones.
+     *
+     * \param serial the change serial returned by an earlier call or 0
+     * \param removedIds set to the IDs of the notifications closed after the serial
+     * \param currentSerial set to the current change serial, to be passed to the next call
+     * \param complete set to \c true if all notifications were returned, \c false if only the changes were returned
+     * \return the notifications added or modified after the serial
+     */
+    NotificationList GetNotificationsSince(quint64 serial, QList<uint> &removedIds, quint64 &currentSerial, bool &complete);
+
+    /*!
+     * Returns statistics about the rate limiting of incoming notifications:
+     * "coalesced" is the number of updates collapsed into a later update,
+     * "dropped" the number of notifications dropped because their sender had
+     * too many deferred notifications, "deferred" the number of
+     * notifications currently waiting to be handled, "volatile" the number
+     * of notifications kept in memory only, "databaseWritesAvoided" the
+     * number of database writes skipped because they concerned volatile
+     * notifications and "evicted" the number of notifications closed to
+     * keep within the notification capacity.
+     *
+     * \return the statistics keyed by their names
+     */
+    QVariantHash GetNotificationStatistics() const;
+
+    /*!
+     * Returns the number of notifications of each application, for diagnostics.
+     *
+     * \return the numbers of notifications keyed by application name
+     */
+    QVariantHash GetApplicationNotificationCounts();
+
+    /*!
+     * Creates notifications restored from the database but not created yet
+     * and emits notificationsRestored() for them. Normally the restored
+     * notifications are created in batches when the event loop is idle.
+     *
+     * \param maximumCount the maximum number of notifications to create
+     */
+    void restorePendingNotifications(int maximumCount = INT_MAX);
+
+    /*!
+     * Returns the IDs of the notifications in the given category.
+     *
+     * \param category the category of the notifications
+     * \return the IDs of the notifications in the category
+     */
+    QList<uint> notificationIdsWithCategory(const QString &category);
+
 signals:
     /*!
      * A completed notification is one that has timed out, or has been dismissed by the user.
@@ -247,6 +350,14 @@ signals:
      */
     void notificationModified(uint id);
 
+    /*!
+     * Emitted when a batch of notifications has been added or updated, for
+     * example with NotifyMany() or due to changed category definitions.
+     *
+     * \param ids the IDs of the modified notifications
+     */
+    void notificationsModified(const QList<uint> &ids);
+
     /*!
      * Emitted when a notification is removed.
      *
@@ -261,6 +372,27 @@ signals:
      */
     void notificationsRemoved(const QList<uint> &ids);
 
+    /*!
+     * Emitted when a batch of notifications has been restored from the
+     * database. The latest notifications are restored first.
+     *
+     * \param ids the IDs of the restored notifications
+     */
+    void notificationsRestored(const QList<uint> &ids);
+
+    /*!
+     * Emitted once per event loop iteration in which notifications were
+     * added, modified or removed. Changes which cancel each other out, such
+     * as a notification added and removed again, are not reported. A
+     * notification which was removed and added again with the same ID is
+     * reported both as removed and as added.
+     *
+     * \param added the IDs of the added notifications
+     * \param modified the IDs of the modified notifications which were neither added nor removed
+     * \param removed the IDs of the removed notifications, which are no longer available with notification()
+     */
+    void notificationsChanged(const QList<uint> &added, const QList<uint> &modified, const QList<uint> &removed);
+
 public slots:
     /*!
      * Removes all notifications which are user removable.
@@ -269,25 +401,45 @@ public slots:
 
 private slots:
     /*!
-     * Removes all notifications with the specified category.
+     * Removes all notifications with the specified categories.
      *
-     * \param category the category of the notifications to remove
+     * \param categories the categories of the notifications to remove
      */
-    void removeNotificationsWithCategory(const QString &category);
+    void removeNotificationsWithCategories(const QStringList &categories);
 
     /*!
      * Update category data of all notifications with the
-     * specified category.
+     * specified categories in a single batch.
      *
-     * \param category the category of the notifications to update
+     * \param categories the categories of the notifications to update
+     */
+    void updateNotificationsWithCategories(const QStringList &categories);
+
+    /*!
+     * Destroys any removed notifications.
+     */
+    void destroyRemovedNotifications();
+
+    /*!
+     * Destroys any removed notifications if the device is idle. Otherwise
+     * the notifications are destroyed by the next maintenance.
      */
-    void updateNotificationsWithCategory(const QString &category);
+    void destroyRemovedNotificationsIfIdle();
 
     /*!
-     * Commits the current database transaction, if any.
-     * Also destroys any removed notifications.
+     * Starts the maintenance timer when the display goes off or the device
+     * becomes inactive and stops it when the device is used again.
      */
-    void commit();
+    void scheduleMaintenance();
+
+    /*!
+     * Destroys the removed notifications no longer in use and maintains
+     * the database file if the device is still idle.
+     */
+    void performMaintenance();
+
+    //! Reports the changes recorded in the change journal with notificationsChanged()
+    void flushChangeJournal();
 
     /*!
      * Invokes the given action if it is has been defined. The
@@ -309,7 +461,68 @@ private slots:
      */
     void expire();
 
+    /*!
+     * Creates the next batch of the notifications restored from the database.
+     */
+    void restoreNextNotifications();
+
+    /*!
+     * Handles the deferred notifications whose senders are within their rate
+     * limits and not being identified, and ends the current coalescing interval.
+     */
+    void processDeferredNotifications();
+
+    /*!
+     * Caches the identity of a sender whose process ID has been looked up
+     * asynchronously. The deferred notifications waiting for the identity
+     * are handled when the deferred notifications are processed next.
+     *
+     * \param watcher the watcher of the process ID lookup
+     */
+    void handleSenderPidReply(QDBusPendingCallWatcher *watcher);
+
+    /*!
+     * Forgets the cached identity of a sender which has disconnected from the bus.
+     *
+     * \param sender the unique bus name of the sender
+     */
+    void removeSenderIdentity(const QString &sender);
+
 private:
+    //! A notification whose handling has been deferred by rate limiting or coalescing
+    struct DeferredNotification
+    {
+        DeferredNotification() : expireTimeout(-1), create(false) {}
+
+        QString sender;
+        QString appName;
+        QString appIcon;
+        QString summary;
+        QString body;
+        QStringList actions;
+        QVariantHash hints;
+        int expireTimeout;
+        //! Whether the notification is to be created rather than replaced
+        bool create;
+    };
+
+    //! The application name and icon of a D-Bus sender derived from its process
+    struct SenderIdentity
+    {
+        QString appName;
+        QString appIcon;
+    };
+
+    //! A token bucket limiting the rate of notifications from a sender
+    struct RateLimitBucket
+    {
+        RateLimitBucket() : tokens(0), updated(0) {}
+
+        double tokens;
+        //! Time of the last refill in milliseconds on rateLimitClock
+        qint64 updated;
+    };
+
     /*!
      * Creates a new notification manager.
      *
@@ -320,6 +533,68 @@ private:
     //! Destroys the notification manager.
     virtual ~NotificationManager();
 
+    /*!
+     * Adds a new notification or replaces an existing one without emitting
+     * notificationModified(). The parameters are as in Notify().
+     *
+     * \param sender the D-Bus service of the sender used to look up a missing application name or icon, or an empty string
+     * \param newId the ID to use for a new notification or 0 to use the next available ID
+     * \return the ID of the notification or 0 if the notification to be replaced does not exist
+     */
+    uint addOrReplaceNotification(const QString &sender, const QString &appName, uint replacesId, const QString &appIcon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout, uint newId = 0);
+
+    /*!
+     * Handles a notification subject to rate limiting and coalescing. The
+     * parameters are as in Notify(). A notification whose sender has to be
+     * identified first is deferred until the identity has been looked up.
+     *
+     * \param sender the D-Bus service of the sender or an empty string if the notification is not rate limited
+     * \param beyondRateLimit \c true if the sender is already known to be beyond its rate limit, so that no token is to be taken
+     * \return the ID of the notification or 0 if the notification to be replaced does not exist or the notification was dropped
+     */
+    uint throttledNotify(const QString &sender, const QString &appName, uint replacesId, const QString &appIcon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout, bool beyondRateLimit = false);
+
+    /*!
+     * Handles a batch of notifications subject to rate limiting. The batch
+     * takes a single token of the rate limit of the sender. Within the
+     * rate limit the notifications are handled in a single transaction and
+     * supersede any deferred updates of the same notifications; beyond it,
+     * or while the sender is being identified, they are deferred like in
+     * throttledNotify().
+     *
+     * \param sender the D-Bus service of the sender or an empty string if the notifications are not rate limited
+     * \param batch the notifications to handle
+     * \return the IDs of the notifications in the same order as in NotifyMany()
+     */
+    QList<uint> throttledNotifyMany(const QString &sender, const QList<LipstickNotification *> &batch);
+
+    /*!
+     * Defers the handling of a notification. The timer for handling the
+     * deferred notifications is started if it's not running yet.
+     *
+     * \param id the ID of the notification
+     * \param sender the D-Bus service of the sender
+     * \param create whether the notification is to be created rather than replaced
+     * \return the deferred notification to be filled in
+     */
+    DeferredNotification &deferNotification(uint id, const QString &sender, bool create);
+
+    /*!
+     * Takes a token from the token bucket of a sender.
+     *
+     * \param sender the D-Bus service of the sender
+     * \return \c true if the sender is within its rate limit, \c false otherwise
+     */
+    bool takeRateLimitToken(const QString &sender);
+
+    /*!
+     * Cancels a deferred notification, if any.
+     *
+     * \param id the ID of the notification
+     * \return \c true if the notification had not been created yet, \c false otherwise
+     */
+    bool cancelDeferredNotification(uint id);
+
     /*!
      * Returns the next available notification ID
      *
@@ -342,74 +617,242 @@ private:
      */
     void addTimestamp(QVariantHash &hints);
 
-    //! Restores the notifications from a database on the disk
+    /*!
+     * Restores the notifications from a database on the disk. Only the IDs
+     * and expiration times are taken into use immediately; the notifications
+     * themselves are created in batches afterwards.
+     */
     void restoreNotifications();
 
     /*!
-     * Creates a connection to the Sqlite database.
+     * Returns a notification with the given ID, creating it first if it has
+     * been restored from the database but not created yet.
+     *
+     * \param id the ID of the notification to return
+     * \return the notification with the given ID or 0 if there is no such notification
+     */
+    LipstickNotification *restoredNotification(uint id);
+
+    /*!
+     * Returns whether the device is idle, i.e. the display is off or the
+     * device is inactive.
+     *
+     * \return \c true if the device is idle, \c false otherwise
+     */
+    bool isIdle() const;
+
+    /*!
+     * Returns whether a notification with the given hints is volatile,
+     * i.e. kept in memory only and never stored in the database.
+     *
+     * \param hints the hints of the notification
+     * \return \c true if the notification is volatile, \c false otherwise
+     */
+    static bool isVolatile(const QVariantHash &hints);
+
+    /*!
+     * Writes a new notification to the database.
+     *
+     * \param id the ID of the notification
+     * \param appName the application name
+     * \param appIcon the application icon
+     * \param summary the summary
+     * \param body the body
+     * \param actions the actions
+     * \param hints the hints
+     * \param expireTimeout the expiration timeout
+     */
+    void insertNotification(uint id, const QString &appName, const QString &appIcon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout);
+
+    /*!
+     * Writes the columns of a notification that differ from the given values to the database.
+     * Nothing is written if all the values are equal to the current ones.
+     *
+     * \param notification the notification being replaced
+     * \param appName the new application name
+     * \param appIcon the new application icon
+     * \param summary the new summary
+     * \param body the new body
+     * \param actions the new actions
+     * \param hints the new hints
+     * \param expireTimeout the new expiration timeout
+     */
+    void updateNotification(const LipstickNotification *notification, const QString &appName, const QString &appIcon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout);
+
+    /*!
+     * Schedules a notification to be expired at the given time. The time is not
+     * stored to the database.
+     *
+     * \param id the ID of the notification
+     * \param expireAt the expiration time in milliseconds since epoch
+     */
+    void scheduleExpiration(uint id, qint64 expireAt);
+
+    /*!
+     * Cancels the scheduled expiration of a notification.
+     *
+     * \param id the ID of the notification
+     * \return \c true if the notification had a scheduled expiration, \c false otherwise
+     */
+    bool unscheduleExpiration(uint id);
+
+    /*!
+     * Starts the expiration timer for the next scheduled expiration or stops it
+     * if there are no scheduled expirations.
+     *
+     * \param currentTime the current time in milliseconds since epoch
+     */
+    void updateExpirationTimer(qint64 currentTime);
+
+    /*!
+     * Deletes the rows matching the given IDs from a table using as few DELETE statements as possible.
+     * \param table the name of the table
+     * \param ids the IDs of the rows to delete
+     */
+    void deleteRows(const QString &table, const QVariantList &ids);
+
+    /*!
+     * Returns the ID of a notification, or 0 if the notification has already
+     * been removed.
+     *
+     * \param notification the notification
+     * \return the ID of the notification or 0
+     */
+    uint notificationId(const LipstickNotification *notification) const;
+
+    /*!
+     * Removes a notification from the notification hash and the secondary indexes.
+     *
+     * \param id the ID of the notification
+     * \return the removed notification or 0 if there was no notification with the ID
+     */
+    LipstickNotification *takeNotification(uint id);
+
+    //! Adds a notification to the secondary indexes
+    void addToIndexes(const LipstickNotification *notification);
+
+    //! Removes a notification from the secondary indexes. Must be called before the indexed properties change.
+    void removeFromIndexes(const LipstickNotification *notification);
+
+    /*!
+     * Adds a notification to the eviction indexes if it may be evicted.
+     * Must be called after the notification has been given a change serial.
      *
-     * \return \c true if the connection was successfully established, \c false otherwise
+     * \param id the ID of the notification
+     * \param appName the application name of the notification
+     * \param hints the hints of the notification
      */
-    bool connectToDatabase();
+    void addToEvictionIndexes(uint id, const QString &appName, const QVariantHash &hints);
 
     /*!
-     * Checks whether there is enough free disk space available.
+     * Removes a notification from the eviction indexes. Must be called
+     * before the change serial or the application name of the notification changes.
      *
-     * \param path any path to the file system from which the space should be checked
-     * \param freeSpaceNeeded free space needed in kilobytes
-     * \return \c true if there is enough free space in given file system, \c false otherwise
+     * \param id the ID of the notification
+     * \param appName the application name of the notification
      */
-    static bool checkForDiskSpace(const QString &path, unsigned long freeSpaceNeeded);
+    void removeFromEvictionIndexes(uint id, const QString &appName);
 
     /*!
-     * Removes a database file from the filesystem. Removes related -wal and -shm files as well.
+     * Closes the oldest notifications of the application of a new
+     * notification if the application has more notifications than allowed,
+     * and then the oldest notifications of any application if there are
+     * more notifications than allowed in total. Only notifications which
+     * are not critical and are removable by the user are closed, so the
+     * limits may be exceeded if there are no such notifications. Restored
+     * notifications not created yet count against the limits and, having
+     * change serials from before this instance, are closed first. The
+     * notifications are closed in a single batch.
      *
-     * \param path the path of the database file to be removed
+     * \param id the ID of the new notification, which is never closed
      */
-    static void removeDatabaseFile(const QString &path);
+    void evictNotifications(uint id);
 
     /*!
-     * Ensures that all database tables have the requires fields.
-     * Recreates the tables if needed.
+     * Returns whether a notification may be closed to make room for new ones.
      *
-     * \return \c true if the database can be used, \c false otherwise
+     * \param hints the hints of the notification to check
+     * \return \c true if the notification is neither critical nor unremovable by the user, \c false otherwise
      */
-    bool checkTableValidity();
+    static bool isEvictable(const QVariantHash &hints);
 
     /*!
-     * Returns the schema version of the database.
+     * Stores the image data hints of a notification in the image cache and
+     * replaces them with a HINT_IMAGE_PATH hint referring to the stored image.
+     * The hints are left as they are if the image data can't be stored.
      *
-     * \return the version number the database schema is currently set to.
+     * \param hints the hints of the notification
      */
-    int schemaVersion();
+    void storeImageData(QVariantHash &hints);
 
     /*!
-     * Sets the schema version of the database.
+     * Makes a notification refer to the cached image its HINT_IMAGE_PATH
+     * hint points to, if any, and releases the image it referred to before.
      *
-     * \param version the version number to set the database schema to.
-     * \return \c true if the database is updated.
+     * \param id the ID of the notification
+     * \param hints the hints of the notification
      */
-    bool setSchemaVersion(int version);
+    void updateImageReference(uint id, const QVariantHash &hints);
+
+    //! Stamps a notification as added or modified with a new change serial
+    void stampChange(uint id);
+
+    //! Stamps a notification as closed with a new change serial and remembers the closure for GetNotificationsSince()
+    void stampRemoval(uint id);
+
+    //! Kinds of changes recorded in the change journal
+    enum JournalChange {
+        JournalAdded = 0x1,
+        JournalModified = 0x2,
+        JournalRemoved = 0x4
+    };
 
     /*!
-     * Recreates a table in the database.
+     * Records a change of a notification in the change journal to be
+     * reported with notificationsChanged() once control returns to the event loop.
      *
-     * \param tableName the name of the table to be created
-     * \param definition SQL definition for the table
-     * \return \c true if the table was created, \c false otherwise
+     * \param id the ID of the changed notification
+     * \param change the kind of the change
      */
-    bool recreateTable(const QString &tableName, const QString &definition);
+    void journalChange(uint id, JournalChange change);
 
-    //! Fills the notifications hash table with data from the database
-    void fetchData();
+    /*!
+     * Returns the cached identity of a sender. The identity is never looked
+     * up synchronously, so an empty identity is returned for a sender which
+     * has not been identified.
+     *
+     * \param sender the unique bus name of the sender
+     * \return the identity of the sender
+     */
+    SenderIdentity senderIdentity(const QString &sender);
+
+    /*!
+     * Checks whether a notification has to wait for the identity of its
+     * sender to be looked up before it can be handled.
+     *
+     * \param sender the unique bus name of the sender
+     * \param appName the application name of the notification
+     * \param appIcon the application icon of the notification
+     * \return \c true if the sender is needed for a missing name or icon but has not been identified yet, \c false otherwise
+     */
+    bool awaitsSenderIdentity(const QString &sender, const QString &appName, const QString &appIcon) const;
 
     /*!
-     * Executes a SQL command in the database. Starts a new transaction if none is active currently, otherwise
-     * the command goes to the active transaction. Restarts the transaction commit timer.
-     * \param command the SQL command
-     * \param args list of values to be bound to the positional placeholders ('?' -character) in the command.
+     * Starts an asynchronous lookup of the identity of a sender unless
+     * the identity has already been cached or is being looked up.
+     *
+     * \param sender the unique bus name of the sender
      */
-    void execSQL(const QString &command, const QVariantList &args = QVariantList());
+    void lookUpSenderIdentity(const QString &sender);
+
+    /*!
+     * Derives the identity of a sender from its process and caches it.
+     *
+     * \param sender the unique bus name of the sender
+     * \param pid the process ID of the sender
+     * \return the identity of the sender
+     */
+    SenderIdentity cacheSenderIdentity(const QString &sender, uint pid);
 
     //! The singleton notification manager instance
     static NotificationManager *instance_;
@@ -417,6 +860,15 @@ private:
     //! Hash of all notifications keyed by notification IDs
     QHash<uint, LipstickNotification*> notifications;
 
+    //! IDs of the notifications keyed by their owners
+    QHash<QString, QSet<uint> > notificationIdsByOwner;
+
+    //! IDs of the notifications keyed by their categories
+    QHash<QString, QSet<uint> > notificationIdsByCategory;
+
+    //! IDs of the notifications keyed by their application names
+    QHash<QString, QSet<uint> > notificationIdsByAppName;
+
     //! Notifications waiting to be destroyed
     QSet<LipstickNotification *> removedNotifications;
 
@@ -427,22 +879,152 @@ private:
     CategoryDefinitionStore *categoryDefinitionStore;
 
     //! Database for the notifications
-    QSqlDatabase *database;
+    NotificationDatabase *database;
+
+    //! Files for the images sent as image data hints
+    NotificationImageCache *imageCache;
+
+    //! Paths of the cached images keyed by the IDs of the notifications referring to them
+    QHash<uint, QString> notificationImages;
+
+    //! The first change serial of this instance; serials up to it are from earlier instances
+    quint64 firstChangeSerial;
+
+    //! The latest change serial handed out
+    quint64 changeSerial;
+
+    //! Change serials of the notifications keyed by notification ID
+    QHash<uint, quint64> notificationSerials;
+
+    //! IDs of the notifications keyed by their change serials
+    QMap<quint64, uint> notificationIdsBySerial;
 
-    //! Whether the current database transaction has been committed to the database
-    bool committed;
+    //! IDs of the notifications which may be evicted keyed by their change serials, least recently changed first
+    QMap<quint64, uint> evictableIdsBySerial;
 
-    //! Timer for triggering the commit of the current database transaction
-    QTimer databaseCommitTimer;
+    //! IDs of the notifications which may be evicted keyed by their change serials for each application name
+    QHash<QString, QMap<quint64, uint> > evictableIdsByAppName;
+
+    //! Change serials and IDs of the most recently closed notifications, oldest first
+    QList<QPair<quint64, uint> > removalLog;
+
+    //! The change serial of the latest closure no longer in the removal log
+    quint64 removalLogStart;
+
+    //! Timer for triggering the destruction of removed notifications
+    QTimer removedNotificationsTimer;
 
     //! Timer for triggering the expiration of displayed notifications
     QTimer expirationTimer;
 
-    //! Next trigger time for the expirationTimer, relative to epoch
-    qint64 nextExpirationTime;
+    //! Notifications restored from the database but not created yet, keyed by notification ID
+    QHash<uint, NotificationRecord> pendingRecords;
+
+    //! IDs of the restored notifications in the order in which they are to be created
+    QList<uint> pendingRecordIds;
+
+    //! Numbers of the restored notifications not created yet keyed by application name
+    QHash<QString, int> pendingCountsByAppName;
+
+    //! Timer for creating the restored notifications in batches
+    QTimer restoreTimer;
+
+    //! Deferred notifications keyed by notification ID
+    QHash<uint, DeferredNotification> deferredNotifications;
+
+    //! IDs of the deferred notifications in the order in which they arrived
+    QList<uint> deferredNotificationIds;
+
+    //! Number of deferred notifications keyed by sender
+    QHash<QString, int> deferredNotificationCounts;
+
+    //! IDs of the notifications modified over D-Bus during the current coalescing interval
+    QSet<uint> coalescingIds;
+
+    //! Timer for ending the coalescing interval and handling the deferred notifications
+    QTimer deferredNotificationTimer;
+
+    //! Token buckets keyed by sender
+    QHash<QString, RateLimitBucket> rateLimitBuckets;
+
+    //! Clock for refilling the token buckets
+    QElapsedTimer rateLimitClock;
+
+    //! Number of notifications per second a sender may send over time or 0 for no limit
+    double rateLimit;
+
+    //! Number of notifications a sender may send in a burst
+    int rateLimitBurst;
+
+    //! Number of updates collapsed into a later update
+    uint coalescedNotificationCount;
+
+    //! Number of notifications dropped because their sender had too many deferred notifications
+    uint droppedNotificationCount;
+
+    //! IDs of the volatile notifications, which are not stored in the database
+    QSet<uint> volatileNotificationIds;
+
+    //! Number of database writes skipped because they concerned volatile notifications
+    uint avoidedDatabaseWriteCount;
+
+    //! Maximum number of notifications of a single application or 0 for no limit
+    int maxNotificationsPerApplication;
+
+    //! Maximum number of notifications in total or 0 for no limit
+    int maxNotifications;
+
+    //! Number of notifications closed to keep within the maximum numbers of notifications
+    uint evictedNotificationCount;
+
+    //! Identities of the senders keyed by unique bus name
+    QHash<QString, SenderIdentity> senderIdentities;
+
+    //! Senders whose identities are being looked up asynchronously
+    QSet<QString> senderIdentityLookups;
+
+    //! Watcher for removing the identities of disconnected senders
+    QDBusServiceWatcher *senderWatcher;
+
+    //! Number of sender identities found in the cache
+    uint senderIdentityHits;
+
+    //! Number of sender identities not found in the cache
+    uint senderIdentityMisses;
+
+    //! The display state, used for maintaining the database while the display is off
+    MeeGo::QmDisplayState *displayState;
+
+    //! The activity state, used for maintaining the database while the device is inactive
+    MeeGo::QmActivity *activity;
+
+    //! Timer for maintaining the database once the device has been idle for a while
+    QTimer maintenanceTimer;
+
+    //! Changes not yet reported with notificationsChanged() as JournalChange flags keyed by notification ID
+    QHash<uint, int> changeJournal;
+
+    //! IDs of the notifications in the change journal in the order of their first change
+    QList<uint> changeJournalOrder;
+
+    //! Timer for reporting the changes in the change journal once control returns to the event loop
+    QTimer changeJournalTimer;
+
+    //! Expiration times of displayed notifications keyed by notification ID, relative to epoch
+    QHash<uint, qint64> expirationTimes;
+
+    //! An entry in the expiration queue: the expiration time and the notification ID
+    typedef QPair<qint64, uint> ExpirationEntry;
+
+    /*!
+     * Min-heap of the scheduled expirations ordered by expiration time. Entries whose
+     * time doesn't match the one in expirationTimes are stale and get discarded lazily.
+     */
+    QVector<ExpirationEntry> expirationQueue;
 
 #ifdef UNIT_TEST
     friend class Ut_NotificationManager;
+    friend class Bm_NotificationManager;
 #endif
 };
 
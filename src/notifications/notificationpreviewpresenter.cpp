@@ -38,15 +38,26 @@ enum PreviewMode {
 NotificationPreviewPresenter::NotificationPreviewPresenter(QObject *parent) :
     QObject(parent),
     window(0),
+    arrivalCount(0),
+    coalescing_(false),
+    maximumQueueDepth(0),
+    shownCount(0),
+    coalescedTotal(0),
+    totalWaitTime(0),
+    maximumWaitTime(0),
     currentNotification(0),
+    currentCoalescedCount(0),
     notificationFeedbackPlayer(new NotificationFeedbackPlayer(this)),
     locks(new MeeGo::QmLocks(this)),
     displayState(new MeeGo::QmDisplayState(this))
 {
     connect(NotificationManager::instance(), SIGNAL(notificationModified(uint)), this, SLOT(updateNotification(uint)));
+    connect(NotificationManager::instance(), SIGNAL(notificationsModified(const QList<uint> &)), this, SLOT(updateNotifications(const QList<uint> &)));
     connect(NotificationManager::instance(), SIGNAL(notificationRemoved(uint)), this, SLOT(removeNotification(uint)));
     connect(this, SIGNAL(notificationPresented(uint)), notificationFeedbackPlayer, SLOT(addNotification(uint)));
 
+    queueClock.start();
+
     QTimer::singleShot(0, this, SLOT(createWindowIfNecessary()));
 }
 
@@ -70,7 +81,8 @@ void NotificationPreviewPresenter::showNextNotification()
 
         setCurrentNotification(0);
     } else {
-        LipstickNotification *notification = notificationQueue.takeFirst();
+        int coalescedCount = 0;
+        LipstickNotification *notification = dequeueNotification(coalescedCount);
 
         if (locks->getState(MeeGo::QmLocks::TouchAndKeyboard) == MeeGo::QmLocks::Locked && displayState->get() == MeeGo::QmDisplayState::Off) {
             // Screen locked and off: don't show the notification but just remove it from the queue
@@ -87,6 +99,7 @@ void NotificationPreviewPresenter::showNextNotification()
 
             emit notificationPresented(notification->replacesId());
 
+            currentCoalescedCount = coalescedCount;
             setCurrentNotification(notification);
         }
     }
@@ -97,6 +110,50 @@ LipstickNotification *NotificationPreviewPresenter::notification() const
     return currentNotification;
 }
 
+int NotificationPreviewPresenter::coalescedCount() const
+{
+    return currentNotification != 0 ? currentCoalescedCount : 0;
+}
+
+bool NotificationPreviewPresenter::coalescing() const
+{
+    return coalescing_;
+}
+
+void NotificationPreviewPresenter::setCoalescing(bool coalescing)
+{
+    if (coalescing_ == coalescing) {
+        return;
+    }
+
+    coalescing_ = coalescing;
+    queuedNotificationsByApp.clear();
+    if (coalescing_) {
+        // Notifications already queued are not folded together, only the ones arriving later
+        foreach (LipstickNotification *notification, notificationQueue) {
+            queuedNotificationsByApp.insert(queuedNotifications.value(notification).appName, notification);
+        }
+    }
+    emit coalescingChanged();
+}
+
+int NotificationPreviewPresenter::queueDepth() const
+{
+    return notificationQueue.count();
+}
+
+QVariantHash NotificationPreviewPresenter::statistics() const
+{
+    QVariantHash statistics;
+    statistics.insert("queueDepth", notificationQueue.count());
+    statistics.insert("maximumQueueDepth", maximumQueueDepth);
+    statistics.insert("shown", shownCount);
+    statistics.insert("coalesced", coalescedTotal);
+    statistics.insert("averageWaitTime", shownCount > 0 ? totalWaitTime / shownCount : 0);
+    statistics.insert("maximumWaitTime", maximumWaitTime);
+    return statistics;
+}
+
 void NotificationPreviewPresenter::updateNotification(uint id)
 {
     LipstickNotification *notification = NotificationManager::instance()->notification(id);
@@ -104,8 +161,8 @@ void NotificationPreviewPresenter::updateNotification(uint id)
     if (notification != 0) {
         if (notificationShouldBeShown(notification)) {
             // Add the notification to the queue if not already there or the current notification
-            if (currentNotification != notification && !notificationQueue.contains(notification)) {
-                notificationQueue.append(notification);
+            if (currentNotification != notification) {
+                enqueueNotification(notification);
 
                 // Show the notification if no notification currently being shown
                 if (currentNotification == 0) {
@@ -125,13 +182,20 @@ void NotificationPreviewPresenter::updateNotification(uint id)
     }
 }
 
+void NotificationPreviewPresenter::updateNotifications(const QList<uint> &ids)
+{
+    foreach (uint id, ids) {
+        updateNotification(id);
+    }
+}
+
 void NotificationPreviewPresenter::removeNotification(uint id, bool onlyFromQueue)
 {
     // Remove the notification from the queue
     LipstickNotification *notification = NotificationManager::instance()->notification(id);
 
     if (notification != 0) {
-        notificationQueue.removeAll(notification);
+        removeFromQueue(notification);
 
         // If the notification is currently being shown hide it - the next notification will be shown after the current one has been hidden
         if (!onlyFromQueue && currentNotification == notification) {
@@ -176,6 +240,103 @@ bool NotificationPreviewPresenter::notificationShouldBeShown(LipstickNotificatio
             (mode == AllNotificationsEnabled || (mode == ApplicationNotificationsDisabled && notificationIsCritical) || (mode == SystemNotificationsDisabled && !notificationIsCritical));
 }
 
+bool NotificationPreviewPresenter::QueueKey::operator<(const QueueKey &other) const
+{
+    if (urgency != other.urgency) {
+        return urgency > other.urgency;
+    }
+    if (priority != other.priority) {
+        return priority > other.priority;
+    }
+    return arrival < other.arrival;
+}
+
+void NotificationPreviewPresenter::enqueueNotification(LipstickNotification *notification)
+{
+    QHash<LipstickNotification *, QueueEntry>::iterator it = queuedNotifications.find(notification);
+    if (it != queuedNotifications.end()) {
+        // Move the notification to the position matching its current urgency and priority; the arrival is kept
+        notificationQueue.remove(it->key);
+        it->key.urgency = notification->urgency();
+        it->key.priority = notification->priority();
+        notificationQueue.insert(it->key, notification);
+
+        if (it->appName != notification->appName()) {
+            // Keep the index consistent with the name the notification is stored under
+            if (queuedNotificationsByApp.value(it->appName) == notification) {
+                queuedNotificationsByApp.remove(it->appName);
+                if (!queuedNotificationsByApp.contains(notification->appName())) {
+                    queuedNotificationsByApp.insert(notification->appName(), notification);
+                }
+            }
+            it->appName = notification->appName();
+        }
+        return;
+    }
+
+    QueueEntry entry;
+    entry.key.urgency = notification->urgency();
+    entry.key.priority = notification->priority();
+    entry.key.arrival = arrivalCount++;
+    entry.queuedAt = queueClock.elapsed();
+    entry.coalescedCount = 0;
+    entry.appName = notification->appName();
+
+    if (coalescing_ && notification->urgency() < 2) {
+        LipstickNotification *queuedNotification = queuedNotificationsByApp.value(entry.appName);
+        if (queuedNotification != 0 && queuedNotification->urgency() < 2) {
+            // Fold the queued notification into this one, which takes its place in the queue
+            const QueueEntry queuedEntry(queuedNotifications.take(queuedNotification));
+            notificationQueue.remove(queuedEntry.key);
+            entry.key.arrival = queuedEntry.key.arrival;
+            entry.queuedAt = queuedEntry.queuedAt;
+            entry.coalescedCount = queuedEntry.coalescedCount + 1;
+            coalescedTotal++;
+            NotificationManager::instance()->MarkNotificationDisplayed(queuedNotification->replacesId());
+        }
+        queuedNotificationsByApp.insert(entry.appName, notification);
+    }
+
+    queuedNotifications.insert(notification, entry);
+    notificationQueue.insert(entry.key, notification);
+    maximumQueueDepth = qMax(maximumQueueDepth, notificationQueue.count());
+    emit queueDepthChanged();
+}
+
+LipstickNotification *NotificationPreviewPresenter::dequeueNotification(int &coalescedCount)
+{
+    LipstickNotification *notification = notificationQueue.take(notificationQueue.firstKey());
+    const QueueEntry entry(queuedNotifications.take(notification));
+    if (queuedNotificationsByApp.value(entry.appName) == notification) {
+        queuedNotificationsByApp.remove(entry.appName);
+    }
+
+    const qint64 waitTime = queueClock.elapsed() - entry.queuedAt;
+    shownCount++;
+    totalWaitTime += waitTime;
+    maximumWaitTime = qMax(maximumWaitTime, waitTime);
+    coalescedCount = entry.coalescedCount;
+
+    emit queueDepthChanged();
+    return notification;
+}
+
+void NotificationPreviewPresenter::removeFromQueue(LipstickNotification *notification)
+{
+    QHash<LipstickNotification *, QueueEntry>::iterator it = queuedNotifications.find(notification);
+    if (it == queuedNotifications.end()) {
+        return;
+    }
+
+    const QString appName(it->appName);
+    notificationQueue.remove(it->key);
+    queuedNotifications.erase(it);
+    if (queuedNotificationsByApp.value(appName) == notification) {
+        queuedNotificationsByApp.remove(appName);
+    }
+    emit queueDepthChanged();
+}
+
 void NotificationPreviewPresenter::setCurrentNotification(LipstickNotification *notification)
 {
     if (currentNotification != notification) {
@@ -17,7 +17,11 @@
 #define NOTIFICATIONPREVIEWPRESENTER_H
 
 #include "lipstickglobal.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
 #include <QObject>
+#include <QVariantHash>
 
 class HomeWindow;
 class LipstickNotification;
@@ -35,11 +39,24 @@ class QmDisplayState;
  *
  * Creates a transparent notification window which can be used to show
  * notification previews.
+ *
+ * The queued notifications are shown in the order of their urgency, then
+ * their priority and then their arrival, so a critical notification is not
+ * delayed by earlier notifications of lower urgency.
+ *
+ * In the coalescing mode a notification replaces any queued notification
+ * of the same application, taking its place in the queue, so that a burst
+ * of notifications from an application results in a single preview. The
+ * number of notifications folded into the preview is available in the
+ * coalescedCount property. Critical notifications are never coalesced.
  */
 class LIPSTICK_EXPORT NotificationPreviewPresenter : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(LipstickNotification *notification READ notification NOTIFY notificationChanged)
+    Q_PROPERTY(int coalescedCount READ coalescedCount NOTIFY notificationChanged)
+    Q_PROPERTY(bool coalescing READ coalescing WRITE setCoalescing NOTIFY coalescingChanged)
+    Q_PROPERTY(int queueDepth READ queueDepth NOTIFY queueDepthChanged)
 
 public:
     /*!
@@ -62,10 +79,45 @@ public:
      */
     LipstickNotification *notification() const;
 
+    /*!
+     * Returns the number of earlier notifications folded into the
+     * notification to be currently shown in the coalescing mode.
+     *
+     * \return the number of notifications folded into the current notification
+     */
+    int coalescedCount() const;
+
+    //! Returns whether notifications from the same application are coalesced
+    bool coalescing() const;
+
+    //! Sets whether notifications from the same application are coalesced
+    void setCoalescing(bool coalescing);
+
+    //! Returns the number of notifications waiting to be shown
+    int queueDepth() const;
+
+    /*!
+     * Returns statistics about the queue: "queueDepth" is the number of
+     * notifications waiting to be shown and "maximumQueueDepth" the highest
+     * number seen, "shown" the number of notifications taken from the queue,
+     * "coalesced" the number of notifications folded into later ones, and
+     * "averageWaitTime" and "maximumWaitTime" the time in milliseconds the
+     * taken notifications waited in the queue.
+     *
+     * \return the statistics keyed by their names
+     */
+    Q_INVOKABLE QVariantHash statistics() const;
+
 signals:
     //! Sent when the notification to be shown has changed.
     void notificationChanged();
 
+    //! Sent when the coalescing mode has changed.
+    void coalescingChanged();
+
+    //! Sent when the number of notifications waiting to be shown has changed.
+    void queueDepthChanged();
+
     //! Sent when a notification is considered presented by the presenter
     void notificationPresented(uint id);
 
@@ -85,6 +137,13 @@ private slots:
      */
     void updateNotification(uint id);
 
+    /*!
+     * Updates the notifications with the given IDs.
+     *
+     * \param ids the IDs of the notifications to be updated
+     */
+    void updateNotifications(const QList<uint> &ids);
+
     /*!
      * Removes the notification with the given ID.
      *
@@ -96,21 +155,96 @@ private slots:
     void createWindowIfNecessary();
 
 private:
+    //! Position of a notification in the queue: higher urgency first, then higher priority, then earlier arrival
+    struct QueueKey
+    {
+        int urgency;
+        int priority;
+        quint64 arrival;
+
+        bool operator<(const QueueKey &other) const;
+    };
+
+    //! A notification waiting to be shown
+    struct QueueEntry
+    {
+        QueueKey key;
+        //! Time in milliseconds on queueClock when the notification was queued
+        qint64 queuedAt;
+        //! Number of earlier notifications folded into the notification
+        int coalescedCount;
+        //! Application name under which the notification is kept in queuedNotificationsByApp
+        QString appName;
+    };
+
     //! Checks whether the given notification has a preview body and a preview summary.
     bool notificationShouldBeShown(LipstickNotification *notification);
 
     //! Sets the given notification as the current notification
     void setCurrentNotification(LipstickNotification *notification);
 
+    /*!
+     * Adds a notification to the queue or moves it to its new position if
+     * it is already queued. In the coalescing mode a queued notification of
+     * the same application is replaced.
+     *
+     * \param notification the notification to be queued
+     */
+    void enqueueNotification(LipstickNotification *notification);
+
+    /*!
+     * Removes the first notification from the queue.
+     *
+     * \param coalescedCount set to the number of notifications folded into the notification
+     * \return the notification
+     */
+    LipstickNotification *dequeueNotification(int &coalescedCount);
+
+    //! Removes a notification from the queue if it is queued
+    void removeFromQueue(LipstickNotification *notification);
+
     //! The notification window
     HomeWindow *window;
 
-    //! Notifications to be shown
-    QList<LipstickNotification *> notificationQueue;
+    //! Notifications to be shown in the order in which they are to be shown
+    QMap<QueueKey, LipstickNotification *> notificationQueue;
+
+    //! The queued notifications and their queue entries
+    QHash<LipstickNotification *, QueueEntry> queuedNotifications;
+
+    //! The queued notifications of each application; only maintained in the coalescing mode
+    QHash<QString, LipstickNotification *> queuedNotificationsByApp;
+
+    //! Arrival counter for ordering notifications of equal urgency and priority
+    quint64 arrivalCount;
+
+    //! Clock for measuring the time the notifications wait in the queue
+    QElapsedTimer queueClock;
+
+    //! Whether notifications from the same application are coalesced
+    bool coalescing_;
+
+    //! Highest number of notifications seen waiting in the queue
+    int maximumQueueDepth;
+
+    //! Number of notifications taken from the queue
+    int shownCount;
+
+    //! Number of notifications folded into later ones
+    int coalescedTotal;
+
+    //! Total time in milliseconds the notifications taken from the queue waited
+    qint64 totalWaitTime;
+
+    //! Longest time in milliseconds a notification waited in the queue
+    qint64 maximumWaitTime;
 
     //! Notification currently being shown
     LipstickNotification *currentNotification;
 
+    //! Number of notifications folded into the notification currently being shown
+    int currentCoalescedCount;
+
     //! Player for notification feedbacks
     NotificationFeedbackPlayer *notificationFeedbackPlayer;
 
@@ -66,5 +66,6 @@ void ThermalNotifier::createAndPublishNotification(const QString &category, cons
     QVariantHash hints;
     hints.insert(NotificationManager::HINT_CATEGORY, category);
     hints.insert(NotificationManager::HINT_PREVIEW_BODY, body);
+    hints.insert(NotificationManager::HINT_VOLATILE, true);
     manager->Notify(qApp->applicationName(), 0, QString(), QString(), QString(), QStringList(), hints, -1);
 }
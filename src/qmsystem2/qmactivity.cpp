@@ -39,6 +39,9 @@ QmActivity::QmActivity(QObject *parent)
            : QObject(parent) {
     MEEGO_INITIALIZE(QmActivity);
 
+    // Start mirroring the state so that it is known by the time it is read
+    QmStateMirror::instance();
+
     connect(priv, SIGNAL(activityChanged(MeeGo::QmActivity::Activity)),
             this, SIGNAL(activityChanged(MeeGo::QmActivity::Activity)));
 }
@@ -93,14 +96,12 @@ void QmActivity::disconnectNotify(const QMetaMethod &signal) {
 
 QmActivity::Activity QmActivity::get() const {
     QmActivity::Activity status = Inactive;
-    QDBusReply<bool> inactivityStatusReply = QDBusConnection::systemBus().call(
-                                                 QDBusMessage::createMethodCall(MCE_SERVICE, MCE_REQUEST_PATH, MCE_REQUEST_IF,
-                                                                                MCE_INACTIVITY_STATUS_GET));
-    if (!inactivityStatusReply.isValid()) {
+    const QVariant inactivityStatusValue = QmStateMirror::instance()->value(QmStateMirror::Inactivity);
+    if (!inactivityStatusValue.isValid()) {
         return status;
     }
 
-    bool inactivityStatus = inactivityStatusReply.value();
+    bool inactivityStatus = inactivityStatusValue.toBool();
     if (!inactivityStatus) {
         status = Active;
     }
@@ -31,6 +31,7 @@
 #define QMACTIVITY_P_H
 
 #include "qmactivity.h"
+#include "qmstatemirror_p.h"
 
 #include <QMutex>
 
@@ -52,6 +53,8 @@ namespace MeeGo
 
         QmActivityPrivate() {
             connectCount[SIGNAL_INACTIVITY] = 0;
+            connect(QmStateMirror::instance(), SIGNAL(fetched(int, const QVariant&)),
+                    this, SLOT(slotStateFetched(int, const QVariant&)));
         }
 
         ~QmActivityPrivate() {
@@ -63,6 +66,18 @@ namespace MeeGo
     public Q_SLOTS:
 
         void slotActivityChanged(bool inactivity) {
+            QmStateMirror::instance()->update(QmStateMirror::Inactivity, inactivity);
+            emitActivityChanged(inactivity);
+        }
+
+        void slotStateFetched(int key, const QVariant &value) {
+            if (key == QmStateMirror::Inactivity) {
+                emitActivityChanged(value.toBool());
+            }
+        }
+
+    private:
+        void emitActivityChanged(bool inactivity) {
             if (inactivity) {
                 emit activityChanged(QmActivity::Inactive);
             } else {
@@ -40,6 +40,9 @@ QmDisplayState::QmDisplayState(QObject *parent)
               : QObject(parent) {
      MEEGO_INITIALIZE(QmDisplayState);
 
+     // Start mirroring the state so that it is known by the time it is read
+     QmStateMirror::instance();
+
      connect(priv, SIGNAL(displayStateChanged(MeeGo::QmDisplayState::DisplayState)),
              this, SIGNAL(displayStateChanged(MeeGo::QmDisplayState::DisplayState)));
 }
@@ -94,14 +97,12 @@ void QmDisplayState::disconnectNotify(const QMetaMethod &signal) {
 
 QmDisplayState::DisplayState QmDisplayState::get() const {
     QmDisplayState::DisplayState state = Unknown;
-    QDBusReply<QString> displayStateReply = QDBusConnection::systemBus().call(
-                                                QDBusMessage::createMethodCall(MCE_SERVICE, MCE_REQUEST_PATH, MCE_REQUEST_IF,
-                                                                               MCE_DISPLAY_STATUS_GET));
-    if (!displayStateReply.isValid()) {
+    const QVariant displayState = QmStateMirror::instance()->value(QmStateMirror::DisplayState);
+    if (!displayState.isValid()) {
         return state;
     }
 
-    QString stateStr = displayStateReply.value();
+    QString stateStr = displayState.toString();
 
     if (stateStr == MCE_DISPLAY_DIM_STRING) {
         state = Dimmed;
@@ -28,6 +28,7 @@
 #define QMDISPLAYSTATE_P_H
 
 #include "qmdisplaystate.h"
+#include "qmstatemirror_p.h"
 
 #include <QMutex>
 
@@ -46,6 +47,8 @@ namespace MeeGo
     public:
         QmDisplayStatePrivate() {
             connectCount[SIGNAL_DISPLAY_STATE] = 0;
+            connect(QmStateMirror::instance(), SIGNAL(fetched(int, const QVariant&)),
+                    this, SLOT(slotStateFetched(int, const QVariant&)));
         }
 
         ~QmDisplayStatePrivate() {
@@ -60,6 +63,18 @@ namespace MeeGo
     private Q_SLOTS:
 
         void slotDisplayStateChanged(const QString& state) {
+            QmStateMirror::instance()->update(QmStateMirror::DisplayState, state);
+            emitDisplayStateChanged(state);
+        }
+
+        void slotStateFetched(int key, const QVariant &value) {
+            if (key == QmStateMirror::DisplayState) {
+                emitDisplayStateChanged(value.toString());
+            }
+        }
+
+    private:
+        void emitDisplayStateChanged(const QString &state) {
             if (state == MCE_DISPLAY_OFF_STRING)
                 emit displayStateChanged(QmDisplayState::Off);
             else if (state == MCE_DISPLAY_DIM_STRING)
@@ -36,6 +36,9 @@ QmLocks::QmLocks(QObject *parent)
              : QObject(parent) {
     MEEGO_INITIALIZE(QmLocks);
 
+    // Start mirroring the state so that it is known by the time it is read
+    QmStateMirror::instance();
+
     connect(priv, SIGNAL(stateChanged(MeeGo::QmLocks::Lock, MeeGo::QmLocks::State)),
             this, SIGNAL(stateChanged(MeeGo::QmLocks::Lock,MeeGo::QmLocks::State)));
 }
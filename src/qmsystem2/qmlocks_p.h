@@ -40,6 +40,7 @@
 #include "mce/mode-names.h"
 
 #include "qmipcinterface_p.h"
+#include "qmstatemirror_p.h"
 
 // The DBus system service provided by devicelock
 #define DEVLOCK_SERVICE "org.nemomobile.lipstick"
@@ -75,6 +76,8 @@ namespace MeeGo
             devlockIf = new QmIPCInterface(DEVLOCK_SERVICE, DEVLOCK_PATH, DEVLOCK_INTERFACE);
 
             connectCount[SIGNAL_LOCK_STATE] = 0;
+            connect(QmStateMirror::instance(), SIGNAL(fetched(int, const QVariant&)),
+                    this, SLOT(stateFetched(int, const QVariant&)));
         }
 
         ~QmLocksPrivate() {
@@ -132,14 +135,14 @@ namespace MeeGo
             QmLocks::State state = QmLocks::Unknown;
 
             if (what == QmLocks::Device) {
-                QDBusReply<int> reply = devlockIf->call(DEVLOCK_GET);
-                if (reply.isValid()) {
-                    state = QmLocksPrivate::stateToState(reply.value());
+                const QVariant value = QmStateMirror::instance()->value(QmStateMirror::DeviceLock);
+                if (value.isValid()) {
+                    state = QmLocksPrivate::stateToState(value.toInt());
                 }
             } else if (what == QmLocks::TouchAndKeyboard) {
-                QDBusReply<QString> reply = mceRequestIf->call(MCE_TKLOCK_MODE_GET);
-                if (reply.isValid()) {
-                    state = QmLocksPrivate::stringToState(reply.value());
+                const QVariant value = QmStateMirror::instance()->value(QmStateMirror::TouchAndKeyboardLock);
+                if (value.isValid()) {
+                    state = QmLocksPrivate::stringToState(value.toString());
                 }
             }
             return state;
@@ -188,12 +191,22 @@ namespace MeeGo
         }
 
         void deviceStateChanged(int state) {
+            QmStateMirror::instance()->update(QmStateMirror::DeviceLock, state);
             emit stateChanged(QmLocks::Device, stateToState(state));
         }
 
         void touchAndKeyboardStateChanged(const QString& state) {
+            QmStateMirror::instance()->update(QmStateMirror::TouchAndKeyboardLock, state);
             emit stateChanged(QmLocks::TouchAndKeyboard, stringToState(state));
         }
+
+        void stateFetched(int key, const QVariant &value) {
+            if (key == QmStateMirror::DeviceLock) {
+                emit stateChanged(QmLocks::Device, stateToState(value.toInt()));
+            } else if (key == QmStateMirror::TouchAndKeyboardLock) {
+                emit stateChanged(QmLocks::TouchAndKeyboard, stringToState(value.toString()));
+            }
+        }
     };
 }
 #endif // QMLOCKS_P_H
@@ -0,0 +1,195 @@
+/*!
+ * @file qmstatemirror.cpp
+ * @brief QmStateMirror
+
+   <p>
+   Copyright (C) 2013 Jolla Ltd.
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#include "qmstatemirror_p.h"
+#include "qmlocks_p.h"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusServiceWatcher>
+#include <QPointer>
+
+#include <dsme/thermalmanager_dbus_if.h>
+
+// Time in milliseconds after which a value not confirmed by a signal or a reply is refreshed
+#define STALE_VALUE_AGE 60000
+
+namespace MeeGo {
+
+namespace {
+
+struct Source {
+    const char *service;
+    const char *path;
+    const char *interface;
+    const char *method;
+};
+
+// The methods for fetching the values, in the order of QmStateMirror::Key
+const Source sources[QmStateMirror::KeyCount] = {
+    { MCE_SERVICE, MCE_REQUEST_PATH, MCE_REQUEST_IF, MCE_DISPLAY_STATUS_GET },
+    { MCE_SERVICE, MCE_REQUEST_PATH, MCE_REQUEST_IF, MCE_INACTIVITY_STATUS_GET },
+    { MCE_SERVICE, MCE_REQUEST_PATH, MCE_REQUEST_IF, MCE_TKLOCK_MODE_GET },
+    { DEVLOCK_SERVICE, DEVLOCK_PATH, DEVLOCK_INTERFACE, DEVLOCK_GET },
+    { thermalmanager_service, thermalmanager_path, thermalmanager_interface, thermalmanager_get_thermal_state }
+};
+
+}
+
+QmStateMirror::QmStateMirror(QObject *parent)
+             : QObject(parent),
+               serviceWatcher(new QDBusServiceWatcher(this)) {
+    QDBusConnection bus = QDBusConnection::systemBus();
+    serviceWatcher->setConnection(bus);
+    serviceWatcher->setWatchMode(QDBusServiceWatcher::WatchForRegistration);
+    for (int key = 0; key < KeyCount; ++key) {
+        if (!serviceWatcher->watchedServices().contains(sources[key].service)) {
+            serviceWatcher->addWatchedService(sources[key].service);
+        }
+    }
+    connect(serviceWatcher, SIGNAL(serviceRegistered(QString)), this, SLOT(serviceRegistered(QString)));
+
+    bus.connect(MCE_SERVICE, MCE_SIGNAL_PATH, MCE_SIGNAL_IF, MCE_DISPLAY_SIG,
+                this, SLOT(displayStateChanged(const QString&)));
+    bus.connect(MCE_SERVICE, MCE_SIGNAL_PATH, MCE_SIGNAL_IF, MCE_INACTIVITY_SIG,
+                this, SLOT(inactivityChanged(bool)));
+    bus.connect(MCE_SERVICE, MCE_SIGNAL_PATH, MCE_SIGNAL_IF, MCE_TKLOCK_MODE_SIG,
+                this, SLOT(touchAndKeyboardLockChanged(const QString&)));
+    bus.connect(DEVLOCK_SERVICE, DEVLOCK_PATH, DEVLOCK_INTERFACE, DEVLOCK_SIGNAL,
+                this, SLOT(deviceLockChanged(int)));
+    bus.connect("", thermalmanager_path, thermalmanager_interface, thermalmanager_state_change_ind,
+                this, SLOT(thermalStateChanged(const QString&)));
+
+    for (int key = 0; key < KeyCount; ++key) {
+        fetch(static_cast<Key>(key));
+    }
+}
+
+QmStateMirror *QmStateMirror::instance() {
+    static QPointer<QmStateMirror> mirror;
+    if (mirror.isNull()) {
+        mirror = new QmStateMirror(QCoreApplication::instance());
+    }
+    return mirror;
+}
+
+QVariant QmStateMirror::value(Key key) {
+    Entry &entry = entries[key];
+    if (!entry.initialized) {
+        // Wait for a value never received, so that callers don't take an unknown state, such as an
+        // unknown device lock state, for a known one. This only happens before the first reply.
+        if (entry.pending == 0) {
+            fetch(key);
+        }
+        entry.pending->waitForFinished();
+        applyReply(key);
+    } else if (entry.pending == 0 && entry.updated.hasExpired(STALE_VALUE_AGE)) {
+        // Don't wait for the reply; it is reported with fetched() if it changes the value
+        fetch(key);
+    }
+    entry.reported = entry.initialized;
+    return entry.value;
+}
+
+void QmStateMirror::update(Key key, const QVariant &value) {
+    Entry &entry = entries[key];
+    entry.value = value;
+    entry.updated.start();
+    entry.initialized = true;
+    entry.reported = true;
+    entry.generation++;
+}
+
+void QmStateMirror::displayStateChanged(const QString &state) {
+    update(DisplayState, state);
+}
+
+void QmStateMirror::inactivityChanged(bool inactivity) {
+    update(Inactivity, inactivity);
+}
+
+void QmStateMirror::touchAndKeyboardLockChanged(const QString &state) {
+    update(TouchAndKeyboardLock, state);
+}
+
+void QmStateMirror::deviceLockChanged(int state) {
+    update(DeviceLock, state);
+}
+
+void QmStateMirror::thermalStateChanged(const QString &state) {
+    update(ThermalState, state);
+}
+
+void QmStateMirror::handleReply(QDBusPendingCallWatcher *watcher) {
+    for (int key = 0; key < KeyCount; ++key) {
+        if (entries[key].pending == watcher) {
+            applyReply(static_cast<Key>(key));
+            return;
+        }
+    }
+}
+
+void QmStateMirror::serviceRegistered(const QString &service) {
+    // A restarted service may have a different state and the earlier fetches may have failed
+    for (int key = 0; key < KeyCount; ++key) {
+        if (entries[key].pending == 0 && service == sources[key].service) {
+            fetch(static_cast<Key>(key));
+        }
+    }
+}
+
+void QmStateMirror::fetch(Key key) {
+    Entry &entry = entries[key];
+    const Source &source = sources[key];
+    QDBusMessage call = QDBusMessage::createMethodCall(source.service, source.path, source.interface, source.method);
+    entry.pending = new QDBusPendingCallWatcher(QDBusConnection::systemBus().asyncCall(call), this);
+    entry.pendingGeneration = entry.generation;
+    connect(entry.pending, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(handleReply(QDBusPendingCallWatcher*)));
+}
+
+void QmStateMirror::applyReply(Key key) {
+    Entry &entry = entries[key];
+    QDBusPendingCallWatcher *watcher = entry.pending;
+    entry.pending = 0;
+    watcher->disconnect(this);
+    watcher->deleteLater();
+
+    // A change signal received after the call was made is newer than the reply. A failed
+    // fetch leaves the entry as it was, so that the value is fetched again on the next read.
+    const QDBusMessage reply = watcher->reply();
+    if (entry.generation == entry.pendingGeneration && reply.type() == QDBusMessage::ReplyMessage &&
+            !reply.arguments().isEmpty()) {
+        // Only a value differing from one already given to the callers is news to them
+        const QVariant value = reply.arguments().first();
+        const bool changed = entry.reported && entry.value != value;
+        entry.value = value;
+        entry.updated.start();
+        entry.initialized = true;
+        if (changed) {
+            emit fetched(key, value);
+        }
+    }
+}
+
+} // MeeGo namespace
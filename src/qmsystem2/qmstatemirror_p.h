@@ -0,0 +1,153 @@
+/*!
+ * @file qmstatemirror_p.h
+ * @brief Contains QmStateMirror
+
+   <p>
+   Copyright (C) 2013 Jolla Ltd.
+
+   @scope Private
+
+   This file is part of SystemSW QtAPI.
+
+   SystemSW QtAPI is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License
+   version 2.1 as published by the Free Software Foundation.
+
+   SystemSW QtAPI is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with SystemSW QtAPI.  If not, see <http://www.gnu.org/licenses/>.
+   </p>
+ */
+#ifndef QMSTATEMIRROR_P_H
+#define QMSTATEMIRROR_P_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QVariant>
+
+class QDBusPendingCallWatcher;
+class QDBusServiceWatcher;
+
+namespace MeeGo
+{
+    /*
+     * Process-wide mirror of the system state read by the getters of the
+     * QmSystem classes. The mirror subscribes once to the change signals of
+     * MCE, the thermal manager and the device lock and fetches the initial
+     * values asynchronously, so that reading the state does not make a D-Bus
+     * call. Only reading a value which has not arrived yet waits for the
+     * reply, since an unknown state must not be taken for a known one.
+     *
+     * A value which has not been confirmed for a while is refreshed
+     * asynchronously when read; the cached value is returned meanwhile and
+     * fetched() is emitted if the reply differs from it. A value which could
+     * not be fetched is fetched again when it is read or when its service
+     * appears on the bus.
+     *
+     * The mirror is to be used in the main thread only.
+     */
+    class QmStateMirror : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        //! The mirrored values. The values are stored as sent by the services.
+        enum Key {
+            //! Display state string from MCE
+            DisplayState,
+            //! Inactivity boolean from MCE
+            Inactivity,
+            //! Touchscreen/keypad lock mode string from MCE
+            TouchAndKeyboardLock,
+            //! Device lock state integer from the device lock
+            DeviceLock,
+            //! Thermal state string from the thermal manager
+            ThermalState,
+            KeyCount
+        };
+
+        //! Returns the mirror, creating it on first use
+        static QmStateMirror *instance();
+
+        /*
+         * Returns the mirrored value, waiting for it if it has not been
+         * received yet.
+         *
+         * @param key the value to return
+         * @return the value or an invalid value if it could not be fetched
+         */
+        QVariant value(Key key);
+
+        /*
+         * Updates a mirrored value. Called when a change signal is received.
+         *
+         * @param key the value to update
+         * @param value the new value
+         */
+        void update(Key key, const QVariant &value);
+
+    Q_SIGNALS:
+        /*
+         * Sent when a fetched value differs from the one given to the
+         * callers by value() or by a change signal. Changes received as
+         * signals are not reported, since the QmSystem classes report them
+         * already, and neither are values nobody has been given yet.
+         *
+         * @param key the value which was fetched, a QmStateMirror::Key
+         * @param value the fetched value
+         */
+        void fetched(int key, const QVariant &value);
+
+    private Q_SLOTS:
+        void displayStateChanged(const QString &state);
+        void inactivityChanged(bool inactivity);
+        void touchAndKeyboardLockChanged(const QString &state);
+        void deviceLockChanged(int state);
+        void thermalStateChanged(const QString &state);
+        void handleReply(QDBusPendingCallWatcher *watcher);
+        void serviceRegistered(const QString &service);
+
+    private:
+        explicit QmStateMirror(QObject *parent = 0);
+
+        //! Starts an asynchronous call to fetch a value
+        void fetch(Key key);
+
+        //! Applies the reply to the pending call of a value unless the value has changed since the call was made
+        void applyReply(Key key);
+
+        struct Entry {
+            Entry() : initialized(false), reported(false), generation(0), pending(0), pendingGeneration(0) {}
+
+            //! The value as sent by the service
+            QVariant value;
+            //! Time since the value was last received
+            QElapsedTimer updated;
+            //! Whether a value has been received
+            bool initialized;
+            //! Whether the value has been given to the callers by value() or by a change signal
+            bool reported;
+            //! Incremented on each change signal
+            uint generation;
+            //! The pending call fetching the value, if any
+            QDBusPendingCallWatcher *pending;
+            //! The generation of the value when the pending call was made
+            uint pendingGeneration;
+        };
+
+        Entry entries[KeyCount];
+
+        //! Watches the services for restarts to refetch their values
+        QDBusServiceWatcher *serviceWatcher;
+
+#ifdef UNIT_TEST
+        friend class Ut_QmStateMirror;
+#endif
+    };
+}
+
+#endif // QMSTATEMIRROR_P_H
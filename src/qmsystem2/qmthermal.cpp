@@ -26,6 +26,7 @@
  */
 #include "qmthermal.h"
 #include "qmthermal_p.h"
+#include <QDBusConnection>
 #include <QMetaMethod>
 
 namespace MeeGo {
@@ -34,6 +35,9 @@ QmThermal::QmThermal(QObject *parent)
              : QObject(parent) {
     MEEGO_INITIALIZE(QmThermal)
 
+    // Start mirroring the state so that it is known by the time it is read
+    QmStateMirror::instance();
+
     connect(priv, SIGNAL(thermalChanged(MeeGo::QmThermal::ThermalState)),
             this, SIGNAL(thermalChanged(MeeGo::QmThermal::ThermalState)));
 }
@@ -87,18 +91,13 @@ void QmThermal::disconnectNotify(const QMetaMethod &signal) {
 }
 
 QmThermal::ThermalState QmThermal::get() const {
-    MEEGO_PRIVATE_CONST(QmThermal)
-    QString state;
-    QList<QVariant> resp;
-
-    resp = priv->If->get(thermalmanager_get_thermal_state);
+    const QVariant state = QmStateMirror::instance()->value(QmStateMirror::ThermalState);
 
-    if (resp.isEmpty()) {
+    if (!state.isValid()) {
         return Error;
     }
 
-    state = resp[0].toString();
-    return QmThermalPrivate::stringToState(state);
+    return QmThermalPrivate::stringToState(state.toString());
 }
 
 } // MeeGo namespace
@@ -28,7 +28,7 @@
 #define QMTHERMAL_P_H
 
 #include "qmthermal.h"
-#include "qmipcinterface_p.h"
+#include "qmstatemirror_p.h"
 
 #include <dsme/thermalmanager_dbus_if.h>
 
@@ -46,17 +46,12 @@ namespace MeeGo
 
     public:
         QmThermalPrivate() {
-            If = new QmIPCInterface(thermalmanager_service,
-                                    thermalmanager_path,
-                                    thermalmanager_interface);
-
             connectCount[SIGNAL_THERMAL_STATE] = 0;
+            connect(QmStateMirror::instance(), SIGNAL(fetched(int, const QVariant&)),
+                    this, SLOT(thermalStateFetched(int, const QVariant&)));
         }
 
         ~QmThermalPrivate() {
-            if (If) {
-                delete If, If = 0;
-            }
         }
 
         static QmThermal::ThermalState stringToState(const QString& state) {
@@ -76,15 +71,21 @@ namespace MeeGo
 
         QMutex connectMutex;
         size_t connectCount[1];
-        QmIPCInterface *If;
 
     Q_SIGNALS:
         void thermalChanged(MeeGo::QmThermal::ThermalState);
 
     private Q_SLOTS:
         void thermalStateChanged(const QString &state) {
+            QmStateMirror::instance()->update(QmStateMirror::ThermalState, state);
             emit thermalChanged(QmThermalPrivate::stringToState(state));
         }
+
+        void thermalStateFetched(int key, const QVariant &value) {
+            if (key == QmStateMirror::ThermalState) {
+                emit thermalChanged(QmThermalPrivate::stringToState(value.toString()));
+            }
+        }
     };
 }
 #endif // QMTHERMAL_P_H
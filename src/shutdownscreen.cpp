@@ -100,6 +100,7 @@ void ShutdownScreen::createAndPublishNotification(const QString &category, const
     QVariantHash hints;
     hints.insert(NotificationManager::HINT_CATEGORY, category);
     hints.insert(NotificationManager::HINT_PREVIEW_BODY, body);
+    hints.insert(NotificationManager::HINT_VOLATILE, true);
     manager->Notify(qApp->applicationName(), 0, QString(), QString(), QString(), QStringList(), hints, -1);
 }
 
@@ -68,6 +68,8 @@ HEADERS += \
     3rdparty/synchronizelists.h \
     notifications/notificationmanageradaptor.h \
     notifications/categorydefinitionstore.h \
+    notifications/notificationdatabase.h \
+    notifications/notificationimagecache.h \
     notifications/batterynotifier.h \
     notifications/lowbatterynotifier.h \
     notifications/diskspacenotifier.h \
@@ -91,6 +93,7 @@ HEADERS += \
     qmsystem2/qmactivity_p.h \
     qmsystem2/qmipcinterface_p.h \
     qmsystem2/qmthermal_p.h \
+    qmsystem2/qmstatemirror_p.h \
 
 
 SOURCES += \
@@ -107,6 +110,8 @@ SOURCES += \
     components/launcherdbus.cpp \
     components/launcherfoldermodel.cpp \
     notifications/notificationmanager.cpp \
+    notifications/notificationdatabase.cpp \
+    notifications/notificationimagecache.cpp \
     notifications/notificationmanageradaptor.cpp \
     notifications/lipsticknotification.cpp \
     notifications/categorydefinitionstore.cpp \
@@ -137,6 +142,7 @@ SOURCES += \
     qmsystem2/qmthermal.cpp \
     qmsystem2/qmusbmode.cpp \
     qmsystem2/qmipcinterface.cpp \
+    qmsystem2/qmstatemirror.cpp \
 
 CONFIG += link_pkgconfig mobility qt warn_on depend_includepath qmake_cache target_qt
 CONFIG -= link_prl
@@ -100,6 +100,7 @@ void USBModeSelector::applyUSBMode(MeeGo::QmUSBMode::Mode mode)
             hints.insert(NotificationManager::HINT_CATEGORY, "x-nemo.device.locked");
             //% "Unlock device first"
             hints.insert(NotificationManager::HINT_PREVIEW_BODY, qtTrId("qtn_usb_device_locked"));
+            hints.insert(NotificationManager::HINT_VOLATILE, true);
             manager->Notify(qApp->applicationName(), 0, QString(), QString(), QString(), QStringList(), hints, -1);
         }
         break;
@@ -181,6 +182,7 @@ void USBModeSelector::showNotification(MeeGo::QmUSBMode::Mode mode)
     QVariantHash hints;
     hints.insert(NotificationManager::HINT_CATEGORY, category);
     hints.insert(NotificationManager::HINT_PREVIEW_BODY, body);
+    hints.insert(NotificationManager::HINT_VOLATILE, true);
     manager->Notify(qApp->applicationName(), 0, QString(), QString(), QString(), QStringList(), hints, -1);
 }
 
@@ -192,6 +194,7 @@ void USBModeSelector::showError(const QString &errorCode)
         hints.insert(NotificationManager::HINT_CATEGORY, "device.error");
         //% "USB connection error occurred"
         hints.insert(NotificationManager::HINT_PREVIEW_BODY, qtTrId(errorCodeToTranslationID.value(errorCode).toUtf8().constData()));
+        hints.insert(NotificationManager::HINT_VOLATILE, true);
         manager->Notify(qApp->applicationName(), 0, QString(), QString(), QString(), QStringList(), hints, -1);
     }
 }
@@ -94,13 +94,13 @@ void QObjectListModel::addItem(QObject *item)
     insertItem(_list->count(), item);
 }
 
-void QObjectListModel::addItems(const QList<QObject *> &items)
+void QObjectListModel::insertItems(int index, const QList<QObject *> &items)
 {
     if (!items.isEmpty()) {
-        int index(_list->count());
         beginInsertRows(QModelIndex(), index, (index + items.count() - 1));
+        int position(index);
         foreach (QObject *item, items) {
-            _list->append(item);
+            _list->insert(position++, item);
             connect(item, SIGNAL(destroyed()), this, SLOT(removeDestroyedItem()));
         }
         endInsertRows();
@@ -112,6 +112,11 @@ void QObjectListModel::addItems(const QList<QObject *> &items)
     }
 }
 
+void QObjectListModel::addItems(const QList<QObject *> &items)
+{
+    insertItems(_list->count(), items);
+}
+
 void QObjectListModel::removeDestroyedItem()
 {
     QObject *obj = QObject::sender();
@@ -158,7 +163,7 @@ void QObjectListModel::removeItems(const QList<QObject *> &items)
                 --first;
             }
 
-            beginRemoveRows(QModelIndex(), first, last);
+            beginRemoveRows(QModelIndex(), removals.at(first).first, removals.at(last).first);
             while (last >= first) {
                 const QPair<int, QObject *> &removal(removals.at(last));
                 --last;
@@ -42,6 +42,7 @@ public:
     Q_INVOKABLE void update(int row);
 
     void insertItem(int index, QObject *item);
+    void insertItems(int index, const QList<QObject *> &items);
     void addItem(QObject *item);
     void addItems(const QList<QObject *> &items);
     void removeItem(QObject *item);
@@ -0,0 +1,191 @@
+/***************************************************************************
+**
+** Copyright (C) 2012 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include "bm_notificationmanager.h"
+#include "notificationmanager.h"
+#include "notificationdatabase.h"
+#include "notificationmanageradaptor_stub.h"
+#include "categorydefinitionstore_stub.h"
+#include "notificationimagecache_stub.h"
+#include "qmactivity_stub.h"
+#include "qmdisplaystate_stub.h"
+
+void Bm_NotificationManager::initTestCase()
+{
+    // Keep the benchmark database away from the real one
+    databaseDirectory = new QTemporaryDir;
+    QVERIFY(databaseDirectory->isValid());
+    qputenv("LIPSTICK_NOTIFICATION_DATABASE_DIR", databaseDirectory->path().toLocal8Bit());
+}
+
+void Bm_NotificationManager::cleanupTestCase()
+{
+    delete databaseDirectory;
+}
+
+void Bm_NotificationManager::init()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVERIFY(manager->database->isOpen());
+
+    // Measure the notification handling itself rather than the eviction of old notifications
+    manager->maxNotificationsPerApplication = 0;
+    manager->maxNotifications = 0;
+}
+
+void Bm_NotificationManager::cleanup()
+{
+    delete NotificationManager::instance_;
+    NotificationManager::instance_ = 0;
+
+    // Start each benchmark with an empty database
+    QDir directory(databaseDirectory->path());
+    foreach (const QString &fileName, directory.entryList(QStringList() << "notifications.db*", QDir::Files)) {
+        directory.remove(fileName);
+    }
+}
+
+void Bm_NotificationManager::addNotificationCounts()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+}
+
+QList<uint> Bm_NotificationManager::notify(int count, int expireTimeout)
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    hints.insert(NotificationManager::HINT_CATEGORY, "im.received");
+    hints.insert(NotificationManager::HINT_PREVIEW_SUMMARY, "previewSummary");
+
+    QList<uint> ids;
+    for (int i = 0; i < count; ++i) {
+        ids.append(manager->Notify("app", 0, "icon", "summary", QString("body %1").arg(i), QStringList() << "default" << "Open", hints, expireTimeout));
+    }
+    return ids;
+}
+
+void Bm_NotificationManager::flush()
+{
+    // Include the cost of writing the changes to the database
+    NotificationManager::instance()->database->flush();
+}
+
+void Bm_NotificationManager::benchmarkNotify_data()
+{
+    addNotificationCounts();
+}
+
+void Bm_NotificationManager::benchmarkNotify()
+{
+    QFETCH(int, count);
+
+    QBENCHMARK_ONCE {
+        notify(count);
+        flush();
+    }
+    QCOMPARE(NotificationManager::instance()->notificationIds().count(), count);
+}
+
+void Bm_NotificationManager::benchmarkReplace_data()
+{
+    addNotificationCounts();
+}
+
+void Bm_NotificationManager::benchmarkReplace()
+{
+    QFETCH(int, count);
+    NotificationManager *manager = NotificationManager::instance();
+    const QList<uint> ids(notify(count));
+    flush();
+
+    QBENCHMARK_ONCE {
+        foreach (uint id, ids) {
+            manager->Notify("app", id, "icon", "summary", "updated body", QStringList() << "default" << "Open", QVariantHash(), 0);
+        }
+        flush();
+    }
+    QCOMPARE(manager->notificationIds().count(), count);
+}
+
+void Bm_NotificationManager::benchmarkClose_data()
+{
+    addNotificationCounts();
+}
+
+void Bm_NotificationManager::benchmarkClose()
+{
+    QFETCH(int, count);
+    NotificationManager *manager = NotificationManager::instance();
+    const QList<uint> ids(notify(count));
+    flush();
+
+    QBENCHMARK_ONCE {
+        foreach (uint id, ids) {
+            manager->CloseNotification(id);
+        }
+        flush();
+    }
+    QCOMPARE(manager->notificationIds().count(), 0);
+}
+
+void Bm_NotificationManager::benchmarkExpire_data()
+{
+    addNotificationCounts();
+}
+
+void Bm_NotificationManager::benchmarkExpire()
+{
+    QFETCH(int, count);
+    NotificationManager *manager = NotificationManager::instance();
+    foreach (uint id, notify(count, 1)) {
+        manager->MarkNotificationDisplayed(id);
+    }
+    flush();
+
+    // Let all the notifications expire before expiring them in one go
+    QTest::qSleep(10);
+    QBENCHMARK_ONCE {
+        manager->expire();
+        flush();
+    }
+    QCOMPARE(manager->notificationIds().count(), 0);
+}
+
+void Bm_NotificationManager::benchmarkRestore_data()
+{
+    addNotificationCounts();
+}
+
+void Bm_NotificationManager::benchmarkRestore()
+{
+    QFETCH(int, count);
+    notify(count);
+    delete NotificationManager::instance_;
+    NotificationManager::instance_ = 0;
+
+    NotificationManager *manager = 0;
+    QBENCHMARK_ONCE {
+        manager = NotificationManager::instance();
+        manager->restorePendingNotifications();
+    }
+    QCOMPARE(manager->notificationIds().count(), count);
+}
+
+QTEST_MAIN(Bm_NotificationManager)
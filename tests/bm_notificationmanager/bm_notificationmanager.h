@@ -0,0 +1,51 @@
+/***************************************************************************
+**
+** Copyright (C) 2012 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+#ifndef BM_NOTIFICATIONMANAGER_H
+#define BM_NOTIFICATIONMANAGER_H
+
+#include <QObject>
+#include <QList>
+
+class QTemporaryDir;
+
+class Bm_NotificationManager : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+    void benchmarkNotify_data();
+    void benchmarkNotify();
+    void benchmarkReplace_data();
+    void benchmarkReplace();
+    void benchmarkClose_data();
+    void benchmarkClose();
+    void benchmarkExpire_data();
+    void benchmarkExpire();
+    void benchmarkRestore_data();
+    void benchmarkRestore();
+
+private:
+    void addNotificationCounts();
+    QList<uint> notify(int count, int expireTimeout = 0);
+    void flush();
+
+    QTemporaryDir *databaseDirectory;
+};
+
+#endif
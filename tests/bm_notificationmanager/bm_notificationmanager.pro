@@ -0,0 +1,26 @@
+include(../common.pri)
+TARGET = bm_notificationmanager
+INCLUDEPATH += $$NOTIFICATIONSRCDIR ../../src/qmsystem2
+CONFIG += link_pkgconfig
+QT += dbus sql
+PKGCONFIG += mlite5
+
+# benchmark and the units it drives against a real database
+SOURCES += \
+    bm_notificationmanager.cpp \
+    $$NOTIFICATIONSRCDIR/notificationmanager.cpp \
+    $$NOTIFICATIONSRCDIR/notificationdatabase.cpp \
+    $$NOTIFICATIONSRCDIR/lipsticknotification.cpp \
+    $$STUBSDIR/stubbase.cpp \
+
+# benchmark, the units and the stubbed classes they use
+HEADERS += \
+    bm_notificationmanager.h \
+    $$NOTIFICATIONSRCDIR/notificationmanager.h \
+    $$NOTIFICATIONSRCDIR/notificationdatabase.h \
+    $$NOTIFICATIONSRCDIR/notificationimagecache.h \
+    $$NOTIFICATIONSRCDIR/lipsticknotification.h \
+    $$NOTIFICATIONSRCDIR/notificationmanageradaptor.h \
+    $$NOTIFICATIONSRCDIR/categorydefinitionstore.h \
+    ../../src/qmsystem2/qmactivity.h \
+    ../../src/qmsystem2/qmdisplaystate.h
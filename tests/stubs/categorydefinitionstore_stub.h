@@ -29,8 +29,9 @@ class CategoryDefinitionStoreStub : public StubBase {
   virtual bool contains(const QString &category, const QString &key);
   virtual QString value(const QString &category, const QString &key);
   virtual QHash<QString, QString> categoryParameters(const QString &category);
-  virtual void updateCategoryDefinitionFileList();
-  virtual void updateCategoryDefinitionFile(const QString &path);
+  virtual void scheduleCategoryDefinitionFileListUpdate();
+  virtual void scheduleCategoryDefinitionFileUpdate(const QString &path);
+  virtual void processCategoryDefinitionChanges();
 };
 
 // 2. IMPLEMENT STUB
@@ -77,14 +78,18 @@ QHash<QString, QString> CategoryDefinitionStoreStub::categoryParameters(const QS
   return stubReturnValue<QHash<QString, QString> >("categoryParameters");
 }
 
-void CategoryDefinitionStoreStub::updateCategoryDefinitionFileList() {
-  stubMethodEntered("updateCategoryDefinitionFileList");
+void CategoryDefinitionStoreStub::scheduleCategoryDefinitionFileListUpdate() {
+  stubMethodEntered("scheduleCategoryDefinitionFileListUpdate");
 }
 
-void CategoryDefinitionStoreStub::updateCategoryDefinitionFile(const QString &path) {
+void CategoryDefinitionStoreStub::scheduleCategoryDefinitionFileUpdate(const QString &path) {
   QList<ParameterBase*> params;
   params.append( new Parameter<const QString & >(path));
-  stubMethodEntered("updateCategoryDefinitionFile",params);
+  stubMethodEntered("scheduleCategoryDefinitionFileUpdate",params);
+}
+
+void CategoryDefinitionStoreStub::processCategoryDefinitionChanges() {
+  stubMethodEntered("processCategoryDefinitionChanges");
 }
 
 
@@ -119,12 +124,16 @@ QHash<QString, QString> CategoryDefinitionStore::categoryParameters(const QStrin
   return gCategoryDefinitionStoreStub->categoryParameters(category);
 }
 
-void CategoryDefinitionStore::updateCategoryDefinitionFileList() {
-  gCategoryDefinitionStoreStub->updateCategoryDefinitionFileList();
+void CategoryDefinitionStore::scheduleCategoryDefinitionFileListUpdate() {
+  gCategoryDefinitionStoreStub->scheduleCategoryDefinitionFileListUpdate();
+}
+
+void CategoryDefinitionStore::scheduleCategoryDefinitionFileUpdate(const QString &path) {
+  gCategoryDefinitionStoreStub->scheduleCategoryDefinitionFileUpdate(path);
 }
 
-void CategoryDefinitionStore::updateCategoryDefinitionFile(const QString &path) {
-  gCategoryDefinitionStoreStub->updateCategoryDefinitionFile(path);
+void CategoryDefinitionStore::processCategoryDefinitionChanges() {
+  gCategoryDefinitionStoreStub->processCategoryDefinitionChanges();
 }
 
 
@@ -29,6 +29,7 @@ class NotificationFeedbackPlayerStub : public StubBase {
   virtual void init();
   virtual void addNotification(uint id);
   virtual void removeNotification(uint id);
+  virtual void addRestoredNotifications(const QList<uint> &ids);
 }; 
 
 // 2. IMPLEMENT STUB
@@ -63,6 +64,12 @@ void NotificationFeedbackPlayerStub::removeNotification(uint id) {
   stubMethodEntered("removeNotification",params);
 }
 
+void NotificationFeedbackPlayerStub::addRestoredNotifications(const QList<uint> &ids) {
+  QList<ParameterBase*> params;
+  params.append( new Parameter<QList<uint> >(ids));
+  stubMethodEntered("addRestoredNotifications",params);
+}
+
 
 
 // 3. CREATE A STUB INSTANCE
@@ -95,5 +102,9 @@ void NotificationFeedbackPlayer::removeNotification(uint id) {
   gNotificationFeedbackPlayerStub->removeNotification(id);
 }
 
+void NotificationFeedbackPlayer::addRestoredNotifications(const QList<uint> &ids) {
+  gNotificationFeedbackPlayerStub->addRestoredNotifications(ids);
+}
+
 
 #endif
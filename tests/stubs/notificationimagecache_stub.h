@@ -0,0 +1,119 @@
+/***************************************************************************
+**
+** Copyright (C) 2012 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+#ifndef NOTIFICATIONIMAGECACHE_STUB
+#define NOTIFICATIONIMAGECACHE_STUB
+
+#include "notificationimagecache.h"
+#include <stubbase.h>
+
+
+// 1. DECLARE STUB
+// FIXME - stubgen is not yet finished
+class NotificationImageCacheStub : public StubBase {
+  public:
+  virtual void NotificationImageCacheConstructor(const QString &path);
+  virtual void NotificationImageCacheDestructor();
+  virtual QString store(const QVariant &imageData);
+  virtual bool contains(const QString &path);
+  virtual void addReference(const QString &path);
+  virtual void releaseReference(const QString &path);
+  virtual void removeUnreferencedImages();
+  virtual void waitForFileOperations();
+};
+
+// 2. IMPLEMENT STUB
+void NotificationImageCacheStub::NotificationImageCacheConstructor(const QString &path) {
+  Q_UNUSED(path);
+
+}
+void NotificationImageCacheStub::NotificationImageCacheDestructor() {
+
+}
+QString NotificationImageCacheStub::store(const QVariant &imageData) {
+  QList<ParameterBase*> params;
+  params.append( new Parameter<const QVariant & >(imageData));
+  stubMethodEntered("store",params);
+  return stubReturnValue<QString>("store");
+}
+
+bool NotificationImageCacheStub::contains(const QString &path) {
+  QList<ParameterBase*> params;
+  params.append( new Parameter<const QString & >(path));
+  stubMethodEntered("contains",params);
+  return stubReturnValue<bool>("contains");
+}
+
+void NotificationImageCacheStub::addReference(const QString &path) {
+  QList<ParameterBase*> params;
+  params.append( new Parameter<const QString & >(path));
+  stubMethodEntered("addReference",params);
+}
+
+void NotificationImageCacheStub::releaseReference(const QString &path) {
+  QList<ParameterBase*> params;
+  params.append( new Parameter<const QString & >(path));
+  stubMethodEntered("releaseReference",params);
+}
+
+void NotificationImageCacheStub::removeUnreferencedImages() {
+  stubMethodEntered("removeUnreferencedImages");
+}
+
+void NotificationImageCacheStub::waitForFileOperations() {
+  stubMethodEntered("waitForFileOperations");
+}
+
+
+
+// 3. CREATE A STUB INSTANCE
+NotificationImageCacheStub gDefaultNotificationImageCacheStub;
+NotificationImageCacheStub* gNotificationImageCacheStub = &gDefaultNotificationImageCacheStub;
+
+
+// 4. CREATE A PROXY WHICH CALLS THE STUB
+NotificationImageCache::NotificationImageCache(const QString &path) {
+  gNotificationImageCacheStub->NotificationImageCacheConstructor(path);
+}
+
+NotificationImageCache::~NotificationImageCache() {
+  gNotificationImageCacheStub->NotificationImageCacheDestructor();
+}
+
+QString NotificationImageCache::store(const QVariant &imageData) {
+  return gNotificationImageCacheStub->store(imageData);
+}
+
+bool NotificationImageCache::contains(const QString &path) const {
+  return gNotificationImageCacheStub->contains(path);
+}
+
+void NotificationImageCache::addReference(const QString &path) {
+  gNotificationImageCacheStub->addReference(path);
+}
+
+void NotificationImageCache::releaseReference(const QString &path) {
+  gNotificationImageCacheStub->releaseReference(path);
+}
+
+void NotificationImageCache::removeUnreferencedImages() {
+  gNotificationImageCacheStub->removeUnreferencedImages();
+}
+
+void NotificationImageCache::waitForFileOperations() {
+  gNotificationImageCacheStub->waitForFileOperations();
+}
+
+
+#endif
@@ -26,7 +26,6 @@ class NotificationListModelStub : public StubBase {
   virtual void NotificationListModelConstructor(QObject *parent);
   virtual void NotificationListModelDestructor();
   virtual void updateNotification(uint id);
-  virtual void removeNotification(uint id);
 }; 
 
 // 2. IMPLEMENT STUB
@@ -43,11 +42,6 @@ void NotificationListModelStub::updateNotification(uint id) {
   stubMethodEntered("updateNotification",params);
 }
 
-void NotificationListModelStub::removeNotification(uint id) {
-  QList<ParameterBase*> params;
-  params.append( new Parameter<uint >(id));
-  stubMethodEntered("removeNotification",params);
-}
 
 
 
@@ -69,9 +63,6 @@ void NotificationListModel::updateNotification(uint id) {
   gNotificationListModelStub->updateNotification(id);
 }
 
-void NotificationListModel::removeNotification(uint id) {
-  gNotificationListModelStub->removeNotification(id);
-}
 
 
 #endif
@@ -16,6 +16,7 @@
 #define NOTIFICATIONMANAGER_STUB
 
 #include "notificationmanager.h"
+#include "notificationdatabase.h"
 #include <stubbase.h>
 
 
@@ -33,13 +34,22 @@ class NotificationManagerStub : public StubBase {
   virtual void MarkNotificationDisplayed(uint id);
   virtual QString GetServerInformation(QString &name, QString &vendor, QString &version);
   virtual NotificationList GetNotifications(const QString &appName);
-  virtual void removeNotificationsWithCategory(const QString &category);
-  virtual void updateNotificationsWithCategory(const QString &category);
-  virtual void commit();
+  virtual void removeNotificationsWithCategories(const QStringList &categories);
+  virtual void updateNotificationsWithCategories(const QStringList &categories);
+  virtual QList<uint> notificationIdsWithCategory(const QString &category);
+  virtual void destroyRemovedNotifications();
+  virtual void destroyRemovedNotificationsIfIdle();
+  virtual void scheduleMaintenance();
+  virtual void performMaintenance();
+  virtual void flushChangeJournal();
   virtual void invokeAction(const QString &action);
   virtual void removeNotificationIfUserRemovable(uint id);
   virtual void removeUserRemovableNotifications();
   virtual void expire();
+  virtual void restoreNextNotifications();
+  virtual void processDeferredNotifications();
+  virtual void handleSenderPidReply(QDBusPendingCallWatcher *watcher);
+  virtual void removeSenderIdentity(const QString &sender);
   virtual void NotificationManagerConstructor(QObject *parent);
   virtual void NotificationManagerDestructor();
 }; 
@@ -110,20 +120,43 @@ NotificationList NotificationManagerStub::GetNotifications(const QString &appNam
   return stubReturnValue<NotificationList>("GetNotifications");
 }
 
-void NotificationManagerStub::removeNotificationsWithCategory(const QString &category) {
+void NotificationManagerStub::removeNotificationsWithCategories(const QStringList &categories) {
   QList<ParameterBase*> params;
-  params.append( new Parameter<QString >(category));
-  stubMethodEntered("removeNotificationsWithCategory",params);
+  params.append( new Parameter<QStringList >(categories));
+  stubMethodEntered("removeNotificationsWithCategories",params);
 }
 
-void NotificationManagerStub::updateNotificationsWithCategory(const QString &category) {
+void NotificationManagerStub::updateNotificationsWithCategories(const QStringList &categories) {
+  QList<ParameterBase*> params;
+  params.append( new Parameter<QStringList >(categories));
+  stubMethodEntered("updateNotificationsWithCategories",params);
+}
+
+QList<uint> NotificationManagerStub::notificationIdsWithCategory(const QString &category) {
   QList<ParameterBase*> params;
   params.append( new Parameter<QString >(category));
-  stubMethodEntered("updateNotificationsWithCategory",params);
+  stubMethodEntered("notificationIdsWithCategory",params);
+  return stubReturnValue<QList<uint> >("notificationIdsWithCategory");
+}
+
+void NotificationManagerStub::destroyRemovedNotifications() {
+  stubMethodEntered("destroyRemovedNotifications");
+}
+
+void NotificationManagerStub::destroyRemovedNotificationsIfIdle() {
+  stubMethodEntered("destroyRemovedNotificationsIfIdle");
+}
+
+void NotificationManagerStub::scheduleMaintenance() {
+  stubMethodEntered("scheduleMaintenance");
 }
 
-void NotificationManagerStub::commit() {
-  stubMethodEntered("commit");
+void NotificationManagerStub::performMaintenance() {
+  stubMethodEntered("performMaintenance");
+}
+
+void NotificationManagerStub::flushChangeJournal() {
+  stubMethodEntered("flushChangeJournal");
 }
 
 void NotificationManagerStub::invokeAction(const QString &action) {
@@ -147,6 +180,26 @@ void NotificationManagerStub::expire() {
   stubMethodEntered("expire");
 }
 
+void NotificationManagerStub::restoreNextNotifications() {
+  stubMethodEntered("restoreNextNotifications");
+}
+
+void NotificationManagerStub::processDeferredNotifications() {
+  stubMethodEntered("processDeferredNotifications");
+}
+
+void NotificationManagerStub::handleSenderPidReply(QDBusPendingCallWatcher *watcher) {
+  QList<ParameterBase*> params;
+  params.append( new Parameter<QDBusPendingCallWatcher * >(watcher));
+  stubMethodEntered("handleSenderPidReply",params);
+}
+
+void NotificationManagerStub::removeSenderIdentity(const QString &sender) {
+  QList<ParameterBase*> params;
+  params.append( new Parameter<QString >(sender));
+  stubMethodEntered("removeSenderIdentity",params);
+}
+
 void NotificationManagerStub::NotificationManagerConstructor(QObject *parent) {
   Q_UNUSED(parent);
 
@@ -180,6 +233,7 @@ const char *NotificationManager::HINT_USER_REMOVABLE = "x-nemo-user-removable";
 const char *NotificationManager::HINT_LED_DISABLED_WITHOUT_BODY_AND_SUMMARY = "x-nemo-led-disabled-without-body-and-summary";
 const char *NotificationManager::HINT_ORIGIN = "x-nemo-origin";
 const char *NotificationManager::HINT_OWNER = "x-nemo-owner";
+const char *NotificationManager::HINT_VOLATILE = "x-nemo-volatile";
 
 NotificationManager *NotificationManager::instance_ = 0;
 NotificationManager * NotificationManager::instance() {
@@ -221,16 +275,36 @@ NotificationList NotificationManager::GetNotifications(const QString &appName) {
   return gNotificationManagerStub->GetNotifications(appName);
 }
 
-void NotificationManager::removeNotificationsWithCategory(const QString &category) {
-  gNotificationManagerStub->removeNotificationsWithCategory(category);
+void NotificationManager::removeNotificationsWithCategories(const QStringList &categories) {
+  gNotificationManagerStub->removeNotificationsWithCategories(categories);
+}
+
+void NotificationManager::updateNotificationsWithCategories(const QStringList &categories) {
+  gNotificationManagerStub->updateNotificationsWithCategories(categories);
+}
+
+QList<uint> NotificationManager::notificationIdsWithCategory(const QString &category) {
+  return gNotificationManagerStub->notificationIdsWithCategory(category);
+}
+
+void NotificationManager::destroyRemovedNotifications() {
+  gNotificationManagerStub->destroyRemovedNotifications();
+}
+
+void NotificationManager::destroyRemovedNotificationsIfIdle() {
+  gNotificationManagerStub->destroyRemovedNotificationsIfIdle();
 }
 
-void NotificationManager::updateNotificationsWithCategory(const QString &category) {
-  gNotificationManagerStub->updateNotificationsWithCategory(category);
+void NotificationManager::scheduleMaintenance() {
+  gNotificationManagerStub->scheduleMaintenance();
 }
 
-void NotificationManager::commit() {
-  gNotificationManagerStub->commit();
+void NotificationManager::performMaintenance() {
+  gNotificationManagerStub->performMaintenance();
+}
+
+void NotificationManager::flushChangeJournal() {
+  gNotificationManagerStub->flushChangeJournal();
 }
 
 void NotificationManager::invokeAction(const QString &action) {
@@ -249,6 +323,22 @@ void NotificationManager::expire() {
   gNotificationManagerStub->expire();
 }
 
+void NotificationManager::restoreNextNotifications() {
+  gNotificationManagerStub->restoreNextNotifications();
+}
+
+void NotificationManager::processDeferredNotifications() {
+  gNotificationManagerStub->processDeferredNotifications();
+}
+
+void NotificationManager::handleSenderPidReply(QDBusPendingCallWatcher *watcher) {
+  gNotificationManagerStub->handleSenderPidReply(watcher);
+}
+
+void NotificationManager::removeSenderIdentity(const QString &sender) {
+  gNotificationManagerStub->removeSenderIdentity(sender);
+}
+
 NotificationManager::NotificationManager(QObject *parent) {
   gNotificationManagerStub->NotificationManagerConstructor(parent);
 }
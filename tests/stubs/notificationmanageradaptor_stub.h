@@ -30,6 +30,11 @@ class NotificationManagerAdaptorStub : public StubBase {
   virtual QString GetServerInformation(QString &name, QString &vendor, QString &version);
   virtual uint Notify(const QString &app_name, uint replaces_id, const QString &app_icon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expire_timeout);
   virtual NotificationList GetNotifications(const QString &app_name);
+  virtual QList<uint> NotifyMany(const NotificationList &notifications);
+  virtual void CloseNotifications(const QList<uint> &ids);
+  virtual NotificationList GetNotificationsSince(qulonglong serial, QList<uint> &removed_ids, qulonglong &current_serial, bool &complete);
+  virtual QVariantHash GetNotificationStatistics();
+  virtual QVariantHash GetApplicationNotificationCounts();
 };
 
 // 2. IMPLEMENT STUB
@@ -81,6 +86,39 @@ NotificationList NotificationManagerAdaptorStub::GetNotifications(const QString
   return stubReturnValue<NotificationList >("GetNotifications");
 }
 
+QList<uint> NotificationManagerAdaptorStub::NotifyMany(const NotificationList &notifications) {
+  QList<ParameterBase*> params;
+  params.append( new Parameter<NotificationList >(notifications));
+  stubMethodEntered("NotifyMany",params);
+  return stubReturnValue<QList<uint> >("NotifyMany");
+}
+
+void NotificationManagerAdaptorStub::CloseNotifications(const QList<uint> &ids) {
+  QList<ParameterBase*> params;
+  params.append( new Parameter<QList<uint> >(ids));
+  stubMethodEntered("CloseNotifications",params);
+}
+
+NotificationList NotificationManagerAdaptorStub::GetNotificationsSince(qulonglong serial, QList<uint> &removed_ids, qulonglong &current_serial, bool &complete) {
+  QList<ParameterBase*> params;
+  params.append( new Parameter<qulonglong >(serial));
+  params.append( new Parameter<QList<uint> & >(removed_ids));
+  params.append( new Parameter<qulonglong & >(current_serial));
+  params.append( new Parameter<bool & >(complete));
+  stubMethodEntered("GetNotificationsSince",params);
+  return stubReturnValue<NotificationList >("GetNotificationsSince");
+}
+
+QVariantHash NotificationManagerAdaptorStub::GetNotificationStatistics() {
+  stubMethodEntered("GetNotificationStatistics");
+  return stubReturnValue<QVariantHash>("GetNotificationStatistics");
+}
+
+QVariantHash NotificationManagerAdaptorStub::GetApplicationNotificationCounts() {
+  stubMethodEntered("GetApplicationNotificationCounts");
+  return stubReturnValue<QVariantHash>("GetApplicationNotificationCounts");
+}
+
 
 
 // 3. CREATE A STUB INSTANCE
@@ -117,5 +155,25 @@ NotificationList NotificationManagerAdaptor::GetNotifications(const QString &app
   return gNotificationManagerAdaptorStub->GetNotifications(app_name);
 }
 
+QList<uint> NotificationManagerAdaptor::NotifyMany(const NotificationList &notifications) {
+  return gNotificationManagerAdaptorStub->NotifyMany(notifications);
+}
+
+void NotificationManagerAdaptor::CloseNotifications(const QList<uint> &ids) {
+  gNotificationManagerAdaptorStub->CloseNotifications(ids);
+}
+
+NotificationList NotificationManagerAdaptor::GetNotificationsSince(qulonglong serial, QList<uint> &removed_ids, qulonglong &current_serial, bool &complete) {
+  return gNotificationManagerAdaptorStub->GetNotificationsSince(serial, removed_ids, current_serial, complete);
+}
+
+QVariantHash NotificationManagerAdaptor::GetNotificationStatistics() {
+  return gNotificationManagerAdaptorStub->GetNotificationStatistics();
+}
+
+QVariantHash NotificationManagerAdaptor::GetApplicationNotificationCounts() {
+  return gNotificationManagerAdaptorStub->GetApplicationNotificationCounts();
+}
+
 
 #endif
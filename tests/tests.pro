@@ -1,5 +1,6 @@
 TEMPLATE = subdirs
 SUBDIRS = \
+          bm_notificationmanager \
           ut_batterynotifier \
           ut_categorydefinitionstore \
           ut_closeeventeater \
@@ -10,9 +11,12 @@ SUBDIRS = \
           ut_lowbatterynotifier \
           ut_lipsticknotification \
           ut_notificationfeedbackplayer \
+          ut_notificationdatabase \
+          ut_notificationimagecache \
           ut_notificationlistmodel \
           ut_notificationmanager \
           ut_notificationpreviewpresenter \
+          ut_qmstatemirror \
           ut_qobjectlistmodel \
           ut_screenlock \
           ut_shutdownscreen \
@@ -24,6 +24,8 @@ QStringList categoryDefinitionFilesList;
 QMap<QString, QMap<QString, QString> > categoryDefinitionSettingsMap;
 // Size of the category definition file
 uint categoryDefinitionFileSize;
+// Number of times category definition files have been parsed
+int categoryDefinitionParseCount;
 
 // QFileSystemWatcher stubs
 bool QFileSystemWatcher::addPath(const QString &)
@@ -56,6 +58,7 @@ QStringList QDir::entryList(const QStringList &, Filters, SortFlags) const
 // Stubs of QSettings methods
 QStringList QSettings::allKeys() const
 {
+    categoryDefinitionParseCount++;
     return QStringList(categoryDefinitionSettingsMap.value(QFileInfo(fileName()).baseName()).keys());
 }
 
@@ -78,6 +81,7 @@ void Ut_CategoryDefinitionStore::init()
     categoryDefinitionFilesList.clear();
     categoryDefinitionSettingsMap.clear();
     categoryDefinitionFileSize = 100;
+    categoryDefinitionParseCount = 0;
 }
 
 void Ut_CategoryDefinitionStore::cleanup()
@@ -176,26 +180,129 @@ void Ut_CategoryDefinitionStore::testCategoryDefinitionUninstalling()
     categoryDefinitionFilesList.append("smsCategoryDefinition.conf");
 
     store = new CategoryDefinitionStore("/categorydefinitionpath");
-    QSignalSpy uninstallSpy(store, SIGNAL(categoryDefinitionUninstalled(QString)));
-    connect(this, SIGNAL(directoryChanged(QString)), store, SLOT(updateCategoryDefinitionFileList()));
+    QSignalSpy uninstallSpy(store, SIGNAL(categoryDefinitionsUninstalled(QStringList)));
+    connect(this, SIGNAL(directoryChanged(QString)), store, SLOT(scheduleCategoryDefinitionFileListUpdate()));
 
     // Add new category definition file
     categoryDefinitionFilesList.append("chatCategoryDefinition.conf");
     emit directoryChanged("/categorydefinitionpath");
+    QMetaObject::invokeMethod(store, "processCategoryDefinitionChanges");
     QCOMPARE(uninstallSpy.count(), 0);
     QCOMPARE(store->categoryDefinitionExists("chatCategoryDefinition"), true);
 
     // Remove the added category definition file
     categoryDefinitionFilesList.removeOne("chatCategoryDefinition.conf");
     emit directoryChanged("/categorydefinitionpath");
+    QMetaObject::invokeMethod(store, "processCategoryDefinitionChanges");
     QCOMPARE(uninstallSpy.count(), 1);
+    QCOMPARE(uninstallSpy.last().at(0).toStringList(), QStringList() << "chatCategoryDefinition");
     QCOMPARE(store->categoryDefinitionExists("chatCategoryDefinition"), false);
 
     // Remove the existing category definition file
     categoryDefinitionFilesList.removeOne("smsCategoryDefinition.conf");
     emit directoryChanged("/categorydefinitionpath");
+    QMetaObject::invokeMethod(store, "processCategoryDefinitionChanges");
     QCOMPARE(uninstallSpy.count(), 2);
+    QCOMPARE(uninstallSpy.last().at(0).toStringList(), QStringList() << "smsCategoryDefinition");
     QCOMPARE(store->categoryDefinitionExists("smsCategoryDefinition"), false);
 }
 
+void Ut_CategoryDefinitionStore::testCategoryDefinitionIsParsedOnce()
+{
+    categoryDefinitionFilesList.append("smsCategoryDefinition.conf");
+    QMap<QString, QString> smsSettingsMap;
+    smsSettingsMap.insert("iconId", "sms-icon");
+    categoryDefinitionSettingsMap.insert("smsCategoryDefinition", smsSettingsMap);
+
+    store = new CategoryDefinitionStore("/categorydefinitionpath");
+
+    // Check that the file is parsed only when the category is first used
+    QCOMPARE(categoryDefinitionParseCount, 0);
+    QCOMPARE(store->value("smsCategoryDefinition", "iconId"), QString("sms-icon"));
+    QCOMPARE(store->contains("smsCategoryDefinition", "iconId"), true);
+    QCOMPARE(store->categoryParameters("smsCategoryDefinition").value("iconId"), QString("sms-icon"));
+    QCOMPARE(store->allKeys("smsCategoryDefinition").count(), 1);
+    QCOMPARE(categoryDefinitionParseCount, 1);
+
+    // Check that categories without a definition file are not looked up from the file system
+    QCOMPARE(store->categoryDefinitionExists("idontexist"), false);
+    QCOMPARE(categoryDefinitionParseCount, 1);
+
+    // Check that the file is parsed again when it changes
+    smsSettingsMap.insert("iconId", "new-sms-icon");
+    categoryDefinitionSettingsMap.insert("smsCategoryDefinition", smsSettingsMap);
+    QSignalSpy modifiedSpy(store, SIGNAL(categoryDefinitionsModified(QStringList)));
+    QMetaObject::invokeMethod(store, "scheduleCategoryDefinitionFileUpdate", Q_ARG(QString, "/categorydefinitionpath/smsCategoryDefinition.conf"));
+    QMetaObject::invokeMethod(store, "processCategoryDefinitionChanges");
+    QCOMPARE(modifiedSpy.count(), 1);
+    QCOMPARE(categoryDefinitionParseCount, 2);
+    QCOMPARE(store->value("smsCategoryDefinition", "iconId"), QString("new-sms-icon"));
+    QCOMPARE(categoryDefinitionParseCount, 2);
+}
+
+void Ut_CategoryDefinitionStore::testCategoryDefinitionChangesAreBatched()
+{
+    categoryDefinitionFilesList << "smsCategoryDefinition.conf" << "emailCategoryDefinition.conf" << "chatCategoryDefinition.conf";
+
+    store = new CategoryDefinitionStore("/categorydefinitionpath");
+    QSignalSpy modifiedSpy(store, SIGNAL(categoryDefinitionsModified(QStringList)));
+    QSignalSpy uninstallSpy(store, SIGNAL(categoryDefinitionsUninstalled(QStringList)));
+
+    // Modify two files, one of them twice, and remove the third one
+    QMetaObject::invokeMethod(store, "scheduleCategoryDefinitionFileUpdate", Q_ARG(QString, "/categorydefinitionpath/smsCategoryDefinition.conf"));
+    QMetaObject::invokeMethod(store, "scheduleCategoryDefinitionFileUpdate", Q_ARG(QString, "/categorydefinitionpath/emailCategoryDefinition.conf"));
+    QMetaObject::invokeMethod(store, "scheduleCategoryDefinitionFileUpdate", Q_ARG(QString, "/categorydefinitionpath/smsCategoryDefinition.conf"));
+    categoryDefinitionFilesList.removeOne("chatCategoryDefinition.conf");
+    QMetaObject::invokeMethod(store, "scheduleCategoryDefinitionFileListUpdate");
+    QCOMPARE(modifiedSpy.count(), 0);
+    QCOMPARE(uninstallSpy.count(), 0);
+
+    // Check that the changes are reported in one batch when processed
+    QMetaObject::invokeMethod(store, "processCategoryDefinitionChanges");
+    QCOMPARE(modifiedSpy.count(), 1);
+    QCOMPARE(modifiedSpy.last().at(0).toStringList().toSet(), QSet<QString>() << "smsCategoryDefinition" << "emailCategoryDefinition");
+    QCOMPARE(uninstallSpy.count(), 1);
+    QCOMPARE(uninstallSpy.last().at(0).toStringList(), QStringList() << "chatCategoryDefinition");
+
+    // Check that nothing is reported again
+    QMetaObject::invokeMethod(store, "processCategoryDefinitionChanges");
+    QCOMPARE(modifiedSpy.count(), 1);
+    QCOMPARE(uninstallSpy.count(), 1);
+}
+
+void Ut_CategoryDefinitionStore::testUnreadableCategoryDefinitionIsUninstalled()
+{
+    categoryDefinitionFilesList << "smsCategoryDefinition.conf";
+    QMap<QString, QString> smsSettingsMap;
+    smsSettingsMap.insert("iconId", "sms-icon");
+    categoryDefinitionSettingsMap.insert("smsCategoryDefinition", smsSettingsMap);
+
+    store = new CategoryDefinitionStore("/categorydefinitionpath");
+    QCOMPARE(store->value("smsCategoryDefinition", "iconId"), QString("sms-icon"));
+    QSignalSpy modifiedSpy(store, SIGNAL(categoryDefinitionsModified(QStringList)));
+    QSignalSpy uninstallSpy(store, SIGNAL(categoryDefinitionsUninstalled(QStringList)));
+
+    // Check that a definition file which becomes empty is reported as uninstalled and its old parameters are forgotten
+    categoryDefinitionFileSize = 0;
+    QMetaObject::invokeMethod(store, "scheduleCategoryDefinitionFileUpdate", Q_ARG(QString, "/categorydefinitionpath/smsCategoryDefinition.conf"));
+    QMetaObject::invokeMethod(store, "processCategoryDefinitionChanges");
+    QCOMPARE(modifiedSpy.count(), 0);
+    QCOMPARE(uninstallSpy.count(), 1);
+    QCOMPARE(uninstallSpy.last().at(0).toStringList(), QStringList() << "smsCategoryDefinition");
+    QCOMPARE(store->categoryDefinitionExists("smsCategoryDefinition"), false);
+}
+
+void Ut_CategoryDefinitionStore::testNewCategoryDefinitionIsAvailableBeforeChangesAreProcessed()
+{
+    store = new CategoryDefinitionStore("/categorydefinitionpath");
+
+    // Check that a category installed while changes are being collected can be used right away
+    categoryDefinitionFilesList << "chatCategoryDefinition.conf";
+    QMap<QString, QString> chatSettingsMap;
+    chatSettingsMap.insert("iconId", "chat-icon");
+    categoryDefinitionSettingsMap.insert("chatCategoryDefinition", chatSettingsMap);
+    QMetaObject::invokeMethod(store, "scheduleCategoryDefinitionFileListUpdate");
+    QCOMPARE(store->value("chatCategoryDefinition", "iconId"), QString("chat-icon"));
+}
+
 QTEST_APPLESS_MAIN(Ut_CategoryDefinitionStore)
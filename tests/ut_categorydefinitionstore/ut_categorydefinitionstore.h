@@ -32,6 +32,10 @@ private slots:
     void testCategoryDefinitionSettingsValues();
     void testCategoryDefinitionStoreMaxFileSizeHandling();
     void testCategoryDefinitionUninstalling();
+    void testCategoryDefinitionIsParsedOnce();
+    void testCategoryDefinitionChangesAreBatched();
+    void testUnreadableCategoryDefinitionIsUninstalled();
+    void testNewCategoryDefinitionIsAvailableBeforeChangesAreProcessed();
 
 private:
     CategoryDefinitionStore *store;
@@ -125,12 +125,10 @@ void Ut_DiskSpaceNotifier::testConstruction()
     delete m_subject;
 
     // Check that the constructor destroys only any previous notifications of type x-nemo.system.diskspace
-    QVariantHash hints;
-    hints.insert(NotificationManager::HINT_CATEGORY, "x-nemo.system.diskspace");
-    LipstickNotification notification(qApp->applicationName(), 1, QString(), QString(), QString(), QStringList(), hints, -1);
-    gNotificationManagerStub->stubSetReturnValue("notificationIds", QList<uint>() << 1u << 1u);
-    gNotificationManagerStub->stubSetReturnValue("notification", &notification);
+    gNotificationManagerStub->stubSetReturnValue("notificationIdsWithCategory", QList<uint>() << 1u << 1u);
     m_subject = new DiskSpaceNotifier();
+    QCOMPARE(gNotificationManagerStub->stubCallCount("notificationIdsWithCategory"), 1);
+    QCOMPARE(gNotificationManagerStub->stubLastCallTo("notificationIdsWithCategory").parameter<QString>(0), QString("x-nemo.system.diskspace"));
     QCOMPARE(gNotificationManagerStub->stubCallCount("CloseNotification"), 2);
 }
 
@@ -14,6 +14,7 @@
 ****************************************************************************/
 
 #include <QtTest/QtTest>
+#include <malloc.h>
 #include "qdbusargument_fake.h"
 #include "ut_lipsticknotification.h"
 #include "lipsticknotification.h"
@@ -233,4 +234,144 @@ void Ut_Notification::testSerialization()
     QCOMPARE(n2.timestamp(), n1.timestamp());
 }
 
+void Ut_Notification::testHintValuesFollowHints()
+{
+    QVariantHash hints;
+    hints.insert(NotificationManager::HINT_CATEGORY, "category");
+    hints.insert("x-nemo.testing.custom-hint-value", 1);
+    LipstickNotification notification(QString(), 0, QString(), QString(), QString(), QStringList(), hints, 0);
+    QCOMPARE(notification.hintValues().keys(), QStringList() << "x-nemo.testing.custom-hint-value");
+
+    hints.insert("x-nemo.testing.custom-hint-value", 2);
+    hints.insert(NotificationManager::HINT_OWNER, "owner");
+    notification.setHints(hints);
+    QCOMPARE(notification.hintValues().keys(), QStringList() << "x-nemo.testing.custom-hint-value");
+    QCOMPARE(notification.hintValues().value("x-nemo.testing.custom-hint-value").toInt(), 2);
+    QCOMPARE(notification.owner(), QString("owner"));
+}
+
+void Ut_Notification::testRemoteActionsFollowActions()
+{
+    QVariantHash hints;
+    hints.insert(NotificationManager::HINT_REMOTE_ACTION_PREFIX + QStringLiteral("default"), "service path iface method");
+    LipstickNotification notification(QString(), 0, QString(), QString(), QString(), QStringList(), hints, 0);
+    QCOMPARE(notification.remoteActions().count(), 0);
+
+    notification.setActions(QStringList() << "default" << "Default");
+    QCOMPARE(notification.remoteActions().count(), 1);
+    QVariantMap action(notification.remoteActions().at(0).toMap());
+    QCOMPARE(action.value("name").toString(), QString("default"));
+    QCOMPARE(action.value("displayName").toString(), QString("Default"));
+    QCOMPARE(action.value("method").toString(), QString("method"));
+}
+
+// Returns the key of the given hint as stored by the notification
+static QString storedHintKey(const LipstickNotification &notification, const QString &hint)
+{
+    const QVariantHash hints(notification.hints());
+    return hints.constFind(hint).key();
+}
+
+void Ut_Notification::testWellKnownHintKeysAreShared()
+{
+    // Build the keys at run time so that the hashes don't share them to begin with
+    const QString category(QString(NotificationManager::HINT_CATEGORY).toUpper().toLower());
+    const QString custom(QString("x-nemo.testing.custom-hint").toUpper().toLower());
+    QVariantHash hints1;
+    hints1.insert(category, "category");
+    hints1.insert(custom, 1);
+    QVariantHash hints2;
+    hints2.insert(QString(category).toUpper().toLower(), "category");
+    hints2.insert(QString(custom).toUpper().toLower(), 2);
+    LipstickNotification notification1(QString(), 0, QString(), QString(), QString(), QStringList(), hints1, 0);
+    LipstickNotification notification2(QString(), 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    notification2.setHints(hints2);
+
+    // Check that the keys of the well-known hints are shared but the ones chosen by the sender are not
+    QCOMPARE(storedHintKey(notification1, category).constData(), storedHintKey(notification2, category).constData());
+    QVERIFY(storedHintKey(notification1, custom).constData() != storedHintKey(notification2, custom).constData());
+    QCOMPARE(notification2.category(), QString("category"));
+    QCOMPARE(notification2.hints().value(custom).toInt(), 2);
+}
+
+void Ut_Notification::benchmarkAccessors()
+{
+    QVariantHash hints;
+    hints.insert(NotificationManager::HINT_TIMESTAMP, "2012-10-01 18:04:19");
+    hints.insert(NotificationManager::HINT_CATEGORY, "category");
+    hints.insert(NotificationManager::HINT_URGENCY, 1);
+    hints.insert(NotificationManager::HINT_PRIORITY, 100);
+    hints.insert(NotificationManager::HINT_REMOTE_ACTION_PREFIX + QStringLiteral("default"), "service path iface method");
+    for (int i = 0; i < 10; ++i) {
+        hints.insert(QString("x-nemo.testing.hint%1").arg(i), i);
+    }
+    LipstickNotification notification(QString(), 0, QString(), QString(), QString(), QStringList() << "default" << "Default", hints, 0);
+
+    QBENCHMARK {
+        notification.timestamp();
+        notification.category();
+        notification.urgency();
+        notification.priority();
+        notification.remoteActions();
+        notification.hintValues();
+    }
+}
+
+// Returns hints like those demarshalled from a D-Bus call, so that no data is shared with other notifications
+static QVariantHash typicalHints(int index)
+{
+    QVariantHash hints;
+    hints.insert(NotificationManager::HINT_TIMESTAMP, QString("2012-10-01 18:04:%1").arg(index % 60, 2, 10, QChar('0')));
+    hints.insert(NotificationManager::HINT_CATEGORY, QString("x-nemo.email"));
+    hints.insert(NotificationManager::HINT_ICON, QString("icon-lock-email%1").arg(index));
+    hints.insert(NotificationManager::HINT_PREVIEW_SUMMARY, QString("Preview summary %1").arg(index));
+    hints.insert(NotificationManager::HINT_PREVIEW_BODY, QString("Preview body %1").arg(index));
+    hints.insert(NotificationManager::HINT_URGENCY, 1);
+    hints.insert(NotificationManager::HINT_ITEM_COUNT, index);
+    hints.insert(NotificationManager::HINT_PRIORITY, 100);
+    hints.insert(NotificationManager::HINT_REMOTE_ACTION_PREFIX + QStringLiteral("default"), QString("service path iface method%1").arg(index));
+    hints.insert(QString("x-nemo.testing.hint"), index);
+    return hints;
+}
+
+void Ut_Notification::benchmarkSetHints()
+{
+    LipstickNotification notification("appName", 1, "appIcon", "summary", "body", QStringList() << "default" << "Open", typicalHints(0), 0);
+
+    // Setting the hints of another notification is the common case when updating a notification
+    const QVariantHash hints(LipstickNotification("appName", 2, "appIcon", "summary", "body", QStringList(), typicalHints(1), 0).hints());
+    QBENCHMARK {
+        notification.setHints(hints);
+    }
+}
+
+void Ut_Notification::benchmarkMemoryUsage_data()
+{
+    QTest::addColumn<bool>("notifications");
+    QTest::newRow("hints only") << false;
+    QTest::newRow("notifications") << true;
+}
+
+void Ut_Notification::benchmarkMemoryUsage()
+{
+    QFETCH(bool, notifications);
+    const int count = 1000;
+
+    // Report the heap used per notification; the hints alone are the baseline for the parsed members and caches
+    QList<QVariantHash> hintList;
+    QList<LipstickNotification *> notificationList;
+    const int before = mallinfo().uordblks;
+    for (int i = 0; i < count; ++i) {
+        if (notifications) {
+            notificationList.append(new LipstickNotification("appName", i + 1, "appIcon", "summary", "body", QStringList() << "default" << "Open", typicalHints(i), 0));
+        } else {
+            hintList.append(typicalHints(i));
+        }
+    }
+    const int after = mallinfo().uordblks;
+    QTest::setBenchmarkResult(qreal(after - before) / count, QTest::BytesAllocated);
+
+    qDeleteAll(notificationList);
+}
+
 QTEST_MAIN(Ut_Notification)
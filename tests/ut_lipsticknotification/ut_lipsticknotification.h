@@ -27,6 +27,13 @@ private slots:
     void testIcon();
     void testSignals();
     void testSerialization();
+    void testHintValuesFollowHints();
+    void testRemoteActionsFollowActions();
+    void testWellKnownHintKeysAreShared();
+    void benchmarkAccessors();
+    void benchmarkSetHints();
+    void benchmarkMemoryUsage_data();
+    void benchmarkMemoryUsage();
 };
 
 #endif
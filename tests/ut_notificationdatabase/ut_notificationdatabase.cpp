@@ -0,0 +1,751 @@
+/***************************************************************************
+**
+** Copyright (C) 2012 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include "ut_notificationdatabase.h"
+#include "notificationdatabase.h"
+#include "notificationmanager_stub.h"
+#include <QSqlQuery>
+#include <QSqlTableModel>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <sys/statfs.h>
+
+const static uint DISK_SPACE_NEEDED = 1024;
+
+unsigned long diskSpaceAvailableKb;
+bool diskSpaceChecked;
+int statfs (const char *, struct statfs *st)
+{
+    st->f_bsize = 4096;
+    st->f_bavail = (diskSpaceAvailableKb * 1024) / st->f_bsize;
+    diskSpaceChecked = true;
+    return 0;
+}
+
+// QDir stubs
+bool qDirRemoveCalled;
+bool QDir::remove(const QString &) {
+    return qDirRemoveCalled = true;
+}
+
+// QSqlDatabase stubs
+QString qSqlDatabaseAddDatabaseType = QString();
+QSqlDatabase qSqlDatabaseInstance;
+QSqlDatabase QSqlDatabase::addDatabase (const QString & type, const QString&)
+{
+    qSqlDatabaseAddDatabaseType = type;
+    return qSqlDatabaseInstance;
+}
+
+QString qSqlDatabaseDatabaseName = QString();
+void QSqlDatabase::setDatabaseName(const QString& name)
+{
+    qSqlDatabaseDatabaseName = name;
+}
+
+bool qSqlDatabaseOpenSucceeds = true;
+bool qSqlIterateOpenSuccess = false;
+int qSqlDatabaseOpenCalledCount = 0;
+bool QSqlDatabase::open()
+{
+    bool success = qSqlDatabaseOpenSucceeds;
+
+    // Change to negation for the next call
+    if (qSqlIterateOpenSuccess) {
+        qSqlDatabaseOpenSucceeds = !success;
+    }
+    qSqlDatabaseOpenCalledCount++;
+
+    return success;
+}
+
+bool QSqlDatabase::isOpen() const
+{
+    return (qSqlDatabaseOpenCalledCount > 0);
+}
+
+QStringList qSqlDatabaseExec;
+QSqlQuery QSqlDatabase::exec(const QString& query) const
+{
+    qSqlDatabaseExec << query;
+    return QSqlQuery();
+}
+
+int qSqlDatabaseTransactionCount = 0;
+bool QSqlDatabase::transaction()
+{
+    qSqlDatabaseTransactionCount++;
+    return true;
+}
+
+bool qSqlDatabaseCommitCalled = false;
+int qSqlDatabaseCommitCount = 0;
+bool QSqlDatabase::commit()
+{
+    qSqlDatabaseCommitCalled = true;
+    qSqlDatabaseCommitCount++;
+    return true;
+}
+
+// QSqlQuery stubs
+QStringList qSqlQueryExecQuery = QStringList();
+int qSqlQueryIndex = -1;
+QSqlQuery::QSqlQuery(const QString& query, QSqlDatabase)
+{
+    if (!query.isEmpty()) {
+        qSqlQueryExecQuery << query;
+    }
+    qSqlQueryIndex = -1;
+}
+
+QSqlQuery::~QSqlQuery()
+{
+}
+
+bool QSqlQuery::exec(const QString& query)
+{
+    qSqlQueryExecQuery << query;
+    qSqlQueryIndex = -1;
+    return true;
+}
+
+QHash<const QSqlQuery *, QString> qSqlQueryPreparedQuery;
+QStringList qSqlQueryExecPrepared = QStringList();
+QThread *qSqlQueryExecThread = 0;
+bool QSqlQuery::exec()
+{
+    qSqlQueryExecPrepared << qSqlQueryPreparedQuery.value(this);
+    qSqlQueryExecThread = QThread::currentThread();
+    return true;
+}
+
+QSqlError QSqlQuery::lastError() const
+{
+    return QSqlError();
+}
+
+QStringList qSqlQueryPrepare = QStringList();
+bool QSqlQuery::prepare(const QString& query)
+{
+    qSqlQueryPrepare << query;
+    qSqlQueryPreparedQuery.insert(this, query);
+    return true;
+}
+
+QVariantList qSqlQueryAddBindValue = QVariantList();
+void QSqlQuery::addBindValue(const QVariant &val, QSql::ParamType)
+{
+    qSqlQueryAddBindValue << val;
+}
+
+QHash<QString, int> qSqlRecordIndexOf;
+QSqlRecord QSqlQuery::record() const
+{
+    qSqlRecordIndexOf.clear();
+    if (qSqlQueryExecQuery.last() == "SELECT * FROM notifications") {
+        qSqlRecordIndexOf.insert("id", 0);
+        qSqlRecordIndexOf.insert("app_name", 1);
+        qSqlRecordIndexOf.insert("app_icon", 2);
+        qSqlRecordIndexOf.insert("summary", 3);
+        qSqlRecordIndexOf.insert("body", 4);
+        qSqlRecordIndexOf.insert("expire_timeout", 5);
+        qSqlRecordIndexOf.insert("actions", 6);
+        qSqlRecordIndexOf.insert("hints", 7);
+    } else if (qSqlQueryExecQuery.last() == "SELECT * FROM actions") {
+        qSqlRecordIndexOf.insert("id", 0);
+        qSqlRecordIndexOf.insert("action", 1);
+    } else if (qSqlQueryExecQuery.last() == "SELECT * FROM hints") {
+        qSqlRecordIndexOf.insert("id", 0);
+        qSqlRecordIndexOf.insert("hint", 1);
+        qSqlRecordIndexOf.insert("value", 2);
+    } else if (qSqlQueryExecQuery.last() == "SELECT * FROM expiration") {
+        qSqlRecordIndexOf.insert("id", 0);
+        qSqlRecordIndexOf.insert("expire_at", 1);
+    }
+    return QSqlRecord();
+}
+
+typedef QHash<int, QVariant> QueryValues;
+typedef QList<QueryValues> QueryValueList;
+QHash<QString, QueryValueList> qSqlQueryValues;
+bool QSqlQuery::next()
+{
+    if (qSqlQueryIndex < qSqlQueryValues.value(qSqlQueryExecQuery.last()).count() - 1) {
+        qSqlQueryIndex++;
+        return true;
+    } else {
+        return false;
+    }
+}
+
+QVariant QSqlQuery::value(int i) const
+{
+    return qSqlQueryValues.value(qSqlQueryExecQuery.last()).at(qSqlQueryIndex).value(i);
+}
+
+int QSqlRecord::indexOf(const QString &name) const
+{
+    return qSqlRecordIndexOf.value(name, -1);
+}
+
+// QSqlTableModel stubs
+QMap<QSqlQueryModel*, QString> modelToTableName = QMap<QSqlQueryModel*, QString>();
+void QSqlTableModel::setTable(const QString &tableName)
+{
+    modelToTableName[this] = tableName;
+}
+
+QHash<QString, int> notificationsTableFieldIndices;
+QHash<QString, int> expirationTableFieldIndices;
+int QSqlTableModel::fieldIndex(const QString &fieldName) const
+{
+    if (notificationsTableFieldIndices.empty()) {
+        notificationsTableFieldIndices.insert("id", 0);
+        notificationsTableFieldIndices.insert("app_name", 1);
+        notificationsTableFieldIndices.insert("app_icon", 2);
+        notificationsTableFieldIndices.insert("summary", 3);
+        notificationsTableFieldIndices.insert("body", 4);
+        notificationsTableFieldIndices.insert("expire_timeout", 5);
+        notificationsTableFieldIndices.insert("actions", 6);
+        notificationsTableFieldIndices.insert("hints", 7);
+
+        expirationTableFieldIndices.insert("id", 0);
+        expirationTableFieldIndices.insert("expire_at", 1);
+    }
+
+    int ret = -1;
+
+    QString tableName = modelToTableName.value(const_cast<QSqlTableModel*>(this));
+    if (tableName == "notifications") {
+        if (notificationsTableFieldIndices.contains(fieldName)) {
+            ret = notificationsTableFieldIndices.value(fieldName);
+        }
+    } else if (tableName == "expiration") {
+        if (expirationTableFieldIndices.contains(fieldName)) {
+            ret = expirationTableFieldIndices.value(fieldName);
+        }
+    }
+
+    return ret;
+}
+
+// QTimer stubs
+QList<QObject*> qTimerStartInstances;
+QList<int> qTimerStartIntervals;
+void QTimer::start()
+{
+    qTimerStartInstances.append(this);
+    qTimerStartIntervals.append(interval());
+}
+
+void QTimer::setInterval(int msec)
+{
+    inter = msec;
+}
+
+void Ut_NotificationDatabase::init()
+{
+    qSqlQueryExecQuery.clear();
+    qSqlQueryPrepare.clear();
+    qSqlQueryPreparedQuery.clear();
+    qSqlQueryExecPrepared.clear();
+    qSqlQueryExecThread = 0;
+    qSqlQueryAddBindValue.clear();
+    qSqlQueryValues.clear();
+    qSqlDatabaseAddDatabaseType.clear();
+    qSqlDatabaseDatabaseName.clear();
+    qSqlDatabaseOpenCalledCount = 0;
+    qSqlDatabaseOpenSucceeds = true;
+    qSqlIterateOpenSuccess = false;
+    qDirRemoveCalled = false;
+    qSqlDatabaseExec.clear();
+    qTimerStartInstances.clear();
+    qTimerStartIntervals.clear();
+    qSqlDatabaseCommitCalled = false;
+    qSqlDatabaseCommitCount = 0;
+    qSqlDatabaseTransactionCount = 0;
+    diskSpaceAvailableKb = DISK_SPACE_NEEDED + 100;
+    diskSpaceChecked = false;
+}
+
+void Ut_NotificationDatabase::testDatabaseConnectionSucceedsAndTablesAreOk()
+{
+    NotificationDatabase database;
+    database.restore();
+    QCOMPARE(database.isOpen(), true);
+    QCOMPARE(diskSpaceChecked, true);
+    QCOMPARE(qSqlDatabaseAddDatabaseType, QString("QSQLITE"));
+    QCOMPARE(qSqlDatabaseDatabaseName, QDir::homePath() + "/.local/share/system/privileged/Notifications/notifications.db");
+    QCOMPARE(qSqlDatabaseOpenCalledCount, 1);
+    QVERIFY(qSqlQueryExecQuery.count() > 1);
+    QCOMPARE(qSqlQueryExecQuery.at(0), QString("PRAGMA journal_mode=WAL"));
+    QCOMPARE(qSqlQueryExecQuery.at(1), QString("PRAGMA user_version"));
+}
+
+void Ut_NotificationDatabase::testDatabaseConnectionSucceedsAndTablesAreNotOk()
+{
+    // Set up the tables so that the schema won't match
+    notificationsTableFieldIndices.clear();
+    expirationTableFieldIndices.clear();
+    notificationsTableFieldIndices.insert("created", 0);
+    expirationTableFieldIndices.insert("created", 0);
+
+    // Check that the tables are dropped and recreated
+    NotificationDatabase database;
+    database.restore();
+    QCOMPARE(database.isOpen(), true);
+    QCOMPARE(qSqlDatabaseAddDatabaseType, QString("QSQLITE"));
+    QCOMPARE(qSqlDatabaseDatabaseName, QDir::homePath() + "/.local/share/system/privileged/Notifications/notifications.db");
+    QCOMPARE(qSqlDatabaseOpenCalledCount, 1);
+    QCOMPARE(qSqlQueryExecQuery.count(), 9);
+    QCOMPARE(qSqlQueryExecQuery.at(0), QString("PRAGMA journal_mode=WAL"));
+    QCOMPARE(qSqlQueryExecQuery.at(1), QString("PRAGMA user_version"));
+    QCOMPARE(qSqlQueryExecQuery.at(2), QString("DROP TABLE notifications"));
+    QCOMPARE(qSqlQueryExecQuery.at(3), QString("CREATE TABLE notifications (id INTEGER PRIMARY KEY, app_name TEXT, app_icon TEXT, summary TEXT, body TEXT, expire_timeout INTEGER, actions BLOB, hints BLOB)"));
+    QCOMPARE(qSqlQueryExecQuery.at(4), QString("DROP TABLE expiration"));
+    QCOMPARE(qSqlQueryExecQuery.at(5), QString("CREATE TABLE expiration (id INTEGER PRIMARY KEY, expire_at INTEGER)"));
+    QCOMPARE(qSqlQueryExecQuery.at(6), QString("PRAGMA user_version=2"));
+    QCOMPARE(qSqlQueryExecQuery.at(7), QString("SELECT * FROM expiration"));
+    QCOMPARE(qSqlQueryExecQuery.at(8), QString("SELECT * FROM notifications"));
+    QCOMPARE((bool)modelToTableName.values().contains("notifications"), true);
+    QCOMPARE((bool)modelToTableName.values().contains("expiration"), true);
+    notificationsTableFieldIndices.clear();
+    expirationTableFieldIndices.clear();
+}
+
+void Ut_NotificationDatabase::testDatabaseIsMigratedFromSchemaVersion1()
+{
+    // Make the database report schema version 1 with one notification, its actions and its hints in separate tables
+    QHash<int, QVariant> version;
+    version.insert(0, 1);
+    qSqlQueryValues["PRAGMA user_version"].append(version);
+
+    QHash<int, QVariant> notificationId;
+    notificationId.insert(0, 1);
+    qSqlQueryValues["SELECT id FROM notifications"].append(notificationId);
+
+    QHash<int, QVariant> actionIdentifier;
+    QHash<int, QVariant> actionName;
+    actionIdentifier.insert(0, 1);
+    actionIdentifier.insert(1, "action");
+    actionName.insert(0, 1);
+    actionName.insert(1, "Action");
+    qSqlQueryValues["SELECT * FROM actions"] << actionIdentifier << actionName;
+
+    QHash<int, QVariant> hint;
+    QHash<int, QVariant> timestampHint;
+    hint.insert(0, 1);
+    hint.insert(1, "hint");
+    hint.insert(2, "value");
+    timestampHint.insert(0, 1);
+    timestampHint.insert(1, NotificationManager::HINT_TIMESTAMP);
+    timestampHint.insert(2, "2013-01-02T03:04:05");
+    qSqlQueryValues["SELECT * FROM hints"] << hint << timestampHint;
+
+    // Check that the actions and hints are moved to the notifications table and the old tables are dropped
+    NotificationDatabase database;
+    database.restore();
+    QCOMPARE(qSqlQueryExecQuery.at(1), QString("PRAGMA user_version"));
+    QCOMPARE(qSqlQueryExecQuery.at(2), QString("SELECT * FROM actions"));
+    QCOMPARE(qSqlQueryExecQuery.at(3), QString("SELECT * FROM hints"));
+    QCOMPARE(qSqlQueryExecQuery.at(4), QString("ALTER TABLE notifications ADD COLUMN actions BLOB"));
+    QCOMPARE(qSqlQueryExecQuery.at(5), QString("ALTER TABLE notifications ADD COLUMN hints BLOB"));
+    QCOMPARE(qSqlQueryExecQuery.at(6), QString("SELECT id FROM notifications"));
+    QCOMPARE(qSqlQueryExecQuery.at(7), QString("DROP TABLE actions"));
+    QCOMPARE(qSqlQueryExecQuery.at(8), QString("DROP TABLE hints"));
+    QCOMPARE(qSqlQueryExecQuery.at(9), QString("PRAGMA user_version=2"));
+    QCOMPARE(qSqlQueryExecQuery.at(10), QString("VACUUM"));
+    QCOMPARE(qSqlDatabaseCommitCalled, true);
+    QCOMPARE(qSqlQueryExecPrepared.count(), 1);
+    QCOMPARE(qSqlQueryExecPrepared.at(0), QString("UPDATE notifications SET actions=?, hints=? WHERE id=?"));
+    QCOMPARE(qSqlQueryAddBindValue.count(), 3);
+    QCOMPARE(NotificationDatabase::deserializeActions(qSqlQueryAddBindValue.at(0).toByteArray()), QStringList() << "action" << "Action");
+    QVariantHash hints = NotificationDatabase::deserializeHints(qSqlQueryAddBindValue.at(1).toByteArray());
+    QCOMPARE(hints.count(), 2);
+    QCOMPARE(hints.value("hint"), QVariant("value"));
+    QCOMPARE(hints.value(NotificationManager::HINT_TIMESTAMP).type(), QVariant::DateTime);
+    QCOMPARE(hints.value(NotificationManager::HINT_TIMESTAMP).toDateTime(), QDateTime(QDate(2013, 1, 2), QTime(3, 4, 5), Qt::UTC));
+    QCOMPARE(qSqlQueryAddBindValue.at(2).toUInt(), (uint)1);
+}
+
+void Ut_NotificationDatabase::testFirstDatabaseConnectionFails()
+{
+    // Make the first database connection fail but the second to succeed
+    qSqlDatabaseOpenSucceeds = false;
+    qSqlIterateOpenSuccess = true;
+    NotificationDatabase database;
+    database.restore();
+
+    // Check that the old database is removed, the database opened twice and the database opened as expected on the second time
+    QCOMPARE(qDirRemoveCalled, true);
+    QCOMPARE(qSqlDatabaseOpenCalledCount, 2);
+    QCOMPARE(qSqlQueryExecQuery.count(), 4);
+    QCOMPARE(database.isOpen(), true);
+}
+
+void Ut_NotificationDatabase::testNotEnoughDiskSpaceToOpenDatabase()
+{
+    diskSpaceAvailableKb = DISK_SPACE_NEEDED - 100;
+
+    // Check that the database is not opened when there is not enough space
+    NotificationDatabase database;
+    QCOMPARE(database.restore().isEmpty(), true);
+    QCOMPARE(qSqlDatabaseOpenCalledCount, 0);
+    QCOMPARE(database.isOpen(), false);
+
+    // Check that modifications are dropped when the database is not open
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    database.flush();
+    QCOMPARE(qSqlQueryExecPrepared.count(), 0);
+}
+
+void Ut_NotificationDatabase::testNotificationsAreRestored()
+{
+    // Make the database return two notifications, one of which has an expiration time
+    QHash<int, QVariant> notification1Values;
+    notification1Values.insert(0, 1);
+    notification1Values.insert(1, "appName1");
+    notification1Values.insert(2, "appIcon1");
+    notification1Values.insert(3, "summary1");
+    notification1Values.insert(4, "body1");
+    notification1Values.insert(5, 1);
+    notification1Values.insert(6, NotificationDatabase::serializeActions(QStringList() << "action1" << "Action 1"));
+    QVariantHash hints1;
+    hints1.insert("hint1-1", "value1-1");
+    hints1.insert("hint1-2", 12);
+    notification1Values.insert(7, NotificationDatabase::serializeHints(hints1));
+    QHash<int, QVariant> notification2Values;
+    notification2Values.insert(0, 2);
+    notification2Values.insert(1, "appName2");
+    notification2Values.insert(2, "appIcon2");
+    notification2Values.insert(3, "summary2");
+    notification2Values.insert(4, "body2");
+    notification2Values.insert(5, 2);
+    qSqlQueryValues["SELECT * FROM notifications"] << notification1Values << notification2Values;
+
+    const qint64 expireAt = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch() + 1000;
+    QHash<int, QVariant> notification1Expiration;
+    notification1Expiration.insert(0, 1);
+    notification1Expiration.insert(1, expireAt);
+    qSqlQueryValues["SELECT * FROM expiration"] << notification1Expiration;
+
+    // Check that the notifications are returned with their actions, hints and expiration times
+    NotificationDatabase database;
+    QList<NotificationDatabase::Record> records = database.restore();
+    QCOMPARE(records.count(), 2);
+    QCOMPARE(records.at(0).id, (uint)1);
+    QCOMPARE(records.at(0).appName, QString("appName1"));
+    QCOMPARE(records.at(0).appIcon, QString("appIcon1"));
+    QCOMPARE(records.at(0).summary, QString("summary1"));
+    QCOMPARE(records.at(0).body, QString("body1"));
+    QCOMPARE(records.at(0).expireTimeout, 1);
+    QCOMPARE(records.at(0).actions, QStringList() << "action1" << "Action 1");
+    QCOMPARE(records.at(0).hints, hints1);
+    QCOMPARE(records.at(0).expireAt, expireAt);
+    QCOMPARE(records.at(1).id, (uint)2);
+    QCOMPARE(records.at(1).actions.isEmpty(), true);
+    QCOMPARE(records.at(1).hints.isEmpty(), true);
+    QCOMPARE(records.at(1).expireAt, (qint64)0);
+
+    // The records are only returned once
+    QCOMPARE(database.restoredRecords.isEmpty(), true);
+}
+
+void Ut_NotificationDatabase::testHintsAreSerializedWithTheirTypes()
+{
+    QVariantHash hints;
+    hints.insert("string", "value");
+    hints.insert("int", 12);
+    hints.insert("timestamp", QDateTime(QDate(2013, 1, 2), QTime(3, 4, 5), Qt::UTC));
+
+    QVariantHash deserializedHints = NotificationDatabase::deserializeHints(NotificationDatabase::serializeHints(hints));
+    QCOMPARE(deserializedHints, hints);
+    foreach (const QString &hint, hints.keys()) {
+        QCOMPARE(deserializedHints.value(hint).type(), hints.value(hint).type());
+    }
+    QCOMPARE(NotificationDatabase::serializeHints(QVariantHash()).isEmpty(), true);
+    QCOMPARE(NotificationDatabase::serializeActions(QStringList()).isEmpty(), true);
+}
+
+void Ut_NotificationDatabase::testCorruptHintsAreNotTrusted()
+{
+    QVariantHash hints;
+    hints.insert("string", "value");
+    hints.insert("int", 12);
+
+    // Check that a count larger than the data holds and a truncated entry are ignored
+    QByteArray data(NotificationDatabase::serializeHints(hints));
+    data[0] = data[1] = data[2] = data[3] = char(0xff);
+    QCOMPARE(NotificationDatabase::deserializeHints(data), hints);
+    data.chop(1);
+    QCOMPARE(NotificationDatabase::deserializeHints(data).count(), 1);
+}
+
+void Ut_NotificationDatabase::testModificationsAreAppliedInOrder()
+{
+    NotificationDatabase database;
+    database.restore();
+
+    database.execSQL("INSERT INTO expiration(id, expire_at) VALUES(?, ?)", QVariantList() << 1 << 100);
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 2);
+    database.execSQL("DELETE FROM expiration WHERE id=?", QVariantList() << 3);
+    database.flush();
+
+    QCOMPARE(qSqlQueryExecPrepared.count(), 3);
+    QCOMPARE(qSqlQueryExecPrepared.at(0), QString("INSERT INTO expiration(id, expire_at) VALUES(?, ?)"));
+    QCOMPARE(qSqlQueryExecPrepared.at(1), QString("DELETE FROM notifications WHERE id=?"));
+    QCOMPARE(qSqlQueryExecPrepared.at(2), QString("DELETE FROM expiration WHERE id=?"));
+    QCOMPARE(qSqlQueryAddBindValue, QVariantList() << 1 << 100 << 2 << 3);
+
+    // Flushing commits the transaction
+    QCOMPARE(qSqlDatabaseCommitCount, 1);
+}
+
+void Ut_NotificationDatabase::testModificationsAreAppliedInWorkerThread()
+{
+    NotificationDatabase database;
+    database.restore();
+
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    database.flush();
+    QVERIFY(qSqlQueryExecThread != 0);
+    QVERIFY(qSqlQueryExecThread != QThread::currentThread());
+    QCOMPARE(qSqlQueryExecThread, &database.workerThread);
+}
+
+void Ut_NotificationDatabase::testCommitIsDelayed()
+{
+    NotificationDatabase database;
+    database.restore();
+
+    // Check that processing the modifications starts the commit timer but doesn't commit
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    QMetaObject::invokeMethod(&database, "processModifications", Qt::BlockingQueuedConnection);
+    QCOMPARE(qSqlQueryExecPrepared.count(), 1);
+    QCOMPARE(qSqlDatabaseCommitCalled, false);
+    QCOMPARE(qTimerStartInstances.count(), 1);
+    QCOMPARE(qTimerStartInstances.at(0), (QObject *)database.databaseCommitTimer);
+    QCOMPARE(qTimerStartIntervals.at(0), 10000);
+
+    // Check that the commit timer commits the transaction
+    QMetaObject::invokeMethod(&database, "commit", Qt::BlockingQueuedConnection);
+    QCOMPARE(qSqlDatabaseCommitCount, 1);
+}
+
+void Ut_NotificationDatabase::testStoragePolicyIsParsed()
+{
+    QCOMPARE(NotificationDatabase::storagePolicyFromString("memory"), NotificationDatabase::MemoryOnly);
+    QCOMPARE(NotificationDatabase::storagePolicyFromString("batched"), NotificationDatabase::Batched);
+    QCOMPARE(NotificationDatabase::storagePolicyFromString("durable"), NotificationDatabase::Durable);
+    QCOMPARE(NotificationDatabase::storagePolicyFromString(QString()), NotificationDatabase::Batched);
+    QCOMPARE(NotificationDatabase::storagePolicyFromString("foo"), NotificationDatabase::Batched);
+}
+
+void Ut_NotificationDatabase::testMemoryOnlyPolicyDoesNotUseDatabase()
+{
+    NotificationDatabase database(NotificationDatabase::MemoryOnly);
+    QCOMPARE(database.storagePolicy(), NotificationDatabase::MemoryOnly);
+    QCOMPARE(database.restore().isEmpty(), true);
+    QCOMPARE(database.isOpen(), false);
+    QCOMPARE(database.workerThread.isRunning(), false);
+
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    database.flush();
+    QCOMPARE(qSqlDatabaseOpenCalledCount, 0);
+    QCOMPARE(qSqlQueryExecPrepared.count(), 0);
+}
+
+void Ut_NotificationDatabase::testDurablePolicyCommitsEachModification()
+{
+    NotificationDatabase database(NotificationDatabase::Durable);
+    database.restore();
+
+    // Check that the modifications are not collected into a transaction
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 2);
+    QMetaObject::invokeMethod(&database, "processModifications", Qt::BlockingQueuedConnection);
+    QCOMPARE(qSqlQueryExecPrepared.count(), 2);
+    QCOMPARE(qSqlDatabaseTransactionCount, 0);
+    QCOMPARE(qTimerStartInstances.count(), 0);
+}
+
+void Ut_NotificationDatabase::testBatchedTransactionIsCommittedWhenTooOld()
+{
+    NotificationDatabase database(NotificationDatabase::Batched, 5000, 0);
+    database.restore();
+
+    // Check that each modification is committed since the transaction is immediately too old
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 2);
+    QMetaObject::invokeMethod(&database, "processModifications", Qt::BlockingQueuedConnection);
+    QCOMPARE(qSqlQueryExecPrepared.count(), 2);
+    QCOMPARE(qSqlDatabaseTransactionCount, 2);
+    QCOMPARE(qSqlDatabaseCommitCount, 2);
+    QCOMPARE(qTimerStartInstances.count(), 0);
+}
+
+void Ut_NotificationDatabase::testBatchedTransactionIsCommittedAfterCommitDelay()
+{
+    NotificationDatabase database(NotificationDatabase::Batched, 5000, 60000);
+    database.restore();
+
+    // Check that the modifications go to the same transaction and the commit timer uses the given delay
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 2);
+    QMetaObject::invokeMethod(&database, "processModifications", Qt::BlockingQueuedConnection);
+    QCOMPARE(qSqlDatabaseTransactionCount, 1);
+    QCOMPARE(qSqlDatabaseCommitCount, 0);
+    QCOMPARE(qTimerStartIntervals, QList<int>() << 5000 << 5000);
+}
+
+void Ut_NotificationDatabase::testDurableBatchIsCommittedInOneTransaction()
+{
+    NotificationDatabase database(NotificationDatabase::Durable);
+    database.restore();
+
+    // Check that the modifications of a batch go to the same transaction which is committed at the end of the batch
+    database.beginBatch();
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    database.beginBatch();
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 2);
+    database.endBatch();
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 3);
+    QMetaObject::invokeMethod(&database, "processModifications", Qt::BlockingQueuedConnection);
+    QCOMPARE(qSqlQueryExecPrepared.count(), 3);
+    QCOMPARE(qSqlDatabaseTransactionCount, 1);
+    QCOMPARE(qSqlDatabaseCommitCount, 0);
+
+    database.endBatch();
+    QMetaObject::invokeMethod(&database, "processModifications", Qt::BlockingQueuedConnection);
+    QCOMPARE(qSqlDatabaseTransactionCount, 1);
+    QCOMPARE(qSqlDatabaseCommitCount, 1);
+    QCOMPARE(qTimerStartInstances.count(), 0);
+}
+
+void Ut_NotificationDatabase::testBatchedTransactionIsNotCommittedInTheMiddleOfABatch()
+{
+    NotificationDatabase database(NotificationDatabase::Batched, 5000, 0);
+    database.restore();
+
+    // Check that a too old transaction is only committed once the batch ends
+    database.beginBatch();
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 2);
+    database.endBatch();
+    QMetaObject::invokeMethod(&database, "processModifications", Qt::BlockingQueuedConnection);
+    QCOMPARE(qSqlQueryExecPrepared.count(), 2);
+    QCOMPARE(qSqlDatabaseTransactionCount, 1);
+    QCOMPARE(qSqlDatabaseCommitCount, 1);
+}
+
+void Ut_NotificationDatabase::testPreparedStatementsAreReused()
+{
+    NotificationDatabase database;
+    database.restore();
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    database.flush();
+    qSqlQueryPrepare.clear();
+    qSqlQueryExecPrepared.clear();
+
+    // The statement of the first modification should be reused for the second one
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 2);
+    database.flush();
+    QCOMPARE(qSqlQueryPrepare.count(), 0);
+    QCOMPARE(qSqlQueryExecPrepared.count(), 1);
+}
+
+void Ut_NotificationDatabase::testMaintenanceIsDoneAfterModifications()
+{
+    NotificationDatabase database;
+    database.restore();
+    QueryValues autoVacuum;
+    autoVacuum.insert(0, 2);
+    qSqlQueryValues["PRAGMA auto_vacuum"].append(autoVacuum);
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    qSqlQueryExecQuery.clear();
+    qSqlDatabaseCommitCount = 0;
+
+    // Check that the queued modification is committed before the maintenance
+    database.performMaintenance();
+    database.flush();
+    QCOMPARE(qSqlQueryExecPrepared, QStringList() << "DELETE FROM notifications WHERE id=?");
+    QCOMPARE(qSqlDatabaseCommitCount, 1);
+    QCOMPARE(qSqlQueryExecQuery, QStringList() << "DELETE FROM expiration WHERE id NOT IN (SELECT id FROM notifications)"
+                                               << "PRAGMA auto_vacuum"
+                                               << "PRAGMA incremental_vacuum"
+                                               << "PRAGMA wal_checkpoint(TRUNCATE)");
+
+    // Check that nothing is done if nothing has been modified since the previous maintenance
+    qSqlQueryExecQuery.clear();
+    database.performMaintenance();
+    database.flush();
+    QCOMPARE(qSqlQueryExecQuery.count(), 0);
+}
+
+void Ut_NotificationDatabase::testMaintenanceEnablesIncrementalVacuum()
+{
+    NotificationDatabase database;
+    database.restore();
+    QueryValues autoVacuum;
+    autoVacuum.insert(0, 0);
+    qSqlQueryValues["PRAGMA auto_vacuum"].append(autoVacuum);
+    database.execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    qSqlQueryExecQuery.clear();
+
+    database.performMaintenance();
+    database.flush();
+    QCOMPARE(qSqlQueryExecQuery, QStringList() << "DELETE FROM expiration WHERE id NOT IN (SELECT id FROM notifications)"
+                                               << "PRAGMA auto_vacuum"
+                                               << "PRAGMA auto_vacuum=INCREMENTAL"
+                                               << "VACUUM"
+                                               << "PRAGMA wal_checkpoint(TRUNCATE)");
+}
+
+void Ut_NotificationDatabase::testDatabaseCommitIsDoneOnDestruction()
+{
+    NotificationDatabase *database = new NotificationDatabase;
+    database->restore();
+    database->execSQL("DELETE FROM notifications WHERE id=?", QVariantList() << 1);
+    delete database;
+
+    QCOMPARE(qSqlQueryExecPrepared.count(), 1);
+    QCOMPARE(qSqlDatabaseCommitCalled, true);
+}
+
+void Ut_NotificationDatabase::benchmarkExecSQL_data()
+{
+    QTest::addColumn<int>("storagePolicy");
+    QTest::newRow("memory") << (int)NotificationDatabase::MemoryOnly;
+    QTest::newRow("batched") << (int)NotificationDatabase::Batched;
+    QTest::newRow("durable") << (int)NotificationDatabase::Durable;
+}
+
+void Ut_NotificationDatabase::benchmarkExecSQL()
+{
+    QFETCH(int, storagePolicy);
+    NotificationDatabase database(static_cast<NotificationDatabase::StoragePolicy>(storagePolicy));
+    database.restore();
+
+    const QVariantList args(QVariantList() << 1 << QString("body"));
+    QBENCHMARK {
+        for (int i = 0; i < 100; ++i) {
+            database.execSQL("UPDATE notifications SET body=? WHERE id=?", args);
+        }
+        database.flush();
+    }
+}
+
+QTEST_MAIN(Ut_NotificationDatabase)
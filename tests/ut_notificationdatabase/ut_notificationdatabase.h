@@ -0,0 +1,52 @@
+/***************************************************************************
+**
+** Copyright (C) 2012 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+#ifndef UT_NOTIFICATIONDATABASE_H
+#define UT_NOTIFICATIONDATABASE_H
+
+#include <QObject>
+
+class Ut_NotificationDatabase : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void testDatabaseConnectionSucceedsAndTablesAreOk();
+    void testDatabaseConnectionSucceedsAndTablesAreNotOk();
+    void testDatabaseIsMigratedFromSchemaVersion1();
+    void testFirstDatabaseConnectionFails();
+    void testNotEnoughDiskSpaceToOpenDatabase();
+    void testNotificationsAreRestored();
+    void testHintsAreSerializedWithTheirTypes();
+    void testCorruptHintsAreNotTrusted();
+    void testModificationsAreAppliedInOrder();
+    void testModificationsAreAppliedInWorkerThread();
+    void testCommitIsDelayed();
+    void testStoragePolicyIsParsed();
+    void testMemoryOnlyPolicyDoesNotUseDatabase();
+    void testDurablePolicyCommitsEachModification();
+    void testBatchedTransactionIsCommittedWhenTooOld();
+    void testBatchedTransactionIsCommittedAfterCommitDelay();
+    void testDurableBatchIsCommittedInOneTransaction();
+    void testBatchedTransactionIsNotCommittedInTheMiddleOfABatch();
+    void testPreparedStatementsAreReused();
+    void testMaintenanceIsDoneAfterModifications();
+    void testMaintenanceEnablesIncrementalVacuum();
+    void testDatabaseCommitIsDoneOnDestruction();
+    void benchmarkExecSQL_data();
+    void benchmarkExecSQL();
+};
+
+#endif
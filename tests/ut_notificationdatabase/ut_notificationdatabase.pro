@@ -0,0 +1,18 @@
+include(../common.pri)
+TARGET = ut_notificationdatabase
+INCLUDEPATH += $$NOTIFICATIONSRCDIR
+QT += sql dbus
+
+# unit test and unit
+SOURCES += \
+    ut_notificationdatabase.cpp \
+    $$NOTIFICATIONSRCDIR/notificationdatabase.cpp \
+    $$NOTIFICATIONSRCDIR/lipsticknotification.cpp \
+    $$STUBSDIR/stubbase.cpp \
+
+# unit test and unit
+HEADERS += \
+    ut_notificationdatabase.h \
+    $$NOTIFICATIONSRCDIR/notificationdatabase.h \
+    $$NOTIFICATIONSRCDIR/notificationmanager.h \
+    $$NOTIFICATIONSRCDIR/lipsticknotification.h
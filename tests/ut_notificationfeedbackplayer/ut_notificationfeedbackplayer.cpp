@@ -15,6 +15,7 @@
 
 #include <QtTest/QtTest>
 #include "notificationmanager.h"
+#include "notificationdatabase.h"
 #include "notificationfeedbackplayer.h"
 #include "lipstickcompositor_stub.h"
 #include "ngfclient_stub.h"
@@ -55,15 +56,31 @@ void NotificationManager::removeNotificationIfUserRemovable(uint)
 {
 }
 
-void NotificationManager::removeNotificationsWithCategory(const QString &)
+void NotificationManager::removeNotificationsWithCategories(const QStringList &)
 {
 }
 
-void NotificationManager::updateNotificationsWithCategory(const QString &)
+void NotificationManager::updateNotificationsWithCategories(const QStringList &)
 {
 }
 
-void NotificationManager::commit()
+void NotificationManager::destroyRemovedNotifications()
+{
+}
+
+void NotificationManager::destroyRemovedNotificationsIfIdle()
+{
+}
+
+void NotificationManager::scheduleMaintenance()
+{
+}
+
+void NotificationManager::performMaintenance()
+{
+}
+
+void NotificationManager::flushChangeJournal()
 {
 }
 
@@ -75,6 +92,22 @@ void NotificationManager::expire()
 {
 }
 
+void NotificationManager::restoreNextNotifications()
+{
+}
+
+void NotificationManager::processDeferredNotifications()
+{
+}
+
+void NotificationManager::handleSenderPidReply(QDBusPendingCallWatcher *)
+{
+}
+
+void NotificationManager::removeSenderIdentity(const QString &)
+{
+}
+
 NotificationManager *notificationManagerInstance = 0;
 NotificationManager *NotificationManager::instance()
 {
@@ -209,6 +242,19 @@ void Ut_NotificationFeedbackPlayer::testUpdateNotificationIsNotPossibleAfterRest
     QCOMPARE(gClientStub->stubCallCount("play"), 0);
 }
 
+void Ut_NotificationFeedbackPlayer::testUpdateRestoredNotificationIsNotPossible()
+{
+    // Restore a notification after the player has been initialized
+    createNotification(1);
+    player->addRestoredNotifications(QList<uint>() << 1);
+
+    // Update the notification
+    player->addNotification(1);
+
+    // Check that NGFAdapter::play() was not called
+    QCOMPARE(gClientStub->stubCallCount("play"), 0);
+}
+
 QWaylandSurface *surface = (QWaylandSurface *)1;
 void Ut_NotificationFeedbackPlayer::testNotificationPreviewsDisabled_data()
 {
@@ -311,6 +357,7 @@ void Ut_NotificationFeedbackPlayer::testLEDDisabledWhenNoSummaryAndBody()
     notificationManagerNotification.insert(2, notification2);
     notificationManagerNotification.insert(3, notification3);
 
+    player->setFeedbackMergeWindow(0);
     player->addNotification(1);
     QCOMPARE(gClientStub->stubCallCount("play"), 1);
     QCOMPARE(gClientStub->stubLastCallTo("play").parameter<QVariantMap>(1).contains("media.leds"), mediaParametersDefined);
@@ -330,4 +377,139 @@ void Ut_NotificationFeedbackPlayer::testLEDDisabledWhenNoSummaryAndBody()
     QCOMPARE(gClientStub->stubLastCallTo("play").parameter<QVariantMap>(1).isEmpty(), true);
 }
 
+void Ut_NotificationFeedbackPlayer::testSameFeedbackIsMergedWithinWindow()
+{
+    gClientStub->stubSetReturnValue("play", (quint32)1);
+    player->setFeedbackMergeWindow(60000);
+
+    createNotification(1);
+    createNotification(2);
+    LipstickNotification *notification3 = createNotification(3);
+    QVariantHash hints(notification3->hints());
+    hints.insert(NotificationManager::HINT_FEEDBACK, "feedback2");
+    notification3->setHints(hints);
+
+    player->addNotification(1);
+    player->addNotification(2);
+    gClientStub->stubSetReturnValue("play", (quint32)2);
+    player->addNotification(3);
+
+    // Only one event should be played per feedback
+    QCOMPARE(gClientStub->stubCallCount("play"), 2);
+    QCOMPARE(gClientStub->stubLastCallTo("play").parameter<QString>(0), QString("feedback2"));
+    QCOMPARE(player->statistics().value("played").toInt(), 2);
+    QCOMPARE(player->statistics().value("merged").toInt(), 1);
+
+    // Removing a merged notification should not stop the event of the first one
+    player->removeNotification(2);
+    QCOMPARE(gClientStub->stubCallCount("stop"), 0);
+}
+
+void Ut_NotificationFeedbackPlayer::testMergedFeedbackIsStoppedWithLastNotification()
+{
+    gClientStub->stubSetReturnValue("play", (quint32)1);
+    player->setFeedbackMergeWindow(60000);
+
+    createNotification(1);
+    createNotification(2);
+    createNotification(3);
+    player->addNotification(1);
+    player->addNotification(2);
+    player->addNotification(3);
+    QCOMPARE(gClientStub->stubCallCount("play"), 1);
+
+    // The event should keep playing while merged notifications remain
+    player->removeNotification(1);
+    player->removeNotification(3);
+    QCOMPARE(gClientStub->stubCallCount("stop"), 0);
+
+    player->removeNotification(2);
+    QCOMPARE(gClientStub->stubCallCount("stop"), 1);
+    QCOMPARE(gClientStub->stubLastCallTo("stop").parameter<quint32>(0), (quint32)1);
+}
+
+void Ut_NotificationFeedbackPlayer::testFailedFeedbackIsNotMerged()
+{
+    gClientStub->stubSetReturnValue("play", (quint32)0);
+    player->setFeedbackMergeWindow(60000);
+
+    createNotification(1);
+    createNotification(2);
+    player->addNotification(1);
+
+    // A feedback which failed to play should not suppress the next one
+    gClientStub->stubSetReturnValue("play", (quint32)1);
+    player->addNotification(2);
+    QCOMPARE(gClientStub->stubCallCount("play"), 2);
+    QCOMPARE(player->statistics().value("played").toInt(), 1);
+    QCOMPARE(player->statistics().value("merged").toInt(), 0);
+
+    // Removing the notification without an event should not stop anything
+    player->removeNotification(1);
+    QCOMPARE(gClientStub->stubCallCount("stop"), 0);
+}
+
+void Ut_NotificationFeedbackPlayer::testCriticalFeedbackIsNotMerged()
+{
+    player->setFeedbackMergeWindow(60000);
+
+    createNotification(1);
+    createNotification(2, 2);
+    player->addNotification(1);
+    player->addNotification(2);
+
+    QCOMPARE(gClientStub->stubCallCount("play"), 2);
+    QCOMPARE(player->statistics().value("merged").toInt(), 0);
+}
+
+void Ut_NotificationFeedbackPlayer::testActiveEventsAreCapped()
+{
+    gClientStub->stubSetReturnValue("play", (quint32)1);
+    player->setFeedbackMergeWindow(0);
+    player->setMaximumActiveEvents(1);
+
+    createNotification(1);
+    createNotification(2);
+    player->addNotification(1);
+    player->addNotification(2);
+
+    // The second feedback should be suppressed while the first one is active
+    QCOMPARE(gClientStub->stubCallCount("play"), 1);
+    QCOMPARE(player->statistics().value("capped").toInt(), 1);
+
+    // A critical feedback should stop the oldest active event
+    gClientStub->stubSetReturnValue("play", (quint32)2);
+    createNotification(3, 2);
+    player->addNotification(3);
+    QCOMPARE(gClientStub->stubCallCount("play"), 2);
+    QCOMPARE(gClientStub->stubCallCount("stop"), 1);
+    QCOMPARE(gClientStub->stubLastCallTo("stop").parameter<quint32>(0), (quint32)1);
+
+    // The stopped event should not be stopped again when its notification is removed
+    player->removeNotification(1);
+    QCOMPARE(gClientStub->stubCallCount("stop"), 1);
+
+    // Once the critical event completes there is room for new events
+    player->removeActiveEvent(2);
+    createNotification(4);
+    player->addNotification(4);
+    QCOMPARE(gClientStub->stubCallCount("play"), 3);
+}
+
+void Ut_NotificationFeedbackPlayer::testDisplayOnRequestsAreDeduplicated()
+{
+    player->setFeedbackMergeWindow(60000);
+
+    for (uint id = 1; id <= 3; id++) {
+        LipstickNotification *notification = createNotification(id);
+        QVariantHash hints(notification->hints());
+        hints.insert(NotificationManager::HINT_DISPLAY_ON, true);
+        notification->setHints(hints);
+        player->addNotification(id);
+    }
+
+    QCOMPARE(player->statistics().value("displayOnRequests").toInt(), 1);
+    QCOMPARE(player->statistics().value("displayOnRequestsSuppressed").toInt(), 2);
+}
+
 QTEST_MAIN(Ut_NotificationFeedbackPlayer)
@@ -37,12 +37,19 @@ private slots:
     void testWithoutFeedbackId();
     void testUpdateNotificationIsNotPossible();
     void testUpdateNotificationIsNotPossibleAfterRestart();
+    void testUpdateRestoredNotificationIsNotPossible();
     void testNotificationPreviewsDisabled_data();
     void testNotificationPreviewsDisabled();
     void testNotificationPriority_data();
     void testNotificationPriority();
     void testLEDDisabledWhenNoSummaryAndBody_data();
     void testLEDDisabledWhenNoSummaryAndBody();
+    void testSameFeedbackIsMergedWithinWindow();
+    void testMergedFeedbackIsStoppedWithLastNotification();
+    void testFailedFeedbackIsNotMerged();
+    void testCriticalFeedbackIsNotMerged();
+    void testActiveEventsAreCapped();
+    void testDisplayOnRequestsAreDeduplicated();
 
 private:
     NotificationFeedbackPlayer *player;
@@ -0,0 +1,182 @@
+/***************************************************************************
+**
+** Copyright (C) 2012 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include <QImage>
+#include <QTemporaryDir>
+#include "ut_notificationimagecache.h"
+#include "notificationimagecache.h"
+
+static QImage createImage(QRgb color)
+{
+    QImage image(4, 4, QImage::Format_ARGB32);
+    image.fill(color);
+    return image;
+}
+
+// Returns the number of image contents stored in the cache
+static int contentCount(const QTemporaryDir *directory)
+{
+    return QDir(directory->path() + "/images/content").entryList(QDir::Files).count();
+}
+
+void Ut_NotificationImageCache::init()
+{
+    directory = new QTemporaryDir;
+    cache = new NotificationImageCache(directory->path() + "/images");
+}
+
+void Ut_NotificationImageCache::cleanup()
+{
+    delete cache;
+    delete directory;
+}
+
+void Ut_NotificationImageCache::testIdenticalImagesAreStoredOnce()
+{
+    const QString path(cache->store(createImage(qRgba(255, 0, 0, 128))));
+    QVERIFY(!path.isEmpty());
+    QVERIFY(cache->contains(path));
+    cache->waitForFileOperations();
+    QCOMPARE(QImage(path).size(), QSize(4, 4));
+    QCOMPARE(QImage(path).pixel(0, 0), qRgba(255, 0, 0, 128));
+
+    // Each stored image has a path of its own but identical images share the contents
+    const QString path2(cache->store(createImage(qRgba(255, 0, 0, 128))));
+    QVERIFY(path2 != path);
+    cache->waitForFileOperations();
+    QCOMPARE(QImage(path2).pixel(0, 0), qRgba(255, 0, 0, 128));
+    QCOMPARE(contentCount(directory), 1);
+}
+
+void Ut_NotificationImageCache::testDifferentImagesAreStoredSeparately()
+{
+    const QString path1(cache->store(createImage(qRgba(255, 0, 0, 255))));
+    const QString path2(cache->store(createImage(qRgba(0, 255, 0, 255))));
+    QVERIFY(!path1.isEmpty());
+    QVERIFY(!path2.isEmpty());
+    QVERIFY(path1 != path2);
+    cache->waitForFileOperations();
+    QCOMPARE(contentCount(directory), 2);
+}
+
+void Ut_NotificationImageCache::testInvalidImageDataIsNotStored()
+{
+    QCOMPARE(cache->store(QVariant("image")), QString());
+    QCOMPARE(cache->store(QImage()), QString());
+    cache->waitForFileOperations();
+    QVERIFY(!QDir(directory->path() + "/images").exists());
+}
+
+void Ut_NotificationImageCache::testImageIsRemovedWithLastReference()
+{
+    const QString path(cache->store(createImage(qRgba(255, 0, 0, 255))));
+    cache->addReference(path);
+    cache->addReference(path);
+
+    cache->releaseReference(path);
+    cache->waitForFileOperations();
+    QVERIFY(QFile::exists(path));
+
+    cache->releaseReference(path);
+    cache->waitForFileOperations();
+    QVERIFY(!QFile::exists(path));
+    QVERIFY(!cache->contains(path));
+    QCOMPARE(contentCount(directory), 0);
+}
+
+void Ut_NotificationImageCache::testSharedContentsAreKeptWhileLinked()
+{
+    const QString path1(cache->store(createImage(qRgba(255, 0, 0, 255))));
+    const QString path2(cache->store(createImage(qRgba(255, 0, 0, 255))));
+    cache->addReference(path1);
+    cache->addReference(path2);
+
+    // Check that releasing one of two identical images keeps the contents for the other one
+    cache->releaseReference(path1);
+    cache->waitForFileOperations();
+    QVERIFY(!QFile::exists(path1));
+    QCOMPARE(QImage(path2).pixel(0, 0), qRgba(255, 0, 0, 255));
+    QCOMPARE(contentCount(directory), 1);
+
+    cache->releaseReference(path2);
+    cache->waitForFileOperations();
+    QCOMPARE(contentCount(directory), 0);
+}
+
+void Ut_NotificationImageCache::testReferencesToFilesOutsideCacheAreIgnored()
+{
+    const QString path(directory->path() + "/image.png");
+    QVERIFY(createImage(qRgba(255, 0, 0, 255)).save(path, "PNG"));
+    QVERIFY(!cache->contains(path));
+
+    cache->addReference(path);
+    cache->releaseReference(path);
+    QVERIFY(QFile::exists(path));
+}
+
+void Ut_NotificationImageCache::testUnreferencedImagesAreRemoved()
+{
+    const QString path1(cache->store(createImage(qRgba(255, 0, 0, 255))));
+    const QString path2(cache->store(createImage(qRgba(0, 255, 0, 255))));
+    cache->addReference(path1);
+
+    cache->removeUnreferencedImages();
+    cache->waitForFileOperations();
+    QVERIFY(QFile::exists(path1));
+    QVERIFY(!QFile::exists(path2));
+    QVERIFY(cache->contains(path1));
+    QVERIFY(!cache->contains(path2));
+    QCOMPARE(contentCount(directory), 1);
+}
+
+void Ut_NotificationImageCache::testImagesStoredEarlierAreFound()
+{
+    const QString path(cache->store(createImage(qRgba(255, 0, 0, 255))));
+    delete cache;
+
+    // Check that the images of an earlier instance are found without touching the file system afterwards
+    cache = new NotificationImageCache(directory->path() + "/images");
+    QVERIFY(cache->contains(path));
+    cache->addReference(path);
+    cache->removeUnreferencedImages();
+    cache->waitForFileOperations();
+    QCOMPARE(QImage(path).pixel(0, 0), qRgba(255, 0, 0, 255));
+}
+
+void Ut_NotificationImageCache::testOversizedImagesAreNotStored()
+{
+    QImage wideImage(1025, 1, QImage::Format_ARGB32);
+    wideImage.fill(qRgba(255, 0, 0, 255));
+    QImage tallImage(1, 1025, QImage::Format_ARGB32);
+    tallImage.fill(qRgba(255, 0, 0, 255));
+
+    QCOMPARE(cache->store(wideImage), QString());
+    QCOMPARE(cache->store(tallImage), QString());
+    QVERIFY(!cache->store(createImage(qRgba(255, 0, 0, 255))).isEmpty());
+}
+
+void Ut_NotificationImageCache::testImageIsStoredBeforeItIsWritten()
+{
+    const QString path(cache->store(createImage(qRgba(255, 0, 0, 255))));
+    cache->addReference(path);
+
+    // The path can be referred to while the file is still being written
+    QVERIFY(cache->contains(path));
+    cache->waitForFileOperations();
+    QVERIFY(QFile::exists(path));
+}
+
+QTEST_APPLESS_MAIN(Ut_NotificationImageCache)
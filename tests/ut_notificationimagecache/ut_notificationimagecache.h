@@ -0,0 +1,47 @@
+/***************************************************************************
+**
+** Copyright (C) 2012 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+#ifndef UT_NOTIFICATIONIMAGECACHE_H
+#define UT_NOTIFICATIONIMAGECACHE_H
+
+#include <QObject>
+
+class NotificationImageCache;
+class QTemporaryDir;
+
+class Ut_NotificationImageCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testIdenticalImagesAreStoredOnce();
+    void testDifferentImagesAreStoredSeparately();
+    void testInvalidImageDataIsNotStored();
+    void testImageIsRemovedWithLastReference();
+    void testSharedContentsAreKeptWhileLinked();
+    void testReferencesToFilesOutsideCacheAreIgnored();
+    void testUnreferencedImagesAreRemoved();
+    void testImagesStoredEarlierAreFound();
+    void testOversizedImagesAreNotStored();
+    void testImageIsStoredBeforeItIsWritten();
+
+private:
+    QTemporaryDir *directory;
+    NotificationImageCache *cache;
+};
+
+#endif
@@ -0,0 +1,14 @@
+include(../common.pri)
+TARGET = ut_notificationimagecache
+INCLUDEPATH += $$NOTIFICATIONSRCDIR
+QT += dbus
+
+# unit test and unit
+SOURCES += \
+    ut_notificationimagecache.cpp \
+    $$NOTIFICATIONSRCDIR/notificationimagecache.cpp \
+
+# unit test and unit
+HEADERS += \
+    ut_notificationimagecache.h \
+    $$NOTIFICATIONSRCDIR/notificationimagecache.h
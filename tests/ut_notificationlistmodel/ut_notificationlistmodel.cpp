@@ -40,8 +40,9 @@ void Ut_NotificationListModel::cleanup()
 void Ut_NotificationListModel::testSignalConnections()
 {
     NotificationListModel model;
-    QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationModified(uint)), &model, SLOT(updateNotification(uint))), true);
-    QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationRemoved(uint)), &model, SLOT(removeNotification(uint))), true);
+    QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationsChanged(QList<uint>,QList<uint>,QList<uint>)), &model, SLOT(applyChanges(QList<uint>,QList<uint>,QList<uint>))), true);
+    QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationModified(uint)), &model, SLOT(updateNotification(uint))), false);
+    QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationsRestored(QList<uint>)), &model, SLOT(addNotifications(QList<uint>))), true);
     QCOMPARE(disconnect(&model, SIGNAL(clearRequested()), NotificationManager::instance(), SLOT(removeUserRemovableNotifications())), true);
 }
 
@@ -66,6 +67,23 @@ void Ut_NotificationListModel::testNotificationIsOnlyAddedIfNotAlreadyAdded()
     QCOMPARE(model.itemCount(), 1);
 }
 
+void Ut_NotificationListModel::testRestoredNotificationsAreAdded()
+{
+    LipstickNotification notification("appName", 1, "appIcon", "summary", "body", QStringList() << "action", QVariantHash(), 1);
+    gNotificationManagerStub->stubSetReturnValue("notificationIds", QList<uint>());
+    gNotificationManagerStub->stubSetReturnValue("notification", &notification);
+    NotificationListModel model;
+    QCOMPARE(model.itemCount(), 0);
+
+    model.addNotifications(QList<uint>() << 1);
+    QCOMPARE(model.itemCount(), 1);
+    QCOMPARE(model.get(0), &notification);
+
+    // Already added notifications are not added again
+    model.addNotifications(QList<uint>() << 1);
+    QCOMPARE(model.itemCount(), 1);
+}
+
 void Ut_NotificationListModel::testNotificationIsNotAddedIfNoSummaryOrBody_data()
 {
     QTest::addColumn<QString>("summary");
@@ -115,7 +133,12 @@ void Ut_NotificationListModel::testNotificationRemoval()
     LipstickNotification notification("appName", 1, "appIcon", "summary", "body", QStringList() << "action", QVariantHash(), 1);
     gNotificationManagerStub->stubSetReturnValue("notification", &notification);
     NotificationListModel model;
-    model.removeNotification(1);
+    model.updateNotification(1);
+    QCOMPARE(model.itemCount(), 1);
+
+    // The manager no longer knows the removed notification
+    gNotificationManagerStub->stubSetReturnValue("notification", (LipstickNotification *)0);
+    model.applyChanges(QList<uint>(), QList<uint>(), QList<uint>() << 1);
     QCOMPARE(model.itemCount(), 0);
     QCOMPARE(model.populated(), true);
 }
@@ -160,6 +183,71 @@ void Ut_NotificationListModel::testNotificationOrdering()
     QCOMPARE(model.get(2), &notification2);
 }
 
+void Ut_NotificationListModel::testModifiedNotificationsAreAddedInOrder()
+{
+    NotificationListModel model;
+    QVariantHash hints1;
+    QVariantHash hints2;
+    hints1.insert(NotificationManager::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, 1), QTime(12, 34, 56)));
+    hints2.insert(NotificationManager::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, 3), QTime(12, 34, 56)));
+    LipstickNotification notification1("appName1", 1, "appIcon1", "summary1", "body1", QStringList() << "action1", hints1, 1);
+    LipstickNotification notification2("appName2", 2, "appIcon2", "summary2", "body2", QStringList() << "action2", hints2, 1);
+    gNotificationManagerStub->stubSetReturnValue("notification", &notification1);
+    model.updateNotification(1);
+
+    // A later notification is placed first
+    QSignalSpy rowsInsertedSpy(&model, SIGNAL(rowsInserted(QModelIndex,int,int)));
+    gNotificationManagerStub->stubSetReturnValue("notification", &notification2);
+    model.applyChanges(QList<uint>(), QList<uint>() << 2, QList<uint>());
+    QCOMPARE(model.itemCount(), 2);
+    QCOMPARE(model.get(0), &notification2);
+    QCOMPARE(model.get(1), &notification1);
+    QCOMPARE(rowsInsertedSpy.count(), 1);
+
+    // An existing notification is moved according to its new timestamp
+    hints1.insert(NotificationManager::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, 5), QTime(12, 34, 56)));
+    notification1.setHints(hints1);
+    gNotificationManagerStub->stubSetReturnValue("notification", &notification1);
+    model.applyChanges(QList<uint>(), QList<uint>() << 1, QList<uint>());
+    QCOMPARE(model.itemCount(), 2);
+    QCOMPARE(model.get(0), &notification1);
+    QCOMPARE(model.get(1), &notification2);
+}
+
+void Ut_NotificationListModel::testModifiedNotificationsAreInsertedBetweenExistingOnes()
+{
+    NotificationListModel model;
+    QList<LipstickNotification *> notifications;
+    for (int day = 1; day <= 6; ++day) {
+        QVariantHash hints;
+        hints.insert(NotificationManager::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, day), QTime(12, 34, 56)));
+        notifications.append(new LipstickNotification("appName", day, "appIcon", "summary", "body", QStringList(), hints, 1, this));
+    }
+
+    // Add the notifications of days 1 and 5 to the model
+    gNotificationManagerStub->stubSetReturnValue("notification", notifications.at(0));
+    model.updateNotification(1);
+    gNotificationManagerStub->stubSetReturnValue("notification", notifications.at(4));
+    model.updateNotification(5);
+
+    // Check that the rest are inserted in order with one insertion per run of adjacent notifications
+    QSignalSpy rowsInsertedSpy(&model, SIGNAL(rowsInserted(QModelIndex,int,int)));
+    QList<LipstickNotification *> newNotifications;
+    newNotifications << notifications.at(1) << notifications.at(5) << notifications.at(2) << notifications.at(3);
+    model.insertNotifications(newNotifications);
+    QCOMPARE(model.itemCount(), 6);
+    for (int index = 0; index < 6; ++index) {
+        QCOMPARE(model.get(index), notifications.at(5 - index));
+    }
+    QCOMPARE(rowsInsertedSpy.count(), 2);
+
+    // Check that the positions are still found after the insertions
+    QCOMPARE(model.indexFor(notifications.at(3)), 2);
+    QCOMPARE(model.indexFor(notifications.at(0)), 5);
+
+    qDeleteAll(notifications);
+}
+
 void Ut_NotificationListModel::testNotificationUpdate()
 {
     LipstickNotification notification("appName", 1, "appIcon", "summary", "body", QStringList() << "action", QVariantHash(), 1);
@@ -188,6 +276,67 @@ void Ut_NotificationListModel::testNotificationUpdate()
     QCOMPARE(qvariant_cast<QModelIndex>(dataChangedSpy.at(0).at(1)).column(), 0);
 }
 
+void Ut_NotificationListModel::testChangedNotificationsAreRemovedInRuns()
+{
+    NotificationListModel model;
+    QList<LipstickNotification *> notifications;
+    for (int day = 1; day <= 6; ++day) {
+        QVariantHash hints;
+        hints.insert(NotificationManager::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, day), QTime(12, 34, 56)));
+        notifications.append(new LipstickNotification("appName", day, "appIcon", "summary", "body", QStringList(), hints, 1, this));
+        gNotificationManagerStub->stubSetReturnValue("notification", notifications.last());
+        model.updateNotification(day);
+    }
+
+    // The removed notifications are found by their sort keys and each run of adjacent rows is removed in one go
+    QSignalSpy rowsRemovedSpy(&model, SIGNAL(rowsRemoved(QModelIndex,int,int)));
+    gNotificationManagerStub->stubSetReturnValue("notification", (LipstickNotification *)0);
+    model.applyChanges(QList<uint>(), QList<uint>(), QList<uint>() << 2 << 6 << 3 << 4);
+    QCOMPARE(model.itemCount(), 2);
+    QCOMPARE(model.get(0), notifications.at(4));
+    QCOMPARE(model.get(1), notifications.at(0));
+    QCOMPARE(rowsRemovedSpy.count(), 2);
+    QCOMPARE(rowsRemovedSpy.at(0).at(1).toInt(), 2);
+    QCOMPARE(rowsRemovedSpy.at(0).at(2).toInt(), 4);
+    QCOMPARE(rowsRemovedSpy.at(1).at(1).toInt(), 0);
+    QCOMPARE(rowsRemovedSpy.at(1).at(2).toInt(), 0);
+
+    qDeleteAll(notifications);
+}
+
+void Ut_NotificationListModel::testChangedNotificationsAreUpdated()
+{
+    NotificationListModel model;
+    LipstickNotification notification("appName", 1, "appIcon", "summary", "body", QStringList(), QVariantHash(), 1);
+    gNotificationManagerStub->stubSetReturnValue("notification", &notification);
+
+    // Changes made before the model is populated are not applied
+    model.m_populated = false;
+    model.applyChanges(QList<uint>() << 1, QList<uint>(), QList<uint>());
+    QCOMPARE(model.itemCount(), 0);
+    model.m_populated = true;
+
+    model.applyChanges(QList<uint>() << 1, QList<uint>(), QList<uint>());
+    QCOMPARE(model.itemCount(), 1);
+    QCOMPARE(model.get(0), &notification);
+
+    // A notification modified in place is reported as changed data
+    QSignalSpy dataChangedSpy(&model, SIGNAL(dataChanged(QModelIndex,QModelIndex)));
+    notification.setBody("differentBody");
+    model.applyChanges(QList<uint>(), QList<uint>() << 1, QList<uint>());
+    QCOMPARE(model.itemCount(), 1);
+    QCOMPARE(dataChangedSpy.count(), 1);
+    QCOMPARE(qvariant_cast<QModelIndex>(dataChangedSpy.at(0).at(0)).row(), 0);
+    QCOMPARE(qvariant_cast<QModelIndex>(dataChangedSpy.at(0).at(1)).row(), 0);
+
+    // A notification which should no longer be shown is removed
+    QVariantHash hints;
+    hints.insert(NotificationManager::HINT_HIDDEN, true);
+    notification.setHints(hints);
+    model.applyChanges(QList<uint>(), QList<uint>() << 1, QList<uint>());
+    QCOMPARE(model.itemCount(), 0);
+}
+
 void Ut_NotificationListModel::testRemoteActions()
 {
     QStringList actions;
@@ -222,4 +371,26 @@ void Ut_NotificationListModel::testRemoteActions()
     QCOMPARE(remoteAction["icon"].toString(), QString());
 }
 
+void Ut_NotificationListModel::benchmarkUpdatingNotifications()
+{
+    QList<LipstickNotification *> notifications;
+    for (int i = 0; i < 2000; ++i) {
+        QVariantHash hints;
+        // Spread the timestamps so that the notifications don't arrive in order
+        hints.insert(NotificationManager::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, 1), QTime(0, 0)).addSecs((i * 7919) % 2000));
+        notifications.append(new LipstickNotification("appName", i + 1, "appIcon", "summary", "body", QStringList(), hints, 1, this));
+    }
+
+    QBENCHMARK {
+        NotificationListModel model;
+        foreach (LipstickNotification *notification, notifications) {
+            gNotificationManagerStub->stubSetReturnValue("notification", notification);
+            model.updateNotification(notification->replacesId());
+        }
+        QCOMPARE(model.itemCount(), notifications.count());
+    }
+
+    qDeleteAll(notifications);
+}
+
 QTEST_MAIN(Ut_NotificationListModel)
@@ -27,14 +27,20 @@ private slots:
     void testSignalConnections();
     void testModelPopulatesOnConstruction();
     void testNotificationIsOnlyAddedIfNotAlreadyAdded();
+    void testRestoredNotificationsAreAdded();
     void testNotificationIsNotAddedIfNoSummaryOrBody_data();
     void testNotificationIsNotAddedIfNoSummaryOrBody();
     void testNotificationIsNotAddedIfHidden();
     void testAlreadyAddedNotificationIsRemovedIfNoLongerAddable();
     void testNotificationRemoval();
     void testNotificationOrdering();
+    void testModifiedNotificationsAreAddedInOrder();
+    void testModifiedNotificationsAreInsertedBetweenExistingOnes();
     void testNotificationUpdate();
+    void testChangedNotificationsAreRemovedInRuns();
+    void testChangedNotificationsAreUpdated();
     void testRemoteActions();
+    void benchmarkUpdatingNotifications();
 };
 
 #endif
@@ -14,237 +14,143 @@
 ****************************************************************************/
 
 #include <QtTest/QtTest>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
 #include "ut_notificationmanager.h"
 #include "notificationmanager.h"
+#include "notificationdatabase.h"
 #include "notificationmanageradaptor_stub.h"
 #include "categorydefinitionstore_stub.h"
-#include <QSqlQuery>
-#include <QSqlTableModel>
-#include <QSqlRecord>
-#include <QSqlError>
+#include "notificationimagecache_stub.h"
+#include "qmactivity_stub.h"
+#include "qmdisplaystate_stub.h"
 #include <mremoteaction.h>
-#include <sys/statfs.h>
 
-const static uint DISK_SPACE_NEEDED = 1024;
-
-unsigned long diskSpaceAvailableKb;
-bool diskSpaceChecked;
-int statfs (const char *, struct statfs *st)
+// NotificationDatabase stubs
+QList<NotificationDatabase::Record> notificationDatabaseRecords;
+bool notificationDatabaseDestroyed = false;
+QStringList notificationDatabaseCommands;
+QVariantList notificationDatabaseArgs;
+NotificationDatabase::NotificationDatabase(StoragePolicy storagePolicy, int, int maximumTransactionAge) :
+    policy(storagePolicy),
+    maxTransactionAge(maximumTransactionAge),
+    database(0),
+    committed(true),
+    databaseCommitTimer(0),
+    queueTail(0),
+    opened(false)
 {
-    st->f_bsize = 4096;
-    st->f_bavail = (diskSpaceAvailableKb * 1024) / st->f_bsize;
-    diskSpaceChecked = true;
-    return 0;
-}
-
-// QDir stubs
-bool qDirRemoveCalled;
-bool QDir::remove(const QString &) {
-    return qDirRemoveCalled = true;
 }
 
-// QSqlDatabase stubs
-QString qSqlDatabaseAddDatabaseType = QString();
-QSqlDatabase qSqlDatabaseInstance;
-QSqlDatabase QSqlDatabase::addDatabase (const QString & type, const QString&)
+NotificationDatabase::~NotificationDatabase()
 {
-    qSqlDatabaseAddDatabaseType = type;
-    return qSqlDatabaseInstance;
+    notificationDatabaseDestroyed = true;
 }
 
-QString qSqlDatabaseDatabaseName = QString();
-void QSqlDatabase::setDatabaseName(const QString& name)
+QList<NotificationDatabase::Record> NotificationDatabase::restore()
 {
-    qSqlDatabaseDatabaseName = name;
+    opened = true;
+    return notificationDatabaseRecords;
 }
 
-bool qSqlDatabaseOpenSucceeds = true;
-bool qSqlIterateOpenSuccess = false;
-int qSqlDatabaseOpenCalledCount = 0;
-bool QSqlDatabase::open()
+bool NotificationDatabase::isOpen() const
 {
-    bool success = qSqlDatabaseOpenSucceeds;
-
-    // Change to negation for the next call
-    if (qSqlIterateOpenSuccess) {
-        qSqlDatabaseOpenSucceeds = !success;
-    }
-    qSqlDatabaseOpenCalledCount++;
-
-    return success;
+    return opened;
 }
 
-bool QSqlDatabase::isOpen() const
+void NotificationDatabase::execSQL(const QString &command, const QVariantList &args)
 {
-    return (qSqlDatabaseOpenCalledCount > 0);
+    notificationDatabaseCommands << command;
+    notificationDatabaseArgs << args;
 }
 
-QStringList qSqlDatabaseExec;
-QSqlQuery QSqlDatabase::exec(const QString& query) const
+int notificationDatabaseBatchCount = 0;
+int notificationDatabaseOpenBatches = 0;
+void NotificationDatabase::beginBatch()
 {
-    qSqlDatabaseExec << query;
-    return QSqlQuery();
+    notificationDatabaseBatchCount++;
+    notificationDatabaseOpenBatches++;
 }
 
-bool QSqlDatabase::transaction()
+void NotificationDatabase::endBatch()
 {
-    return true;
+    notificationDatabaseOpenBatches--;
 }
 
-bool qSqlDatabaseCommitCalled = false;
-bool QSqlDatabase::commit()
+void NotificationDatabase::flush()
 {
-    qSqlDatabaseCommitCalled = true;
-    return true;
 }
 
-// QSqlQuery stubs
-QStringList qSqlQueryExecQuery = QStringList();
-int qSqlQueryIndex = -1;
-QSqlQuery::QSqlQuery(const QString& query, QSqlDatabase)
+int notificationDatabaseMaintenanceCount = 0;
+void NotificationDatabase::performMaintenance()
 {
-    if (!query.isEmpty()) {
-        qSqlQueryExecQuery << query;
-    }
-    qSqlQueryIndex = -1;
+    notificationDatabaseMaintenanceCount++;
 }
 
-QSqlQuery::~QSqlQuery()
+NotificationDatabase::StoragePolicy NotificationDatabase::storagePolicyFromString(const QString &)
 {
+    return Batched;
 }
 
-bool QSqlQuery::exec(const QString& query)
+QString NotificationDatabase::directory()
 {
-    qSqlQueryExecQuery << query;
-    qSqlQueryIndex = -1;
-    return true;
+    return "/tmp/notifications";
 }
 
-bool QSqlQuery::exec()
+QByteArray NotificationDatabase::serializeActions(const QStringList &actions)
 {
-    return true;
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << actions;
+    return data;
 }
 
-QSqlError QSqlQuery::lastError() const
+QStringList NotificationDatabase::deserializeActions(const QByteArray &data)
 {
-    return QSqlError();
+    QStringList actions;
+    QDataStream stream(data);
+    stream >> actions;
+    return actions;
 }
 
-QStringList qSqlQueryPrepare = QStringList();
-bool QSqlQuery::prepare(const QString& query)
+QByteArray NotificationDatabase::serializeHints(const QVariantHash &hints)
 {
-    qSqlQueryPrepare << query;
-    return true;
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << hints;
+    return data;
 }
 
-QVariantList qSqlQueryAddBindValue = QVariantList();
-void QSqlQuery::addBindValue(const QVariant &val, QSql::ParamType)
+QVariantHash NotificationDatabase::deserializeHints(const QByteArray &data)
 {
-    qSqlQueryAddBindValue << val;
+    QVariantHash hints;
+    QDataStream stream(data);
+    stream >> hints;
+    return hints;
 }
 
-QHash<QString, int> qSqlRecordIndexOf;
-QSqlRecord QSqlQuery::record() const
+void NotificationDatabase::open()
 {
-    qSqlRecordIndexOf.clear();
-    if (qSqlQueryExecQuery.last() == "SELECT * FROM notifications") {
-        qSqlRecordIndexOf.insert("id", 0);
-        qSqlRecordIndexOf.insert("app_name", 1);
-        qSqlRecordIndexOf.insert("app_icon", 2);
-        qSqlRecordIndexOf.insert("summary", 3);
-        qSqlRecordIndexOf.insert("body", 4);
-        qSqlRecordIndexOf.insert("expire_timeout", 5);
-    } else if (qSqlQueryExecQuery.last() == "SELECT * FROM actions") {
-        qSqlRecordIndexOf.insert("id", 0);
-        qSqlRecordIndexOf.insert("action", 1);
-    } else if (qSqlQueryExecQuery.last() == "SELECT * FROM hints") {
-        qSqlRecordIndexOf.insert("id", 0);
-        qSqlRecordIndexOf.insert("hint", 1);
-        qSqlRecordIndexOf.insert("value", 2);
-    } else if (qSqlQueryExecQuery.last() == "SELECT * FROM expiration") {
-        qSqlRecordIndexOf.insert("id", 0);
-        qSqlRecordIndexOf.insert("expire_at", 1);
-    }
-    return QSqlRecord();
 }
 
-typedef QHash<int, QVariant> QueryValues;
-typedef QList<QueryValues> QueryValueList;
-QHash<QString, QueryValueList> qSqlQueryValues;
-bool QSqlQuery::next()
+void NotificationDatabase::close()
 {
-    if (qSqlQueryIndex < qSqlQueryValues.value(qSqlQueryExecQuery.last()).count() - 1) {
-        qSqlQueryIndex++;
-        return true;
-    } else {
-        return false;
-    }
 }
 
-QVariant QSqlQuery::value(int i) const
+void NotificationDatabase::processModifications()
 {
-    return qSqlQueryValues.value(qSqlQueryExecQuery.last()).at(qSqlQueryIndex).value(i);
 }
 
-int QSqlRecord::indexOf(const QString &name) const
+void NotificationDatabase::processModificationsAndCommit()
 {
-    return qSqlRecordIndexOf.value(name, -1);
 }
 
-// QSqlTableModel stubs
-QMap<QSqlQueryModel*, QString> modelToTableName = QMap<QSqlQueryModel*, QString>();
-void QSqlTableModel::setTable(const QString &tableName)
+void NotificationDatabase::commit()
 {
-    modelToTableName[this] = tableName;
 }
 
-QHash<QString, int> notificationsTableFieldIndices;
-QHash<QString, int> actionsTableFieldIndices;
-QHash<QString, int> hintsTableFieldIndices;
-QHash<QString, int> expirationTableFieldIndices;
-int QSqlTableModel::fieldIndex(const QString &fieldName) const
+void NotificationDatabase::maintain()
 {
-    if (notificationsTableFieldIndices.empty()) {
-        notificationsTableFieldIndices.insert("id", 0);
-        notificationsTableFieldIndices.insert("app_name", 1);
-        notificationsTableFieldIndices.insert("app_icon", 2);
-        notificationsTableFieldIndices.insert("summary", 3);
-        notificationsTableFieldIndices.insert("body", 4);
-        notificationsTableFieldIndices.insert("expire_timeout", 5);
-
-        actionsTableFieldIndices.insert("id", 0);
-        actionsTableFieldIndices.insert("action", 1);
-
-        hintsTableFieldIndices.insert("id", 0);
-        hintsTableFieldIndices.insert("hint", 1);
-        hintsTableFieldIndices.insert("value", 2);
-
-        expirationTableFieldIndices.insert("id", 0);
-        expirationTableFieldIndices.insert("expire_at", 1);
-    }
-
-    int ret = -1;
-
-    QString tableName = modelToTableName.value(const_cast<QSqlTableModel*>(this));
-    if (tableName == "notifications") {
-        if (notificationsTableFieldIndices.contains(fieldName)) {
-            ret = notificationsTableFieldIndices.value(fieldName);
-        }
-    } else if (tableName == "actions") {
-        if (actionsTableFieldIndices.contains(fieldName)) {
-            ret = actionsTableFieldIndices.value(fieldName);
-        }
-    } else if (tableName == "hints") {
-        if (hintsTableFieldIndices.contains(fieldName)) {
-            ret = hintsTableFieldIndices.value(fieldName);
-        }
-    } else if (tableName == "expiration") {
-        if (expirationTableFieldIndices.contains(fieldName)) {
-            ret = expirationTableFieldIndices.value(fieldName);
-        }
-    }
-
-    return ret;
 }
 
 // QTimer stubs
@@ -273,22 +179,19 @@ void MRemoteAction::trigger()
 
 void Ut_NotificationManager::init()
 {
-    qSqlQueryExecQuery.clear();
-    qSqlQueryPrepare.clear();
-    qSqlQueryAddBindValue.clear();
-    qSqlQueryValues.clear();
-    qSqlDatabaseAddDatabaseType.clear();
-    qSqlDatabaseDatabaseName.clear();
-    qSqlDatabaseOpenCalledCount = 0;
-    qSqlDatabaseOpenSucceeds = true;
-    qSqlIterateOpenSuccess = false;
-    qDirRemoveCalled = false;
-    qSqlDatabaseExec.clear();
+    qRegisterMetaType<QList<uint> >();
+    notificationDatabaseRecords.clear();
+    notificationDatabaseDestroyed = false;
+    notificationDatabaseCommands.clear();
+    notificationDatabaseArgs.clear();
+    notificationDatabaseBatchCount = 0;
+    notificationDatabaseOpenBatches = 0;
+    notificationDatabaseMaintenanceCount = 0;
     qTimerStartInstances.clear();
-    qSqlDatabaseCommitCalled = false;
-    diskSpaceAvailableKb = DISK_SPACE_NEEDED + 100;
-    diskSpaceChecked = true;
     mRemoteActionTrigger.clear();
+    gNotificationImageCacheStub->stubReset();
+    gQmDisplayStateStub->stubReset();
+    gQmActivityStub->stubReset();
 }
 
 void Ut_NotificationManager::cleanup()
@@ -305,214 +208,163 @@ void Ut_NotificationManager::testManagerIsSingleton()
     QCOMPARE(manager2, manager1);
 }
 
-void Ut_NotificationManager::testDatabaseConnectionSucceedsAndTablesAreOk()
-{
-    NotificationManager::instance();
-    QCOMPARE(diskSpaceChecked, true);
-    QCOMPARE(qSqlDatabaseAddDatabaseType, QString("QSQLITE"));
-    QCOMPARE(qSqlDatabaseDatabaseName, QDir::homePath() + "/.local/share/system/privileged/Notifications/notifications.db");
-    QCOMPARE(qSqlDatabaseOpenCalledCount, 1);
-    QVERIFY(qSqlQueryExecQuery.count() > 1);
-    QCOMPARE(qSqlQueryExecQuery.at(0), QString("PRAGMA journal_mode=WAL"));
-    QCOMPARE(qSqlQueryExecQuery.at(1), QString("PRAGMA user_version"));
-}
-
-void Ut_NotificationManager::testDatabaseConnectionSucceedsAndTablesAreNotOk()
-{
-    // Set up the tables so that the schema won't match
-    notificationsTableFieldIndices.clear();
-    actionsTableFieldIndices.clear();
-    hintsTableFieldIndices.clear();
-    expirationTableFieldIndices.clear();
-    notificationsTableFieldIndices.insert("created", 0);
-    actionsTableFieldIndices.insert("created", 0);
-    hintsTableFieldIndices.insert("created", 0);
-    expirationTableFieldIndices.insert("created", 0);
-    qSqlQueryValues.clear();
-
-    // Check that the tables are dropped and recreated
-    NotificationManager::instance();
-    QCOMPARE(qSqlDatabaseAddDatabaseType, QString("QSQLITE"));
-    QCOMPARE(qSqlDatabaseDatabaseName, QDir::homePath() + "/.local/share/system/privileged/Notifications/notifications.db");
-    QCOMPARE(qSqlDatabaseOpenCalledCount, 1);
-    QCOMPARE(qSqlQueryExecQuery.count(), 14);
-    QCOMPARE(qSqlQueryExecQuery.at(0), QString("PRAGMA journal_mode=WAL"));
-    QCOMPARE(qSqlQueryExecQuery.at(1), QString("PRAGMA user_version"));
-    QCOMPARE(qSqlQueryExecQuery.at(2), QString("DROP TABLE notifications"));
-    QCOMPARE(qSqlQueryExecQuery.at(3), QString("CREATE TABLE notifications (id INTEGER PRIMARY KEY, app_name TEXT, app_icon TEXT, summary TEXT, body TEXT, expire_timeout INTEGER)"));
-    QCOMPARE(qSqlQueryExecQuery.at(4), QString("DROP TABLE actions"));
-    QCOMPARE(qSqlQueryExecQuery.at(5), QString("CREATE TABLE actions (id INTEGER, action TEXT, PRIMARY KEY(id, action))"));
-    QCOMPARE(qSqlQueryExecQuery.at(6), QString("DROP TABLE hints"));
-    QCOMPARE(qSqlQueryExecQuery.at(7), QString("CREATE TABLE hints (id INTEGER, hint TEXT, value TEXT, PRIMARY KEY(id, hint))"));
-    QCOMPARE(qSqlQueryExecQuery.at(8), QString("DROP TABLE expiration"));
-    QCOMPARE(qSqlQueryExecQuery.at(9), QString("CREATE TABLE expiration (id INTEGER PRIMARY KEY, expire_at INTEGER)"));
-    QCOMPARE(qSqlQueryExecQuery.at(10), QString("SELECT * FROM actions"));
-    QCOMPARE(qSqlQueryExecQuery.at(11), QString("SELECT * FROM hints"));
-    QCOMPARE(qSqlQueryExecQuery.at(12), QString("SELECT * FROM expiration"));
-    QCOMPARE(qSqlQueryExecQuery.at(13), QString("SELECT * FROM notifications"));
-    QCOMPARE((bool)modelToTableName.values().contains("notifications"), true);
-    QCOMPARE((bool)modelToTableName.values().contains("actions"), true);
-    QCOMPARE((bool)modelToTableName.values().contains("hints"), true);
-    QCOMPARE((bool)modelToTableName.values().contains("expiration"), true);
-    notificationsTableFieldIndices.clear();
-    actionsTableFieldIndices.clear();
-    hintsTableFieldIndices.clear();
-    expirationTableFieldIndices.clear();
-}
-
-void Ut_NotificationManager::testFirstDatabaseConnectionFails()
-{
-    // Make the first database connection fail but the second to succeed
-    qSqlDatabaseOpenSucceeds = false;
-    qSqlIterateOpenSuccess = true;
-    NotificationManager::instance();
-
-    // Check that the old database is removed, the database opened twice and the database opened as expected on the second time
-    QCOMPARE(qDirRemoveCalled, true);
-    QCOMPARE(qSqlDatabaseOpenCalledCount, 2);
-    QCOMPARE(qSqlQueryExecQuery.count(), 6);
-}
-
-void Ut_NotificationManager::testNotEnoughDiskSpaceToOpenDatabase()
-{
-    diskSpaceAvailableKb = DISK_SPACE_NEEDED - 100;
-
-    // Check that the database is not opened when there is not enough space
-    NotificationManager::instance();
-    QCOMPARE(qSqlDatabaseOpenCalledCount, 0);
-}
-
 void Ut_NotificationManager::testNotificationsAreRestoredOnConstruction()
 {
     // Make the database return two notifications with different values
-    QHash<int, QVariant> notification1Values;
-    QHash<int, QVariant> notification2Values;
+    NotificationDatabase::Record notification1;
+    notification1.id = 1;
+    notification1.appName = "appName1";
+    notification1.appIcon = "appIcon1";
+    notification1.summary = "summary1";
+    notification1.body = "body1";
+    notification1.expireTimeout = 1;
+    notification1.actions << "action1" << "Action 1";
+    notification1.hints.insert("hint1-1", "value1-1");
+    notification1.hints.insert("hint1-2", 12);
+    NotificationDatabase::Record notification2;
+    notification2.id = 2;
+    notification2.appName = "appName2";
+    notification2.appIcon = "appIcon2";
+    notification2.summary = "summary2";
+    notification2.body = "body2";
+    notification2.expireTimeout = 2;
+    notification2.actions << "action2" << "Action 2";
+    notification2.hints.insert("hint2-1", "value2-1");
+    notification2.hints.insert("hint2-2", QDateTime(QDate(2013, 1, 2), QTime(3, 4, 5), Qt::UTC));
     // Also include a notification which has expired
-    QHash<int, QVariant> notification3Values;
-    notification1Values.insert(0, 1);
-    notification1Values.insert(1, "appName1");
-    notification1Values.insert(2, "appIcon1");
-    notification1Values.insert(3, "summary1");
-    notification1Values.insert(4, "body1");
-    notification1Values.insert(5, 1);
-    notification2Values.insert(0, 2);
-    notification2Values.insert(1, "appName2");
-    notification2Values.insert(2, "appIcon2");
-    notification2Values.insert(3, "summary2");
-    notification2Values.insert(4, "body2");
-    notification2Values.insert(5, 2);
-    notification3Values.insert(0, 3);
-    notification3Values.insert(1, "appName3");
-    notification3Values.insert(2, "appIcon3");
-    notification3Values.insert(3, "summary3");
-    notification3Values.insert(4, "body3");
-    notification3Values.insert(5, 3);
-    QList<QHash<int, QVariant> > notificationValues;
-    notificationValues << notification1Values << notification2Values << notification3Values;
-    qSqlQueryValues["SELECT * FROM notifications"].append(notificationValues);
-    QHash<uint, QHash<int, QVariant> > notificationValuesById;
-    notificationValuesById.insert(1, notification1Values);
-    notificationValuesById.insert(2, notification2Values);
-
-    QHash<int, QVariant> notification1ActionIdentifier;
-    QHash<int, QVariant> notification1ActionName;
-    QHash<int, QVariant> notification2ActionIdentifier;
-    QHash<int, QVariant> notification2ActionName;
-    QHash<int, QVariant> notification3ActionIdentifier;
-    QHash<int, QVariant> notification3ActionName;
-    notification1ActionIdentifier.insert(0, 1);
-    notification1ActionIdentifier.insert(1, "action1");
-    notification1ActionName.insert(0, 1);
-    notification1ActionName.insert(1, "Action 1");
-    notification2ActionIdentifier.insert(0, 2);
-    notification2ActionIdentifier.insert(1, "action2");
-    notification2ActionName.insert(0, 2);
-    notification2ActionName.insert(1, "Action 2");
-    notification3ActionIdentifier.insert(0, 3);
-    notification3ActionIdentifier.insert(1, "action3");
-    notification3ActionName.insert(0, 3);
-    notification3ActionName.insert(1, "Action 3");
-    QList<QHash<int, QVariant> > notificationActions;
-    notificationActions << notification1ActionIdentifier << notification1ActionName << notification2ActionIdentifier << notification2ActionName << notification3ActionIdentifier << notification3ActionName;
-    qSqlQueryValues["SELECT * FROM actions"].append(notificationActions);
-    QHash<uint, QStringList> notificationActionsById;
-    notificationActionsById.insert(1, QStringList() << "action1" << "Action 1");
-    notificationActionsById.insert(2, QStringList() << "action2" << "Action 2");
-
-    QHash<int, QVariant> notification1Hint1;
-    QHash<int, QVariant> notification1Hint2;
-    QHash<int, QVariant> notification2Hint1;
-    QHash<int, QVariant> notification2Hint2;
-    QHash<int, QVariant> notification3Hint1;
-    QHash<int, QVariant> notification3Hint2;
-    notification1Hint1.insert(0, 1);
-    notification1Hint1.insert(1, "hint1-1");
-    notification1Hint1.insert(2, "value1-1");
-    notification1Hint2.insert(0, 1);
-    notification1Hint2.insert(1, "hint1-2");
-    notification1Hint2.insert(2, "value1-2");
-    notification2Hint1.insert(0, 2);
-    notification2Hint1.insert(1, "hint2-1");
-    notification2Hint1.insert(2, "value2-1");
-    notification2Hint2.insert(0, 2);
-    notification2Hint2.insert(1, "hint2-2");
-    notification2Hint2.insert(2, "value2-2");
-    notification3Hint1.insert(0, 3);
-    notification3Hint1.insert(1, "hint3-1");
-    notification3Hint1.insert(2, "value3-1");
-    notification3Hint2.insert(0, 3);
-    notification3Hint2.insert(1, "hint3-2");
-    notification3Hint2.insert(2, "value3-2");
-    QList<QHash<int, QVariant> > notificationHints;
-    notificationHints << notification1Hint1 << notification1Hint2 << notification2Hint1 << notification2Hint2 << notification3Hint1 << notification3Hint2;
-    qSqlQueryValues["SELECT * FROM hints"].append(notificationHints);
-    QHash<uint, QList<QPair<QString, QVariant> > > notificationHintsById;
-    notificationHintsById.insert(1, QList<QPair<QString, QVariant> >() << qMakePair(QString("hint1-1"), QVariant("value1-1")) << qMakePair(QString("hint1-2"), QVariant("value1-2")));
-    notificationHintsById.insert(2, QList<QPair<QString, QVariant> >() << qMakePair(QString("hint2-1"), QVariant("value2-1")) << qMakePair(QString("hint2-2"), QVariant("value2-2")));
-
-    QHash<int, QVariant> notification3Expiration;
-    notification3Expiration.insert(0, 3);
-    notification3Expiration.insert(1, QDateTime::currentDateTimeUtc().toMSecsSinceEpoch() - 1000);
-    QList<QHash<int, QVariant> > notificationExpirations;
-    notificationExpirations << notification3Expiration;
-    qSqlQueryValues["SELECT * FROM expiration"].append(notificationExpirations);
-
-    // Check that the notifications exist in the manager after construction and contain the expected values
+    NotificationDatabase::Record notification3;
+    notification3.id = 3;
+    notification3.appName = "appName3";
+    notification3.expireTimeout = 3;
+    notification3.expireAt = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch() - 1000;
+    notificationDatabaseRecords << notification1 << notification2 << notification3;
+    QHash<uint, NotificationDatabase::Record> notificationsById;
+    notificationsById.insert(1, notification1);
+    notificationsById.insert(2, notification2);
+
+    // Check that the notifications are created after construction, latest first, and contain the expected values
     NotificationManager *manager = NotificationManager::instance();
+    QCOMPARE(manager->notificationIds().isEmpty(), true);
+    QSignalSpy spy(manager, SIGNAL(notificationsRestored(QList<uint>)));
+    manager->restorePendingNotifications();
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.last().at(0).value<QList<uint> >(), QList<uint>() << 2 << 1);
     QList<uint> ids = manager->notificationIds();
-    QCOMPARE(ids.count(), notificationValuesById.count());
+    QCOMPARE(ids.count(), notificationsById.count());
     // The expired notification should not be reported
     QCOMPARE(ids.contains(3), false);
-    foreach (uint id, notificationValuesById.keys()) {
-        QCOMPARE(id, notificationValuesById.value(id).value(0).toUInt());
-        LipstickNotification *notification = manager->notification(id);
-        QCOMPARE(notification->appName(), notificationValuesById.value(id).value(1).toString());
-        QCOMPARE(notification->appIcon(), notificationValuesById.value(id).value(2).toString());
-        QCOMPARE(notification->summary(), notificationValuesById.value(id).value(3).toString());
-        QCOMPARE(notification->body(), notificationValuesById.value(id).value(4).toString());
-        QCOMPARE(notification->expireTimeout(), notificationValuesById.value(id).value(5).toInt());
-        QCOMPARE(notification->actions(), notificationActionsById.value(id));
-
-        typedef QPair<QString, QVariant> HintData;
-        foreach (const HintData &hint, notificationHintsById.value(id)) {
-            QCOMPARE(notification->hints().value(hint.first), hint.second);
+    foreach (const NotificationDatabase::Record &record, notificationsById) {
+        LipstickNotification *notification = manager->notification(record.id);
+        QVERIFY(notification != 0);
+        QCOMPARE(notification->appName(), record.appName);
+        QCOMPARE(notification->appIcon(), record.appIcon);
+        QCOMPARE(notification->summary(), record.summary);
+        QCOMPARE(notification->body(), record.body);
+        QCOMPARE(notification->expireTimeout(), record.expireTimeout);
+        QCOMPARE(notification->actions(), record.actions);
+
+        QVariantHash::const_iterator it = record.hints.constBegin(), end = record.hints.constEnd();
+        for ( ; it != end; ++it) {
+            QCOMPARE(notification->hints().value(it.key()), it.value());
+            QCOMPARE(notification->hints().value(it.key()).type(), it.value().type());
         }
     }
+
+    // The expired notification should be removed from the database
+    QCOMPARE(notificationDatabaseCommands.count(), 2);
+    QCOMPARE(notificationDatabaseCommands.at(0), QString("DELETE FROM notifications WHERE id=?"));
+    QCOMPARE(notificationDatabaseCommands.at(1), QString("DELETE FROM expiration WHERE id=?"));
 }
 
-void Ut_NotificationManager::testDatabaseCommitIsDoneOnDestruction()
+void Ut_NotificationManager::testRestoredNotificationsAreCreatedInBatches()
+{
+    for (uint id = 1; id <= 120; ++id) {
+        NotificationDatabase::Record record;
+        record.id = id;
+        notificationDatabaseRecords << record;
+    }
+
+    // Check that the notifications are created in batches from a timer, latest first
+    NotificationManager *manager = NotificationManager::instance();
+    QCOMPARE(qTimerStartInstances.contains(&manager->restoreTimer), true);
+    QSignalSpy spy(manager, SIGNAL(notificationsRestored(QList<uint>)));
+    manager->restoreNextNotifications();
+    QCOMPARE(spy.count(), 1);
+    QList<uint> ids = spy.last().at(0).value<QList<uint> >();
+    QCOMPARE(ids.count(), 50);
+    QCOMPARE(ids.first(), (uint)120);
+    QCOMPARE(ids.last(), (uint)71);
+    QCOMPARE(manager->notificationIds().count(), 50);
+
+    manager->restoreNextNotifications();
+    manager->restoreNextNotifications();
+    QCOMPARE(spy.count(), 3);
+    QCOMPARE(spy.last().at(0).value<QList<uint> >().count(), 20);
+    QCOMPARE(spy.last().at(0).value<QList<uint> >().last(), (uint)1);
+    QCOMPARE(manager->notificationIds().count(), 120);
+
+    // Nothing is left to restore
+    manager->restoreNextNotifications();
+    QCOMPARE(spy.count(), 3);
+}
+
+void Ut_NotificationManager::testPendingNotificationIsCreatedWhenReplaced()
+{
+    NotificationDatabase::Record record;
+    record.id = 1;
+    record.appName = "appName";
+    notificationDatabaseRecords << record;
+
+    // Check that the notification can be replaced before it has been restored
+    NotificationManager *manager = NotificationManager::instance();
+    QCOMPARE(manager->Notify("appName", 1, QString(), QString(), "body", QStringList(), QVariantHash(), 0), (uint)1);
+    QVERIFY(manager->notification(1) != 0);
+    QCOMPARE(manager->notification(1)->body(), QString("body"));
+
+    // The notification is not restored again
+    QSignalSpy spy(manager, SIGNAL(notificationsRestored(QList<uint>)));
+    manager->restorePendingNotifications();
+    QCOMPARE(spy.count(), 0);
+}
+
+void Ut_NotificationManager::testPendingNotificationIsCreatedWhenClosed()
+{
+    NotificationDatabase::Record record;
+    record.id = 1;
+    notificationDatabaseRecords << record;
+
+    // Check that the notification can be closed before it has been restored
+    NotificationManager *manager = NotificationManager::instance();
+    QSignalSpy closedSpy(manager, SIGNAL(NotificationClosed(uint,uint)));
+    manager->CloseNotification(1);
+    QCOMPARE(closedSpy.count(), 1);
+    QCOMPARE(closedSpy.last().at(0).toUInt(), (uint)1);
+    QCOMPARE(notificationDatabaseCommands, QStringList() << "DELETE FROM notifications WHERE id=?");
+}
+
+void Ut_NotificationManager::testNewNotificationsDoNotReusePendingNotificationIds()
+{
+    NotificationDatabase::Record record;
+    record.id = 5;
+    notificationDatabaseRecords << record;
+
+    NotificationManager *manager = NotificationManager::instance();
+    QCOMPARE(manager->Notify("appName", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0), (uint)6);
+}
+
+void Ut_NotificationManager::testDatabaseIsClosedOnDestruction()
 {
     delete NotificationManager::instance();
     NotificationManager::instance_ = 0;
 
-    QCOMPARE(qSqlDatabaseCommitCalled, true);
+    QCOMPARE(notificationDatabaseDestroyed, true);
 }
 
 void Ut_NotificationManager::testCapabilities()
 {
     // Check the supported capabilities includes all the Nemo hints
     QStringList capabilities = NotificationManager::instance()->GetCapabilities();
-    QCOMPARE(capabilities.count(), 12);
+    QCOMPARE(capabilities.count(), 13);
     QCOMPARE((bool)capabilities.contains("body"), true);
     QCOMPARE((bool)capabilities.contains("actions"), true);
     QCOMPARE((bool)capabilities.contains(NotificationManager::HINT_ICON), true);
@@ -525,6 +377,7 @@ void Ut_NotificationManager::testCapabilities()
     QCOMPARE((bool)capabilities.contains(NotificationManager::HINT_USER_REMOVABLE), true);
     QCOMPARE((bool)capabilities.contains("x-nemo-get-notifications"), true);
     QCOMPARE((bool)capabilities.contains(NotificationManager::HINT_ORIGIN), true);
+    QCOMPARE((bool)capabilities.contains("x-nemo-batch"), true);
 }
 
 void Ut_NotificationManager::testAddingNotification()
@@ -540,35 +393,20 @@ void Ut_NotificationManager::testAddingNotification()
     QCOMPARE(disconnect(notification, SIGNAL(actionInvoked(QString)), manager, SLOT(invokeAction(QString))), true);
     QCOMPARE(spy.count(), 1);
     QCOMPARE(spy.last().at(0).toUInt(), id);
-    QCOMPARE(qSqlQueryPrepare.count(), 5);
-    QCOMPARE(qSqlQueryPrepare.at(0), QString("INSERT INTO notifications VALUES (?, ?, ?, ?, ?, ?)"));
-    QCOMPARE(qSqlQueryPrepare.at(1), QString("INSERT INTO actions VALUES (?, ?)"));
-    QCOMPARE(qSqlQueryPrepare.at(2), QString("INSERT INTO actions VALUES (?, ?)"));
-    QCOMPARE(qSqlQueryPrepare.at(3), QString("INSERT INTO hints VALUES (?, ?, ?)"));
-    QCOMPARE(qSqlQueryPrepare.at(4), QString("INSERT INTO hints VALUES (?, ?, ?)"));
-    QCOMPARE(qSqlQueryAddBindValue.count(), 16);
-    QCOMPARE(qSqlQueryAddBindValue.at(0).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(1), QVariant("appName"));
-    QCOMPARE(qSqlQueryAddBindValue.at(2), QVariant("appIcon"));
-    QCOMPARE(qSqlQueryAddBindValue.at(3), QVariant("summary"));
-    QCOMPARE(qSqlQueryAddBindValue.at(4), QVariant("body"));
-    QCOMPARE(qSqlQueryAddBindValue.at(5).toInt(), 1);
-    QCOMPARE(qSqlQueryAddBindValue.at(6).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(7), QVariant("action"));
-    QCOMPARE(qSqlQueryAddBindValue.at(8).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(9), QVariant("Action"));
-    int hintBase = 10;
-    int timestampHintBase = 13;
-    if (qSqlQueryAddBindValue.at(11) != QVariant("hint")) {
-        hintBase = 13;
-        timestampHintBase = 10;
-    }
-    QCOMPARE(qSqlQueryAddBindValue.at(hintBase).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(hintBase + 1), QVariant("hint"));
-    QCOMPARE(qSqlQueryAddBindValue.at(hintBase + 2), QVariant("value"));
-    QCOMPARE(qSqlQueryAddBindValue.at(timestampHintBase).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(timestampHintBase + 1), QVariant(NotificationManager::HINT_TIMESTAMP));
-    QCOMPARE(qSqlQueryAddBindValue.at(timestampHintBase + 2).type(), QVariant::DateTime);
+    QCOMPARE(notificationDatabaseCommands.count(), 1);
+    QCOMPARE(notificationDatabaseCommands.at(0), QString("INSERT INTO notifications VALUES (?, ?, ?, ?, ?, ?, ?, ?)"));
+    QCOMPARE(notificationDatabaseArgs.count(), 8);
+    QCOMPARE(notificationDatabaseArgs.at(0).toUInt(), id);
+    QCOMPARE(notificationDatabaseArgs.at(1), QVariant("appName"));
+    QCOMPARE(notificationDatabaseArgs.at(2), QVariant("appIcon"));
+    QCOMPARE(notificationDatabaseArgs.at(3), QVariant("summary"));
+    QCOMPARE(notificationDatabaseArgs.at(4), QVariant("body"));
+    QCOMPARE(notificationDatabaseArgs.at(5).toInt(), 1);
+    QCOMPARE(NotificationDatabase::deserializeActions(notificationDatabaseArgs.at(6).toByteArray()), QStringList() << "action" << "Action");
+    QVariantHash storedHints = NotificationDatabase::deserializeHints(notificationDatabaseArgs.at(7).toByteArray());
+    QCOMPARE(storedHints.count(), 2);
+    QCOMPARE(storedHints.value("hint"), QVariant("value"));
+    QCOMPARE(storedHints.value(NotificationManager::HINT_TIMESTAMP).type(), QVariant::DateTime);
     QCOMPARE(notification->appName(), QString("appName"));
     QCOMPARE(notification->appIcon(), QString("appIcon"));
     QCOMPARE(notification->summary(), QString("summary"));
@@ -585,40 +423,34 @@ void Ut_NotificationManager::testUpdatingExistingNotification()
     NotificationManager *manager = NotificationManager::instance();
 
     uint id = manager->Notify("appName", 0, "appIcon", "summary", "body", QStringList(), QVariantHash(), 1);
-    qSqlQueryPrepare.clear();
-    qSqlQueryAddBindValue.clear();
+    manager->MarkNotificationDisplayed(id);
+    notificationDatabaseCommands.clear();
+    notificationDatabaseArgs.clear();
 
     QSignalSpy spy(manager, SIGNAL(notificationModified(uint)));
-    uint newId = manager->Notify("newAppName", id, "newAppIcon", "newSummary", "newBody", QStringList() << "action", QVariantHash(), 2);
+    QVariantHash hints;
+    hints.insert("hint", "value");
+    uint newId = manager->Notify("newAppName", id, "newAppIcon", "newSummary", "newBody", QStringList() << "action", hints, 2);
     QCOMPARE(newId, id);
     LipstickNotification *notification = manager->notification(id);
     QCOMPARE(disconnect(notification, SIGNAL(actionInvoked(QString)), manager, SLOT(invokeAction(QString))), true);
     QCOMPARE(spy.count(), 1);
     QCOMPARE(spy.last().at(0).toUInt(), id);
-    QCOMPARE(qSqlQueryPrepare.count(), 7);
-    QCOMPARE(qSqlQueryPrepare.at(0), QString("DELETE FROM notifications WHERE id=?"));
-    QCOMPARE(qSqlQueryPrepare.at(1), QString("DELETE FROM actions WHERE id=?"));
-    QCOMPARE(qSqlQueryPrepare.at(2), QString("DELETE FROM hints WHERE id=?"));
-    QCOMPARE(qSqlQueryPrepare.at(3), QString("DELETE FROM expiration WHERE id=?"));
-    QCOMPARE(qSqlQueryPrepare.at(4), QString("INSERT INTO notifications VALUES (?, ?, ?, ?, ?, ?)"));
-    QCOMPARE(qSqlQueryPrepare.at(5), QString("INSERT INTO actions VALUES (?, ?)"));
-    QCOMPARE(qSqlQueryPrepare.at(6), QString("INSERT INTO hints VALUES (?, ?, ?)"));
-    QCOMPARE(qSqlQueryAddBindValue.count(), 15);
-    QCOMPARE(qSqlQueryAddBindValue.at(0).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(1).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(2).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(3).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(4).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(5), QVariant("newAppName"));
-    QCOMPARE(qSqlQueryAddBindValue.at(6), QVariant("newAppIcon"));
-    QCOMPARE(qSqlQueryAddBindValue.at(7), QVariant("newSummary"));
-    QCOMPARE(qSqlQueryAddBindValue.at(8), QVariant("newBody"));
-    QCOMPARE(qSqlQueryAddBindValue.at(9).toInt(), 2);
-    QCOMPARE(qSqlQueryAddBindValue.at(10).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(11), QVariant("action"));
-    QCOMPARE(qSqlQueryAddBindValue.at(12).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(13), QVariant(NotificationManager::HINT_TIMESTAMP));
-    QCOMPARE(qSqlQueryAddBindValue.at(14).type(), QVariant::DateTime);
+    QCOMPARE(notificationDatabaseCommands.count(), 2);
+    QCOMPARE(notificationDatabaseCommands.at(0), QString("UPDATE notifications SET app_name=?, app_icon=?, summary=?, body=?, expire_timeout=?, actions=?, hints=? WHERE id=?"));
+    QCOMPARE(notificationDatabaseCommands.at(1), QString("DELETE FROM expiration WHERE id=?"));
+    QCOMPARE(notificationDatabaseArgs.count(), 9);
+    QCOMPARE(notificationDatabaseArgs.at(0), QVariant("newAppName"));
+    QCOMPARE(notificationDatabaseArgs.at(1), QVariant("newAppIcon"));
+    QCOMPARE(notificationDatabaseArgs.at(2), QVariant("newSummary"));
+    QCOMPARE(notificationDatabaseArgs.at(3), QVariant("newBody"));
+    QCOMPARE(notificationDatabaseArgs.at(4).toInt(), 2);
+    QCOMPARE(NotificationDatabase::deserializeActions(notificationDatabaseArgs.at(5).toByteArray()), QStringList() << "action");
+    QVariantHash storedHints = NotificationDatabase::deserializeHints(notificationDatabaseArgs.at(6).toByteArray());
+    QCOMPARE(storedHints.value("hint"), QVariant("value"));
+    QCOMPARE(storedHints.value(NotificationManager::HINT_TIMESTAMP).type(), QVariant::DateTime);
+    QCOMPARE(notificationDatabaseArgs.at(7).toUInt(), id);
+    QCOMPARE(notificationDatabaseArgs.at(8).toUInt(), id);
     QCOMPARE(notification->appName(), QString("newAppName"));
     QCOMPARE(notification->appIcon(), QString("newAppIcon"));
     QCOMPARE(notification->summary(), QString("newSummary"));
@@ -628,6 +460,49 @@ void Ut_NotificationManager::testUpdatingExistingNotification()
     QCOMPARE(notification->hints().value(NotificationManager::HINT_TIMESTAMP).type(), QVariant::DateTime);
 }
 
+void Ut_NotificationManager::testUpdatingOnlyChangedColumns()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    hints.insert(NotificationManager::HINT_ITEM_COUNT, 1);
+    uint id = manager->Notify("appName", 0, "appIcon", "summary", "body", QStringList() << "action", hints, 0);
+    QDateTime timestamp = manager->notification(id)->hints().value(NotificationManager::HINT_TIMESTAMP).toDateTime();
+    notificationDatabaseCommands.clear();
+    notificationDatabaseArgs.clear();
+
+    // Check that only the changed body is written and the timestamp is kept
+    manager->Notify("appName", id, "appIcon", "summary", "newBody", QStringList() << "action", hints, 0);
+    QCOMPARE(notificationDatabaseCommands.count(), 1);
+    QCOMPARE(notificationDatabaseCommands.at(0), QString("UPDATE notifications SET body=? WHERE id=?"));
+    QCOMPARE(notificationDatabaseArgs.count(), 2);
+    QCOMPARE(notificationDatabaseArgs.at(0), QVariant("newBody"));
+    QCOMPARE(notificationDatabaseArgs.at(1).toUInt(), id);
+    QCOMPARE(manager->notification(id)->hints().value(NotificationManager::HINT_TIMESTAMP).toDateTime(), timestamp);
+    notificationDatabaseCommands.clear();
+    notificationDatabaseArgs.clear();
+
+    // Check that only the hints are written when a hint changes
+    hints.insert(NotificationManager::HINT_ITEM_COUNT, 2);
+    manager->Notify("appName", id, "appIcon", "summary", "newBody", QStringList() << "action", hints, 0);
+    QCOMPARE(notificationDatabaseCommands.count(), 1);
+    QCOMPARE(notificationDatabaseCommands.at(0), QString("UPDATE notifications SET hints=? WHERE id=?"));
+    QCOMPARE(NotificationDatabase::deserializeHints(notificationDatabaseArgs.at(0).toByteArray()).value(NotificationManager::HINT_ITEM_COUNT), QVariant(2));
+    QCOMPARE(notificationDatabaseArgs.at(1).toUInt(), id);
+}
+
+void Ut_NotificationManager::testUpdatingNotificationWithoutChangesDoesNotWrite()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    uint id = manager->Notify("appName", 0, "appIcon", "summary", "body", QStringList() << "action", QVariantHash(), 0);
+    notificationDatabaseCommands.clear();
+
+    // Check that the database is not touched but the notification is still reported modified
+    QSignalSpy spy(manager, SIGNAL(notificationModified(uint)));
+    QCOMPARE(manager->Notify("appName", id, "appIcon", "summary", "body", QStringList() << "action", QVariantHash(), 0), id);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(notificationDatabaseCommands.count(), 0);
+}
+
 void Ut_NotificationManager::testUpdatingInexistingNotification()
 {
     NotificationManager *manager = NotificationManager::instance();
@@ -635,15 +510,16 @@ void Ut_NotificationManager::testUpdatingInexistingNotification()
     uint id = manager->Notify("appName", 1, "appIcon", "summary", "body", QStringList(), QVariantHash(), 1);
     QCOMPARE(id, (uint)0);
     QCOMPARE(spy.count(), 0);
-    QCOMPARE(qSqlQueryPrepare.count(), 0);
+    QCOMPARE(notificationDatabaseCommands.count(), 0);
 }
 
 void Ut_NotificationManager::testRemovingExistingNotification()
 {
     NotificationManager *manager = NotificationManager::instance();
     uint id = manager->Notify("appName", 0, "appIcon", "summary", "body", QStringList(), QVariantHash(), 1);
-    qSqlQueryPrepare.clear();
-    qSqlQueryAddBindValue.clear();
+    manager->MarkNotificationDisplayed(id);
+    notificationDatabaseCommands.clear();
+    notificationDatabaseArgs.clear();
 
     QSignalSpy removedSpy(manager, SIGNAL(notificationRemoved(uint)));
     QSignalSpy closedSpy(manager, SIGNAL(NotificationClosed(uint,uint)));
@@ -653,16 +529,24 @@ void Ut_NotificationManager::testRemovingExistingNotification()
     QCOMPARE(closedSpy.count(), 1);
     QCOMPARE(closedSpy.last().at(0).toUInt(), id);
     QCOMPARE(closedSpy.last().at(1).toInt(), (int)NotificationManager::CloseNotificationCalled);
-    QCOMPARE(qSqlQueryPrepare.count(), 4);
-    QCOMPARE(qSqlQueryPrepare.at(0), QString("DELETE FROM notifications WHERE id=?"));
-    QCOMPARE(qSqlQueryPrepare.at(1), QString("DELETE FROM actions WHERE id=?"));
-    QCOMPARE(qSqlQueryPrepare.at(2), QString("DELETE FROM hints WHERE id=?"));
-    QCOMPARE(qSqlQueryPrepare.at(3), QString("DELETE FROM expiration WHERE id=?"));
-    QCOMPARE(qSqlQueryAddBindValue.count(), 4);
-    QCOMPARE(qSqlQueryAddBindValue.at(0).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(1).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(2).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(3).toUInt(), id);
+    QCOMPARE(notificationDatabaseCommands.count(), 2);
+    QCOMPARE(notificationDatabaseCommands.at(0), QString("DELETE FROM notifications WHERE id=?"));
+    QCOMPARE(notificationDatabaseCommands.at(1), QString("DELETE FROM expiration WHERE id=?"));
+    QCOMPARE(notificationDatabaseArgs.count(), 2);
+    QCOMPARE(notificationDatabaseArgs.at(0).toUInt(), id);
+    QCOMPARE(notificationDatabaseArgs.at(1).toUInt(), id);
+}
+
+void Ut_NotificationManager::testRemovingNotificationWithoutExpirationTime()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    uint id = manager->Notify("appName", 0, "appIcon", "summary", "body", QStringList(), QVariantHash(), 1);
+    notificationDatabaseCommands.clear();
+
+    // The notification has not been displayed so there is no expiration time to remove
+    manager->CloseNotification(id);
+    QCOMPARE(notificationDatabaseCommands.count(), 1);
+    QCOMPARE(notificationDatabaseCommands.at(0), QString("DELETE FROM notifications WHERE id=?"));
 }
 
 void Ut_NotificationManager::testRemovingInexistingNotification()
@@ -673,7 +557,7 @@ void Ut_NotificationManager::testRemovingInexistingNotification()
     manager->CloseNotification(1);
     QCOMPARE(removedSpy.count(), 0);
     QCOMPARE(closedSpy.count(), 0);
-    QCOMPARE(qSqlQueryPrepare.count(), 0);
+    QCOMPARE(notificationDatabaseCommands.count(), 0);
 }
 
 void Ut_NotificationManager::testServerInformation()
@@ -693,7 +577,7 @@ void Ut_NotificationManager::testModifyingCategoryDefinitionUpdatesNotifications
     NotificationManager *manager = NotificationManager::instance();
 
     // Check the signal connection
-    QCOMPARE(disconnect(manager->categoryDefinitionStore, SIGNAL(categoryDefinitionModified(QString)), manager, SLOT(updateNotificationsWithCategory(QString))), true);
+    QCOMPARE(disconnect(manager->categoryDefinitionStore, SIGNAL(categoryDefinitionsModified(QStringList)), manager, SLOT(updateNotificationsWithCategories(QStringList))), true);
 
     // Add two notifications, one with category "category1" and one with category "category2"
     QVariantHash hints1;
@@ -708,10 +592,11 @@ void Ut_NotificationManager::testModifyingCategoryDefinitionUpdatesNotifications
     uint id2 = manager->Notify("app2", 0, QString(), QString(), QString(), QStringList(), hints2, 0);
 
     // Updating notifications with category "category2" should only update the notification with that category
-    QSignalSpy modifiedSpy(manager, SIGNAL(notificationModified(uint)));
-    manager->updateNotificationsWithCategory("category2");
+    QSignalSpy modifiedSpy(manager, SIGNAL(notificationsModified(QList<uint>)));
+    manager->updateNotificationsWithCategories(QStringList() << "category2" << "category3");
     QCOMPARE(modifiedSpy.count(), 1);
-    QCOMPARE(modifiedSpy.last().at(0).toUInt(), id2);
+    QCOMPARE(modifiedSpy.last().at(0).value<QList<uint> >(), QList<uint>() << id2);
+    QCOMPARE(notificationDatabaseBatchCount, 1);
 
     // The preview summary and body should be removed for the notification in category "category2"
     QCOMPARE(manager->notification(id1)->previewBody(), QString("previewBody1"));
@@ -725,7 +610,7 @@ void Ut_NotificationManager::testUninstallingCategoryDefinitionRemovesNotificati
     NotificationManager *manager = NotificationManager::instance();
 
     // Check the signal connection
-    QCOMPARE(disconnect(manager->categoryDefinitionStore, SIGNAL(categoryDefinitionUninstalled(QString)), manager, SLOT(removeNotificationsWithCategory(QString))), true);
+    QCOMPARE(disconnect(manager->categoryDefinitionStore, SIGNAL(categoryDefinitionsUninstalled(QStringList)), manager, SLOT(removeNotificationsWithCategories(QStringList))), true);
 
     // Add two notifications, one with category "category1" and one with category "category2"
     QVariantHash hints1;
@@ -737,7 +622,7 @@ void Ut_NotificationManager::testUninstallingCategoryDefinitionRemovesNotificati
 
     // Removing notifications with category "category2" should only remove the notification with that category
     QSignalSpy removedSpy(manager, SIGNAL(notificationRemoved(uint)));
-    manager->removeNotificationsWithCategory("category2");
+    manager->removeNotificationsWithCategories(QStringList() << "category2" << "category3");
     QCOMPARE(removedSpy.count(), 1);
     QCOMPARE(removedSpy.last().at(0).toUInt(), id2);
     QVERIFY(manager->notification(id1) != 0);
@@ -852,8 +737,8 @@ void Ut_NotificationManager::testInvokingActionRemovesNotificationIfUserRemovabl
     uint id = manager->Notify("app2", 0, QString(), QString(), QString(), QStringList(), hints, 0);
     LipstickNotification *notification = manager->notification(id);
     connect(this, SIGNAL(actionInvoked(QString)), notification, SIGNAL(actionInvoked(QString)));
-    qSqlQueryPrepare.clear();
-    qSqlQueryAddBindValue.clear();
+    notificationDatabaseCommands.clear();
+    notificationDatabaseArgs.clear();
 
     // Make the notifications emit the actionInvoked() signal for action "action"; removable notifications should get removed but non-closeable should not be closed
     QSignalSpy removedSpy(manager, SIGNAL(notificationRemoved(uint)));
@@ -865,12 +750,11 @@ void Ut_NotificationManager::testInvokingActionRemovesNotificationIfUserRemovabl
     QCOMPARE(closedSpy.count(), 0);
 
     // Check that the notification was marked hidden
-    QCOMPARE(qSqlQueryPrepare.count(), 1);
-    QCOMPARE(qSqlQueryPrepare.at(0), QString("INSERT INTO hints VALUES (?, ?, ?)"));
-    QCOMPARE(qSqlQueryAddBindValue.count(), 3);
-    QCOMPARE(qSqlQueryAddBindValue.at(0).toUInt(), id);
-    QCOMPARE(qSqlQueryAddBindValue.at(1), QVariant(NotificationManager::HINT_HIDDEN));
-    QCOMPARE(qSqlQueryAddBindValue.at(2), QVariant(true));
+    QCOMPARE(notificationDatabaseCommands.count(), 1);
+    QCOMPARE(notificationDatabaseCommands.at(0), QString("UPDATE notifications SET hints=? WHERE id=?"));
+    QCOMPARE(notificationDatabaseArgs.count(), 2);
+    QCOMPARE(NotificationDatabase::deserializeHints(notificationDatabaseArgs.at(0).toByteArray()).value(NotificationManager::HINT_HIDDEN), QVariant(true));
+    QCOMPARE(notificationDatabaseArgs.at(1).toUInt(), id);
 }
 
 void Ut_NotificationManager::testListingNotifications()
@@ -1011,15 +895,6 @@ void Ut_NotificationManager::testDelayedExpiration()
     uint id1 = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 200);
     uint id2 = manager->Notify("app2", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 100);
 
-    QueryValues expirationValues1, expirationValues2;
-    expirationValues1.insert(0, id1);
-    expirationValues1.insert(1, QDateTime::currentDateTimeUtc().toMSecsSinceEpoch() + 200);
-    expirationValues2.insert(0, id2);
-    expirationValues2.insert(1, QDateTime::currentDateTimeUtc().toMSecsSinceEpoch() + 100);
-
-    qSqlQueryValues.clear();
-    qSqlQueryValues["SELECT * FROM expiration"] = QueryValueList() << expirationValues1;
-
     QSignalSpy removedSpy(manager, SIGNAL(notificationRemoved(uint)));
     QSignalSpy closedSpy(manager, SIGNAL(NotificationClosed(uint,uint)));
     manager->MarkNotificationDisplayed(id1);
@@ -1027,7 +902,6 @@ void Ut_NotificationManager::testDelayedExpiration()
     QCOMPARE(removedSpy.count(), 0);
     QCOMPARE(closedSpy.count(), 0);
 
-    qSqlQueryValues["SELECT * FROM expiration"] = QueryValueList() << expirationValues1 << expirationValues2;
     manager->MarkNotificationDisplayed(id2);
 
     QCoreApplication::processEvents();
@@ -1040,8 +914,6 @@ void Ut_NotificationManager::testDelayedExpiration()
     QCOMPARE(closedSpy.last().at(0).toUInt(), id2);
     QCOMPARE(closedSpy.last().at(1).toUInt(), static_cast<uint>(NotificationManager::NotificationExpired));
 
-    qSqlQueryValues["SELECT * FROM expiration"] = QueryValueList() << expirationValues1;
-
     QTRY_COMPARE(removedSpy.count(), 2);
     QCOMPARE(removedSpy.last().at(0).toUInt(), id1);
     QCOMPARE(closedSpy.count(), 2);
@@ -1049,4 +921,891 @@ void Ut_NotificationManager::testDelayedExpiration()
     QCOMPARE(closedSpy.last().at(1).toUInt(), static_cast<uint>(NotificationManager::NotificationExpired));
 }
 
+void Ut_NotificationManager::testExpirationIsNotRescheduledWhenDisplayedAgain()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    uint id = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 10000);
+    manager->MarkNotificationDisplayed(id);
+    notificationDatabaseCommands.clear();
+
+    // Displaying the notification again should keep the original expiration time
+    manager->MarkNotificationDisplayed(id);
+    QCOMPARE(notificationDatabaseCommands.count(), 0);
+}
+
+void Ut_NotificationManager::testExpiredNotificationsAreClosedInExpirationOrder()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QList<uint> ids;
+    for (int i = 0; i < 5; ++i) {
+        ids.append(manager->Notify("app", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 10000));
+        manager->MarkNotificationDisplayed(ids.last());
+    }
+
+    // Replacing a notification cancels its scheduled expiration
+    manager->Notify("app", ids.at(2), QString(), QString(), "body", QStringList(), QVariantHash(), 10000);
+
+    // Move the expiration times of the rest to the past in reverse order
+    const qint64 currentTime = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch();
+    for (int i = 0; i < 5; ++i) {
+        if (i != 2) {
+            manager->scheduleExpiration(ids.at(i), currentTime - i);
+        }
+    }
+
+    QSignalSpy closedSpy(manager, SIGNAL(NotificationClosed(uint,uint)));
+    manager->expire();
+    QCOMPARE(closedSpy.count(), 4);
+    QCOMPARE(closedSpy.at(0).at(0).toUInt(), ids.at(4));
+    QCOMPARE(closedSpy.at(1).at(0).toUInt(), ids.at(3));
+    QCOMPARE(closedSpy.at(2).at(0).toUInt(), ids.at(1));
+    QCOMPARE(closedSpy.at(3).at(0).toUInt(), ids.at(0));
+    QVERIFY(manager->notification(ids.at(2)) != 0);
+    QCOMPARE(manager->expirationTimes.isEmpty(), true);
+}
+
+void Ut_NotificationManager::testClosingNotificationsIsBatched()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    uint id1 = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 10000);
+    uint id2 = manager->Notify("app2", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 10000);
+    uint id3 = manager->Notify("app3", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    manager->MarkNotificationDisplayed(id1);
+    manager->MarkNotificationDisplayed(id2);
+    manager->MarkNotificationDisplayed(id3);
+    notificationDatabaseCommands.clear();
+    notificationDatabaseArgs.clear();
+
+    QSignalSpy removedSpy(manager, SIGNAL(notificationsRemoved(QList<uint>)));
+    manager->CloseNotifications(QList<uint>() << id1 << id2 << id3 << id3 + 1);
+    QCOMPARE(notificationDatabaseCommands.count(), 2);
+    QCOMPARE(notificationDatabaseCommands.at(0), QString("DELETE FROM notifications WHERE id IN (?, ?, ?)"));
+    QCOMPARE(notificationDatabaseCommands.at(1), QString("DELETE FROM expiration WHERE id IN (?, ?)"));
+    QCOMPARE(notificationDatabaseArgs.count(), 5);
+    QCOMPARE(notificationDatabaseBatchCount, 1);
+    QCOMPARE(notificationDatabaseOpenBatches, 0);
+
+    // Only the notifications which actually existed are reported as removed
+    QCOMPARE(removedSpy.count(), 1);
+    QCOMPARE(removedSpy.at(0).at(0).value<QList<uint> >(), QList<uint>() << id1 << id2 << id3);
+
+    // Closing nonexistent notifications does nothing
+    manager->CloseNotifications(QList<uint>() << id1 << id2);
+    QCOMPARE(notificationDatabaseCommands.count(), 2);
+    QCOMPARE(notificationDatabaseBatchCount, 1);
+    QCOMPARE(removedSpy.count(), 1);
+}
+
+void Ut_NotificationManager::testNotifyManyAddsNotificationsInOneBatch()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    uint existingId = manager->Notify("app", 0, QString(), "summary", "body", QStringList(), QVariantHash(), 0);
+    notificationDatabaseCommands.clear();
+    notificationDatabaseArgs.clear();
+
+    LipstickNotification notification1("app1", 0, "icon1", "summary1", "body1", QStringList() << "action1", QVariantHash(), 0);
+    LipstickNotification notification2("app2", existingId, "icon2", "summary2", "body2", QStringList(), QVariantHash(), 0);
+    LipstickNotification notification3("app3", existingId + 100, "icon3", "summary3", "body3", QStringList(), QVariantHash(), 0);
+    QSignalSpy modifiedSpy(manager, SIGNAL(notificationModified(uint)));
+    QSignalSpy batchModifiedSpy(manager, SIGNAL(notificationsModified(QList<uint>)));
+    QList<uint> ids = manager->NotifyMany(NotificationList(QList<LipstickNotification *>() << &notification1 << &notification2 << &notification3));
+
+    // Check that a new ID is returned for the new notification, the replaced ID for the replaced one and 0 for the nonexistent one
+    QCOMPARE(ids.count(), 3);
+    QVERIFY(ids.at(0) != 0);
+    QVERIFY(ids.at(0) != existingId);
+    QCOMPARE(ids.at(1), existingId);
+    QCOMPARE(ids.at(2), 0u);
+    QCOMPARE(manager->notification(ids.at(0))->summary(), QString("summary1"));
+    QCOMPARE(manager->notification(existingId)->summary(), QString("summary2"));
+
+    // Check that the database modifications are done in one batch
+    QCOMPARE(notificationDatabaseCommands.count(), 2);
+    QCOMPARE(notificationDatabaseCommands.at(0), QString("INSERT INTO notifications VALUES (?, ?, ?, ?, ?, ?, ?, ?)"));
+    QCOMPARE(notificationDatabaseBatchCount, 1);
+    QCOMPARE(notificationDatabaseOpenBatches, 0);
+
+    // Check that a single signal is sent about the modifications
+    QCOMPARE(modifiedSpy.count(), 0);
+    QCOMPARE(batchModifiedSpy.count(), 1);
+    QCOMPARE(batchModifiedSpy.at(0).at(0).value<QList<uint> >(), QList<uint>() << ids.at(0) << existingId);
+}
+
+void Ut_NotificationManager::testUpdatesFromDBusAreCoalesced()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QSignalSpy modifiedSpy(manager, SIGNAL(notificationModified(uint)));
+    QSignalSpy batchModifiedSpy(manager, SIGNAL(notificationsModified(QList<uint>)));
+
+    // Check that the first update is handled right away
+    uint id = manager->throttledNotify(":1.1", "app", 0, "icon", "summary1", "body", QStringList(), QVariantHash(), 0);
+    QVERIFY(id != 0);
+    QCOMPARE(modifiedSpy.count(), 1);
+    QCOMPARE(manager->notification(id)->summary(), QString("summary1"));
+
+    // Check that further updates during the coalescing interval are deferred and collapsed into the latest one
+    QCOMPARE(manager->throttledNotify(":1.1", "app", id, "icon", "summary2", "body", QStringList(), QVariantHash(), 0), id);
+    QCOMPARE(manager->throttledNotify(":1.1", "app", id, "icon", "summary3", "body", QStringList(), QVariantHash(), 0), id);
+    QCOMPARE(modifiedSpy.count(), 1);
+    QCOMPARE(manager->notification(id)->summary(), QString("summary1"));
+    QCOMPARE(manager->GetNotificationStatistics().value("coalesced").toUInt(), 1u);
+    QCOMPARE(manager->GetNotificationStatistics().value("deferred").toInt(), 1);
+
+    // Check that the latest update is handled when the coalescing interval ends
+    manager->processDeferredNotifications();
+    QCOMPARE(manager->notification(id)->summary(), QString("summary3"));
+    QCOMPARE(batchModifiedSpy.count(), 1);
+    QCOMPARE(batchModifiedSpy.at(0).at(0).value<QList<uint> >(), QList<uint>() << id);
+    QCOMPARE(manager->GetNotificationStatistics().value("deferred").toInt(), 0);
+
+    // Check that updating a nonexistent notification fails right away
+    QCOMPARE(manager->throttledNotify(":1.1", "app", id + 1, "icon", "summary", "body", QStringList(), QVariantHash(), 0), 0u);
+}
+
+void Ut_NotificationManager::testSendersExceedingRateLimitAreDeferred()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    manager->rateLimit = 0.001;
+    manager->rateLimitBurst = 2;
+    QSignalSpy batchModifiedSpy(manager, SIGNAL(notificationsModified(QList<uint>)));
+
+    // Check that notifications beyond the burst size get an ID but are not created yet
+    uint id1 = manager->throttledNotify(":1.1", "app", 0, "icon", "summary1", "body", QStringList(), QVariantHash(), 0);
+    uint id2 = manager->throttledNotify(":1.1", "app", 0, "icon", "summary2", "body", QStringList(), QVariantHash(), 0);
+    uint id3 = manager->throttledNotify(":1.1", "app", 0, "icon", "summary3", "body", QStringList(), QVariantHash(), 0);
+    QVERIFY(manager->notification(id1) != 0);
+    QVERIFY(manager->notification(id2) != 0);
+    QVERIFY(id3 != 0);
+    QVERIFY(id3 != id1 && id3 != id2);
+    QCOMPARE(manager->notification(id3), (LipstickNotification *)0);
+
+    // Check that other senders are not affected
+    uint id4 = manager->throttledNotify(":1.2", "app", 0, "icon", "summary4", "body", QStringList(), QVariantHash(), 0);
+    QVERIFY(id4 != id3);
+    QVERIFY(manager->notification(id4) != 0);
+
+    // Check that the deferred notification stays deferred until the sender gets a token
+    manager->processDeferredNotifications();
+    QCOMPARE(manager->notification(id3), (LipstickNotification *)0);
+    QCOMPARE(batchModifiedSpy.count(), 0);
+
+    manager->rateLimitBuckets[":1.1"].tokens = 1;
+    manager->processDeferredNotifications();
+    QVERIFY(manager->notification(id3) != 0);
+    QCOMPARE(manager->notification(id3)->summary(), QString("summary3"));
+    QCOMPARE(batchModifiedSpy.count(), 1);
+    QCOMPARE(batchModifiedSpy.at(0).at(0).value<QList<uint> >(), QList<uint>() << id3);
+}
+
+void Ut_NotificationManager::testDeferredNotificationsAreDroppedWhenTooMany()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    manager->rateLimit = 0.001;
+    manager->rateLimitBurst = 1;
+
+    manager->throttledNotify(":1.1", "app", 0, "icon", "summary", "body", QStringList(), QVariantHash(), 0);
+    for (int i = 0; i < 100; ++i) {
+        QVERIFY(manager->throttledNotify(":1.1", "app", 0, "icon", "summary", "body", QStringList(), QVariantHash(), 0) != 0);
+    }
+    QCOMPARE(manager->throttledNotify(":1.1", "app", 0, "icon", "summary", "body", QStringList(), QVariantHash(), 0), 0u);
+    QCOMPARE(manager->GetNotificationStatistics().value("dropped").toUInt(), 1u);
+    QCOMPARE(manager->GetNotificationStatistics().value("deferred").toInt(), 100);
+}
+
+void Ut_NotificationManager::testClosingDeferredNotification()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    manager->rateLimit = 0.001;
+    manager->rateLimitBurst = 1;
+
+    manager->throttledNotify(":1.1", "app", 0, "icon", "summary", "body", QStringList(), QVariantHash(), 0);
+    uint id = manager->throttledNotify(":1.1", "app", 0, "icon", "summary", "body", QStringList(), QVariantHash(), 0);
+    notificationDatabaseCommands.clear();
+
+    // Check that closing a deferred notification cancels it without touching the database
+    QSignalSpy closedSpy(manager, SIGNAL(NotificationClosed(uint,uint)));
+    manager->CloseNotification(id);
+    QCOMPARE(closedSpy.count(), 1);
+    QCOMPARE(closedSpy.at(0).at(0).toUInt(), id);
+    QCOMPARE(notificationDatabaseCommands.count(), 0);
+    QCOMPARE(manager->GetNotificationStatistics().value("deferred").toInt(), 0);
+
+    manager->rateLimitBuckets[":1.1"].tokens = 1;
+    manager->processDeferredNotifications();
+    QCOMPARE(manager->notification(id), (LipstickNotification *)0);
+}
+
+void Ut_NotificationManager::testBatchesCountAgainstRateLimit()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    manager->rateLimit = 0.001;
+    manager->rateLimitBurst = 1;
+    QSignalSpy batchModifiedSpy(manager, SIGNAL(notificationsModified(QList<uint>)));
+
+    // Check that a batch takes a single token however many notifications it has
+    QList<LipstickNotification *> notifications;
+    for (int i = 0; i < 3; ++i) {
+        notifications.append(new LipstickNotification("app", 0, "icon", QString("summary%1").arg(i), "body", QStringList(), QVariantHash(), 0, this));
+    }
+    QList<uint> ids(manager->throttledNotifyMany(":1.1", notifications));
+    QCOMPARE(ids.count(), 3);
+    foreach (uint id, ids) {
+        QVERIFY(manager->notification(id) != 0);
+    }
+    QCOMPARE(manager->GetNotificationStatistics().value("deferred").toInt(), 0);
+    QCOMPARE(batchModifiedSpy.count(), 1);
+    QCOMPARE(batchModifiedSpy.at(0).at(0).value<QList<uint> >(), ids);
+
+    // Check that a batch beyond the burst size is deferred like the notifications sent with Notify()
+    ids = manager->throttledNotifyMany(":1.1", notifications);
+    qDeleteAll(notifications);
+    QCOMPARE(ids.count(), 3);
+    foreach (uint id, ids) {
+        QVERIFY(id != 0);
+        QCOMPARE(manager->notification(id), (LipstickNotification *)0);
+    }
+    QCOMPARE(manager->GetNotificationStatistics().value("deferred").toInt(), 3);
+    QCOMPARE(batchModifiedSpy.count(), 1);
+}
+
+void Ut_NotificationManager::testBatchSupersedesDeferredUpdate()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    uint id = manager->throttledNotify(":1.1", "app", 0, "icon", "summary1", "body", QStringList(), QVariantHash(), 0);
+    QCOMPARE(manager->throttledNotify(":1.1", "app", id, "icon", "summary2", "body", QStringList(), QVariantHash(), 0), id);
+    QCOMPARE(manager->GetNotificationStatistics().value("deferred").toInt(), 1);
+
+    // Check that the batch replaces the notification right away and the deferred update is dropped
+    QList<LipstickNotification *> notifications;
+    notifications.append(new LipstickNotification("app", id, "icon", "summary3", "body", QStringList(), QVariantHash(), 0, this));
+    QCOMPARE(manager->throttledNotifyMany(":1.1", notifications), QList<uint>() << id);
+    qDeleteAll(notifications);
+    QCOMPARE(manager->notification(id)->summary(), QString("summary3"));
+    QCOMPARE(manager->GetNotificationStatistics().value("deferred").toInt(), 0);
+
+    manager->processDeferredNotifications();
+    QCOMPARE(manager->notification(id)->summary(), QString("summary3"));
+}
+
+void Ut_NotificationManager::testCategoryIndexFollowsNotificationChanges()
+{
+    NotificationManager *manager = NotificationManager::instance();
+
+    QVariantHash hints1;
+    QVariantHash hints2;
+    hints1.insert(NotificationManager::HINT_CATEGORY, "category1");
+    hints2.insert(NotificationManager::HINT_CATEGORY, "category2");
+    uint id1 = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), hints1, 0);
+    uint id2 = manager->Notify("app2", 0, QString(), QString(), QString(), QStringList(), hints1, 0);
+    QCOMPARE(manager->notificationIdsWithCategory("category1").toSet(), QSet<uint>() << id1 << id2);
+    QCOMPARE(manager->notificationIdsWithCategory("category2"), QList<uint>());
+
+    // Changing the category of a notification should move it in the index
+    manager->Notify("app1", id1, QString(), QString(), QString(), QStringList(), hints2, 0);
+    QCOMPARE(manager->notificationIdsWithCategory("category1"), QList<uint>() << id2);
+    QCOMPARE(manager->notificationIdsWithCategory("category2"), QList<uint>() << id1);
+
+    // Closing a notification should remove it from the index
+    manager->CloseNotification(id2);
+    QCOMPARE(manager->notificationIdsWithCategory("category1"), QList<uint>());
+    QVERIFY(!manager->notificationIdsByCategory.contains("category1"));
+}
+
+void Ut_NotificationManager::testSenderIdentityIsCached()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    NotificationManager::SenderIdentity identity;
+    identity.appName = "senderApp";
+    identity.appIcon = "senderIcon";
+    manager->senderIdentities.insert(":1.1", identity);
+
+    // Check that a missing application name and icon are taken from the cached identity
+    uint id = manager->throttledNotify(":1.1", QString(), 0, QString(), "summary", "body", QStringList(), QVariantHash(), 0);
+    QCOMPARE(manager->notification(id)->appName(), QString("senderApp"));
+    QCOMPARE(manager->notification(id)->appIcon(), QString("senderIcon"));
+    QCOMPARE(manager->senderIdentityHits, 1u);
+    QCOMPARE(manager->senderIdentityMisses, 0u);
+
+    // Check that given properties take precedence and don't need the identity
+    id = manager->throttledNotify(":1.1", "app", 0, "icon", "summary", "body", QStringList(), QVariantHash(), 0);
+    QCOMPARE(manager->notification(id)->appName(), QString("app"));
+    QCOMPARE(manager->notification(id)->appIcon(), QString("icon"));
+    QCOMPARE(manager->senderIdentityHits, 1u);
+
+    // Check that the identity is forgotten when the sender disconnects
+    QCOMPARE(disconnect(manager->senderWatcher, SIGNAL(serviceUnregistered(QString)), manager, SLOT(removeSenderIdentity(QString))), true);
+    manager->removeSenderIdentity(":1.1");
+    QVERIFY(!manager->senderIdentities.contains(":1.1"));
+}
+
+void Ut_NotificationManager::testNewSenderIsIdentifiedAsynchronously()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QSignalSpy modifiedSpy(manager, SIGNAL(notificationModified(uint)));
+    QSignalSpy batchModifiedSpy(manager, SIGNAL(notificationsModified(QList<uint>)));
+
+    // Check that the notification of an unidentified sender gets an ID but waits for the identity
+    uint id = manager->throttledNotify(":1.1", QString(), 0, QString(), "summary", "body", QStringList(), QVariantHash(), 0);
+    QVERIFY(id != 0);
+    QCOMPARE(manager->notification(id), (LipstickNotification *)0);
+    QCOMPARE(modifiedSpy.count(), 0);
+    QVERIFY(manager->senderIdentityLookups.contains(":1.1"));
+    QCOMPARE(manager->GetNotificationStatistics().value("deferred").toInt(), 1);
+
+    // Check that the notification is not handled before the lookup has finished
+    manager->processDeferredNotifications();
+    QCOMPARE(manager->notification(id), (LipstickNotification *)0);
+    QCOMPARE(batchModifiedSpy.count(), 0);
+
+    // Check that the notification is handled with the identity once the process ID arrives
+    QDBusMessage pidReply(QDBusMessage::createMethodCall("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", "GetConnectionUnixProcessID").createReply(QVariant::fromValue<uint>(QCoreApplication::applicationPid())));
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusPendingCall::fromCompletedCall(pidReply), manager);
+    watcher->setProperty("sender", ":1.1");
+    manager->handleSenderPidReply(watcher);
+    QVERIFY(!manager->senderIdentityLookups.contains(":1.1"));
+    QCOMPARE(manager->senderIdentities.value(":1.1").appName, QCoreApplication::applicationName());
+
+    manager->processDeferredNotifications();
+    QVERIFY(manager->notification(id) != 0);
+    QCOMPARE(manager->notification(id)->appName(), QCoreApplication::applicationName());
+    QCOMPARE(batchModifiedSpy.count(), 1);
+    QCOMPARE(batchModifiedSpy.at(0).at(0).value<QList<uint> >(), QList<uint>() << id);
+
+    // Check that the notification of a sender which disconnects before being identified is handled without the identity
+    id = manager->throttledNotify(":1.2", QString(), 0, QString(), "summary", "body", QStringList(), QVariantHash(), 0);
+    QCOMPARE(manager->notification(id), (LipstickNotification *)0);
+    manager->removeSenderIdentity(":1.2");
+    manager->processDeferredNotifications();
+    QVERIFY(manager->notification(id) != 0);
+    QCOMPARE(manager->notification(id)->appName(), QString());
+    QCOMPARE(manager->senderIdentityMisses, 1u);
+}
+
+void Ut_NotificationManager::testImageDataIsStoredOutOfLine()
+{
+    gNotificationImageCacheStub->stubSetReturnValue("store", QString("/images/image.png"));
+    gNotificationImageCacheStub->stubSetReturnValue("contains", true);
+    NotificationManager *manager = NotificationManager::instance();
+
+    // Check that the image data is stored in the image cache and replaced by a reference
+    QVariantHash hints;
+    hints.insert(NotificationManager::HINT_IMAGE_DATA, QByteArray("imageData"));
+    uint id1 = manager->Notify("app", 0, QString(), "summary", "body", QStringList(), hints, 0);
+    QCOMPARE(gNotificationImageCacheStub->stubLastCallTo("store").parameter<QVariant>(0), QVariant(QByteArray("imageData")));
+    QVERIFY(!manager->notification(id1)->hints().contains(NotificationManager::HINT_IMAGE_DATA));
+    QCOMPARE(manager->notification(id1)->hints().value(NotificationManager::HINT_IMAGE_PATH).toString(), QString("/images/image.png"));
+    QVERIFY(!NotificationDatabase::deserializeHints(notificationDatabaseArgs.last().toByteArray()).contains(NotificationManager::HINT_IMAGE_DATA));
+    QCOMPARE(gNotificationImageCacheStub->stubCallCount("addReference"), 1);
+    QCOMPARE(gNotificationImageCacheStub->stubLastCallTo("addReference").parameter<QString>(0), QString("/images/image.png"));
+
+    // Check that each notification with the image refers to it
+    uint id2 = manager->Notify("app", 0, QString(), "summary", "body", QStringList(), hints, 0);
+    QCOMPARE(gNotificationImageCacheStub->stubCallCount("addReference"), 2);
+
+    // Check that replacing a notification with the same image keeps the reference
+    manager->Notify("app", id2, QString(), "summary", "body2", QStringList(), hints, 0);
+    QCOMPARE(gNotificationImageCacheStub->stubCallCount("addReference"), 2);
+    QCOMPARE(gNotificationImageCacheStub->stubCallCount("releaseReference"), 0);
+
+    // Check that closing a notification releases the reference
+    manager->CloseNotification(id1);
+    QCOMPARE(gNotificationImageCacheStub->stubCallCount("releaseReference"), 1);
+    QCOMPARE(gNotificationImageCacheStub->stubLastCallTo("releaseReference").parameter<QString>(0), QString("/images/image.png"));
+
+    // Check that replacing a notification without the image releases the reference
+    manager->Notify("app", id2, QString(), "summary", "body", QStringList(), QVariantHash(), 0);
+    QCOMPARE(gNotificationImageCacheStub->stubCallCount("releaseReference"), 2);
+    manager->CloseNotification(id2);
+    QCOMPARE(gNotificationImageCacheStub->stubCallCount("releaseReference"), 2);
+}
+
+void Ut_NotificationManager::testImageDataIsKeptIfNotStored()
+{
+    gNotificationImageCacheStub->stubSetReturnValue("store", QString());
+    NotificationManager *manager = NotificationManager::instance();
+
+    // Check that image data the cache can't store stays in the hints
+    QVariantHash hints;
+    hints.insert(NotificationManager::HINT_IMAGE_DATA, QByteArray("imageData"));
+    uint id = manager->Notify("app", 0, QString(), "summary", "body", QStringList(), hints, 0);
+    QCOMPARE(manager->notification(id)->hints().value(NotificationManager::HINT_IMAGE_DATA), QVariant(QByteArray("imageData")));
+    QVERIFY(!manager->notification(id)->hints().contains(NotificationManager::HINT_IMAGE_PATH));
+    QCOMPARE(gNotificationImageCacheStub->stubCallCount("addReference"), 0);
+}
+
+void Ut_NotificationManager::testRestoredNotificationsReferToImages()
+{
+    gNotificationImageCacheStub->stubSetReturnValue("contains", true);
+    NotificationDatabase::Record record;
+    record.id = 1;
+    record.appName = "appName";
+    record.hints.insert(NotificationManager::HINT_IMAGE_PATH, "/images/image.png");
+    notificationDatabaseRecords << record;
+
+    // Check that the restored notifications refer to their images before the unreferenced images are removed
+    NotificationManager::instance();
+    QCOMPARE(gNotificationImageCacheStub->stubCallCount("addReference"), 1);
+    QCOMPARE(gNotificationImageCacheStub->stubLastCallTo("addReference").parameter<QString>(0), QString("/images/image.png"));
+    QCOMPARE(gNotificationImageCacheStub->stubCallCount("removeUnreferencedImages"), 1);
+}
+
+void Ut_NotificationManager::testGetNotificationsSinceReturnsChanges()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    uint id1 = manager->Notify("app", 0, QString(), "summary1", "body1", QStringList(), QVariantHash(), 0);
+    uint id2 = manager->Notify("app", 0, QString(), "summary2", "body2", QStringList(), QVariantHash(), 0);
+
+    QList<uint> removedIds;
+    quint64 serial1 = 0;
+    bool complete = false;
+    manager->GetNotificationsSince(0, removedIds, serial1, complete);
+    QCOMPARE(complete, true);
+
+    // Check that only the notifications changed after the serial are returned
+    uint id3 = manager->Notify("app", 0, QString(), "summary3", "body3", QStringList(), QVariantHash(), 0);
+    manager->Notify("app", id1, QString(), "summary1", "modified", QStringList(), QVariantHash(), 0);
+    quint64 serial2 = 0;
+    QList<LipstickNotification *> notifications(manager->GetNotificationsSince(serial1, removedIds, serial2, complete).notifications());
+    QCOMPARE(complete, false);
+    QVERIFY(serial2 > serial1);
+    QCOMPARE(notifications.count(), 2);
+    QCOMPARE(notifications.at(0)->replacesId(), id3);
+    QCOMPARE(notifications.at(1)->replacesId(), id1);
+    QCOMPARE(notifications.at(1)->body(), QString("modified"));
+    QVERIFY(removedIds.isEmpty());
+
+    // Check that closed notifications are reported as removed
+    manager->CloseNotification(id2);
+    quint64 serial3 = 0;
+    notifications = manager->GetNotificationsSince(serial2, removedIds, serial3, complete).notifications();
+    QCOMPARE(complete, false);
+    QCOMPARE(notifications.count(), 0);
+    QCOMPARE(removedIds, QList<uint>() << id2);
+
+    // Check that nothing is returned when nothing has changed
+    removedIds.clear();
+    quint64 serial4 = 0;
+    notifications = manager->GetNotificationsSince(serial3, removedIds, serial4, complete).notifications();
+    QCOMPARE(serial4, serial3);
+    QCOMPARE(notifications.count(), 0);
+    QVERIFY(removedIds.isEmpty());
+}
+
+void Ut_NotificationManager::testGetNotificationsSinceWithUnknownSerialReturnsAll()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    manager->Notify("app", 0, QString(), "summary", "body", QStringList(), QVariantHash(), 0);
+
+    QList<uint> removedIds;
+    quint64 serial = 0;
+    bool complete = false;
+    manager->GetNotificationsSince(0, removedIds, serial, complete);
+
+    // Check that a serial not handed out yet, such as one from an earlier instance, is not trusted
+    QCOMPARE(manager->GetNotificationsSince(serial + 1, removedIds, serial, complete).notifications().count(), 1);
+    QCOMPARE(complete, true);
+
+    // Check that a serial older than the oldest remembered closure is not trusted
+    quint64 oldSerial = serial;
+    for (int i = 0; i <= 1000; ++i) {
+        manager->CloseNotification(manager->Notify("app", 0, QString(), "summary", "body", QStringList(), QVariantHash(), 0));
+    }
+    QCOMPARE(manager->GetNotificationsSince(oldSerial, removedIds, serial, complete).notifications().count(), 1);
+    QCOMPARE(complete, true);
+    QVERIFY(removedIds.isEmpty());
+
+    // Check that the latest serial is still trusted
+    manager->GetNotificationsSince(serial, removedIds, serial, complete);
+    QCOMPARE(complete, false);
+}
+
+void Ut_NotificationManager::testGetNotificationsSinceDoesNotReturnRestoredNotifications()
+{
+    NotificationDatabase::Record record;
+    record.id = 1;
+    record.appName = "app";
+    notificationDatabaseRecords << record;
+    NotificationManager *manager = NotificationManager::instance();
+    quint64 serial = manager->changeSerial;
+
+    // Check that creating a restored notification later does not make it look changed
+    manager->restoreNextNotifications();
+    QVERIFY(manager->notification(1) != 0);
+    QList<uint> removedIds;
+    bool complete = true;
+    QCOMPARE(manager->GetNotificationsSince(serial, removedIds, serial, complete).notifications().count(), 0);
+    QCOMPARE(complete, false);
+}
+
+void Ut_NotificationManager::testVolatileNotificationsAreNotStored()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    hints.insert(NotificationManager::HINT_VOLATILE, true);
+    notificationDatabaseCommands.clear();
+
+    // Check that creating, updating, displaying and closing a volatile notification does not touch the database
+    uint id = manager->Notify("app", 0, QString(), "summary", "body", QStringList(), hints, 1000);
+    manager->Notify("app", id, QString(), "summary", "newBody", QStringList(), hints, 1000);
+    manager->MarkNotificationDisplayed(id);
+    manager->CloseNotification(id);
+    QVERIFY(notificationDatabaseCommands.isEmpty());
+    QCOMPARE(manager->GetNotificationStatistics().value("databaseWritesAvoided").toUInt(), 5u);
+
+    // Check that transient notifications are volatile as well
+    QVariantHash transientHints;
+    transientHints.insert(NotificationManager::HINT_TRANSIENT, true);
+    id = manager->Notify("app", 0, QString(), "summary", "body", QStringList(), transientHints, 0);
+    QCOMPARE(manager->GetNotificationStatistics().value("volatile").toInt(), 1);
+    manager->MarkNotificationDisplayed(id);
+    QVERIFY(notificationDatabaseCommands.isEmpty());
+    QCOMPARE(manager->GetNotificationStatistics().value("volatile").toInt(), 0);
+}
+
+void Ut_NotificationManager::testNotificationBecomingPersistentIsStored()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    hints.insert(NotificationManager::HINT_VOLATILE, true);
+    uint id = manager->Notify("app", 0, QString(), "summary", "body", QStringList(), hints, 0);
+    notificationDatabaseCommands.clear();
+
+    // Check that the whole notification is stored when it stops being volatile
+    hints.insert(NotificationManager::HINT_VOLATILE, false);
+    manager->Notify("app", id, QString(), "summary", "body", QStringList(), hints, 0);
+    QCOMPARE(notificationDatabaseCommands, QStringList() << "INSERT INTO notifications VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+    notificationDatabaseCommands.clear();
+
+    // Check that the stored notification is removed when it becomes volatile again
+    hints.insert(NotificationManager::HINT_VOLATILE, true);
+    manager->Notify("app", id, QString(), "summary", "body", QStringList(), hints, 0);
+    QCOMPARE(notificationDatabaseCommands, QStringList() << "DELETE FROM notifications WHERE id=?");
+}
+
+void Ut_NotificationManager::testMaintenanceIsScheduledWhenIdle()
+{
+    gQmDisplayStateStub->stubSetReturnValue("get", MeeGo::QmDisplayState::On);
+    gQmActivityStub->stubSetReturnValue("get", MeeGo::QmActivity::Active);
+    NotificationManager *manager = NotificationManager::instance();
+
+    // Check that nothing is scheduled while the device is in use
+    manager->scheduleMaintenance();
+    QCOMPARE(qTimerStartInstances.contains(&manager->maintenanceTimer), false);
+
+    // Check that the maintenance is scheduled when the display goes off
+    gQmDisplayStateStub->stubSetReturnValue("get", MeeGo::QmDisplayState::Off);
+    manager->scheduleMaintenance();
+    QCOMPARE(qTimerStartInstances.contains(&manager->maintenanceTimer), true);
+    qTimerStartInstances.clear();
+
+    // Check that the maintenance is scheduled when the device becomes inactive
+    gQmDisplayStateStub->stubSetReturnValue("get", MeeGo::QmDisplayState::Dimmed);
+    gQmActivityStub->stubSetReturnValue("get", MeeGo::QmActivity::Inactive);
+    manager->scheduleMaintenance();
+    QCOMPARE(qTimerStartInstances.contains(&manager->maintenanceTimer), true);
+}
+
+void Ut_NotificationManager::testMaintenanceIsPerformedOnlyWhenIdle()
+{
+    gQmDisplayStateStub->stubSetReturnValue("get", MeeGo::QmDisplayState::On);
+    gQmActivityStub->stubSetReturnValue("get", MeeGo::QmActivity::Active);
+    NotificationManager *manager = NotificationManager::instance();
+    uint id = manager->Notify("app", 0, QString(), "summary", "body", QStringList(), QVariantHash(), 0);
+    manager->CloseNotification(id);
+    QCOMPARE(manager->removedNotifications.count(), 1);
+
+    // Check that the removed notifications are not destroyed while the device is in use
+    manager->destroyRemovedNotificationsIfIdle();
+    manager->performMaintenance();
+    QCOMPARE(manager->removedNotifications.count(), 1);
+    QCOMPARE(notificationDatabaseMaintenanceCount, 0);
+
+    // Check that the removed notifications are destroyed and the database is maintained when the display is off
+    gQmDisplayStateStub->stubSetReturnValue("get", MeeGo::QmDisplayState::Off);
+    manager->performMaintenance();
+    QCOMPARE(manager->removedNotifications.count(), 0);
+    QCOMPARE(notificationDatabaseMaintenanceCount, 1);
+}
+
+void Ut_NotificationManager::testOldestNotificationsOfApplicationAreEvicted()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    manager->maxNotificationsPerApplication = 2;
+
+    QVariantHash criticalHints;
+    criticalHints.insert(NotificationManager::HINT_URGENCY, 2);
+    QVariantHash unremovableHints;
+    unremovableHints.insert(NotificationManager::HINT_USER_REMOVABLE, false);
+    uint id1 = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), criticalHints, 0);
+    uint id2 = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), unremovableHints, 0);
+    uint id3 = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    uint id4 = manager->Notify("app2", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+
+    // Check that critical and unremovable notifications are kept even if the limit is exceeded
+    QCOMPARE(manager->notificationIds().count(), 4);
+
+    // Check that the oldest evictable notification of the application is closed
+    QSignalSpy closedSpy(manager, SIGNAL(NotificationClosed(uint,uint)));
+    uint id5 = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    QCOMPARE(closedSpy.count(), 1);
+    QCOMPARE(closedSpy.last().at(0).toUInt(), id3);
+    QVERIFY(manager->notification(id1) != 0);
+    QVERIFY(manager->notification(id2) != 0);
+    QVERIFY(manager->notification(id4) != 0);
+    QVERIFY(manager->notification(id5) != 0);
+    QCOMPARE(manager->GetNotificationStatistics().value("evicted").toUInt(), 1u);
+
+    QVariantHash counts(manager->GetApplicationNotificationCounts());
+    QCOMPARE(counts.count(), 2);
+    QCOMPARE(counts.value("app1").toUInt(), 3u);
+    QCOMPARE(counts.value("app2").toUInt(), 1u);
+}
+
+void Ut_NotificationManager::testOldestNotificationsAreEvictedWhenTooMany()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    manager->maxNotifications = 3;
+
+    uint id1 = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    uint id2 = manager->Notify("app2", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    uint id3 = manager->Notify("app3", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+
+    // Updating a notification makes it the most recent one
+    manager->Notify("app1", id1, QString(), QString(), "body", QStringList(), QVariantHash(), 0);
+
+    // Check that the least recently changed notifications are closed in a single batch
+    QSignalSpy removedSpy(manager, SIGNAL(notificationsRemoved(QList<uint>)));
+    NotificationList notifications(QList<LipstickNotification *>()
+            << new LipstickNotification("app4", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0)
+            << new LipstickNotification("app4", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0));
+    manager->NotifyMany(notifications);
+    qDeleteAll(notifications.notifications());
+    QCOMPARE(manager->notification(id2), (LipstickNotification *)0);
+    QCOMPARE(manager->notification(id3), (LipstickNotification *)0);
+    QVERIFY(manager->notification(id1) != 0);
+    QCOMPARE(manager->notificationIds().count(), 3);
+    QCOMPARE(removedSpy.count(), 2);
+    QCOMPARE(removedSpy.at(0).at(0).value<QList<uint> >(), QList<uint>() << id2);
+    QCOMPARE(removedSpy.at(1).at(0).value<QList<uint> >(), QList<uint>() << id3);
+}
+
+void Ut_NotificationManager::testNotificationsEvictedWithinBatchAreNotReturned()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    manager->maxNotificationsPerApplication = 2;
+
+    QSignalSpy modifiedSpy(manager, SIGNAL(notificationsModified(QList<uint>)));
+    NotificationList notifications(QList<LipstickNotification *>()
+            << new LipstickNotification("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0)
+            << new LipstickNotification("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0)
+            << new LipstickNotification("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0));
+    QList<uint> ids(manager->NotifyMany(notifications));
+    qDeleteAll(notifications.notifications());
+
+    // Check that the notification evicted by a later one of the same batch is reported as not created
+    QCOMPARE(ids.count(), 3);
+    QCOMPARE(ids.at(0), (uint)0);
+    QVERIFY(ids.at(1) != 0);
+    QVERIFY(ids.at(2) != 0);
+    QCOMPARE(modifiedSpy.count(), 1);
+    QCOMPARE(modifiedSpy.last().at(0).value<QList<uint> >(), QList<uint>() << ids.at(1) << ids.at(2));
+    QCOMPARE(manager->notificationIds().count(), 2);
+}
+
+void Ut_NotificationManager::testPendingNotificationsCountAgainstApplicationLimit()
+{
+    for (uint id = 1; id <= 3; ++id) {
+        NotificationDatabase::Record record;
+        record.id = id;
+        record.appName = "app1";
+        notificationDatabaseRecords << record;
+    }
+    NotificationDatabase::Record record;
+    record.id = 4;
+    record.appName = "app2";
+    notificationDatabaseRecords << record;
+
+    // Check that the oldest restored notifications of the application are closed even if not created yet
+    NotificationManager *manager = NotificationManager::instance();
+    manager->maxNotificationsPerApplication = 2;
+    QSignalSpy closedSpy(manager, SIGNAL(NotificationClosed(uint,uint)));
+    uint id = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    QCOMPARE(closedSpy.count(), 2);
+    QCOMPARE(closedSpy.at(0).at(0).toUInt(), (uint)1);
+    QCOMPARE(closedSpy.at(1).at(0).toUInt(), (uint)2);
+    QVERIFY(manager->notification(id) != 0);
+
+    manager->restorePendingNotifications();
+    QCOMPARE(manager->notificationIds().count(), 3);
+    QVERIFY(manager->notification(3) != 0);
+    QVERIFY(manager->notification(4) != 0);
+}
+
+void Ut_NotificationManager::testPendingNotificationsCountAgainstTotalLimit()
+{
+    for (uint id = 1; id <= 3; ++id) {
+        NotificationDatabase::Record record;
+        record.id = id;
+        record.appName = "app1";
+        if (id == 1) {
+            record.hints.insert(NotificationManager::HINT_URGENCY, 2);
+        }
+        notificationDatabaseRecords << record;
+    }
+
+    // Check that the oldest evictable restored notifications are closed even if not created yet
+    NotificationManager *manager = NotificationManager::instance();
+    manager->maxNotifications = 2;
+    QSignalSpy closedSpy(manager, SIGNAL(NotificationClosed(uint,uint)));
+    uint id = manager->Notify("app2", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    QCOMPARE(closedSpy.count(), 2);
+    QCOMPARE(closedSpy.at(0).at(0).toUInt(), (uint)2);
+    QCOMPARE(closedSpy.at(1).at(0).toUInt(), (uint)3);
+
+    manager->restorePendingNotifications();
+    QCOMPARE(manager->notificationIds().count(), 2);
+    QVERIFY(manager->notification(1) != 0);
+    QVERIFY(manager->notification(id) != 0);
+}
+
+void Ut_NotificationManager::testPendingNotificationsAreEvictedOldestFirst()
+{
+    const QDateTime timestamp(QDateTime::currentDateTimeUtc());
+    for (uint id = 1; id <= 3; ++id) {
+        NotificationDatabase::Record record;
+        record.id = id;
+        record.appName = "app1";
+        record.hints.insert(NotificationManager::HINT_TIMESTAMP, timestamp.addSecs(-id));
+        notificationDatabaseRecords << record;
+    }
+
+    // Check that the restored notifications are closed in the order they were received rather than by ID
+    NotificationManager *manager = NotificationManager::instance();
+    manager->maxNotificationsPerApplication = 2;
+    QSignalSpy closedSpy(manager, SIGNAL(NotificationClosed(uint,uint)));
+    manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    QCOMPARE(closedSpy.count(), 2);
+    QCOMPARE(closedSpy.at(0).at(0).toUInt(), (uint)3);
+    QCOMPARE(closedSpy.at(1).at(0).toUInt(), (uint)2);
+
+    manager->restorePendingNotifications();
+    QVERIFY(manager->notification(1) != 0);
+}
+
+void Ut_NotificationManager::testChangesAreReportedOncePerIteration()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    uint id1 = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    uint id2 = manager->Notify("app2", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    QCOMPARE(qTimerStartInstances.contains(&manager->changeJournalTimer), true);
+    manager->flushChangeJournal();
+
+    QSignalSpy changedSpy(manager, SIGNAL(notificationsChanged(QList<uint>,QList<uint>,QList<uint>)));
+    uint id3 = manager->Notify("app3", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    manager->Notify("app1", id1, QString(), QString(), "body", QStringList(), QVariantHash(), 0);
+    manager->CloseNotification(id2);
+
+    // A notification added and removed during the same iteration is not reported and a modification of an added one is an addition
+    uint id4 = manager->Notify("app4", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0);
+    manager->CloseNotification(id4);
+    manager->Notify("app3", id3, QString(), QString(), "body", QStringList(), QVariantHash(), 0);
+    QCOMPARE(changedSpy.count(), 0);
+
+    manager->flushChangeJournal();
+    QCOMPARE(changedSpy.count(), 1);
+    QCOMPARE(changedSpy.last().at(0).value<QList<uint> >(), QList<uint>() << id3);
+    QCOMPARE(changedSpy.last().at(1).value<QList<uint> >(), QList<uint>() << id1);
+    QCOMPARE(changedSpy.last().at(2).value<QList<uint> >(), QList<uint>() << id2);
+
+    // Nothing is reported when nothing has changed
+    manager->flushChangeJournal();
+    QCOMPARE(changedSpy.count(), 1);
+}
+
+void Ut_NotificationManager::testClearingNotificationsIsReportedInOneBatch()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    manager->maxNotificationsPerApplication = 0;
+    QVariantHash uncloseableHints;
+    uncloseableHints.insert(NotificationManager::HINT_USER_CLOSEABLE, false);
+    QSet<uint> closeableIds;
+    QSet<uint> uncloseableIds;
+    for (int i = 0; i < 500; ++i) {
+        if (i % 2) {
+            uncloseableIds.insert(manager->Notify("app", 0, QString(), QString(), QString(), QStringList(), uncloseableHints, 0));
+        } else {
+            closeableIds.insert(manager->Notify("app", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 0));
+        }
+    }
+    manager->flushChangeJournal();
+    notificationDatabaseBatchCount = 0;
+    notificationDatabaseCommands.clear();
+
+    // The closeable notifications are closed and the uncloseable ones are hidden, both in a single transaction
+    QSignalSpy changedSpy(manager, SIGNAL(notificationsChanged(QList<uint>,QList<uint>,QList<uint>)));
+    manager->removeUserRemovableNotifications();
+    QCOMPARE(notificationDatabaseBatchCount, 2);
+    QCOMPARE(notificationDatabaseOpenBatches, 0);
+    QCOMPARE(notificationDatabaseCommands.count("UPDATE notifications SET hints=? WHERE id=?"), 250);
+
+    manager->flushChangeJournal();
+    QCOMPARE(changedSpy.count(), 1);
+    QCOMPARE(changedSpy.last().at(0).value<QList<uint> >(), QList<uint>());
+    QCOMPARE(changedSpy.last().at(1).value<QList<uint> >().toSet(), uncloseableIds);
+    QCOMPARE(changedSpy.last().at(2).value<QList<uint> >().toSet(), closeableIds);
+
+    // Hidden notifications are not written again
+    notificationDatabaseCommands.clear();
+    manager->removeUserRemovableNotifications();
+    QCOMPARE(notificationDatabaseCommands.count("UPDATE notifications SET hints=? WHERE id=?"), 0);
+}
+
+void Ut_NotificationManager::benchmarkNotify()
+{
+    NotificationManager *manager = NotificationManager::instance();
+
+    QStringList actions;
+    QVariantHash hints;
+    for (int i = 0; i < 4; ++i) {
+        actions << QString("action%1").arg(i) << QString("Action %1").arg(i);
+    }
+    for (int i = 0; i < 15; ++i) {
+        hints.insert(QString("hint%1").arg(i), QString("value%1").arg(i));
+    }
+
+    QBENCHMARK {
+        manager->Notify("app", 0, QString(), "summary", "body", actions, hints, 0);
+    }
+}
+
+void Ut_NotificationManager::benchmarkGetNotifications_data()
+{
+    QTest::addColumn<int>("notificationCount");
+
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+}
+
+void Ut_NotificationManager::benchmarkGetNotifications()
+{
+    QFETCH(int, notificationCount);
+
+    NotificationManager *manager = NotificationManager::instance();
+
+    // Only one of the notifications belongs to the owner being listed
+    QVariantHash hints;
+    for (int i = 0; i < notificationCount - 1; ++i) {
+        hints.insert(NotificationManager::HINT_OWNER, QString("owner%1").arg(i % 10));
+        manager->Notify("app", 0, QString(), "summary", "body", QStringList(), hints, 0);
+    }
+    hints.insert(NotificationManager::HINT_OWNER, "owner");
+    manager->Notify("app", 0, QString(), "summary", "body", QStringList(), hints, 0);
+
+    QBENCHMARK {
+        NotificationList notifications = manager->GetNotifications("owner");
+        QCOMPARE(notifications.notifications().count(), 1);
+    }
+}
+
 QTEST_MAIN(Ut_NotificationManager)
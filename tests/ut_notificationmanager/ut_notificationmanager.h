@@ -25,17 +25,20 @@ private slots:
     void init();
     void cleanup();
     void testManagerIsSingleton();
-    void testDatabaseConnectionSucceedsAndTablesAreOk();
-    void testDatabaseConnectionSucceedsAndTablesAreNotOk();
-    void testFirstDatabaseConnectionFails();
-    void testNotEnoughDiskSpaceToOpenDatabase();
     void testNotificationsAreRestoredOnConstruction();
-    void testDatabaseCommitIsDoneOnDestruction();
+    void testRestoredNotificationsAreCreatedInBatches();
+    void testPendingNotificationIsCreatedWhenReplaced();
+    void testPendingNotificationIsCreatedWhenClosed();
+    void testNewNotificationsDoNotReusePendingNotificationIds();
+    void testDatabaseIsClosedOnDestruction();
     void testCapabilities();
     void testAddingNotification();
     void testUpdatingExistingNotification();
+    void testUpdatingOnlyChangedColumns();
+    void testUpdatingNotificationWithoutChangesDoesNotWrite();
     void testUpdatingInexistingNotification();
     void testRemovingExistingNotification();
+    void testRemovingNotificationWithoutExpirationTime();
     void testRemovingInexistingNotification();
     void testServerInformation();
     void testModifyingCategoryDefinitionUpdatesNotifications();
@@ -50,6 +53,40 @@ private slots:
     void testRemoveRequested();
     void testImmediateExpiration();
     void testDelayedExpiration();
+    void testExpirationIsNotRescheduledWhenDisplayedAgain();
+    void testExpiredNotificationsAreClosedInExpirationOrder();
+    void testClosingNotificationsIsBatched();
+    void testNotifyManyAddsNotificationsInOneBatch();
+    void testUpdatesFromDBusAreCoalesced();
+    void testSendersExceedingRateLimitAreDeferred();
+    void testDeferredNotificationsAreDroppedWhenTooMany();
+    void testClosingDeferredNotification();
+    void testBatchesCountAgainstRateLimit();
+    void testBatchSupersedesDeferredUpdate();
+    void testCategoryIndexFollowsNotificationChanges();
+    void testSenderIdentityIsCached();
+    void testNewSenderIsIdentifiedAsynchronously();
+    void testImageDataIsStoredOutOfLine();
+    void testImageDataIsKeptIfNotStored();
+    void testRestoredNotificationsReferToImages();
+    void testGetNotificationsSinceReturnsChanges();
+    void testGetNotificationsSinceWithUnknownSerialReturnsAll();
+    void testGetNotificationsSinceDoesNotReturnRestoredNotifications();
+    void testVolatileNotificationsAreNotStored();
+    void testNotificationBecomingPersistentIsStored();
+    void testMaintenanceIsScheduledWhenIdle();
+    void testMaintenanceIsPerformedOnlyWhenIdle();
+    void testOldestNotificationsOfApplicationAreEvicted();
+    void testOldestNotificationsAreEvictedWhenTooMany();
+    void testNotificationsEvictedWithinBatchAreNotReturned();
+    void testPendingNotificationsCountAgainstApplicationLimit();
+    void testPendingNotificationsCountAgainstTotalLimit();
+    void testPendingNotificationsAreEvictedOldestFirst();
+    void testChangesAreReportedOncePerIteration();
+    void testClearingNotificationsIsReportedInOneBatch();
+    void benchmarkNotify();
+    void benchmarkGetNotifications_data();
+    void benchmarkGetNotifications();
 
 signals:
     void actionInvoked(QString action);
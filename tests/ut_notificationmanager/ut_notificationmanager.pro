@@ -1,8 +1,8 @@
 include(../common.pri)
 TARGET = ut_notificationmanager
-INCLUDEPATH += $$NOTIFICATIONSRCDIR
+INCLUDEPATH += $$NOTIFICATIONSRCDIR ../../src/qmsystem2
 CONFIG += link_pkgconfig
-QT += sql dbus
+QT += dbus
 PKGCONFIG += mlite5
 
 # unit test and unit
@@ -16,7 +16,11 @@ SOURCES += \
 HEADERS += \
     ut_notificationmanager.h \
     $$NOTIFICATIONSRCDIR/notificationmanager.h \
+    $$NOTIFICATIONSRCDIR/notificationdatabase.h \
+    $$NOTIFICATIONSRCDIR/notificationimagecache.h \
     $$NOTIFICATIONSRCDIR/lipsticknotification.h \
     $$NOTIFICATIONSRCDIR/notificationmanageradaptor.h \
-    $$NOTIFICATIONSRCDIR/categorydefinitionstore.h
+    $$NOTIFICATIONSRCDIR/categorydefinitionstore.h \
+    ../../src/qmsystem2/qmactivity.h \
+    ../../src/qmsystem2/qmdisplaystate.h
 
@@ -18,6 +18,7 @@
 #include <QQmlContext>
 #include <QScreen>
 #include "notificationmanager.h"
+#include "notificationdatabase.h"
 #include "ut_notificationpreviewpresenter.h"
 #include "notificationpreviewpresenter.h"
 #include "notificationfeedbackplayer_stub.h"
@@ -128,15 +129,31 @@ void NotificationManager::removeNotificationIfUserRemovable(uint)
 {
 }
 
-void NotificationManager::removeNotificationsWithCategory(const QString &)
+void NotificationManager::removeNotificationsWithCategories(const QStringList &)
 {
 }
 
-void NotificationManager::updateNotificationsWithCategory(const QString &)
+void NotificationManager::updateNotificationsWithCategories(const QStringList &)
 {
 }
 
-void NotificationManager::commit()
+void NotificationManager::destroyRemovedNotifications()
+{
+}
+
+void NotificationManager::destroyRemovedNotificationsIfIdle()
+{
+}
+
+void NotificationManager::scheduleMaintenance()
+{
+}
+
+void NotificationManager::performMaintenance()
+{
+}
+
+void NotificationManager::flushChangeJournal()
 {
 }
 
@@ -175,15 +192,31 @@ void NotificationManager::expire()
 {
 }
 
+void NotificationManager::restoreNextNotifications()
+{
+}
+
+void NotificationManager::processDeferredNotifications()
+{
+}
+
+void NotificationManager::handleSenderPidReply(QDBusPendingCallWatcher *)
+{
+}
+
+void NotificationManager::removeSenderIdentity(const QString &)
+{
+}
+
 enum Urgency { Low = 0, Normal = 1, Critical = 2 };
 
-LipstickNotification *createNotification(uint id, Urgency urgency = Normal)
+LipstickNotification *createNotification(uint id, Urgency urgency = Normal, const QString &appName = "ut_notificationpreviewpresenter")
 {
     QVariantHash hints;
     hints.insert(NotificationManager::HINT_PREVIEW_SUMMARY, "summary");
     hints.insert(NotificationManager::HINT_PREVIEW_BODY, "body");
     hints.insert(NotificationManager::HINT_URGENCY, static_cast<int>(urgency));
-    LipstickNotification *notification = new LipstickNotification("ut_notificationpreviewpresenter", id, "", "", "", QStringList(), hints, -1);
+    LipstickNotification *notification = new LipstickNotification(appName, id, "", "", "", QStringList(), hints, -1);
     notificationManagerNotification.insert(id, notification);
     return notification;
 }
@@ -217,6 +250,7 @@ void Ut_NotificationPreviewPresenter::testSignalConnections()
 {
     NotificationPreviewPresenter presenter;
     QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationModified(uint)), &presenter, SLOT(updateNotification(uint))), true);
+    QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationsModified(QList<uint>)), &presenter, SLOT(updateNotifications(QList<uint>))), true);
     QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationRemoved(uint)), &presenter, SLOT(removeNotification(uint))), true);
     QCOMPARE(disconnect(&presenter, SIGNAL(notificationPresented(uint)), presenter.notificationFeedbackPlayer, SLOT(addNotification(uint))), true);
 }
@@ -549,6 +583,104 @@ void Ut_NotificationPreviewPresenter::testCriticalNotificationIsMarkedAfterShowi
     QCOMPARE(notificationManagerCloseNotificationIds.count(), 0);
 }
 
+void Ut_NotificationPreviewPresenter::testCriticalNotificationIsShownBeforeEarlierNotifications()
+{
+    NotificationPreviewPresenter presenter;
+    createNotification(1);
+    createNotification(2, Low);
+    createNotification(3);
+    createNotification(4, Critical);
+    QTest::qWait(0);
+    presenter.updateNotification(1);
+    presenter.updateNotification(2);
+    presenter.updateNotification(3);
+    presenter.updateNotification(4);
+    QCOMPARE(presenter.notification()->replacesId(), (uint)1);
+    QCOMPARE(presenter.queueDepth(), 3);
+
+    // Check that the queued notifications are shown by urgency and then by arrival
+    presenter.showNextNotification();
+    QCOMPARE(presenter.notification()->replacesId(), (uint)4);
+    presenter.showNextNotification();
+    QCOMPARE(presenter.notification()->replacesId(), (uint)3);
+    presenter.showNextNotification();
+    QCOMPARE(presenter.notification()->replacesId(), (uint)2);
+    QCOMPARE(presenter.queueDepth(), 0);
+
+    QVariantHash statistics(presenter.statistics());
+    QCOMPARE(statistics.value("shown").toInt(), 4);
+    QCOMPARE(statistics.value("maximumQueueDepth").toInt(), 3);
+    QCOMPARE(statistics.value("queueDepth").toInt(), 0);
+}
+
+void Ut_NotificationPreviewPresenter::testNotificationsFromSameApplicationAreCoalesced()
+{
+    NotificationPreviewPresenter presenter;
+    presenter.setCoalescing(true);
+    createNotification(1, Normal, "app1");
+    createNotification(2, Normal, "app1");
+    createNotification(3, Normal, "app2");
+    createNotification(4, Normal, "app1");
+    createNotification(5, Critical, "app1");
+    QTest::qWait(0);
+    presenter.updateNotification(1);
+    presenter.updateNotification(2);
+    presenter.updateNotification(3);
+    presenter.updateNotification(4);
+    presenter.updateNotification(5);
+
+    // Check that the queued notification 2 was folded into notification 4 but the critical one was not
+    QCOMPARE(presenter.queueDepth(), 3);
+    QCOMPARE(notificationManagerDisplayedNotificationIds, QList<uint>() << 2);
+
+    presenter.showNextNotification();
+    QCOMPARE(presenter.notification()->replacesId(), (uint)5);
+    QCOMPARE(presenter.coalescedCount(), 0);
+
+    // Check that notification 4 took the place of notification 2 in the queue
+    presenter.showNextNotification();
+    QCOMPARE(presenter.notification()->replacesId(), (uint)4);
+    QCOMPARE(presenter.coalescedCount(), 1);
+
+    presenter.showNextNotification();
+    QCOMPARE(presenter.notification()->replacesId(), (uint)3);
+    QCOMPARE(presenter.coalescedCount(), 0);
+    QCOMPARE(presenter.statistics().value("coalesced").toInt(), 1);
+}
+
+void Ut_NotificationPreviewPresenter::testCoalescingFollowsApplicationNameChange()
+{
+    NotificationPreviewPresenter presenter;
+    presenter.setCoalescing(true);
+    createNotification(1, Normal, "app1");
+    LipstickNotification *notification = createNotification(2, Normal, "app1");
+    createNotification(3, Normal, "app1");
+    createNotification(4, Normal, "app2");
+    QTest::qWait(0);
+    presenter.updateNotification(1);
+    presenter.updateNotification(2);
+
+    // Move the queued notification to another application
+    notification->setAppName("app2");
+    presenter.updateNotification(2);
+
+    // Check that notification 2 is folded into a notification of its new application only
+    presenter.updateNotification(3);
+    QCOMPARE(presenter.queueDepth(), 2);
+    QCOMPARE(notificationManagerDisplayedNotificationIds, QList<uint>());
+    presenter.updateNotification(4);
+    QCOMPARE(presenter.queueDepth(), 2);
+    QCOMPARE(notificationManagerDisplayedNotificationIds, QList<uint>() << 2);
+
+    presenter.showNextNotification();
+    QCOMPARE(presenter.notification()->replacesId(), (uint)4);
+    QCOMPARE(presenter.coalescedCount(), 1);
+
+    presenter.showNextNotification();
+    QCOMPARE(presenter.notification()->replacesId(), (uint)3);
+    QCOMPARE(presenter.queueDepth(), 0);
+}
+
 QWaylandSurface *surface = (QWaylandSurface *)1;
 void Ut_NotificationPreviewPresenter::testNotificationPreviewsDisabled_data()
 {
@@ -38,6 +38,9 @@ private slots:
     void testNotificationNotShownIfTouchScreenIsLockedAndDisplayIsOff_data();
     void testNotificationNotShownIfTouchScreenIsLockedAndDisplayIsOff();
     void testCriticalNotificationIsMarkedAfterShowing();
+    void testCriticalNotificationIsShownBeforeEarlierNotifications();
+    void testNotificationsFromSameApplicationAreCoalesced();
+    void testCoalescingFollowsApplicationNameChange();
     void testNotificationPreviewsDisabled_data();
     void testNotificationPreviewsDisabled();
 };
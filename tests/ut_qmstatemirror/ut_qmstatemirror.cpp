@@ -0,0 +1,164 @@
+/***************************************************************************
+**
+** Copyright (C) 2013 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCall>
+#include "ut_qmstatemirror.h"
+#include "qmstatemirror_p.h"
+#include "qmlocks_p.h"
+
+#include <dsme/thermalmanager_dbus_if.h>
+
+using namespace MeeGo;
+
+bool QDBusConnection::connect(const QString &, const QString &, const QString &, const QString &, QObject *, const char *)
+{
+    return true;
+}
+
+QList<QDBusMessage> qDBusConnectionAsyncCallMessages;
+QHash<QString, QVariant> qDBusConnectionAsyncCallReplies;
+QDBusPendingCall QDBusConnection::asyncCall(const QDBusMessage &message, int) const
+{
+    qDBusConnectionAsyncCallMessages.append(message);
+    if (qDBusConnectionAsyncCallReplies.contains(message.member())) {
+        return QDBusPendingCall::fromCompletedCall(message.createReply(qDBusConnectionAsyncCallReplies.value(message.member())));
+    }
+    return QDBusPendingCall::fromCompletedCall(message.createErrorReply(QDBusError::ServiceUnknown, "Service unknown"));
+}
+
+static int asyncCallCount(const QString &method)
+{
+    int count = 0;
+    foreach (const QDBusMessage &message, qDBusConnectionAsyncCallMessages) {
+        if (message.member() == method) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void Ut_QmStateMirror::init()
+{
+    qDBusConnectionAsyncCallReplies.insert(MCE_DISPLAY_STATUS_GET, QString(MCE_DISPLAY_ON_STRING));
+    qDBusConnectionAsyncCallReplies.insert(MCE_INACTIVITY_STATUS_GET, false);
+    mirror = new QmStateMirror;
+}
+
+void Ut_QmStateMirror::cleanup()
+{
+    delete mirror;
+    qDBusConnectionAsyncCallMessages.clear();
+    qDBusConnectionAsyncCallReplies.clear();
+}
+
+void Ut_QmStateMirror::testInitialValuesAreFetched()
+{
+    QCOMPARE(qDBusConnectionAsyncCallMessages.count(), (int)QmStateMirror::KeyCount);
+    QSignalSpy spy(mirror, SIGNAL(fetched(int, const QVariant&)));
+
+    // Values nobody has been given yet are not reported as changed when they arrive
+    QCoreApplication::processEvents();
+    QCOMPARE(spy.count(), 0);
+    QCOMPARE(mirror->value(QmStateMirror::DisplayState), QVariant(QString(MCE_DISPLAY_ON_STRING)));
+    QCOMPARE(mirror->value(QmStateMirror::Inactivity), QVariant(false));
+
+    // Known values are read without further calls
+    QCOMPARE(asyncCallCount(MCE_DISPLAY_STATUS_GET), 1);
+}
+
+void Ut_QmStateMirror::testFirstReadWaitsForReply()
+{
+    QSignalSpy spy(mirror, SIGNAL(fetched(int, const QVariant&)));
+
+    // The replies are delivered only once the event loop runs, so the first read has to wait for the pending call
+    QCOMPARE(mirror->value(QmStateMirror::DisplayState), QVariant(QString(MCE_DISPLAY_ON_STRING)));
+    QCOMPARE(asyncCallCount(MCE_DISPLAY_STATUS_GET), 1);
+
+    QCoreApplication::processEvents();
+    QCOMPARE(mirror->value(QmStateMirror::DisplayState), QVariant(QString(MCE_DISPLAY_ON_STRING)));
+    QCOMPARE(spy.count(), 0);
+}
+
+void Ut_QmStateMirror::testFailedFetchIsRetriedOnRead()
+{
+    QCoreApplication::processEvents();
+    QVERIFY(!mirror->entries[QmStateMirror::ThermalState].initialized);
+    QVERIFY(!mirror->entries[QmStateMirror::ThermalState].updated.isValid());
+
+    qDBusConnectionAsyncCallReplies.insert(thermalmanager_get_thermal_state, QString(thermalmanager_thermal_status_normal));
+    QCOMPARE(mirror->value(QmStateMirror::ThermalState), QVariant(QString(thermalmanager_thermal_status_normal)));
+    QCOMPARE(asyncCallCount(thermalmanager_get_thermal_state), 2);
+
+    QCoreApplication::processEvents();
+    QCOMPARE(mirror->value(QmStateMirror::ThermalState), QVariant(QString(thermalmanager_thermal_status_normal)));
+    QCOMPARE(asyncCallCount(thermalmanager_get_thermal_state), 2);
+}
+
+void Ut_QmStateMirror::testFailedFetchIsRetriedWhenServiceAppears()
+{
+    QCoreApplication::processEvents();
+    QVERIFY(!mirror->entries[QmStateMirror::DeviceLock].initialized);
+
+    qDBusConnectionAsyncCallReplies.insert(DEVLOCK_GET, DEVLOCK_LOCK_STATE_LOCKED);
+    mirror->serviceRegistered(DEVLOCK_SERVICE);
+    QCOMPARE(asyncCallCount(DEVLOCK_GET), 2);
+    QCOMPARE(asyncCallCount(MCE_DISPLAY_STATUS_GET), 1);
+
+    QCoreApplication::processEvents();
+    QVERIFY(mirror->entries[QmStateMirror::DeviceLock].initialized);
+    QCOMPARE(mirror->value(QmStateMirror::DeviceLock), QVariant(DEVLOCK_LOCK_STATE_LOCKED));
+    QCOMPARE(asyncCallCount(DEVLOCK_GET), 2);
+}
+
+void Ut_QmStateMirror::testChangeSignalOverridesPendingReply()
+{
+    mirror->update(QmStateMirror::DisplayState, QString(MCE_DISPLAY_OFF_STRING));
+    QSignalSpy spy(mirror, SIGNAL(fetched(int, const QVariant&)));
+
+    QCoreApplication::processEvents();
+    QCOMPARE(mirror->value(QmStateMirror::DisplayState), QVariant(QString(MCE_DISPLAY_OFF_STRING)));
+    QCOMPARE(spy.count(), 0);
+}
+
+void Ut_QmStateMirror::testChangedFetchedValueIsReported()
+{
+    QCOMPARE(mirror->value(QmStateMirror::DisplayState), QVariant(QString(MCE_DISPLAY_ON_STRING)));
+    QSignalSpy spy(mirror, SIGNAL(fetched(int, const QVariant&)));
+
+    // A refetched value differing from the one given to the callers is reported
+    qDBusConnectionAsyncCallReplies.insert(MCE_DISPLAY_STATUS_GET, QString(MCE_DISPLAY_OFF_STRING));
+    mirror->serviceRegistered(MCE_SERVICE);
+    QCoreApplication::processEvents();
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toInt(), (int)QmStateMirror::DisplayState);
+    QCOMPARE(spy.at(0).at(1), QVariant(QString(MCE_DISPLAY_OFF_STRING)));
+}
+
+void Ut_QmStateMirror::testUnchangedFetchedValueIsNotReported()
+{
+    QCoreApplication::processEvents();
+    QCOMPARE(mirror->value(QmStateMirror::DisplayState), QVariant(QString(MCE_DISPLAY_ON_STRING)));
+    QSignalSpy spy(mirror, SIGNAL(fetched(int, const QVariant&)));
+
+    mirror->serviceRegistered(MCE_SERVICE);
+    QCoreApplication::processEvents();
+    QCOMPARE(asyncCallCount(MCE_DISPLAY_STATUS_GET), 2);
+    QCOMPARE(spy.count(), 0);
+}
+
+QTEST_MAIN(Ut_QmStateMirror)
@@ -0,0 +1,45 @@
+/***************************************************************************
+**
+** Copyright (C) 2013 Jolla Ltd.
+** Contact: Robin Burchell <robin.burchell@jollamobile.com>
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef UT_QMSTATEMIRROR_H
+#define UT_QMSTATEMIRROR_H
+
+#include <QObject>
+
+namespace MeeGo {
+class QmStateMirror;
+}
+
+class Ut_QmStateMirror : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testInitialValuesAreFetched();
+    void testFirstReadWaitsForReply();
+    void testFailedFetchIsRetriedOnRead();
+    void testFailedFetchIsRetriedWhenServiceAppears();
+    void testChangeSignalOverridesPendingReply();
+    void testChangedFetchedValueIsReported();
+    void testUnchangedFetchedValueIsNotReported();
+
+private:
+    MeeGo::QmStateMirror *mirror;
+};
+
+#endif
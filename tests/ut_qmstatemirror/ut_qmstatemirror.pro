@@ -0,0 +1,15 @@
+include(../common.pri)
+TARGET = ut_qmstatemirror
+QT += dbus
+
+INCLUDEPATH += ../../src/qmsystem2
+
+# unit test and unit
+SOURCES += \
+    ut_qmstatemirror.cpp \
+    ../../src/qmsystem2/qmstatemirror.cpp
+
+# unit test and unit
+HEADERS += \
+    ut_qmstatemirror.h \
+    ../../src/qmsystem2/qmstatemirror_p.h
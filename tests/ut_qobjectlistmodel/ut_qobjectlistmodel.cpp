@@ -28,6 +28,7 @@ private slots:
     void testPopulation();
     void testInsertion();
     void testRemoval();
+    void testRemovalOfMultipleItems();
     void testMove();
     void testUpdate();
     void testSynchronization();
@@ -125,6 +126,25 @@ void Ut_QObjectListModel::testInsertion()
     QCOMPARE(::objectName(model.get(3)), QString("b"));
     QCOMPARE(::objectName(model.get(4)), QString("c"));
 
+    addedSpy.clear();
+    countSpy.clear();
+
+    objects->append(makeObject("f"));
+    objects->append(makeObject("g"));
+    model.insertItems(1, QList<QObject *>() << objects->at(5) << objects->at(6));
+
+    QCOMPARE(addedSpy.count(), 2);
+    QCOMPARE(addedSpy.at(0), QVariantList() << QVariant::fromValue(objects->at(5)));
+    QCOMPARE(addedSpy.at(1), QVariantList() << QVariant::fromValue(objects->at(6)));
+    QCOMPARE(removedSpy.count(), 0);
+    QCOMPARE(countSpy.count(), 1);
+
+    QCOMPARE(model.itemCount(), 7);
+    QCOMPARE(::objectName(model.get(0)), QString("e"));
+    QCOMPARE(::objectName(model.get(1)), QString("f"));
+    QCOMPARE(::objectName(model.get(2)), QString("g"));
+    QCOMPARE(::objectName(model.get(3)), QString("a"));
+
     qDeleteAll(*objects);
     delete objects;
 }
@@ -185,6 +205,60 @@ void Ut_QObjectListModel::testRemoval()
     delete objects;
 }
 
+void Ut_QObjectListModel::testRemovalOfMultipleItems()
+{
+    QList<QObject *> *objects = new QList<QObject *>;
+    objects->append(makeObject("a"));
+    objects->append(makeObject("b"));
+    objects->append(makeObject("c"));
+    objects->append(makeObject("d"));
+    objects->append(makeObject("e"));
+    objects->append(makeObject("f"));
+
+    QObjectListModel model(this);
+    model.addItems(*objects);
+
+    QSignalSpy rowsRemovedSpy(&model, SIGNAL(rowsRemoved(QModelIndex,int,int)));
+    QSignalSpy removedSpy(&model, SIGNAL(itemRemoved(QObject*)));
+    QSignalSpy countSpy(&model, SIGNAL(itemCountChanged()));
+
+    // Each run of adjacent rows is removed with the rows it occupies in the model, starting from the end
+    model.removeItems(QList<QObject *>() << objects->at(4) << objects->at(1) << objects->at(3) << objects->at(2));
+
+    QCOMPARE(model.itemCount(), 2);
+    QCOMPARE(::objectName(model.get(0)), QString("a"));
+    QCOMPARE(::objectName(model.get(1)), QString("f"));
+
+    QCOMPARE(rowsRemovedSpy.count(), 1);
+    QCOMPARE(qvariant_cast<QModelIndex>(rowsRemovedSpy.at(0).at(0)), QModelIndex());
+    QCOMPARE(qvariant_cast<int>(rowsRemovedSpy.at(0).at(1)), 1);
+    QCOMPARE(qvariant_cast<int>(rowsRemovedSpy.at(0).at(2)), 4);
+    QCOMPARE(removedSpy.count(), 4);
+    QCOMPARE(countSpy.count(), 1);
+
+    model.addItems(QList<QObject *>() << objects->at(1) << objects->at(2) << objects->at(3) << objects->at(4));
+    rowsRemovedSpy.clear();
+
+    // The model is now a, f, b, c, d, e: remove f and c, e
+    model.removeItems(QList<QObject *>() << objects->at(5) << objects->at(2) << objects->at(4));
+
+    QCOMPARE(model.itemCount(), 3);
+    QCOMPARE(::objectName(model.get(0)), QString("a"));
+    QCOMPARE(::objectName(model.get(1)), QString("b"));
+    QCOMPARE(::objectName(model.get(2)), QString("d"));
+
+    QCOMPARE(rowsRemovedSpy.count(), 3);
+    QCOMPARE(qvariant_cast<int>(rowsRemovedSpy.at(0).at(1)), 5);
+    QCOMPARE(qvariant_cast<int>(rowsRemovedSpy.at(0).at(2)), 5);
+    QCOMPARE(qvariant_cast<int>(rowsRemovedSpy.at(1).at(1)), 3);
+    QCOMPARE(qvariant_cast<int>(rowsRemovedSpy.at(1).at(2)), 3);
+    QCOMPARE(qvariant_cast<int>(rowsRemovedSpy.at(2).at(1)), 1);
+    QCOMPARE(qvariant_cast<int>(rowsRemovedSpy.at(2).at(2)), 1);
+
+    qDeleteAll(*objects);
+    delete objects;
+}
+
 void Ut_QObjectListModel::testMove()
 {
     QList<QObject *> *objects = new QList<QObject *>;
@@ -7,10 +7,12 @@ INCLUDEPATH += $$SCREENLOCKSRCDIR $$UTILITYSRCDIR $$SRCDIR/xtools ../../src/qmsy
 SOURCES += ut_screenlock.cpp \
     $$SCREENLOCKSRCDIR/screenlock.cpp \
     ../../src/qmsystem2/qmdisplaystate.cpp \
+    ../../src/qmsystem2/qmstatemirror.cpp \
     $$STUBSDIR/stubbase.cpp
 
 HEADERS += ut_screenlock.h \
     $$SCREENLOCKSRCDIR/screenlock.h \
     ../../src/qmsystem2/qmdisplaystate.h \
     ../../src/qmsystem2/qmdisplaystate_p.h \
+    ../../src/qmsystem2/qmstatemirror_p.h \
     $$UTILITYSRCDIR/closeeventeater.h
@@ -16,7 +16,9 @@
 #include "notificationmanager.h"
 #include "notificationmanagerproxy.h"
 
+#include <QElapsedTimer>
 #include <QPair>
+#include <QThread>
 
 #include <iostream>
 #include <iomanip>
@@ -33,7 +35,8 @@ enum ToolOperation {
     Add,
     Update,
     Remove,
-    Purge
+    Purge,
+    Load
 };
 
 // The operation to perform
@@ -73,6 +76,18 @@ QList<QPair<QString, QString> > hints;
 // AppName for the notification
 QString appName;
 
+// Number of notifications to add in a single batch
+int batchSize = 0;
+
+// Number of notifications to post when generating load
+int loadCount = 1000;
+
+// Rate at which to post notifications when generating load, per second, or 0 for as fast as possible
+int loadRate = 0;
+
+// Address of the D-Bus bus to use instead of the session bus
+QString busAddress;
+
 // Prints usage information
 int usage(const char *program)
 {
@@ -86,6 +101,7 @@ int usage(const char *program)
     std::cerr << "                             remove - Removes an existing notification." << std::endl;
     std::cerr << "                             list - Print a summary of existing notifications." << std::endl;
     std::cerr << "                             purge - Remove all existing notifications." << std::endl;
+    std::cerr << "                             load - Post notifications one at a time and report the call latency and throughput." << std::endl;
     std::cerr << "  -i, --id=ID                The notification ID to use when updating or removing a notification." << std::endl;
     std::cerr << "  -u, --urgency=NUMBER       The urgency to assign to the notification." << std::endl;
     std::cerr << "  -p, --priority=NUMBER      The priority to assign to the notification." << std::endl;
@@ -97,10 +113,17 @@ int usage(const char *program)
     std::cerr << "  -a, --action=ACTION        An action for the notification in \"ACTIONNAME[;DISPLAYNAME] DBUSSERVICE DBUSPATH DBUSINTERFACE METHOD [ARGUMENTS]...\" format."<< std::endl;
     std::cerr << "  -h, --hint=HINT            A hint to add to the notification, in \"NAME VALUE\" format."<< std::endl;
     std::cerr << "  -A, --application=NAME     The name to use as identifying the application that owns the notification." << std::endl;
+    std::cerr << "  -b, --batch=NUMBER         Add NUMBER notifications with a single call." << std::endl;
+    std::cerr << "  -n, --number=NUMBER        The number of notifications to post when generating load (default 1000)." << std::endl;
+    std::cerr << "  -r, --rate=NUMBER          Post NUMBER notifications per second when generating load, or 0 for as fast as possible (default)." << std::endl;
+    std::cerr << "  -B, --bus=ADDRESS          Use the D-Bus bus at ADDRESS instead of the session bus, for example a private one." << std::endl;
     std::cerr << "      --help                 display this help and exit" << std::endl;
     std::cerr << std::endl;
     std::cerr << "A notification ID is mandatory when the operation is 'update' or 'remove'." << std::endl;
     std::cerr << "All options other than -o and -i are ignored when the operation is 'remove' or 'purge'." << std::endl;
+    std::cerr << "The batch size is only used when the operation is 'add'. Purging always closes all notifications with a single call." << std::endl;
+    std::cerr << "When generating load each call waits for its reply, so a rate the service cannot sustain is reported as a lower throughput." << std::endl;
+    std::cerr << "The notifications posted when generating load are closed afterwards." << std::endl;
     return -1;
 }
 
@@ -122,11 +145,15 @@ int parseArguments(int argc, char *argv[])
             { "action", required_argument, NULL, 'a' },
             { "hint", required_argument, NULL, 'h' },
             { "application", required_argument, NULL, 'A' },
+            { "batch", required_argument, NULL, 'b' },
+            { "number", required_argument, NULL, 'n' },
+            { "rate", required_argument, NULL, 'r' },
+            { "bus", required_argument, NULL, 'B' },
             { "help", no_argument, NULL, 'H' },
             { 0, 0, 0, 0 }
         };
 
-        int c = getopt_long(argc, argv, "o:i:u:p:I:c:C:t:T:a:h:A:", long_options, &option_index);
+        int c = getopt_long(argc, argv, "o:i:u:p:I:c:C:t:T:a:h:A:b:n:r:B:", long_options, &option_index);
         if (c == -1) {
             break;
         }
@@ -143,6 +170,8 @@ int parseArguments(int argc, char *argv[])
                 toolOperation = Remove;
             } else if (strcmp(optarg, "purge") == 0) {
                 toolOperation = Purge;
+            } else if (strcmp(optarg, "load") == 0) {
+                toolOperation = Load;
             }
             break;
         case 'i':
@@ -219,6 +248,18 @@ int parseArguments(int argc, char *argv[])
         case 'A':
             appName = QString::fromUtf8(optarg);
             break;
+        case 'b':
+            batchSize = atoi(optarg);
+            break;
+        case 'n':
+            loadCount = atoi(optarg);
+            break;
+        case 'r':
+            loadRate = atoi(optarg);
+            break;
+        case 'B':
+            busAddress = QString::fromUtf8(optarg);
+            break;
         case 'H':
             return usage(argv[0]);
             break;
@@ -233,7 +274,9 @@ int parseArguments(int argc, char *argv[])
             (toolOperation == Update && argc < optind) ||
             (toolOperation == Update && id == 0) ||
             (toolOperation == Remove && id == 0) ||
-            (toolOperation == Purge && id != 0)) {
+            (toolOperation == Purge && id != 0) ||
+            (toolOperation == Load && id != 0) ||
+            batchSize < 0 || loadCount <= 0 || loadRate < 0) {
         return usage(argv[0]);
     }
     return 0;
@@ -244,6 +287,67 @@ static QString firstLine(const QString &str)
     return str.left(str.indexOf("\n"));
 }
 
+// Returns the latency below which the given percentage of the sorted latencies fall
+static qint64 percentile(const QList<qint64> &sortedLatencies, int percentage)
+{
+    const int index = (sortedLatencies.count() * percentage + 99) / 100 - 1;
+    return sortedLatencies.at(qBound(0, index, sortedLatencies.count() - 1));
+}
+
+static double toMilliseconds(qint64 nanoseconds)
+{
+    return nanoseconds / 1000000.0;
+}
+
+// Posts notifications one at a time at the requested rate and reports the call latencies and the sustained throughput
+static int generateLoad(NotificationManagerProxy &proxy, const QString &summary, const QString &body, const QStringList &actionValues, const QVariantHash &hintValues)
+{
+    QList<qint64> latencies;
+    QList<uint> ids;
+    int failureCount = 0;
+
+    QElapsedTimer clock;
+    clock.start();
+    for (int i = 0; i < loadCount; ++i) {
+        if (loadRate > 0) {
+            // Keep to the schedule, posting right away when behind it
+            const qint64 delay = qint64(i) * 1000000000 / loadRate - clock.nsecsElapsed();
+            if (delay > 0) {
+                QThread::usleep(delay / 1000);
+            }
+        }
+
+        const qint64 start = clock.nsecsElapsed();
+        QDBusPendingReply<uint> reply = proxy.Notify(appName, 0, icon, summary, body, actionValues, hintValues, expireTimeout);
+        reply.waitForFinished();
+        latencies.append(clock.nsecsElapsed() - start);
+
+        if (reply.isError()) {
+            if (failureCount++ == 0) {
+                std::cerr << qUtf8Printable(reply.error().message()) << std::endl;
+            }
+        } else {
+            ids.append(reply.value());
+        }
+    }
+    const qint64 elapsed = clock.nsecsElapsed();
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "Posted " << loadCount << " notifications in " << std::fixed << std::setprecision(1) << toMilliseconds(elapsed) << " ms"
+              << " (" << failureCount << " failed)" << std::endl;
+    std::cout << "Throughput: " << std::setprecision(1) << loadCount / (elapsed / 1000000000.0) << " notifications/s" << std::endl;
+    std::cout << "Latency: p50 " << std::setprecision(3) << toMilliseconds(percentile(latencies, 50))
+              << " ms, p99 " << toMilliseconds(percentile(latencies, 99))
+              << " ms, max " << toMilliseconds(latencies.last()) << " ms" << std::endl;
+
+    // Leave the service as it was
+    if (!ids.isEmpty()) {
+        proxy.CloseNotifications(ids).waitForFinished();
+    }
+
+    return failureCount > 0 ? -1 : 0;
+}
+
 int main(int argc, char *argv[])
 {
     // Parse arguments
@@ -254,12 +358,20 @@ int main(int argc, char *argv[])
 
     QCoreApplication application(argc, argv);
     qDBusRegisterMetaType<QVariantHash>();
-    NotificationManagerProxy proxy("org.freedesktop.Notifications", "/org/freedesktop/Notifications", QDBusConnection::sessionBus());
+    qDBusRegisterMetaType<LipstickNotification>();
+    qDBusRegisterMetaType<NotificationList>();
+    QDBusConnection connection(busAddress.isEmpty() ? QDBusConnection::sessionBus() : QDBusConnection::connectToBus(busAddress, "notificationtool"));
+    if (!connection.isConnected()) {
+        std::cerr << "Unable to connect to the bus: " << qUtf8Printable(connection.lastError().message()) << std::endl;
+        return -1;
+    }
+    NotificationManagerProxy proxy("org.freedesktop.Notifications", "/org/freedesktop/Notifications", connection);
 
     // Execute the desired operation
     switch (toolOperation) {
     case List: {
         NotificationManager *mgr(NotificationManager::instance());
+        mgr->restorePendingNotifications();
         QList<uint> ids(mgr->notificationIds());
         std::sort(ids.begin(), ids.end());
         foreach (id, ids) {
@@ -271,7 +383,8 @@ int main(int argc, char *argv[])
         break;
         }
     case Add:
-    case Update: {
+    case Update:
+    case Load: {
         // Get the parameters for adding and updating notifications
         QString summary, body, previewSummary, previewBody;
         if (argc >= optind) {
@@ -326,7 +439,24 @@ int main(int argc, char *argv[])
         if (appName.isEmpty()) {
             appName = argv[0];
         }
-        result = proxy.Notify(appName, id, icon, summary, body, actionValues, hintValues, expireTimeout);
+        if (toolOperation == Load) {
+            result = generateLoad(proxy, summary.isEmpty() ? QString("Load test") : summary, body, actionValues, hintValues);
+        } else if (toolOperation == Add && batchSize > 0) {
+            // Add all the notifications with a single call
+            QList<LipstickNotification *> notifications;
+            for (int i = 0; i < batchSize; ++i) {
+                notifications.append(new LipstickNotification(appName, 0, icon, summary, body, actionValues, hintValues, expireTimeout));
+            }
+            QDBusPendingReply<QList<uint> > reply = proxy.NotifyMany(NotificationList(notifications));
+            reply.waitForFinished();
+            if (reply.isError()) {
+                std::cerr << qUtf8Printable(reply.error().message()) << std::endl;
+                result = -1;
+            }
+            qDeleteAll(notifications);
+        } else {
+            result = proxy.Notify(appName, id, icon, summary, body, actionValues, hintValues, expireTimeout);
+        }
         break;
     }
     case Remove:
@@ -335,9 +465,8 @@ int main(int argc, char *argv[])
         }
         break;
     case Purge:
-        foreach (uint id, NotificationManager::instance()->notificationIds()) {
-            proxy.CloseNotification(id);
-        }
+        NotificationManager::instance()->restorePendingNotifications();
+        proxy.CloseNotifications(NotificationManager::instance()->notificationIds()).waitForFinished();
         break;
     default:
         break;